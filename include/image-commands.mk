@@ -395,6 +395,13 @@ define Build/linksys-image
 		mv $@.new $@
 endef
 
+# needs the lz4 host tool, a target whose devices use this has to be added
+# to BUILD_LZ4_TOOLS in tools/Makefile
+define Build/lz4
+	$(STAGING_DIR_HOST)/bin/lz4 -l -12 -q -f $@ $@.new
+	@mv $@.new $@
+endef
+
 define Build/lzma
 	$(call Build/lzma-no-dict,-lc1 -lp2 -pb2 $(1))
 endef
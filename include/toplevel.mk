@@ -63,6 +63,9 @@ endif
 SCAN_COOKIE?=$(shell echo $$$$)
 export SCAN_COOKIE
 
+# parsed menu tree, reused by conf/mconf while no Kconfig input changed
+export KCONFIG_CACHE?=$(TOPDIR)/tmp/.config-cache
+
 SUBMAKE:=umask 022; $(SUBMAKE)
 
 ULIMIT_FIX=_limit=`ulimit -n`; [ "$$_limit" = "unlimited" -o "$$_limit" -ge 1024 ] || ulimit -n 1024;
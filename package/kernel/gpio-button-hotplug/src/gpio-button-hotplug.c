@@ -31,10 +31,20 @@
 #include <linux/gpio/consumer.h>
 
 #define BH_SKB_SIZE	2048
+#define BH_BATCH_MAX	16
+/* polled buttons must be idle this long before their interval backs off */
+#define BH_POLL_IDLE	(5 * HZ)
 
 #define DRV_NAME	"gpio-keys"
 #define PFX	DRV_NAME ": "
 
+struct bh_transition {
+	const char		*name;
+	unsigned int		type;
+	char			*action;
+	unsigned long		seen;
+};
+
 struct bh_event {
 	const char		*name;
 	unsigned int		type;
@@ -43,6 +53,10 @@ struct bh_event {
 
 	struct sk_buff		*skb;
 	struct work_struct	work;
+
+	/* transitions coalesced into this event, see batch_interval */
+	unsigned int		nr_batched;
+	struct bh_transition	batch[];
 };
 
 struct bh_map {
@@ -66,6 +80,21 @@ struct gpio_keys_button_data {
 
 extern u64 uevent_next_seqnum(void);
 
+static unsigned int batch_interval;
+module_param(batch_interval, uint, 0644);
+MODULE_PARM_DESC(batch_interval,
+	"Coalesce button transitions within this many ms into one uevent (0 = off)");
+
+static unsigned int poll_backoff = 1;
+module_param(poll_backoff, uint, 0644);
+MODULE_PARM_DESC(poll_backoff,
+	"Max factor the poll interval of idle polled buttons grows by (1 = fixed)");
+
+static bool poll_irq;
+module_param(poll_irq, bool, 0444);
+MODULE_PARM_DESC(poll_irq,
+	"Poll polled buttons on GPIO interrupts instead of the timer where possible");
+
 #define BH_MAP(_code, _name)		\
 	{				\
 		.code = (_code),	\
@@ -132,6 +161,43 @@ int bh_event_add_var(struct bh_event *event, int argv, const char *format, ...)
 	return 0;
 }
 
+static int button_hotplug_fill_batch(struct bh_event *event)
+{
+	int ret, i;
+
+	if (!event->nr_batched)
+		return 0;
+
+	ret = bh_event_add_var(event, 0, "EVENTS=%u", event->nr_batched);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < event->nr_batched; i++) {
+		struct bh_transition *t = &event->batch[i];
+
+		ret = bh_event_add_var(event, 0, "BUTTON%d=%s", i, t->name);
+		if (ret)
+			return ret;
+
+		ret = bh_event_add_var(event, 0, "ACTION%d=%s", i, t->action);
+		if (ret)
+			return ret;
+
+		if (t->type == EV_SW) {
+			ret = bh_event_add_var(event, 0, "TYPE%d=%s", i,
+					       "switch");
+			if (ret)
+				return ret;
+		}
+
+		ret = bh_event_add_var(event, 0, "SEEN%d=%ld", i, t->seen);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 static int button_hotplug_fill_event(struct bh_event *event)
 {
 	int ret;
@@ -167,6 +233,10 @@ static int button_hotplug_fill_event(struct bh_event *event)
 	if (ret)
 		return ret;
 
+	ret = button_hotplug_fill_batch(event);
+	if (ret)
+		return ret;
+
 	ret = bh_event_add_var(event, 0, "SEQNUM=%llu", uevent_next_seqnum());
 
 	return ret;
@@ -201,6 +271,75 @@ static void button_hotplug_work(struct work_struct *work)
 	kfree(event);
 }
 
+static DEFINE_MUTEX(bh_batch_lock);
+static struct bh_event *bh_batch;
+
+static void button_hotplug_batch_flush(struct work_struct *work)
+{
+	struct bh_event *event;
+
+	mutex_lock(&bh_batch_lock);
+	event = bh_batch;
+	bh_batch = NULL;
+	mutex_unlock(&bh_batch_lock);
+
+	if (event)
+		button_hotplug_work(&event->work);
+}
+
+static DECLARE_DELAYED_WORK(bh_batch_work, button_hotplug_batch_flush);
+
+/*
+ * Append a transition to the pending batch. The first transition also fills
+ * the classic BUTTON/ACTION/SEEN variables, so a batch of one looks like a
+ * plain event apart from the EVENTS/BUTTONn/ACTIONn/SEENn variables.
+ */
+static int button_hotplug_batch_event(const char *name, unsigned int type,
+		unsigned long seen, int pressed)
+{
+	struct bh_event *event;
+	struct bh_transition *t;
+
+	mutex_lock(&bh_batch_lock);
+
+	event = bh_batch;
+	if (!event) {
+		event = kzalloc(struct_size(event, batch, BH_BATCH_MAX),
+				GFP_KERNEL);
+		if (!event) {
+			mutex_unlock(&bh_batch_lock);
+			return -ENOMEM;
+		}
+
+		event->name = name;
+		event->type = type;
+		event->seen = seen;
+		event->action = pressed ? "pressed" : "released";
+		INIT_WORK(&event->work, (void *)(void *)button_hotplug_work);
+
+		bh_batch = event;
+		schedule_delayed_work(&bh_batch_work,
+				      msecs_to_jiffies(batch_interval));
+	}
+
+	t = &event->batch[event->nr_batched++];
+	t->name = name;
+	t->type = type;
+	t->seen = seen;
+	t->action = pressed ? "pressed" : "released";
+
+	/* a full batch goes out right away, the next one starts a new timer */
+	if (event->nr_batched == BH_BATCH_MAX) {
+		bh_batch = NULL;
+		cancel_delayed_work(&bh_batch_work);
+		schedule_work(&event->work);
+	}
+
+	mutex_unlock(&bh_batch_lock);
+
+	return 0;
+}
+
 static int button_hotplug_create_event(const char *name, unsigned int type,
 		unsigned long seen, int pressed)
 {
@@ -209,6 +348,9 @@ static int button_hotplug_create_event(const char *name, unsigned int type,
 	pr_debug(PFX "create event, name=%s, seen=%lu, pressed=%d\n",
 		 name, seen, pressed);
 
+	if (batch_interval)
+		return button_hotplug_batch_event(name, type, seen, pressed);
+
 	event = kzalloc(sizeof(*event), GFP_KERNEL);
 	if (!event)
 		return -ENOMEM;
@@ -249,7 +391,8 @@ static int gpio_button_get_value(struct gpio_keys_button_data *bdata)
 	return val;
 }
 
-static void gpio_keys_handle_button(struct gpio_keys_button_data *bdata)
+/* returns true while the button changes state or is being debounced */
+static bool gpio_keys_handle_button(struct gpio_keys_button_data *bdata)
 {
 	unsigned int type = bdata->b->type ?: EV_KEY;
 	int state = gpio_button_get_value(bdata);
@@ -275,12 +418,12 @@ static void gpio_keys_handle_button(struct gpio_keys_button_data *bdata)
 	} else if (bdata->last_state == state) {
 		/* reset asserted counter (only relevant for polled keys) */
 		bdata->count = 0;
-		return;
+		return false;
 	}
 
 	if (bdata->count < bdata->threshold) {
 		bdata->count++;
-		return;
+		return true;
 	}
 
 	if (bdata->seen == 0)
@@ -293,47 +436,141 @@ static void gpio_keys_handle_button(struct gpio_keys_button_data *bdata)
 set_state:
 	bdata->last_state = state;
 	bdata->count = 0;
+
+	return true;
 }
 
 struct gpio_keys_button_dev {
 	int polled;
-	struct delayed_work work;
+
+	/* polled devices, serviced by gpio_keys_polled_work */
+	struct list_head list;
+	unsigned long interval;
+	unsigned long next_poll;
+	unsigned long last_active;
+	bool irq_driven;
+	bool parked;
 
 	struct device *dev;
 	struct gpio_keys_platform_data *pdata;
 	struct gpio_keys_button_data data[0];
 };
 
-static void gpio_keys_polled_queue_work(struct gpio_keys_button_dev *bdev)
+/*
+ * All polled devices share one delayed work. Every device keeps its own
+ * interval, which doubles up to poll_backoff times the configured
+ * poll-interval once its buttons have been idle for BH_POLL_IDLE and drops
+ * back to it as soon as a button changes. Devices whose buttons all have
+ * an interrupt (poll_irq) stop polling completely when idle and are woken
+ * up by the next edge.
+ */
+static LIST_HEAD(gpio_keys_polled_list);
+static DEFINE_MUTEX(gpio_keys_polled_lock);
+
+static void gpio_keys_polled_poll(struct work_struct *work);
+static DECLARE_DELAYED_WORK(gpio_keys_polled_work, gpio_keys_polled_poll);
+
+static void gpio_keys_polled_queue_work(void)
 {
-	struct gpio_keys_platform_data *pdata = bdev->pdata;
-	unsigned long delay = msecs_to_jiffies(pdata->poll_interval);
+	struct gpio_keys_button_dev *bdev;
+	unsigned long next = 0, delay = 0;
+	bool pending = false;
+
+	list_for_each_entry(bdev, &gpio_keys_polled_list, list) {
+		if (bdev->parked)
+			continue;
+
+		if (!pending || time_before(bdev->next_poll, next))
+			next = bdev->next_poll;
+		pending = true;
+	}
 
+	if (!pending)
+		return;
+
+	if (time_after(next, jiffies))
+		delay = next - jiffies;
 	if (delay >= HZ)
 		delay = round_jiffies_relative(delay);
-	schedule_delayed_work(&bdev->work, delay);
+	mod_delayed_work(system_wq, &gpio_keys_polled_work, delay);
 }
 
-static void gpio_keys_polled_poll(struct work_struct *work)
+static void gpio_keys_polled_poll_dev(struct gpio_keys_button_dev *bdev,
+				      unsigned long now)
 {
-	struct gpio_keys_button_dev *bdev =
-		container_of(work, struct gpio_keys_button_dev, work.work);
+	unsigned long base = msecs_to_jiffies(bdev->pdata->poll_interval) ?: 1;
+	unsigned long limit = base * max(poll_backoff, 1U);
+	bool active = false;
 	int i;
 
 	for (i = 0; i < bdev->pdata->nbuttons; i++) {
 		struct gpio_keys_button_data *bdata = &bdev->data[i];
 
-		if (bdata->gpiod)
-			gpio_keys_handle_button(bdata);
+		if (bdata->gpiod && gpio_keys_handle_button(bdata))
+			active = true;
+	}
+
+	if (active) {
+		bdev->interval = base;
+		bdev->last_active = now;
+	} else if (bdev->irq_driven) {
+		bdev->parked = true;
+	} else if (time_after(now, bdev->last_active + BH_POLL_IDLE)) {
+		bdev->interval = min(bdev->interval * 2, limit);
+	}
+
+	bdev->next_poll = now + bdev->interval;
+}
+
+static void gpio_keys_polled_poll(struct work_struct *work)
+{
+	struct gpio_keys_button_dev *bdev;
+	unsigned long now = jiffies;
+
+	mutex_lock(&gpio_keys_polled_lock);
+	list_for_each_entry(bdev, &gpio_keys_polled_list, list) {
+		/* devices due within a quarter interval share this wakeup */
+		if (bdev->parked ||
+		    time_before(now + bdev->interval / 4, bdev->next_poll))
+			continue;
+
+		gpio_keys_polled_poll_dev(bdev, now);
 	}
-	gpio_keys_polled_queue_work(bdev);
+	gpio_keys_polled_queue_work();
+	mutex_unlock(&gpio_keys_polled_lock);
+}
+
+static void gpio_keys_polled_kick(struct gpio_keys_button_dev *bdev)
+{
+	mutex_lock(&gpio_keys_polled_lock);
+	bdev->parked = false;
+	bdev->interval = msecs_to_jiffies(bdev->pdata->poll_interval) ?: 1;
+	bdev->next_poll = jiffies;
+	bdev->last_active = jiffies;
+	mod_delayed_work(system_wq, &gpio_keys_polled_work, 0);
+	mutex_unlock(&gpio_keys_polled_lock);
+}
+
+static irqreturn_t gpio_keys_polled_handle_irq(int irq, void *_bdev)
+{
+	gpio_keys_polled_kick(_bdev);
+
+	return IRQ_HANDLED;
 }
 
 static void gpio_keys_polled_close(struct gpio_keys_button_dev *bdev)
 {
 	struct gpio_keys_platform_data *pdata = bdev->pdata;
+	int i;
+
+	for (i = 0; i < pdata->nbuttons; i++)
+		if (bdev->data[i].irq)
+			disable_irq(bdev->data[i].irq);
 
-	cancel_delayed_work_sync(&bdev->work);
+	/* the shared work holds the lock while it touches a device */
+	mutex_lock(&gpio_keys_polled_lock);
+	list_del(&bdev->list);
+	mutex_unlock(&gpio_keys_polled_lock);
 
 	if (pdata->disable)
 		pdata->disable(bdev->dev);
@@ -639,6 +876,43 @@ static int gpio_keys_probe(struct platform_device *pdev)
 	return 0;
 }
 
+static bool gpio_keys_polled_request_irqs(struct platform_device *pdev,
+					  struct gpio_keys_button_dev *bdev)
+{
+	struct gpio_keys_platform_data *pdata = bdev->pdata;
+	bool irq_driven = true;
+	int i, ret;
+
+	for (i = 0; i < pdata->nbuttons; i++) {
+		struct gpio_keys_button_data *bdata = &bdev->data[i];
+		int irq;
+
+		if (!bdata->gpiod)
+			continue;
+
+		irq = gpiod_to_irq(bdata->gpiod);
+		if (irq <= 0) {
+			irq_driven = false;
+			continue;
+		}
+
+		ret = devm_request_threaded_irq(&pdev->dev, irq, NULL,
+			gpio_keys_polled_handle_irq, IRQF_ONESHOT |
+			IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING,
+			dev_name(&pdev->dev), bdev);
+		if (ret < 0) {
+			dev_dbg(&pdev->dev, "polling button %d, no irq:%d\n",
+				i, irq);
+			irq_driven = false;
+			continue;
+		}
+
+		bdata->irq = irq;
+	}
+
+	return irq_driven;
+}
+
 static int gpio_keys_polled_probe(struct platform_device *pdev)
 {
 	struct gpio_keys_platform_data *pdata;
@@ -649,13 +923,20 @@ static int gpio_keys_polled_probe(struct platform_device *pdev)
 	if (ret)
 		return ret;
 
-	INIT_DELAYED_WORK(&bdev->work, gpio_keys_polled_poll);
-
 	pdata = bdev->pdata;
 	if (pdata->enable)
 		pdata->enable(bdev->dev);
 
-	gpio_keys_polled_queue_work(bdev);
+	if (poll_irq)
+		bdev->irq_driven = gpio_keys_polled_request_irqs(pdev, bdev);
+
+	mutex_lock(&gpio_keys_polled_lock);
+	bdev->interval = msecs_to_jiffies(pdata->poll_interval) ?: 1;
+	bdev->next_poll = jiffies + bdev->interval;
+	bdev->last_active = jiffies;
+	list_add_tail(&bdev->list, &gpio_keys_polled_list);
+	gpio_keys_polled_queue_work();
+	mutex_unlock(&gpio_keys_polled_lock);
 
 	return ret;
 }
@@ -726,6 +1007,8 @@ static void __exit gpio_button_exit(void)
 {
 	platform_driver_unregister(&gpio_keys_driver);
 	platform_driver_unregister(&gpio_keys_polled_driver);
+	cancel_delayed_work_sync(&gpio_keys_polled_work);
+	flush_delayed_work(&bh_batch_work);
 }
 
 module_init(gpio_button_init);
@@ -56,6 +56,7 @@
 #include <linux/interrupt.h>
 #include <linux/delay.h>
 #include <asm/byteorder.h>
+#include <asm/unaligned.h>
 #include <crypto/algapi.h>
 #include <crypto/b128ops.h>
 #include <crypto/gcm.h>
@@ -135,11 +136,16 @@ struct aes_ctx {
     u8 block[AES_BLOCK_SIZE];
     u8 hash[AES_BLOCK_SIZE];
     struct gf128mul_4k *gf128;
+    u32 key_id;
 };
 
 extern int disable_deudma;
 extern int disable_multiblock; 
 
+/* id of the key currently loaded into the DEU, 0 if none or the tweak key */
+static u32 aes_hw_key_id;
+static atomic_t aes_key_seq = ATOMIC_INIT(0);
+
 /*! \fn int aes_set_key (struct crypto_tfm *tfm, const uint8_t *in_key, unsigned int key_len)
  *  \ingroup IFX_AES_FUNCTIONS 
  *  \brief sets the AES keys    
@@ -162,6 +168,7 @@ int aes_set_key (struct crypto_tfm *tfm, const u8 *in_key, unsigned int key_len)
 
     ctx->key_length = key_len;
     ctx->use_tweak = 0;
+    ctx->key_id = atomic_inc_return(&aes_key_seq);
     DPRINTF(0, "ctx @%p, key_len %d, ctx->key_length %d\n", ctx, key_len, ctx->key_length);
     memcpy ((u8 *) (ctx->buf), in_key, key_len);
 
@@ -183,9 +190,10 @@ int aes_set_key_skcipher (struct crypto_skcipher *tfm, const u8 *in_key, unsigne
 }
 
 
-/*! \fn void aes_set_key_skcipher (void *ctx_arg)
+/*! \fn void aes_set_key_hw (void *ctx_arg)
  *  \ingroup IFX_AES_FUNCTIONS
- *  \brief sets the AES key to the hardware, requires spinlock to be set by caller
+ *  \brief sets the AES key to the hardware, requires spinlock to be set by caller.
+ *         The key registers are left untouched if they still hold this key.
  *  \param ctx_arg crypto algo context  
  *  \return
 */
@@ -200,6 +208,9 @@ void aes_set_key_hw (void *ctx_arg)
 
     if (ctx->use_tweak) in_key = ctx->tweakkey;
 
+    if (!ctx->use_tweak && ctx->key_id && ctx->key_id == aes_hw_key_id)
+        return;
+
     /* 128, 192 or 256 bit key length */
     aes->controlr.K = key_len / 8 - 2;
         if (key_len == 128 / 8) {
@@ -236,6 +247,7 @@ void aes_set_key_hw (void *ctx_arg)
        checked in decryption routine! */
     aes->controlr.PNK = 1;
 
+    aes_hw_key_id = ctx->use_tweak ? 0 : ctx->key_id;
 }
 
 
@@ -360,6 +372,7 @@ int ctr_rfc3686_aes_set_key (struct crypto_tfm *tfm, const uint8_t *in_key, unsi
 
     ctx->key_length = key_len;
     ctx->use_tweak = 0;
+    ctx->key_id = atomic_inc_return(&aes_key_seq);
     
     memcpy ((u8 *) (ctx->buf), in_key, key_len);
 
@@ -924,6 +937,7 @@ int xts_aes_set_key_skcipher (struct crypto_skcipher *tfm, const u8 *in_key, uns
 
     ctx->key_length = keylen;
     ctx->use_tweak = 0;
+    ctx->key_id = atomic_inc_return(&aes_key_seq);
     DPRINTF(0, "ctx @%p, key_len %d, ctx->key_length %d\n", ctx, key_len, ctx->key_length);
     memcpy ((u8 *) (ctx->buf), in_key, keylen);
     memcpy ((u8 *) (ctx->tweakkey), in_key + keylen, keylen);
@@ -1606,236 +1620,312 @@ int gcm_aes_setauthsize (struct crypto_aead *aead, unsigned int authsize)
     return crypto_gcm_check_authsize(authsize);
 }
 
-/*! \fn int gcm_aes_encrypt(struct aead_request *req)
+/*! \fn static inline void aes_hw_write_iv (volatile struct aes_t *aes, const u8 *iv)
  *  \ingroup IFX_AES_FUNCTIONS
- *  \brief GCM AES encrypt using linux crypto aead
- *  \param req aead request
- *  \return err
+ *  \brief loads the IV/counter registers, requires spinlock to be set by caller
+ *  \param aes DEU AES registers
+ *  \param iv initialization vector or counter block
 */
-int gcm_aes_encrypt(struct aead_request *req)
+static inline void aes_hw_write_iv (volatile struct aes_t *aes, const u8 *iv)
 {
-    struct aes_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-    struct skcipher_walk walk;
-    struct skcipher_request request;
-    int err;
-    unsigned int enc_bytes, nbytes;
-    be128 lengths;
-    u8 iv[AES_BLOCK_SIZE];
+    aes->IV3R = DEU_ENDIAN_SWAP(*(u32 *) iv);
+    aes->IV2R = DEU_ENDIAN_SWAP(*((u32 *) iv + 1));
+    aes->IV1R = DEU_ENDIAN_SWAP(*((u32 *) iv + 2));
+    aes->IV0R = DEU_ENDIAN_SWAP(*((u32 *) iv + 3));
+}
 
-    lengths.a = cpu_to_be64(req->assoclen * 8);
-    lengths.b = cpu_to_be64(req->cryptlen * 8);
+/*! \fn static inline void aes_hw_read_iv (volatile struct aes_t *aes, u8 *iv)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief reads back the IV/counter registers, requires spinlock to be set by caller
+ *  \param aes DEU AES registers
+ *  \param iv initialization vector or counter block
+*/
+static inline void aes_hw_read_iv (volatile struct aes_t *aes, u8 *iv)
+{
+    *((u32 *) iv) = DEU_ENDIAN_SWAP(aes->IV3R);
+    *((u32 *) iv + 1) = DEU_ENDIAN_SWAP(aes->IV2R);
+    *((u32 *) iv + 2) = DEU_ENDIAN_SWAP(aes->IV1R);
+    *((u32 *) iv + 3) = DEU_ENDIAN_SWAP(aes->IV0R);
+}
 
-    memset(ctx->hash, 0, sizeof(ctx->hash));
-    memset(ctx->block, 0, sizeof(ctx->block));
-    memcpy(iv, req->iv, GCM_AES_IV_SIZE);
-    *(__be32 *)((void *)iv + GCM_AES_IV_SIZE) = cpu_to_be32(1);
-    ifx_deu_aes_ctr(ctx, ctx->block, ctx->block,
-                       iv, 16, CRYPTO_DIR_ENCRYPT, 0);
+/*! \fn static inline void aes_hw_start_block (volatile struct aes_t *aes, const u8 *in)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief writes one input block, which starts the DEU
+ *  \param aes DEU AES registers
+ *  \param in 16-byte block of input
+*/
+static inline void aes_hw_start_block (volatile struct aes_t *aes, const u8 *in)
+{
+    aes->ID3R = INPUT_ENDIAN_SWAP(*((u32 *) in + 0));
+    aes->ID2R = INPUT_ENDIAN_SWAP(*((u32 *) in + 1));
+    aes->ID1R = INPUT_ENDIAN_SWAP(*((u32 *) in + 2));
+    aes->ID0R = INPUT_ENDIAN_SWAP(*((u32 *) in + 3));    /* start crypto */
+}
 
-    request.cryptlen = req->cryptlen + req->assoclen;
-    request.src = req->src;
-    request.dst = req->dst;
-    request.base = req->base;
+/*! \fn static inline void aes_hw_finish_block (volatile struct aes_t *aes, u8 *out)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief waits for the DEU and reads one output block
+ *  \param aes DEU AES registers
+ *  \param out 16-byte block of output, NULL to discard it
+*/
+static inline void aes_hw_finish_block (volatile struct aes_t *aes, u8 *out)
+{
+    while (aes->controlr.BUS) {
+        // this will not take long
+    }
 
-    crypto_skcipher_alg(crypto_skcipher_reqtfm(&request))->walksize = AES_BLOCK_SIZE;
+    if (!out)
+        return;
 
-    if (req->assoclen && (req->assoclen < AES_BLOCK_SIZE))
-        crypto_skcipher_alg(crypto_skcipher_reqtfm(&request))->walksize = req->assoclen;
+    *((volatile u32 *) out + 0) = aes->OD3R;
+    *((volatile u32 *) out + 1) = aes->OD2R;
+    *((volatile u32 *) out + 2) = aes->OD1R;
+    *((volatile u32 *) out + 3) = aes->OD0R;
+}
 
-    err = skcipher_walk_virt(&walk, &request, false);
+/*! \fn static void ifx_deu_aes_resident (u8 *out_arg, const u8 *in_arg, size_t nbytes)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief runs data through the DEU with mode, key and IV already programmed,
+ *         requires spinlock to be set by caller
+ *  \param out_arg output bytestream, NULL to discard the output (CBC-MAC)
+ *  \param in_arg input bytestream
+ *  \param nbytes length of bytestream, a trailing partial block is zero padded
+*/
+static void ifx_deu_aes_resident (u8 *out_arg, const u8 *in_arg, size_t nbytes)
+{
+    volatile struct aes_t *aes = (volatile struct aes_t *) AES_START;
+    u8 temparea[AES_BLOCK_SIZE];
 
-    //process assoc data if available
-    if (req->assoclen > 0) {
-        unsigned int assoc_remain, ghashlen;
+    while (nbytes >= AES_BLOCK_SIZE) {
+        aes_hw_start_block(aes, in_arg);
+        aes_hw_finish_block(aes, out_arg);
 
-        assoc_remain = req->assoclen;
-        ghashlen = min(req->assoclen, walk.nbytes);
-        while ((nbytes = enc_bytes = ghashlen) && (ghashlen >= AES_BLOCK_SIZE)) {
-            u8 *temp;
-            if (nbytes > req->assoclen) nbytes = enc_bytes = req->assoclen;
-            enc_bytes -= (nbytes % AES_BLOCK_SIZE);
-            memcpy(walk.dst.virt.addr, walk.src.virt.addr, enc_bytes);
-            assoc_remain -= enc_bytes;
-            temp = walk.dst.virt.addr;
-            while (enc_bytes > 0) {
-                u128_xor((u128 *)ctx->hash, (u128 *)ctx->hash, (u128 *)temp);
-                gf128mul_4k_lle((be128 *)ctx->hash, ctx->gf128);
-                enc_bytes -= AES_BLOCK_SIZE;
-                temp += 16;
-            }
-            if (assoc_remain < AES_BLOCK_SIZE) walk.stride = assoc_remain;
-            if (assoc_remain == 0) walk.stride = AES_BLOCK_SIZE;
-            enc_bytes = nbytes - (nbytes % AES_BLOCK_SIZE);
-            err = skcipher_walk_done(&walk, (walk.nbytes - enc_bytes));
-            ghashlen = min(assoc_remain, walk.nbytes);
-        }
+        in_arg += AES_BLOCK_SIZE;
+        if (out_arg)
+            out_arg += AES_BLOCK_SIZE;
+        nbytes -= AES_BLOCK_SIZE;
+    }
 
-        if ((enc_bytes = ghashlen)) {
-            memcpy(ctx->lastbuffer, walk.src.virt.addr, enc_bytes);
-            memset(ctx->lastbuffer + enc_bytes, 0, (AES_BLOCK_SIZE - enc_bytes));
-            memcpy(walk.dst.virt.addr, walk.src.virt.addr, ghashlen);
-            u128_xor((u128 *)ctx->hash, (u128 *)ctx->hash, (u128 *)ctx->lastbuffer);
-            gf128mul_4k_lle((be128 *)ctx->hash, ctx->gf128);
-            walk.stride = AES_BLOCK_SIZE;
-            err = skcipher_walk_done(&walk, (walk.nbytes - ghashlen));
-        }
+    if (nbytes) {
+        memset(temparea, 0, sizeof(temparea));
+        memcpy(temparea, in_arg, nbytes);
+        aes_hw_start_block(aes, temparea);
+        aes_hw_finish_block(aes, temparea);
+        if (out_arg)
+            memcpy(out_arg, temparea, nbytes);
     }
+}
 
-    //crypt and hash
-    while ((nbytes = enc_bytes = walk.nbytes) && (walk.nbytes >= AES_BLOCK_SIZE)) {
-        u8 *temp;
-        enc_bytes -= (nbytes % AES_BLOCK_SIZE);
-        ifx_deu_aes_ctr(ctx, walk.dst.virt.addr, walk.src.virt.addr,
-                       iv, enc_bytes, CRYPTO_DIR_ENCRYPT, 0);
-        nbytes &= AES_BLOCK_SIZE - 1;
-        temp = walk.dst.virt.addr;
-        while (enc_bytes) {
-            u128_xor((u128 *)ctx->hash, (u128 *)ctx->hash, (u128 *)temp);
-            gf128mul_4k_lle((be128 *)ctx->hash, ctx->gf128);
-            enc_bytes -= AES_BLOCK_SIZE;
-            temp += 16;
-        }
-        err = skcipher_walk_done(&walk, nbytes);
+/*! \fn static inline void gcm_aes_ghash_block (struct aes_ctx *ctx, u8 *hash, const u8 *data)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief folds one 16-byte block into the running GHASH value
+ *  \param ctx crypto algo context
+ *  \param hash running GHASH value
+ *  \param data 16-byte block of input
+*/
+static inline void gcm_aes_ghash_block (struct aes_ctx *ctx, u8 *hash, const u8 *data)
+{
+    u128_xor((u128 *)hash, (u128 *)hash, (u128 *)data);
+    gf128mul_4k_lle((be128 *)hash, ctx->gf128);
+}
+
+/*! \fn static void aead_aes_copy_assoc (struct aead_request *req)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief copy the associated data to dst for out of place requests, the
+ *         skcipher walk only covers the payload
+ *  \param req aead request
+*/
+static void aead_aes_copy_assoc (struct aead_request *req)
+{
+    u8 block[AES_BLOCK_SIZE];
+    unsigned int offset, len;
+
+    if (req->src == req->dst)
+        return;
+
+    for (offset = 0; offset < req->assoclen; offset += len) {
+        len = min_t(unsigned int, req->assoclen - offset, AES_BLOCK_SIZE);
+        scatterwalk_map_and_copy(block, req->src, offset, len, 0);
+        scatterwalk_map_and_copy(block, req->dst, offset, len, 1);
     }
+}
 
-    /* crypt and hash remaining bytes < AES_BLOCK_SIZE */
-    if ((enc_bytes = walk.nbytes)) {
-        ifx_deu_aes_ctr(ctx, walk.dst.virt.addr, walk.src.virt.addr,
-                       iv, walk.nbytes, CRYPTO_DIR_ENCRYPT, 0);
-        memcpy(ctx->lastbuffer, walk.dst.virt.addr, enc_bytes);
-        memset(ctx->lastbuffer + enc_bytes, 0, (AES_BLOCK_SIZE - enc_bytes));
-        u128_xor((u128 *)ctx->hash, (u128 *)ctx->hash, (u128 *)ctx->lastbuffer);
-        gf128mul_4k_lle((be128 *)ctx->hash, ctx->gf128);
-        err = skcipher_walk_done(&walk, 0);
+/*! \fn static void gcm_aes_ghash_assoc (struct aes_ctx *ctx, struct aead_request *req, u8 *hash)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief GHASH of the associated data, zero padded to the block size
+ *  \param ctx crypto algo context
+ *  \param req aead request
+ *  \param hash running GHASH value
+*/
+static void gcm_aes_ghash_assoc (struct aes_ctx *ctx, struct aead_request *req, u8 *hash)
+{
+    u8 block[AES_BLOCK_SIZE];
+    unsigned int offset, len;
+
+    for (offset = 0; offset < req->assoclen; offset += len) {
+        len = min_t(unsigned int, req->assoclen - offset, AES_BLOCK_SIZE);
+        memset(block, 0, sizeof(block));
+        scatterwalk_map_and_copy(block, req->src, offset, len, 0);
+        gcm_aes_ghash_block(ctx, hash, block);
     }
+}
 
-    //finalize and copy hash
-    u128_xor((u128 *)ctx->hash, (u128 *)ctx->hash, (u128 *)&lengths);
-    gf128mul_4k_lle((be128 *)ctx->hash, ctx->gf128);
-    u128_xor((u128 *)ctx->hash, (u128 *)ctx->hash, (u128 *)ctx->block);
-    scatterwalk_map_and_copy(ctx->hash, req->dst, req->cryptlen + req->assoclen, crypto_aead_authsize(crypto_aead_reqtfm(req)), 1);
+/*! \fn static void ifx_deu_aes_gcm_chunk (struct aes_ctx *ctx, u8 *out_arg, const u8 *in_arg, u8 *hash, size_t nbytes, int encdec)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief CTR crypt and GHASH one chunk with key and counter resident in the DEU.
+ *         The software GHASH of a block runs while the DEU works on the next one.
+ *         Requires spinlock to be set and CTR mode to be programmed by caller.
+ *  \param ctx crypto algo context
+ *  \param out_arg output bytestream
+ *  \param in_arg input bytestream
+ *  \param hash running GHASH value
+ *  \param nbytes length of bytestream, may only be a partial block at the end
+ *  \param encdec 1 for encrypt; 0 for decrypt
+*/
+static void ifx_deu_aes_gcm_chunk (struct aes_ctx *ctx, u8 *out_arg, const u8 *in_arg,
+        u8 *hash, size_t nbytes, int encdec)
+{
+    volatile struct aes_t *aes = (volatile struct aes_t *) AES_START;
+    const u8 *prev = NULL;
+    u8 temparea[AES_BLOCK_SIZE];
 
-    aead_request_complete(req, 0);
+    while (nbytes >= AES_BLOCK_SIZE) {
+        aes_hw_start_block(aes, in_arg);
 
-    return err;
+        /* decryption hashes the input before an in-place result overwrites it */
+        if (!encdec)
+            gcm_aes_ghash_block(ctx, hash, in_arg);
+        else if (prev)
+            gcm_aes_ghash_block(ctx, hash, prev);
+
+        aes_hw_finish_block(aes, out_arg);
+
+        prev = out_arg;
+        in_arg += AES_BLOCK_SIZE;
+        out_arg += AES_BLOCK_SIZE;
+        nbytes -= AES_BLOCK_SIZE;
+    }
+
+    if (encdec && prev)
+        gcm_aes_ghash_block(ctx, hash, prev);
+
+    /* To handle all non-aligned bytes (not aligned to 16B size) */
+    if (nbytes) {
+        memset(temparea, 0, sizeof(temparea));
+        memcpy(temparea, in_arg, nbytes);
+        if (!encdec)
+            gcm_aes_ghash_block(ctx, hash, temparea);
+
+        aes_hw_start_block(aes, temparea);
+        aes_hw_finish_block(aes, temparea);
+        memcpy(out_arg, temparea, nbytes);
+
+        if (encdec) {
+            memset(temparea + nbytes, 0, AES_BLOCK_SIZE - nbytes);
+            gcm_aes_ghash_block(ctx, hash, temparea);
+        }
+    }
 }
 
-/*! \fn int gcm_aes_decrypt(struct aead_request *req)
+/*! \fn static int gcm_aes_crypt(struct aead_request *req, int encdec)
  *  \ingroup IFX_AES_FUNCTIONS
- *  \brief GCM AES decrypt using linux crypto aead
+ *  \brief GCM AES using linux crypto aead, the DEU keeps key and counter for the
+ *         whole scatterlist
  *  \param req aead request
+ *  \param encdec 1 for encrypt; 0 for decrypt
  *  \return err
 */
-int gcm_aes_decrypt(struct aead_request *req)
+static int gcm_aes_crypt(struct aead_request *req, int encdec)
 {
-    struct aes_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+    struct crypto_aead *aead = crypto_aead_reqtfm(req);
+    struct aes_ctx *ctx = crypto_aead_ctx(aead);
+    volatile struct aes_t *aes = (volatile struct aes_t *) AES_START;
+    unsigned int authsize = crypto_aead_authsize(aead);
+    unsigned int cryptlen = req->cryptlen - (encdec ? 0 : authsize);
     struct skcipher_walk walk;
-    struct skcipher_request request;
-    int err;
-    unsigned int dec_bytes, nbytes, authsize;
-    be128 lengths;
+    unsigned long flag;
     u8 iv[AES_BLOCK_SIZE];
+    u8 hash[AES_BLOCK_SIZE] = {0,};
+    u8 tagmask[AES_BLOCK_SIZE] = {0,};
+    u8 tag[AES_BLOCK_SIZE];
+    be128 lengths;
+    int err;
 
-    authsize = crypto_aead_authsize(crypto_aead_reqtfm(req));
-
-    lengths.a = cpu_to_be64(req->assoclen * 8);
-    lengths.b = cpu_to_be64((req->cryptlen - authsize) * 8);
-
-    memset(ctx->hash, 0, sizeof(ctx->hash));
-    memset(ctx->block, 0, sizeof(ctx->block));
     memcpy(iv, req->iv, GCM_AES_IV_SIZE);
     *(__be32 *)((void *)iv + GCM_AES_IV_SIZE) = cpu_to_be32(1);
-    ifx_deu_aes_ctr(ctx, ctx->block, ctx->block,
-                       iv, 16, CRYPTO_DIR_ENCRYPT, 0);
 
-    request.cryptlen = req->cryptlen + req->assoclen - authsize;
-    request.src = req->src;
-    request.dst = req->dst;
-    request.base = req->base;
-    crypto_skcipher_alg(crypto_skcipher_reqtfm(&request))->walksize = AES_BLOCK_SIZE;
+    gcm_aes_ghash_assoc(ctx, req, hash);
+    aead_aes_copy_assoc(req);
 
-    if (req->assoclen && (req->assoclen < AES_BLOCK_SIZE))
-        crypto_skcipher_alg(crypto_skcipher_reqtfm(&request))->walksize = req->assoclen;
+    /* atomic walk, the DEU stays locked until the last chunk is done */
+    if (encdec)
+        err = skcipher_walk_aead_encrypt(&walk, req, true);
+    else
+        err = skcipher_walk_aead_decrypt(&walk, req, true);
+    if (err)
+        return err;
 
-    err = skcipher_walk_virt(&walk, &request, false);
+    CRTCL_SECT_START;
 
-    //process assoc data if available
-    if (req->assoclen > 0) {
-        unsigned int assoc_remain, ghashlen;
+    aes_set_key_hw (ctx);
+    aes->controlr.E_D = !CRYPTO_DIR_ENCRYPT;    //encryption
+    aes->controlr.O = 4; //0 ECB 1 CBC 2 OFB 3 CFB 4 CTR
+    aes_hw_write_iv(aes, iv);
 
-        assoc_remain = req->assoclen;
-        ghashlen = min(req->assoclen, walk.nbytes);
-        while ((nbytes = dec_bytes = ghashlen) && (ghashlen >= AES_BLOCK_SIZE)) {
-            u8 *temp;
-            if (nbytes > req->assoclen) nbytes = dec_bytes = req->assoclen;
-            dec_bytes -= (nbytes % AES_BLOCK_SIZE);
-            memcpy(walk.dst.virt.addr, walk.src.virt.addr, dec_bytes);
-            assoc_remain -= dec_bytes;
-            temp = walk.dst.virt.addr;
-            while (dec_bytes > 0) {
-                u128_xor((u128 *)ctx->hash, (u128 *)ctx->hash, (u128 *)temp);
-                gf128mul_4k_lle((be128 *)ctx->hash, ctx->gf128);
-                dec_bytes -= AES_BLOCK_SIZE;
-                temp += 16;
-            }
-            if (assoc_remain < AES_BLOCK_SIZE) walk.stride = assoc_remain;
-            if (assoc_remain == 0) walk.stride = AES_BLOCK_SIZE;
-            dec_bytes = nbytes - (nbytes % AES_BLOCK_SIZE);
-            err = skcipher_walk_done(&walk, (walk.nbytes - dec_bytes));
-            ghashlen = min(assoc_remain, walk.nbytes);
-        }
+    /* E(K, J0) masks the tag, the counter then continues at J0 + 1 */
+    ifx_deu_aes_resident(tagmask, tagmask, AES_BLOCK_SIZE);
 
-        if ((dec_bytes = ghashlen)) {
-            memcpy(ctx->lastbuffer, walk.src.virt.addr, dec_bytes);
-            memset(ctx->lastbuffer + dec_bytes, 0, (AES_BLOCK_SIZE - dec_bytes));
-            memcpy(walk.dst.virt.addr, walk.src.virt.addr, ghashlen);
-            u128_xor((u128 *)ctx->hash, (u128 *)ctx->hash, (u128 *)ctx->lastbuffer);
-            gf128mul_4k_lle((be128 *)ctx->hash, ctx->gf128);
-            walk.stride = AES_BLOCK_SIZE;
-            err = skcipher_walk_done(&walk, (walk.nbytes - ghashlen));
-        }
-    }
+    while (walk.nbytes) {
+        unsigned int nbytes = walk.nbytes;
 
-    //crypt and hash
-    while ((nbytes = dec_bytes = walk.nbytes) && (walk.nbytes >= AES_BLOCK_SIZE)) {
-        u8 *temp;
-        dec_bytes -= (nbytes % AES_BLOCK_SIZE);
-        temp = walk.src.virt.addr;
-        while (dec_bytes) {
-            u128_xor((u128 *)ctx->hash, (u128 *)ctx->hash, (u128 *)temp);
-            gf128mul_4k_lle((be128 *)ctx->hash, ctx->gf128);
-            dec_bytes -= AES_BLOCK_SIZE;
-            temp += 16;
-        }
-        dec_bytes = nbytes - (nbytes % AES_BLOCK_SIZE);
-        ifx_deu_aes_ctr(ctx, walk.dst.virt.addr, walk.src.virt.addr,
-                       iv, dec_bytes, CRYPTO_DIR_DECRYPT, 0);
-        nbytes &= AES_BLOCK_SIZE - 1;
-        err = skcipher_walk_done(&walk, nbytes);
-    }
+        if (nbytes < walk.total)
+            nbytes = round_down(nbytes, AES_BLOCK_SIZE);
 
-    /* crypt and hash remaining bytes < AES_BLOCK_SIZE */
-    if ((dec_bytes = walk.nbytes)) {
-        memcpy(ctx->lastbuffer, walk.src.virt.addr, dec_bytes);
-        memset(ctx->lastbuffer + dec_bytes, 0, (AES_BLOCK_SIZE - dec_bytes));
-        u128_xor((u128 *)ctx->hash, (u128 *)ctx->hash, (u128 *)ctx->lastbuffer);
-        gf128mul_4k_lle((be128 *)ctx->hash, ctx->gf128);
-        ifx_deu_aes_ctr(ctx, walk.dst.virt.addr, walk.src.virt.addr,
-                       iv, walk.nbytes, CRYPTO_DIR_DECRYPT, 0);
-        err = skcipher_walk_done(&walk, 0);
+        ifx_deu_aes_gcm_chunk(ctx, walk.dst.virt.addr, walk.src.virt.addr,
+                       hash, nbytes, encdec);
+        err = skcipher_walk_done(&walk, walk.nbytes - nbytes);
     }
 
+    CRTCL_SECT_END;
+
+    if (err)
+        return err;
+
     //finalize and copy hash
-    u128_xor((u128 *)ctx->hash, (u128 *)ctx->hash, (u128 *)&lengths);
-    gf128mul_4k_lle((be128 *)ctx->hash, ctx->gf128);
-    u128_xor((u128 *)ctx->hash, (u128 *)ctx->hash, (u128 *)ctx->block);
+    lengths.a = cpu_to_be64(req->assoclen * 8);
+    lengths.b = cpu_to_be64(cryptlen * 8);
+    gcm_aes_ghash_block(ctx, hash, (u8 *)&lengths);
+    crypto_xor(hash, tagmask, AES_BLOCK_SIZE);
 
-    scatterwalk_map_and_copy(ctx->lastbuffer, req->src, req->cryptlen + req->assoclen - authsize, authsize, 0);
-    err = crypto_memneq(ctx->lastbuffer, ctx->hash, authsize) ? -EBADMSG : 0;
+    if (encdec) {
+        scatterwalk_map_and_copy(hash, req->dst, req->assoclen + cryptlen, authsize, 1);
+        return 0;
+    }
 
-    aead_request_complete(req, 0);
+    scatterwalk_map_and_copy(tag, req->src, req->assoclen + cryptlen, authsize, 0);
+    return crypto_memneq(tag, hash, authsize) ? -EBADMSG : 0;
+}
 
-    return err;
+/*! \fn int gcm_aes_encrypt(struct aead_request *req)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief GCM AES encrypt using linux crypto aead
+ *  \param req aead request
+ *  \return err
+*/
+int gcm_aes_encrypt(struct aead_request *req)
+{
+    return gcm_aes_crypt(req, CRYPTO_DIR_ENCRYPT);
+}
+
+/*! \fn int gcm_aes_decrypt(struct aead_request *req)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief GCM AES decrypt using linux crypto aead
+ *  \param req aead request
+ *  \return err
+*/
+int gcm_aes_decrypt(struct aead_request *req)
+{
+    return gcm_aes_crypt(req, CRYPTO_DIR_DECRYPT);
 }
 
 /*! \fn void aes_gcm_exit_tfm(struct crypto_tfm *tfm)
@@ -1871,6 +1961,235 @@ struct aead_alg ifxdeu_gcm_aes_alg = {
     .setauthsize             =   gcm_aes_setauthsize,
 };
 
+/*! \fn int ccm_aes_set_key (struct crypto_aead *aead, const uint8_t *in_key, unsigned int key_len)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief sets the AES keys for aead ccm
+ *  \param aead linux crypto aead
+ *  \param in_key input key
+ *  \param key_len key lengths of 16, 24 and 32 bytes supported
+ *  \return -EINVAL - bad key length, 0 - SUCCESS
+*/
+int ccm_aes_set_key (struct crypto_aead *aead, const u8 *in_key, unsigned int key_len)
+{
+    return aes_set_key(crypto_aead_tfm(aead), in_key, key_len);
+}
+
+/*! \fn int ccm_aes_setauthsize (struct crypto_aead *aead, unsigned int authsize)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief checks the authsize for aead ccm
+ *  \param aead linux crypto aead
+ *  \param authsize even tag length of 4 to 16 bytes
+ *  \return -EINVAL - bad authsize length, 0 - SUCCESS
+*/
+int ccm_aes_setauthsize (struct crypto_aead *aead, unsigned int authsize)
+{
+    switch (authsize) {
+    case 4:
+    case 6:
+    case 8:
+    case 10:
+    case 12:
+    case 14:
+    case 16:
+        return 0;
+    }
+
+    return -EINVAL;
+}
+
+/*! \fn static void ccm_aes_mac_assoc (struct aead_request *req)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief CBC-MAC of the length encoded associated data, requires spinlock to be
+ *         set and CBC mode to be programmed by caller
+ *  \param req aead request
+*/
+static void ccm_aes_mac_assoc (struct aead_request *req)
+{
+    u8 block[AES_BLOCK_SIZE] = {0,};
+    unsigned int offset, len, fill;
+
+    if (!req->assoclen)
+        return;
+
+    if (req->assoclen < 0xff00) {
+        put_unaligned_be16(req->assoclen, block);
+        fill = 2;
+    } else {
+        block[0] = 0xff;
+        block[1] = 0xfe;
+        put_unaligned_be32(req->assoclen, block + 2);
+        fill = 6;
+    }
+
+    for (offset = 0; offset < req->assoclen; offset += len) {
+        len = min_t(unsigned int, req->assoclen - offset, AES_BLOCK_SIZE - fill);
+        scatterwalk_map_and_copy(block + fill, req->src, offset, len, 0);
+        fill += len;
+
+        if (fill == AES_BLOCK_SIZE || offset + len == req->assoclen) {
+            ifx_deu_aes_resident(NULL, block, AES_BLOCK_SIZE);
+            memset(block, 0, sizeof(block));
+            fill = 0;
+        }
+    }
+}
+
+/*! \fn static int ccm_aes_crypt(struct aead_request *req, int encdec)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief CCM AES using linux crypto aead. CBC-MAC and CTR share the resident
+ *         key, only the IV registers are switched between both per chunk.
+ *  \param req aead request
+ *  \param encdec 1 for encrypt; 0 for decrypt
+ *  \return err
+*/
+static int ccm_aes_crypt(struct aead_request *req, int encdec)
+{
+    struct crypto_aead *aead = crypto_aead_reqtfm(req);
+    struct aes_ctx *ctx = crypto_aead_ctx(aead);
+    volatile struct aes_t *aes = (volatile struct aes_t *) AES_START;
+    unsigned int authsize = crypto_aead_authsize(aead);
+    unsigned int cryptlen = req->cryptlen - (encdec ? 0 : authsize);
+    unsigned int l = req->iv[0] + 1;
+    struct skcipher_walk walk;
+    unsigned long flag;
+    u8 b0[AES_BLOCK_SIZE];
+    u8 ctr[AES_BLOCK_SIZE];
+    u8 mac[AES_BLOCK_SIZE] = {0,};
+    u8 tagmask[AES_BLOCK_SIZE] = {0,};
+    u8 tag[AES_BLOCK_SIZE];
+    unsigned int i;
+    int err;
+
+    /* RFC 3610: iv[0] holds L' = L - 1, the size of the length field */
+    if (req->iv[0] < 1 || req->iv[0] > 7)
+        return -EINVAL;
+
+    if (l < 4 && (cryptlen >> (8 * l)))
+        return -EOVERFLOW;
+
+    memcpy(b0, req->iv, AES_BLOCK_SIZE);
+    b0[0] |= ((authsize - 2) / 2) << 3;
+    if (req->assoclen)
+        b0[0] |= 0x40;
+    memset(b0 + AES_BLOCK_SIZE - l, 0, l);
+    for (i = 0; i < l && i < 4; i++)
+        b0[AES_BLOCK_SIZE - 1 - i] = cryptlen >> (8 * i);
+
+    memcpy(ctr, req->iv, AES_BLOCK_SIZE);
+    memset(ctr + AES_BLOCK_SIZE - l, 0, l);
+
+    aead_aes_copy_assoc(req);
+
+    /* atomic walk, the DEU stays locked until the last chunk is done */
+    if (encdec)
+        err = skcipher_walk_aead_encrypt(&walk, req, true);
+    else
+        err = skcipher_walk_aead_decrypt(&walk, req, true);
+    if (err)
+        return err;
+
+    CRTCL_SECT_START;
+
+    aes_set_key_hw (ctx);
+    aes->controlr.E_D = !CRYPTO_DIR_ENCRYPT;    //encryption
+
+    /* S0 = E(K, A0) masks the tag, the payload starts at A1 */
+    aes->controlr.O = 4; //0 ECB 1 CBC 2 OFB 3 CFB 4 CTR
+    aes_hw_write_iv(aes, ctr);
+    ifx_deu_aes_resident(tagmask, tagmask, AES_BLOCK_SIZE);
+    aes_hw_read_iv(aes, ctr);
+
+    aes->controlr.O = 1;
+    aes_hw_write_iv(aes, mac);
+    ifx_deu_aes_resident(NULL, b0, AES_BLOCK_SIZE);
+    ccm_aes_mac_assoc(req);
+
+    /* CBC mode with the running MAC is loaded at the top of every chunk */
+    while (walk.nbytes) {
+        unsigned int nbytes = walk.nbytes;
+
+        if (nbytes < walk.total)
+            nbytes = round_down(nbytes, AES_BLOCK_SIZE);
+
+        /* the MAC covers the plaintext, so take it before an in-place encrypt */
+        if (encdec)
+            ifx_deu_aes_resident(NULL, walk.src.virt.addr, nbytes);
+        aes_hw_read_iv(aes, mac);
+
+        aes->controlr.O = 4;
+        aes_hw_write_iv(aes, ctr);
+        ifx_deu_aes_resident(walk.dst.virt.addr, walk.src.virt.addr, nbytes);
+        aes_hw_read_iv(aes, ctr);
+
+        aes->controlr.O = 1;
+        aes_hw_write_iv(aes, mac);
+        if (!encdec)
+            ifx_deu_aes_resident(NULL, walk.dst.virt.addr, nbytes);
+
+        err = skcipher_walk_done(&walk, walk.nbytes - nbytes);
+    }
+
+    aes_hw_read_iv(aes, mac);
+
+    CRTCL_SECT_END;
+
+    if (err)
+        return err;
+
+    crypto_xor(mac, tagmask, AES_BLOCK_SIZE);
+
+    if (encdec) {
+        scatterwalk_map_and_copy(mac, req->dst, req->assoclen + cryptlen, authsize, 1);
+        return 0;
+    }
+
+    scatterwalk_map_and_copy(tag, req->src, req->assoclen + cryptlen, authsize, 0);
+    return crypto_memneq(tag, mac, authsize) ? -EBADMSG : 0;
+}
+
+/*! \fn int ccm_aes_encrypt(struct aead_request *req)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief CCM AES encrypt using linux crypto aead
+ *  \param req aead request
+ *  \return err
+*/
+int ccm_aes_encrypt(struct aead_request *req)
+{
+    return ccm_aes_crypt(req, CRYPTO_DIR_ENCRYPT);
+}
+
+/*! \fn int ccm_aes_decrypt(struct aead_request *req)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief CCM AES decrypt using linux crypto aead
+ *  \param req aead request
+ *  \return err
+*/
+int ccm_aes_decrypt(struct aead_request *req)
+{
+    return ccm_aes_crypt(req, CRYPTO_DIR_DECRYPT);
+}
+
+/*
+ * \brief AES function mappings
+*/
+struct aead_alg ifxdeu_ccm_aes_alg = {
+    .base.cra_name           =   "ccm(aes)",
+    .base.cra_driver_name    =   "ifxdeu-ccm(aes)",
+    .base.cra_priority       =   400,
+    .base.cra_flags          =   CRYPTO_ALG_TYPE_AEAD | CRYPTO_ALG_KERN_DRIVER_ONLY,
+    .base.cra_blocksize      =   1,
+    .base.cra_ctxsize        =   sizeof(struct aes_ctx),
+    .base.cra_module         =   THIS_MODULE,
+    .base.cra_list           =   LIST_HEAD_INIT(ifxdeu_ccm_aes_alg.base.cra_list),
+    .ivsize                  =   AES_BLOCK_SIZE,
+    .maxauthsize             =   AES_BLOCK_SIZE,
+    .chunksize               =   AES_BLOCK_SIZE,
+    .setkey                  =   ccm_aes_set_key,
+    .encrypt                 =   ccm_aes_encrypt,
+    .decrypt                 =   ccm_aes_decrypt,
+    .setauthsize             =   ccm_aes_setauthsize,
+};
+
 /*! \fn int ifxdeu_init_aes (void)
  *  \ingroup IFX_AES_FUNCTIONS
  *  \brief function to initialize AES driver
@@ -1912,12 +2231,19 @@ int ifxdeu_init_aes (void)
     if ((ret = crypto_register_aead(&ifxdeu_gcm_aes_alg)))
         goto gcm_aes_err;
 
+    if ((ret = crypto_register_aead(&ifxdeu_ccm_aes_alg)))
+        goto ccm_aes_err;
+
     CRTCL_SECT_INIT;
 
 
     printk (KERN_NOTICE "IFX DEU AES initialized%s%s.\n", disable_multiblock ? "" : " (multiblock)", disable_deudma ? "" : " (DMA)");
     return ret;
 
+ccm_aes_err:
+    crypto_unregister_aead(&ifxdeu_ccm_aes_alg);
+    printk (KERN_ERR "IFX ccm_aes initialization failed!\n");
+    return ret;
 gcm_aes_err:
     crypto_unregister_aead(&ifxdeu_gcm_aes_alg);
     printk (KERN_ERR "IFX gcm_aes initialization failed!\n");
@@ -1976,4 +2302,5 @@ void ifxdeu_fini_aes (void)
     crypto_unregister_skcipher (&ifxdeu_ctr_rfc3686_aes_alg);
     crypto_unregister_shash (&ifxdeu_cbcmac_aes_alg);
     crypto_unregister_aead (&ifxdeu_gcm_aes_alg);
+    crypto_unregister_aead (&ifxdeu_ccm_aes_alg);
 }
@@ -0,0 +1,392 @@
+/******************************************************************************
+**
+** FILE NAME    : ifxmips_deu_bench.c
+** PROJECT      : IFX UEIP
+** MODULES      : DEU Module
+**
+** DESCRIPTION  : Data Encryption Unit self benchmark
+**
+**    This program is free software; you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation; either version 2 of the License, or
+**    (at your option) any later version.
+**
+*******************************************************************************/
+/*!
+  \file	ifxmips_deu_bench.c
+  \ingroup IFX_DEU
+  \brief DEU benchmark, compares every registered DEU algorithm against the
+         generic software implementation
+*/
+
+/*!
+ \defgroup IFX_DEU_BENCH_FUNCTIONS IFX_DEU_BENCH_FUNCTIONS
+ \ingroup IFX_DEU
+ \brief IFX DEU benchmark functions
+*/
+
+/* Project header */
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/scatterlist.h>
+#include <linux/timex.h>
+#include <linux/math64.h>
+#include <crypto/aead.h>
+#include <crypto/hash.h>
+#include <crypto/skcipher.h>
+
+#define DEU_BENCH_SKCIPHER  0
+#define DEU_BENCH_AEAD      1
+#define DEU_BENCH_SHASH     2
+
+#define DEU_BENCH_MAX_LEN   4096
+#define DEU_BENCH_AAD_LEN   16
+#define DEU_BENCH_TAG_LEN   16
+
+struct deu_bench_alg {
+    const char *name;       /* algorithm name, resolves to the DEU driver */
+    const char *generic;    /* software driver used as reference */
+    int type;
+    unsigned int klen;
+};
+
+static const struct deu_bench_alg deu_bench_algs[] = {
+    { "ecb(aes)",          "ecb(aes-generic)",          DEU_BENCH_SKCIPHER, 16 },
+    { "cbc(aes)",          "cbc(aes-generic)",          DEU_BENCH_SKCIPHER, 16 },
+    { "ofb(aes)",          "ofb(aes-generic)",          DEU_BENCH_SKCIPHER, 16 },
+    { "cfb(aes)",          "cfb(aes-generic)",          DEU_BENCH_SKCIPHER, 16 },
+    { "ctr(aes)",          "ctr(aes-generic)",          DEU_BENCH_SKCIPHER, 16 },
+    { "rfc3686(ctr(aes))", "rfc3686(ctr(aes-generic))", DEU_BENCH_SKCIPHER, 20 },
+    { "xts(aes)",          "xts(aes-generic)",          DEU_BENCH_SKCIPHER, 32 },
+    { "gcm(aes)",          "gcm_base(ctr(aes-generic),ghash-generic)",          DEU_BENCH_AEAD, 16 },
+    { "ccm(aes)",          "ccm_base(ctr(aes-generic),cbcmac(aes-generic))",    DEU_BENCH_AEAD, 16 },
+    { "cbcmac(aes)",       "cbcmac(aes-generic)",       DEU_BENCH_SHASH,    16 },
+    { "ecb(des)",          "ecb(des-generic)",          DEU_BENCH_SKCIPHER, 8 },
+    { "cbc(des)",          "cbc(des-generic)",          DEU_BENCH_SKCIPHER, 8 },
+    { "ecb(des3_ede)",     "ecb(des3_ede-generic)",     DEU_BENCH_SKCIPHER, 24 },
+    { "cbc(des3_ede)",     "cbc(des3_ede-generic)",     DEU_BENCH_SKCIPHER, 24 },
+    { "sha1",              "sha1-generic",              DEU_BENCH_SHASH,    0 },
+    { "md5",               "md5-generic",               DEU_BENCH_SHASH,    0 },
+    { "hmac(sha1)",        "hmac(sha1-generic)",        DEU_BENCH_SHASH,    20 },
+    { "hmac(md5)",         "hmac(md5-generic)",         DEU_BENCH_SHASH,    16 },
+};
+
+/* 1420 bytes is a typical IPsec ESP payload on a 1500 byte MTU */
+static const unsigned int deu_bench_lens[] = { 16, 64, 256, 1024, 1420, 4096 };
+
+static unsigned int iterations = 256;
+module_param(iterations, uint, 0);
+MODULE_PARM_DESC(iterations, "Timed operations per algorithm and length");
+
+static char *alg;
+module_param(alg, charp, 0);
+MODULE_PARM_DESC(alg, "Only benchmark this algorithm name");
+
+/* deterministic key material, 3DES needs three distinct keys */
+static const u8 deu_bench_key[32] =
+    "\x01\x23\x45\x67\x89\xab\xcd\xef"
+    "\x55\x55\x55\x55\x55\x55\x55\x55"
+    "\xfe\xdc\xba\x98\x76\x54\x32\x10"
+    "\x0f\x1e\x2d\x3c\x4b\x5a\x69\x78";
+
+/*! \fn static bool deu_bench_check(const char *impl, bool deu)
+ *  \ingroup IFX_DEU_BENCH_FUNCTIONS
+ *  \brief check the implementation the crypto api resolved a name to
+ *  \param impl driver name of the allocated transform
+ *  \param deu true if the DEU driver is expected
+ *  \return false if a DEU driver was expected but not picked
+*/
+static bool deu_bench_check(const char *impl, bool deu)
+{
+    return !deu || !strncmp(impl, "ifxdeu-", 7);
+}
+
+/*! \fn static int deu_bench_skcipher(const char *driver, const struct deu_bench_alg *a, u8 *buf, u32 *result, const char **impl)
+ *  \ingroup IFX_DEU_BENCH_FUNCTIONS
+ *  \brief time skcipher encryption for all lengths
+ *  \param driver crypto api name to allocate
+ *  \param a algorithm description
+ *  \param buf scratch buffer of DEU_BENCH_MAX_LEN bytes
+ *  \param result cycles per byte times ten for each length
+ *  \param impl returns the driver name of the allocated transform
+ *  \return -ENODEV if the DEU was requested but another driver was picked, err
+*/
+static int deu_bench_skcipher(const char *driver, const struct deu_bench_alg *a,
+                              u8 *buf, u32 *result, const char **impl)
+{
+    struct crypto_skcipher *tfm;
+    struct skcipher_request *req;
+    struct scatterlist sg;
+    DECLARE_CRYPTO_WAIT(wait);
+    u8 iv[32];
+    int i, n, err;
+
+    tfm = crypto_alloc_skcipher(driver, 0, 0);
+    if (IS_ERR(tfm))
+        return PTR_ERR(tfm);
+
+    *impl = crypto_tfm_alg_driver_name(crypto_skcipher_tfm(tfm));
+    if (!deu_bench_check(*impl, a->generic != driver)) {
+        crypto_free_skcipher(tfm);
+        return -ENODEV;
+    }
+
+    err = crypto_skcipher_setkey(tfm, deu_bench_key, a->klen);
+    if (err)
+        goto out_tfm;
+
+    req = skcipher_request_alloc(tfm, GFP_KERNEL);
+    if (!req) {
+        err = -ENOMEM;
+        goto out_tfm;
+    }
+    skcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+                                  crypto_req_done, &wait);
+
+    for (i = 0; i < ARRAY_SIZE(deu_bench_lens); i++) {
+        unsigned int len = deu_bench_lens[i];
+        cycles_t start;
+
+        sg_init_one(&sg, buf, len);
+        memset(iv, 0, sizeof(iv));
+        skcipher_request_set_crypt(req, &sg, &sg, len, iv);
+
+        /* warm up caches and lazily allocated state */
+        err = crypto_wait_req(crypto_skcipher_encrypt(req), &wait);
+        if (err)
+            break;
+
+        start = get_cycles();
+        for (n = 0; n < iterations && !err; n++)
+            err = crypto_wait_req(crypto_skcipher_encrypt(req), &wait);
+        result[i] = div64_u64((u64)(get_cycles() - start) * 10, (u64)iterations * len);
+    }
+
+    skcipher_request_free(req);
+out_tfm:
+    crypto_free_skcipher(tfm);
+    return err;
+}
+
+/*! \fn static int deu_bench_aead(const char *driver, const struct deu_bench_alg *a, u8 *buf, u32 *result, const char **impl)
+ *  \ingroup IFX_DEU_BENCH_FUNCTIONS
+ *  \brief time aead encryption with 16 bytes of associated data for all lengths
+ *  \param driver crypto api name to allocate
+ *  \param a algorithm description
+ *  \param buf scratch buffer of DEU_BENCH_MAX_LEN bytes plus aad and tag
+ *  \param result cycles per byte times ten for each length
+ *  \param impl returns the driver name of the allocated transform
+ *  \return -ENODEV if the DEU was requested but another driver was picked, err
+*/
+static int deu_bench_aead(const char *driver, const struct deu_bench_alg *a,
+                          u8 *buf, u32 *result, const char **impl)
+{
+    struct crypto_aead *tfm;
+    struct aead_request *req;
+    struct scatterlist sg;
+    DECLARE_CRYPTO_WAIT(wait);
+    u8 iv[16];
+    int i, n, err;
+
+    tfm = crypto_alloc_aead(driver, 0, 0);
+    if (IS_ERR(tfm))
+        return PTR_ERR(tfm);
+
+    *impl = crypto_tfm_alg_driver_name(crypto_aead_tfm(tfm));
+    if (!deu_bench_check(*impl, a->generic != driver)) {
+        crypto_free_aead(tfm);
+        return -ENODEV;
+    }
+
+    err = crypto_aead_setkey(tfm, deu_bench_key, a->klen);
+    if (!err)
+        err = crypto_aead_setauthsize(tfm, DEU_BENCH_TAG_LEN);
+    if (err)
+        goto out_tfm;
+
+    req = aead_request_alloc(tfm, GFP_KERNEL);
+    if (!req) {
+        err = -ENOMEM;
+        goto out_tfm;
+    }
+    aead_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+                              crypto_req_done, &wait);
+
+    for (i = 0; i < ARRAY_SIZE(deu_bench_lens); i++) {
+        unsigned int len = deu_bench_lens[i];
+        cycles_t start;
+
+        sg_init_one(&sg, buf, DEU_BENCH_AAD_LEN + len + DEU_BENCH_TAG_LEN);
+        /* valid for both gcm (12 byte nonce) and ccm (L' = 3) */
+        memset(iv, 0, sizeof(iv));
+        iv[0] = 3;
+        aead_request_set_ad(req, DEU_BENCH_AAD_LEN);
+        aead_request_set_crypt(req, &sg, &sg, len, iv);
+
+        err = crypto_wait_req(crypto_aead_encrypt(req), &wait);
+        if (err)
+            break;
+
+        start = get_cycles();
+        for (n = 0; n < iterations && !err; n++)
+            err = crypto_wait_req(crypto_aead_encrypt(req), &wait);
+        result[i] = div64_u64((u64)(get_cycles() - start) * 10, (u64)iterations * len);
+    }
+
+    aead_request_free(req);
+out_tfm:
+    crypto_free_aead(tfm);
+    return err;
+}
+
+/*! \fn static int deu_bench_shash(const char *driver, const struct deu_bench_alg *a, u8 *buf, u32 *result, const char **impl)
+ *  \ingroup IFX_DEU_BENCH_FUNCTIONS
+ *  \brief time one-shot digests for all lengths
+ *  \param driver crypto api name to allocate
+ *  \param a algorithm description
+ *  \param buf scratch buffer of DEU_BENCH_MAX_LEN bytes
+ *  \param result cycles per byte times ten for each length
+ *  \param impl returns the driver name of the allocated transform
+ *  \return -ENODEV if the DEU was requested but another driver was picked, err
+*/
+static int deu_bench_shash(const char *driver, const struct deu_bench_alg *a,
+                           u8 *buf, u32 *result, const char **impl)
+{
+    struct crypto_shash *tfm;
+    u8 out[64];
+    int i, n, err = 0;
+
+    tfm = crypto_alloc_shash(driver, 0, 0);
+    if (IS_ERR(tfm))
+        return PTR_ERR(tfm);
+
+    *impl = crypto_tfm_alg_driver_name(crypto_shash_tfm(tfm));
+    if (!deu_bench_check(*impl, a->generic != driver)) {
+        crypto_free_shash(tfm);
+        return -ENODEV;
+    }
+
+    if (a->klen)
+        err = crypto_shash_setkey(tfm, deu_bench_key, a->klen);
+
+    for (i = 0; i < ARRAY_SIZE(deu_bench_lens) && !err; i++) {
+        SHASH_DESC_ON_STACK(desc, tfm);
+        unsigned int len = deu_bench_lens[i];
+        cycles_t start;
+
+        desc->tfm = tfm;
+
+        err = crypto_shash_digest(desc, buf, len, out);
+        if (err)
+            break;
+
+        start = get_cycles();
+        for (n = 0; n < iterations && !err; n++)
+            err = crypto_shash_digest(desc, buf, len, out);
+        result[i] = div64_u64((u64)(get_cycles() - start) * 10, (u64)iterations * len);
+
+        shash_desc_zero(desc);
+    }
+
+    crypto_free_shash(tfm);
+    return err;
+}
+
+/*! \fn static int deu_bench_run(const struct deu_bench_alg *a, const char *driver, u8 *buf)
+ *  \ingroup IFX_DEU_BENCH_FUNCTIONS
+ *  \brief benchmark one implementation and print a result row
+ *  \param a algorithm description
+ *  \param driver crypto api name to allocate
+ *  \param buf scratch buffer
+ *  \return -ENODEV if the algorithm is not offloaded to the DEU, err
+*/
+static int deu_bench_run(const struct deu_bench_alg *a, const char *driver, u8 *buf)
+{
+    u32 result[ARRAY_SIZE(deu_bench_lens)] = {0,};
+    const char *impl = driver;
+    int i, err;
+
+    switch (a->type) {
+    case DEU_BENCH_AEAD:
+        err = deu_bench_aead(driver, a, buf, result, &impl);
+        break;
+    case DEU_BENCH_SHASH:
+        err = deu_bench_shash(driver, a, buf, result, &impl);
+        break;
+    default:
+        err = deu_bench_skcipher(driver, a, buf, result, &impl);
+        break;
+    }
+
+    if (err == -ENODEV)
+        return err;
+
+    if (err) {
+        printk(KERN_INFO "%-18s %-34.34s error %d\n", a->name, impl, err);
+        return err;
+    }
+
+    printk(KERN_INFO "%-18s %-34.34s", a->name, impl);
+    for (i = 0; i < ARRAY_SIZE(deu_bench_lens); i++)
+        printk(KERN_CONT " %5u.%u", result[i] / 10, result[i] % 10);
+    printk(KERN_CONT "\n");
+
+    return 0;
+}
+
+/*! \fn static int __init deu_bench_init (void)
+ *  \ingroup IFX_DEU_BENCH_FUNCTIONS
+ *  \brief run the benchmark, cycles are counted with get_cycles() and are CP0
+ *         count ticks on MIPS, i.e. half the CPU clock
+ *  \return -EAGAIN so the module does not stay loaded
+*/
+static int __init deu_bench_init (void)
+{
+    u8 *buf;
+    int i, j;
+
+    if (!iterations)
+        iterations = 1;
+
+    buf = kzalloc(DEU_BENCH_AAD_LEN + DEU_BENCH_MAX_LEN + DEU_BENCH_TAG_LEN, GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    printk(KERN_INFO "DEU benchmark, cycles/byte over %u iterations\n", iterations);
+    printk(KERN_INFO "%-18s %-34s", "algorithm", "driver");
+    for (j = 0; j < ARRAY_SIZE(deu_bench_lens); j++)
+        printk(KERN_CONT " %6uB", deu_bench_lens[j]);
+    printk(KERN_CONT "\n");
+
+    for (i = 0; i < ARRAY_SIZE(deu_bench_algs); i++) {
+        const struct deu_bench_alg *a = &deu_bench_algs[i];
+
+        if (alg && strcmp(alg, a->name))
+            continue;
+
+        /* skip algorithms without a DEU implementation on this SoC */
+        if (deu_bench_run(a, a->name, buf) == -ENODEV)
+            continue;
+
+        deu_bench_run(a, a->generic, buf);
+    }
+
+    kfree(buf);
+
+    /* like tcrypt, fail the load so the benchmark can simply be run again */
+    return -EAGAIN;
+}
+
+static void __exit deu_bench_fini (void)
+{
+}
+
+module_init(deu_bench_init);
+module_exit(deu_bench_fini);
+
+MODULE_DESCRIPTION ("Infineon DEU crypto engine benchmark.");
+MODULE_LICENSE ("GPL");
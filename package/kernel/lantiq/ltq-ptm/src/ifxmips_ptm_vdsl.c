@@ -87,6 +87,8 @@ static inline struct sk_buff* alloc_skb_rx(void);
 static inline struct sk_buff* alloc_skb_tx(unsigned int);
 static inline struct sk_buff *get_skb_pointer(unsigned int);
 static inline int get_tx_desc(unsigned int, unsigned int *);
+static void ptm_tx_reclaim(struct net_device *);
+static void ptm_tx_reset_queue(struct net_device *);
 
 /*
  *  Mailbox handler and signal function
@@ -153,6 +155,9 @@ static void ptm_setup(struct net_device *dev, int ndev)
     dev->max_mtu         = ETH_DATA_LEN + 8;
     netif_napi_add(dev, &g_ptm_priv_data.itf[ndev].napi, ptm_napi_poll, 16);
     dev->watchdog_timeo  = ETH_WATCHDOG_TIMEOUT;
+    /*  room for the skb pointer and the burst alignment in front of the data,
+     *  so that locally generated frames can be sent without a copy */
+    dev->needed_headroom = DATA_BUFFER_ALIGNMENT + sizeof(struct sk_buff *);
 
     dev->dev_addr[0] = 0x00;
     dev->dev_addr[1] = 0x20;
@@ -177,9 +182,13 @@ static int ptm_open(struct net_device *dev)
 {
     ASSERT(dev == g_net_dev[0], "incorrect device");
 
+    ptm_tx_reset_queue(dev);
+
     napi_enable(&g_ptm_priv_data.itf[0].napi);
 
-    IFX_REG_W32_MASK(0, 1, MBOX_IGU1_IER);
+    //  RX and TX descriptor release are both handled in NAPI poll
+    IFX_REG_W32_MASK(0, 1 | (1 << 17), MBOX_IGU1_ISRC);
+    IFX_REG_W32_MASK(0, 1 | (1 << 17), MBOX_IGU1_IER);
 
     netif_start_queue(dev);
 
@@ -196,6 +205,8 @@ static int ptm_stop(struct net_device *dev)
 
     netif_stop_queue(dev);
 
+    ptm_tx_reset_queue(dev);
+
     return 0;
 }
 
@@ -228,7 +239,7 @@ static unsigned int ptm_poll(int ndev, unsigned int work_to_do)
             skb->dev = g_net_dev[0];
             skb->protocol = eth_type_trans(skb, skb->dev);
 
-            netif_receive_skb(skb);
+            napi_gro_receive(&g_ptm_priv_data.itf[0].napi, skb);
 
             g_ptm_priv_data.itf[0].stats.rx_packets++;
             g_ptm_priv_data.itf[0].stats.rx_bytes += reg_desc.datalen;
@@ -257,20 +268,22 @@ static int ptm_napi_poll(struct napi_struct *napi, int budget)
     int ndev = 0;
     unsigned int work_done;
 
+    ptm_tx_reclaim(napi->dev);
+
     work_done = ptm_poll(ndev, budget);
 
     //  interface down
     if ( !netif_running(napi->dev) ) {
-        napi_complete(napi);
+        napi_complete_done(napi, work_done);
         return work_done;
     }
 
     //  clear interrupt
-    IFX_REG_W32_MASK(0, 1, MBOX_IGU1_ISRC);
+    IFX_REG_W32_MASK(0, 1 | (1 << 17), MBOX_IGU1_ISRC);
     //  no more traffic
     if (work_done < budget) {
-	napi_complete(napi);
-        IFX_REG_W32_MASK(0, 1, MBOX_IGU1_IER);
+        napi_complete_done(napi, work_done);
+        IFX_REG_W32_MASK(0, 1 | (1 << 17), MBOX_IGU1_IER);
         return work_done;
     }
 
@@ -280,11 +293,11 @@ static int ptm_napi_poll(struct napi_struct *napi, int budget)
 
 static int ptm_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
 {
+    struct ptm_itf *p_itf = &g_ptm_priv_data.itf[0];
     unsigned int f_full;
     int desc_base;
     volatile struct tx_descriptor *desc;
     struct tx_descriptor reg_desc = {0};
-    struct sk_buff *skb_to_free;
     unsigned int byteoff;
 
     ASSERT(dev == g_net_dev[0], "incorrect device");
@@ -294,39 +307,13 @@ static int ptm_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
         goto PTM_HARD_START_XMIT_FAIL;
     }
 
-    /*  allocate descriptor */
-    desc_base = get_tx_desc(0, &f_full);
-    if ( f_full ) {
-        netif_trans_update(dev);
-        netif_stop_queue(dev);
-
-        IFX_REG_W32_MASK(0, 1 << 17, MBOX_IGU1_ISRC);
-        IFX_REG_W32_MASK(0, 1 << 17, MBOX_IGU1_IER);
+    /*  dev->needed_headroom covers locally generated frames, forwarded or
+     *  cloned ones get their head reallocated instead of a full copy  */
+    if ( skb_cow_head(skb, DATA_BUFFER_ALIGNMENT + sizeof(struct sk_buff *)) ) {
+        dbg("no memory");
+        goto ALLOC_SKB_TX_FAIL;
     }
-    if ( desc_base < 0 )
-        goto PTM_HARD_START_XMIT_FAIL;
-    desc = &CPU_TO_WAN_TX_DESC_BASE[desc_base];
-
     byteoff = (unsigned int)skb->data & (DATA_BUFFER_ALIGNMENT - 1);
-    if ( skb_headroom(skb) < sizeof(struct sk_buff *) + byteoff || skb_cloned(skb) ) {
-        struct sk_buff *new_skb;
-
-        ASSERT(skb_headroom(skb) >= sizeof(struct sk_buff *) + byteoff, "skb_headroom(skb) < sizeof(struct sk_buff *) + byteoff");
-        ASSERT(!skb_cloned(skb), "skb is cloned");
-
-        new_skb = alloc_skb_tx(skb->len);
-        if ( new_skb == NULL ) {
-            dbg("no memory");
-            goto ALLOC_SKB_TX_FAIL;
-        }
-        skb_put(new_skb, skb->len);
-        memcpy(new_skb->data, skb->data, skb->len);
-        dev_kfree_skb_any(skb);
-        skb = new_skb;
-        byteoff = (unsigned int)skb->data & (DATA_BUFFER_ALIGNMENT - 1);
-        /*  write back to physical memory   */
-        dma_cache_wback((unsigned long)skb->data, skb->len);
-    }
 
     /* make the skb unowned */
     skb_orphan(skb);
@@ -335,10 +322,19 @@ static int ptm_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
     /*  write back to physical memory   */
     dma_cache_wback((unsigned long)skb->data - byteoff - sizeof(struct sk_buff *), skb->len + byteoff + sizeof(struct sk_buff *));
 
-    /*  free previous skb   */
-    skb_to_free = get_skb_pointer(desc->dataptr);
-    if ( skb_to_free != NULL )
-        dev_kfree_skb_any(skb_to_free);
+    spin_lock(&p_itf->tx_lock);
+
+    /*  allocate descriptor */
+    desc_base = get_tx_desc(0, &f_full);
+    if ( f_full ) {
+        netif_trans_update(dev);
+        netif_stop_queue(dev);
+    }
+    if ( desc_base < 0 ) {
+        spin_unlock(&p_itf->tx_lock);
+        goto PTM_HARD_START_XMIT_FAIL;
+    }
+    desc = &CPU_TO_WAN_TX_DESC_BASE[desc_base];
 
     /*  update descriptor   */
     reg_desc.small   = 0;
@@ -354,11 +350,16 @@ static int ptm_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
     g_ptm_priv_data.itf[0].stats.tx_packets++;
     g_ptm_priv_data.itf[0].stats.tx_bytes += reg_desc.datalen;
 
+    p_itf->tx_len[desc_base] = reg_desc.datalen;
+    netdev_sent_queue(dev, reg_desc.datalen);
+
     /*  write discriptor to memory  */
     *((volatile unsigned int *)desc + 1) = *((unsigned int *)&reg_desc + 1);
     wmb();
     *(volatile unsigned int *)desc = *(unsigned int *)&reg_desc;
 
+    spin_unlock(&p_itf->tx_lock);
+
     netif_trans_update(dev);
 
     return 0;
@@ -467,11 +468,8 @@ static void ptm_tx_timeout(struct net_device *dev, unsigned int txqueue)
 {
     ASSERT(dev == g_net_dev[0], "incorrect device");
 
-    /*  disable TX irq, release skb when sending new packet */
-    IFX_REG_W32_MASK(1 << 17, 0, MBOX_IGU1_IER);
-
-    /*  wake up TX queue    */
-    netif_wake_queue(dev);
+    /*  reclaim whatever PP32 has released, this wakes up TX queue  */
+    napi_schedule(&g_ptm_priv_data.itf[0].napi);
 
     return;
 }
@@ -543,17 +541,84 @@ static inline int get_tx_desc(unsigned int itf, unsigned int *f_full)
 
     *f_full = 1;
 
-    if ( CPU_TO_WAN_TX_DESC_BASE[p_itf->tx_desc_pos].own == 0 ) {
+    //  a descriptor is free once PP32 released it and it has been reclaimed
+    if ( p_itf->tx_len[p_itf->tx_desc_pos] == 0 ) {
         desc_base = p_itf->tx_desc_pos;
         if ( ++(p_itf->tx_desc_pos) == CPU_TO_WAN_TX_DESC_NUM )
             p_itf->tx_desc_pos = 0;
-        if ( CPU_TO_WAN_TX_DESC_BASE[p_itf->tx_desc_pos].own == 0 )
+        if ( p_itf->tx_len[p_itf->tx_desc_pos] == 0 )
             *f_full = 0;
     }
 
     return desc_base;
 }
 
+/*
+ *  Free the buffers of descriptors released by PP32 and report them to BQL.
+ *  Runs in NAPI context, driven by the TX descriptor release mailbox IRQ.
+ */
+static void ptm_tx_reclaim(struct net_device *dev)
+{
+    struct ptm_itf *p_itf = &g_ptm_priv_data.itf[0];
+    volatile struct tx_descriptor *desc;
+    struct sk_buff *skb;
+    unsigned int freed = 0, pkts = 0, bytes = 0;
+
+    spin_lock(&p_itf->tx_lock);
+
+    while ( p_itf->tx_len[p_itf->tx_reclaim_pos] != 0 ) {
+        desc = &CPU_TO_WAN_TX_DESC_BASE[p_itf->tx_reclaim_pos];
+        if ( desc->own )    //  PP32 still holds descriptor
+            break;
+
+        skb = get_skb_pointer(desc->dataptr);
+        if ( skb != NULL )
+            dev_consume_skb_any(skb);
+        desc->dataptr = 0;
+
+        freed++;
+        if ( p_itf->tx_bql_skip != 0 )
+            p_itf->tx_bql_skip--;
+        else {
+            pkts++;
+            bytes += p_itf->tx_len[p_itf->tx_reclaim_pos];
+        }
+        p_itf->tx_len[p_itf->tx_reclaim_pos] = 0;
+
+        if ( ++p_itf->tx_reclaim_pos == CPU_TO_WAN_TX_DESC_NUM )
+            p_itf->tx_reclaim_pos = 0;
+    }
+
+    if ( pkts )
+        netdev_completed_queue(dev, pkts, bytes);
+    if ( freed && netif_queue_stopped(dev) )
+        netif_wake_queue(dev);
+
+    spin_unlock(&p_itf->tx_lock);
+}
+
+/*
+ *  Start BQL from scratch, on open and stop. Descriptors PP32 still holds
+ *  stay in the ring and are freed by the reclaim later, but must not be
+ *  reported to BQL again.
+ */
+static void ptm_tx_reset_queue(struct net_device *dev)
+{
+    struct ptm_itf *p_itf = &g_ptm_priv_data.itf[0];
+    unsigned int i;
+
+    spin_lock_bh(&p_itf->tx_lock);
+
+    p_itf->tx_bql_skip = 0;
+    for ( i = 0; i < CPU_TO_WAN_TX_DESC_NUM; i++ )
+        if ( p_itf->tx_len[i] != 0 )
+            p_itf->tx_bql_skip++;
+
+    netdev_reset_queue(dev);
+
+    spin_unlock_bh(&p_itf->tx_lock);
+}
+
 static irqreturn_t mailbox_irq_handler(int irq, void *dev_id)
 {
     unsigned int isr;
@@ -562,8 +627,9 @@ static irqreturn_t mailbox_irq_handler(int irq, void *dev_id)
     IFX_REG_W32(isr, MBOX_IGU1_ISRC);
     isr &= IFX_REG_R32(MBOX_IGU1_IER);
 
-            if (isr & BIT(0)) {
-                IFX_REG_W32_MASK(1, 0, MBOX_IGU1_IER);
+            if (isr & (BIT(0) | BIT(17))) {
+                //  RX packet or TX descriptor released, both handled in NAPI
+                IFX_REG_W32_MASK(1 | (1 << 17), 0, MBOX_IGU1_IER);
                 napi_schedule(&g_ptm_priv_data.itf[0].napi);
 #if defined(ENABLE_TMP_DBG) && ENABLE_TMP_DBG
                 {
@@ -579,10 +645,6 @@ static irqreturn_t mailbox_irq_handler(int irq, void *dev_id)
                 IFX_REG_W32_MASK(1 << 16, 0, MBOX_IGU1_IER);
                 tasklet_hi_schedule(&g_swap_desc_tasklet);
             }
-	    if (isr & BIT(17)) {
-                IFX_REG_W32_MASK(1 << 17, 0, MBOX_IGU1_IER);
-                netif_wake_queue(g_net_dev[0]);
-        	}
 
     return IRQ_HANDLED;
 }
@@ -661,6 +723,7 @@ static inline int init_priv_data(void)
     }
 
     memset(&g_ptm_priv_data, 0, sizeof(g_ptm_priv_data));
+    spin_lock_init(&g_ptm_priv_data.itf[0].tx_lock);
 
     {
         int max_packet_priority = ARRAY_SIZE(g_ptm_prio_queue_map);
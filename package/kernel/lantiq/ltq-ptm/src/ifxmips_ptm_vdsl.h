@@ -89,6 +89,10 @@ struct ptm_itf {
     unsigned int                    rx_desc_pos;
 
     unsigned int                    tx_desc_pos;
+    unsigned int                    tx_reclaim_pos;
+    unsigned int                    tx_len[CPU_TO_WAN_TX_DESC_NUM];    //  bytes queued to BQL per descriptor, 0 - free
+    unsigned int                    tx_bql_skip;    //  descriptors queued before the last BQL reset
+    spinlock_t                      tx_lock;
 
     unsigned int                    tx_swap_desc_pos;
 
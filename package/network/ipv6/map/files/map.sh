@@ -20,6 +20,42 @@
 	init_proto "$@"
 }
 
+# Load the port sets of rule $2 as one nftables table, so that a rule with
+# many port ranges costs a single map lookup instead of one SNAT rule per
+# range and protocol. Returns non-zero if nft is missing or rejects the
+# ruleset, the caller then falls back to per-range firewall rules.
+map_nft_setup() {
+	local cfg="$1"
+	local k="$2"
+	local rule="$3"
+	local legacymap="$4"
+	local table="map_$cfg"
+	local file="/tmp/map-$cfg.nft"
+	local sets ranges
+
+	command -v nft >/dev/null || return 1
+
+	sets=$(NFT=1 LEGACY="$legacymap" mapcalc ${tunlink:-\*} $rule) || return 1
+	ranges=$(eval "echo \$RULE_${k}_PORTSETS" | wc -w)
+	[ "$ranges" -gt 0 ] || return 1
+
+	nft delete table inet "$table" 2>/dev/null
+	cat > "$file" <<-EOF
+		table inet $table {
+		$sets
+		chain srcnat {
+			type nat hook postrouting priority srcnat - 1; policy accept;
+			oifname "map-$cfg" meta l4proto { icmp, tcp, udp } snat ip to numgen inc mod $ranges map @rule_${k}_snat
+		}
+		}
+	EOF
+
+	nft -c -f "$file" 2>/dev/null && nft -f "$file" && return 0
+
+	rm -f "$file"
+	return 1
+}
+
 proto_map_setup() {
 	local cfg="$1"
 	local iface="$2"
@@ -132,7 +168,10 @@ proto_map_setup() {
 	[ -n "$zone" ] && json_add_string zone "$zone"
 
 	json_add_array firewall
-	  if [ -z "$(eval "echo \$RULE_${k}_PORTSETS")" ]; then
+	  if [ -n "$(eval "echo \$RULE_${k}_PORTSETS")" ] && \
+	     map_nft_setup "$cfg" "$k" "$rule" "$legacymap"; then
+	    :
+	  elif [ -z "$(eval "echo \$RULE_${k}_PORTSETS")" ]; then
 	    json_add_object ""
 	      json_add_string type nat
 	      json_add_string target SNAT
@@ -213,6 +252,11 @@ proto_map_teardown() {
 		"map-t") [ -f "/proc/net/nat46/control" ] && echo del $link > /proc/net/nat46/control ;;
 	esac
 
+	if [ -f /tmp/map-$cfg.nft ]; then
+		nft delete table inet "map_$cfg" 2>/dev/null
+		rm -f /tmp/map-$cfg.nft
+	fi
+
 	rm -f /tmp/map-$cfg.rules
 }
 
@@ -101,6 +101,61 @@ static void bmemcpys64(void *av, const void *bv, size_t frombits, size_t nbits)
 	bmemcpy(av, &buf, nbits);
 }
 
+struct portrange {
+	uint16_t start;
+	uint16_t end;
+};
+
+/* Expand the PSID into the port ranges it owns, ports 0-1023 excluded
+ * when an offset is used; ranges must hold 1 << offset entries */
+static int portsets(int offset, int psidlen, int psid, struct portrange *ranges)
+{
+	int n = 0;
+
+	for (int k = (offset) ? 1 : 0; k < (1 << offset); ++k) {
+		int start = (k << (16 - offset)) | (psid >> offset);
+		int end = start + (1 << (16 - offset - psidlen)) - 1;
+
+		if (start == 0)
+			start = 1;
+
+		if (start <= end) {
+			ranges[n].start = start;
+			ranges[n].end = end;
+			++n;
+		}
+	}
+
+	return n;
+}
+
+static void print_portrange(const struct portrange *r)
+{
+	if (r->start == r->end)
+		printf("%d", r->start);
+	else
+		printf("%d-%d", r->start, r->end);
+}
+
+/* A numgen keyed SNAT map per rule, so the port restriction costs one
+ * lookup instead of one rule per range. ICMP ids share the port ranges */
+static void print_nft(int rulecnt, const char *ipv4addr,
+		const struct portrange *ranges, int n)
+{
+	printf("# rule %d: %d port ranges\n", rulecnt, n);
+
+	printf("map rule_%d_snat {\n", rulecnt);
+	printf("\ttype mark : interval ipv4_addr . inet_service\n");
+	printf("\tflags interval\n");
+	printf("\telements = {");
+	for (int i = 0; i < n; ++i) {
+		printf("%s%d : %s . ", (i % 4) ? ", " : (i) ? ",\n\t\t" : "\n\t\t",
+				i, ipv4addr);
+		print_portrange(&ranges[i]);
+	}
+	printf("\n\t}\n}\n");
+}
+
 static void handle_dump(struct ubus_request *req __attribute__((unused)),
 		int type __attribute__((unused)), struct blob_attr *msg)
 {
@@ -195,9 +250,12 @@ int main(int argc, char *argv[])
 	const char *legacy_env = getenv("LEGACY");
 	bool legacy = legacy_env && atoi(legacy_env);
 
+	const char *nft_env = getenv("NFT");
+	bool nft = nft_env && atoi(nft_env);
 
 	if (argc < 3) {
 		fprintf(stderr, "Usage: %s <interface|*> <rule1> [rule2] [...]\n", argv[0]);
+		fprintf(stderr, "Set NFT=1 to print nftables port sets instead of shell variables\n");
 		return 1;
 	}
 
@@ -356,6 +414,18 @@ int main(int argc, char *argv[])
 		}
 
 		++rulecnt;
+		struct portrange *ranges = NULL;
+		int nranges = 0;
+
+		if (psidlen > 0 && psid >= 0) {
+			ranges = calloc(1 << offset, sizeof(*ranges));
+			if (!ranges) {
+				fprintf(stderr, "Out of memory\n");
+				return 1;
+			}
+			nranges = portsets(offset, psidlen, psid, ranges);
+		}
+
 		char ipv4addrbuf[INET_ADDRSTRLEN];
 		char ipv4prefixbuf[INET_ADDRSTRLEN];
 		char ipv6prefixbuf[INET6_ADDRSTRLEN];
@@ -368,6 +438,13 @@ int main(int argc, char *argv[])
 		inet_ntop(AF_INET6, &ipv6addr, ipv6addrbuf, sizeof(ipv6addrbuf));
 		inet_ntop(AF_INET6, &pd, pdbuf, sizeof(pdbuf));
 
+		if (nft) {
+			if (nranges > 0 && ipv4addr.s_addr)
+				print_nft(rulecnt, ipv4addrbuf, ranges, nranges);
+			free(ranges);
+			continue;
+		}
+
 		printf("RULE_%d_FMR=%d\n", rulecnt, fmr);
 		printf("RULE_%d_EALEN=%d\n", rulecnt, ealen);
 		printf("RULE_%d_PSIDLEN=%d\n", rulecnt, psidlen);
@@ -393,16 +470,8 @@ int main(int argc, char *argv[])
 
 		if (psidlen > 0 && psid >= 0) {
 			printf("RULE_%d_PORTSETS='", rulecnt);
-			for (int k = (offset) ? 1 : 0; k < (1 << offset); ++k) {
-				int start = (k << (16 - offset)) | (psid >> offset);
-				int end = start + (1 << (16 - offset - psidlen)) - 1;
-
-				if (start == 0)
-					start = 1;
-
-				if (start <= end)
-					printf("%d-%d ", start, end);
-			}
+			for (int k = 0; k < nranges; ++k)
+				printf("%d-%d ", ranges[k].start, ranges[k].end);
 			printf("'\n");
 		}
 
@@ -411,8 +480,11 @@ int main(int argc, char *argv[])
 
 		if (br)
 			printf("RULE_%d_BR=%s\n", rulecnt, br);
+
+		free(ranges);
 	}
 
-	printf("RULE_COUNT=%d\n", rulecnt);
+	if (!nft)
+		printf("RULE_COUNT=%d\n", rulecnt);
 	return status;
 }
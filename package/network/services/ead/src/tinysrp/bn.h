@@ -74,7 +74,7 @@ extern "C" {
 #undef BN_SQR_COMBA
 #undef BN_RECURSION
 #undef RECP_MUL_MOD
-#undef MONT_MUL_MOD
+#define MONT_MUL_MOD
 
 #if defined(SIZEOF_LONG_LONG) && SIZEOF_LONG_LONG == 8
 # if SIZEOF_LONG == 4
@@ -272,6 +272,19 @@ typedef struct bn_recp_ctx_st
 	int flags;
 	} BN_RECP_CTX;
 
+/* Used for fixed-base exponentiation (comb method).  The exponent is cut
+ * into BN_BASE_TEETH rows of 'span' bits; table[i] holds the product of
+ * g^(2^(span*j)) for every bit j set in i, in montgomery form. */
+#define BN_BASE_TEETH   5
+typedef struct bn_base_ctx_st
+	{
+	BN_MONT_CTX mont;
+	BIGNUM g;       /* the base */
+	int span;       /* exponent bits per row */
+	BIGNUM table[1<<BN_BASE_TEETH];
+	int flags;
+	} BN_BASE_CTX;
+
 #define BN_to_montgomery(r,a,mont,ctx)  BN_mod_mul_montgomery(\
 	r,a,&((mont)->RR),(mont),ctx)
 
@@ -382,6 +395,13 @@ void BN_MONT_CTX_free(BN_MONT_CTX *mont);
 int BN_MONT_CTX_set(BN_MONT_CTX *mont,const BIGNUM *modulus,BN_CTX *ctx);
 BN_MONT_CTX *BN_MONT_CTX_copy(BN_MONT_CTX *to,BN_MONT_CTX *from);
 
+BN_BASE_CTX *BN_BASE_CTX_new(void);
+void BN_BASE_CTX_init(BN_BASE_CTX *base);
+void BN_BASE_CTX_free(BN_BASE_CTX *base);
+int BN_BASE_CTX_set(BN_BASE_CTX *base,const BIGNUM *g,const BIGNUM *m,
+		    int bits,BN_CTX *ctx);
+int BN_mod_exp_base(BIGNUM *r,const BIGNUM *p,BN_BASE_CTX *base,BN_CTX *ctx);
+
 void BN_set_params(int mul,int high,int low,int mont);
 int BN_get_params(int which); /* 0, mul, 1 high, 2 low, 3 mont */
 
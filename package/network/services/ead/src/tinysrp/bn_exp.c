@@ -111,6 +111,7 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "bn_lcl.h"
 
 #define TABLE_SIZE      32
@@ -155,15 +156,7 @@ int BN_mod_exp(BIGNUM *r, BIGNUM *a, const BIGNUM *p, const BIGNUM *m,
 /*      if ((m->d[m->top-1]&BN_TBIT) && BN_is_odd(m)) */
 
 	if (BN_is_odd(m))
-		{
-		if (a->top == 1)
-			{
-			BN_ULONG A = a->d[0];
-			ret=BN_mod_exp_mont_word(r,A,p,m,ctx,NULL);
-			}
-		else
-			ret=BN_mod_exp_mont(r,a,p,m,ctx,NULL);
-		}
+		{ ret=BN_mod_exp_mont(r,a,p,m,ctx,NULL); }
 	else
 #endif
 #ifdef RECP_MUL_MOD
@@ -175,6 +168,291 @@ int BN_mod_exp(BIGNUM *r, BIGNUM *a, const BIGNUM *p, const BIGNUM *m,
 	return(ret);
 	}
 
+int BN_mod_exp_mont(BIGNUM *rr, BIGNUM *a, const BIGNUM *p,
+		    const BIGNUM *m, BN_CTX *ctx, BN_MONT_CTX *in_mont)
+	{
+	int i,j,bits,ret=0,wstart,wend,window,wvalue;
+	int start=1,ts=0;
+	BIGNUM *d,*r;
+	BIGNUM *aa;
+	BIGNUM val[TABLE_SIZE];
+	BN_MONT_CTX *mont=NULL;
+
+	bn_check_top(a);
+	bn_check_top(p);
+	bn_check_top(m);
+
+	if (!(m->d[0] & 1))
+		{
+		return(0);
+		}
+	bits=BN_num_bits(p);
+	if (bits == 0)
+		{
+		BN_one(rr);
+		return(1);
+		}
+	BN_CTX_start(ctx);
+	d = BN_CTX_get(ctx);
+	r = BN_CTX_get(ctx);
+	if (d == NULL || r == NULL) goto err;
+
+	/* If this is not done, things will break in the montgomery
+	 * part */
+
+	if (in_mont != NULL)
+		mont=in_mont;
+	else
+		{
+		if ((mont=BN_MONT_CTX_new()) == NULL) goto err;
+		if (!BN_MONT_CTX_set(mont,m,ctx)) goto err;
+		}
+
+	BN_init(&val[0]);
+	ts=1;
+	if (BN_ucmp(a,m) >= 0)
+		{
+		if (!BN_mod(&(val[0]),a,m,ctx))
+			goto err;
+		aa= &(val[0]);
+		}
+	else
+		aa=a;
+	if (!BN_to_montgomery(&(val[0]),aa,mont,ctx)) goto err; /* 1 */
+
+	window = BN_window_bits_for_exponent_size(bits);
+	if (window > 1)
+		{
+		if (!BN_mod_mul_montgomery(d,&(val[0]),&(val[0]),mont,ctx)) goto err; /* 2 */
+		j=1<<(window-1);
+		for (i=1; i<j; i++)
+			{
+			BN_init(&(val[i]));
+			if (!BN_mod_mul_montgomery(&(val[i]),&(val[i-1]),d,mont,ctx))
+				goto err;
+			}
+		ts=i;
+		}
+
+	start=1;        /* This is used to avoid multiplication etc
+			 * when there is only the value '1' in the
+			 * buffer. */
+	wvalue=0;       /* The 'value' of the window */
+	wstart=bits-1;  /* The top bit of the window */
+	wend=0;         /* The bottom bit of the window */
+
+	if (!BN_to_montgomery(r,BN_value_one(),mont,ctx)) goto err;
+	for (;;)
+		{
+		if (BN_is_bit_set(p,wstart) == 0)
+			{
+			if (!start)
+				{
+				if (!BN_mod_mul_montgomery(r,r,r,mont,ctx))
+				goto err;
+				}
+			if (wstart == 0) break;
+			wstart--;
+			continue;
+			}
+		/* We now have wstart on a 'set' bit, we now need to work out
+		 * how bit a window to do.  To do this we need to scan
+		 * forward until the last set bit before the end of the
+		 * window */
+		j=wstart;
+		wvalue=1;
+		wend=0;
+		for (i=1; i<window; i++)
+			{
+			if (wstart-i < 0) break;
+			if (BN_is_bit_set(p,wstart-i))
+				{
+				wvalue<<=(i-wend);
+				wvalue|=1;
+				wend=i;
+				}
+			}
+
+		/* wend is the size of the current window */
+		j=wend+1;
+		/* add the 'bytes above' */
+		if (!start)
+			for (i=0; i<j; i++)
+				{
+				if (!BN_mod_mul_montgomery(r,r,r,mont,ctx))
+					goto err;
+				}
+
+		/* wvalue will be an odd number < 2^window */
+		if (!BN_mod_mul_montgomery(r,r,&(val[wvalue>>1]),mont,ctx))
+			goto err;
+
+		/* move the 'window' down further */
+		wstart-=wend+1;
+		wvalue=0;
+		start=0;
+		if (wstart < 0) break;
+		}
+	if (!BN_from_montgomery(rr,r,mont,ctx)) goto err;
+	ret=1;
+err:
+	if ((in_mont == NULL) && (mont != NULL)) BN_MONT_CTX_free(mont);
+	BN_CTX_end(ctx);
+	for (i=0; i<ts; i++)
+		BN_clear_free(&(val[i]));
+	return(ret);
+	}
+
+void BN_BASE_CTX_init(BN_BASE_CTX *base)
+	{
+	int i;
+
+	BN_MONT_CTX_init(&(base->mont));
+	BN_init(&(base->g));
+	base->span=0;
+	for (i=0; i<(1<<BN_BASE_TEETH); i++)
+		BN_init(&(base->table[i]));
+	base->flags=0;
+	}
+
+BN_BASE_CTX *BN_BASE_CTX_new(void)
+	{
+	BN_BASE_CTX *ret;
+
+	if ((ret=(BN_BASE_CTX *)malloc(sizeof(BN_BASE_CTX))) == NULL)
+		return(NULL);
+
+	BN_BASE_CTX_init(ret);
+	ret->flags=BN_FLG_MALLOCED;
+	return(ret);
+	}
+
+void BN_BASE_CTX_free(BN_BASE_CTX *base)
+	{
+	int i;
+
+	if (base == NULL)
+		return;
+
+	BN_MONT_CTX_free(&(base->mont));
+	BN_free(&(base->g));
+	for (i=0; i<(1<<BN_BASE_TEETH); i++)
+		BN_clear_free(&(base->table[i]));
+	if (base->flags & BN_FLG_MALLOCED)
+		free(base);
+	}
+
+/* Precompute the comb table for g^p mod m, p being at most 'bits' long.
+ * This costs about as much as one BN_mod_exp_mont(), so it only pays off
+ * when the same base is used more than once (e.g. the SRP generator). */
+int BN_BASE_CTX_set(BN_BASE_CTX *base, const BIGNUM *g, const BIGNUM *m,
+		    int bits, BN_CTX *ctx)
+	{
+	int i,j,ret=0;
+	BIGNUM *t;
+
+	bn_check_top(g);
+	bn_check_top(m);
+
+	if (!BN_is_odd(m) || bits <= 0)
+		return(0);
+
+	BN_CTX_start(ctx);
+	if ((t = BN_CTX_get(ctx)) == NULL) goto err;
+
+	if (!BN_MONT_CTX_set(&(base->mont),m,ctx)) goto err;
+	if (!BN_copy(&(base->g),g)) goto err;
+	base->span=(bits+BN_BASE_TEETH-1)/BN_BASE_TEETH;
+
+	if (BN_ucmp(g,m) >= 0)
+		{
+		if (!BN_mod(t,g,m,ctx)) goto err;
+		}
+	else
+		{
+		if (!BN_copy(t,g)) goto err;
+		}
+
+	/* table[0] = 1, table[1<<j] = g^(2^(span*j)) */
+	if (!BN_to_montgomery(&(base->table[0]),BN_value_one(),&(base->mont),ctx))
+		goto err;
+	if (!BN_to_montgomery(&(base->table[1]),t,&(base->mont),ctx)) goto err;
+	for (j=1; j<BN_BASE_TEETH; j++)
+		{
+		if (!BN_copy(t,&(base->table[1<<(j-1)]))) goto err;
+		for (i=0; i<base->span; i++)
+			if (!BN_mod_mul_montgomery(t,t,t,&(base->mont),ctx))
+				goto err;
+		if (!BN_copy(&(base->table[1<<j]),t)) goto err;
+		}
+
+	/* the remaining entries combine the rows above */
+	for (i=3; i<(1<<BN_BASE_TEETH); i++)
+		{
+		if ((i & (i-1)) == 0)
+			continue;
+		j=i & -i;
+		if (!BN_mod_mul_montgomery(&(base->table[i]),&(base->table[i^j]),
+					   &(base->table[j]),&(base->mont),ctx))
+			goto err;
+		}
+	ret=1;
+err:
+	BN_CTX_end(ctx);
+	return(ret);
+	}
+
+/* Fixed-base exponentiation: span squarings and at most span
+ * multiplications, against bits squarings for BN_mod_exp_mont(). */
+int BN_mod_exp_base(BIGNUM *rr, const BIGNUM *p, BN_BASE_CTX *base,
+		    BN_CTX *ctx)
+	{
+	int i,j,k,bits,ret=0;
+	int start=1;
+	BIGNUM *r;
+
+	bn_check_top(p);
+
+	bits=BN_num_bits(p);
+	if (bits == 0)
+		{
+		BN_one(rr);
+		return(1);
+		}
+
+	/* exponent too long for the table */
+	if (bits > base->span*BN_BASE_TEETH)
+		return(BN_mod_exp_mont(rr,&(base->g),p,&(base->mont.N),ctx,
+				       &(base->mont)));
+
+	BN_CTX_start(ctx);
+	if ((r = BN_CTX_get(ctx)) == NULL) goto err;
+	if (!BN_copy(r,&(base->table[0]))) goto err;
+
+	for (i=base->span-1; i>=0; i--)
+		{
+		if (!start)
+			if (!BN_mod_mul_montgomery(r,r,r,&(base->mont),ctx))
+				goto err;
+
+		k=0;
+		for (j=BN_BASE_TEETH-1; j>=0; j--)
+			k=(k<<1)|BN_is_bit_set(p,i+j*base->span);
+
+		if (k)
+			{
+			if (!BN_mod_mul_montgomery(r,r,&(base->table[k]),
+						   &(base->mont),ctx))
+				goto err;
+			start=0;
+			}
+		}
+	if (!BN_from_montgomery(rr,r,&(base->mont),ctx)) goto err;
+	ret=1;
+err:
+	BN_CTX_end(ctx);
+	return(ret);
+	}
 
 #ifdef RECP_MUL_MOD
 int BN_mod_exp_recp(BIGNUM *r, const BIGNUM *a, const BIGNUM *p,
@@ -40,9 +40,91 @@
  */
 
 #include <stdio.h>
+#include <sys/time.h>
 #include "t_defines.h"
 #include "t_pwd.h"
 #include "t_server.h"
+#include "t_client.h"
+
+#define BENCH_USER "bench"
+
+static double
+now()
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/*
+ * Run complete handshakes against an in-process client and report how
+ * many of them the server side manages per second.  Only the server
+ * calls are timed.
+ */
+static int
+bench(count, id)
+     int count;
+     int id;
+{
+  struct t_confent * tce;
+  struct t_pwent tpe;
+  struct t_client * tc;
+  struct t_server * ts;
+  struct t_num salt, * A, * B;
+  unsigned char saltbuf[10];
+  unsigned char * skey;
+  double t, spent = 0;
+  int i, failed = 0;
+
+  tce = gettcid(id);
+  if(tce == NULL) {
+    fprintf(stderr, "Invalid parameter index %d\n", id);
+    return 1;
+  }
+
+  salt.data = saltbuf;
+  salt.len = sizeof(saltbuf);
+
+  for(i = 0; i < count; ++i) {
+    t_random(salt.data, salt.len);
+
+    tc = t_clientopen(BENCH_USER, &tce->modulus, &tce->generator, &salt);
+    A = t_clientgenexp(tc);
+    t_clientpasswd(tc, BENCH_USER);
+
+    tpe.name = BENCH_USER;
+    tpe.index = id;
+    tpe.password = tc->v;
+    tpe.salt = tc->s;
+
+    t = now();
+    ts = t_serveropenraw(&tpe, tce);
+    B = t_servergenexp(ts);
+    skey = t_servergetkey(ts, A);
+    spent += now() - t;
+
+    if(skey == NULL || t_clientgetkey(tc, B) == NULL) {
+      ++failed;
+    } else {
+      t = now();
+      if(t_serververify(ts, t_clientresponse(tc)) != 0)
+        ++failed;
+      spent += now() - t;
+      if(t_clientverify(tc, t_serverresponse(ts)) != 0)
+        ++failed;
+    }
+
+    t_serverclose(ts);
+    t_clientclose(tc);
+  }
+
+  printf("%d-bit modulus: %d handshakes, %d failed, %.3f s server time, "
+         "%.1f handshakes/s\n", 8 * tce->modulus.len, count, failed,
+         spent, spent > 0 ? count / spent : 0);
+
+  return failed != 0;
+}
 
 int
 main(argc, argv)
@@ -63,6 +145,9 @@ main(argc, argv)
   FILE * fp2;
   char confname[256];
 
+  if(argc > 2 && strcmp(argv[1], "-b") == 0)
+    return bench(atoi(argv[2]), argc > 3 ? atoi(argv[3]) : 1);
+
   printf("Enter username: ");
   fgets(username, sizeof(username), stdin);
   username[strlen(username) - 1] = '\0';
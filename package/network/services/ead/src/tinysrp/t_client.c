@@ -140,7 +140,7 @@ t_clientgenexp(tc)
   n = BigIntegerFromBytes(tc->n.data, tc->n.len);
   g = BigIntegerFromBytes(tc->g.data, tc->g.len);
   A = BigIntegerFromInt(0);
-  BigIntegerModExp(A, g, a, n);
+  BigIntegerModExpBase(A, g, a, n);
   tc->A.len = BigIntegerToBytes(A, tc->A.data);
 
   BigIntegerFree(A);
@@ -180,7 +180,7 @@ t_clientpasswd(tc, password)
   p = BigIntegerFromBytes(dig, sizeof(dig));
 
   v = BigIntegerFromInt(0);
-  BigIntegerModExp(v, g, p, n);
+  BigIntegerModExpBase(v, g, p, n);
 
   tc->p.len = BigIntegerToBytes(p, tc->p.data);
   BigIntegerFree(p);
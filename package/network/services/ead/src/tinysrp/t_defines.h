@@ -163,6 +163,10 @@ _TYPE( void ) BigIntegerModExp P((BigInteger result, BigInteger base,
 				BigInteger expt, BigInteger modulus));
 _TYPE( void ) BigIntegerModExpInt P((BigInteger result, BigInteger base,
 				   unsigned int expt, BigInteger modulus));
+/* For BigIntegerModExpBase: base is fixed (the group generator), a table
+   for it is precomputed on first use and kept across calls */
+_TYPE( void ) BigIntegerModExpBase P((BigInteger result, BigInteger base,
+				BigInteger expt, BigInteger modulus));
 _TYPE( int ) BigIntegerCheckPrime P((BigInteger n));
 _TYPE( void ) BigIntegerFree P((BigInteger b));
 
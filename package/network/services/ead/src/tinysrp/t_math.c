@@ -146,12 +146,74 @@ BigIntegerModMul(r, m1, m2, modulus)
   BN_CTX_free(ctx);
 }
 
+/*
+ * A session only ever works in one group, so the Montgomery context of
+ * the last modulus and the fixed-base table of the last generator are
+ * kept around instead of being rebuilt for every exponentiation.
+ */
+#define BASE_EXP_BITS 256	/* covers ALEN/BLEN and SHA-1 exponents */
+
+static BN_BASE_CTX * base_ctx = NULL;
+
+static BN_MONT_CTX *
+BigIntegerMont(m, ctx)
+     BigInteger m;
+     BN_CTX * ctx;
+{
+  if(!BN_is_odd(m))
+    return NULL;
+
+  if(base_ctx == NULL && (base_ctx = BN_BASE_CTX_new()) == NULL)
+    return NULL;
+
+  if(BN_cmp(&base_ctx->mont.N, m) != 0) {
+    BN_zero(&base_ctx->g);
+    base_ctx->span = 0;
+    if(!BN_MONT_CTX_set(&base_ctx->mont, m, ctx)) {
+      BN_zero(&base_ctx->mont.N);
+      return NULL;
+    }
+  }
+
+  return &base_ctx->mont;
+}
+
 void
 BigIntegerModExp(r, b, e, m)
      BigInteger r, b, e, m;
 {
   BN_CTX * ctx = BN_CTX_new();
-  BN_mod_exp(r, b, e, m, ctx);
+  BN_MONT_CTX * mont = BigIntegerMont(m, ctx);
+
+  if(mont)
+    BN_mod_exp_mont(r, b, e, m, ctx, mont);
+  else
+    BN_mod_exp(r, b, e, m, ctx);
+  BN_CTX_free(ctx);
+}
+
+void
+BigIntegerModExpBase(r, b, e, m)
+     BigInteger r, b, e, m;
+{
+  BN_CTX * ctx = BN_CTX_new();
+
+  if(BigIntegerMont(m, ctx) == NULL) {
+    BN_mod_exp(r, b, e, m, ctx);
+    BN_CTX_free(ctx);
+    return;
+  }
+
+  if(base_ctx->span == 0 || BN_cmp(&base_ctx->g, b) != 0) {
+    if(!BN_BASE_CTX_set(base_ctx, b, m, BASE_EXP_BITS, ctx)) {
+      base_ctx->span = 0;
+      BN_mod_exp_mont(r, b, e, m, ctx, &base_ctx->mont);
+      BN_CTX_free(ctx);
+      return;
+    }
+  }
+
+  BN_mod_exp_base(r, e, base_ctx, ctx);
   BN_CTX_free(ctx);
 }
 
@@ -162,9 +224,13 @@ BigIntegerModExpInt(r, b, e, m)
      BigInteger m;
 {
   BN_CTX * ctx = BN_CTX_new();
+  BN_MONT_CTX * mont = BigIntegerMont(m, ctx);
   BIGNUM * p = BN_new();
   BN_set_word(p, e);
-  BN_mod_exp(r, b, p, m, ctx);
+  if(mont)
+    BN_mod_exp_mont(r, b, p, m, ctx, mont);
+  else
+    BN_mod_exp(r, b, p, m, ctx);
   BN_free(p);
   BN_CTX_free(ctx);
 }
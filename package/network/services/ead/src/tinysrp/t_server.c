@@ -123,7 +123,7 @@ t_servergenexp(ts)
   n = BigIntegerFromBytes(ts->n.data, ts->n.len);
   g = BigIntegerFromBytes(ts->g.data, ts->g.len);
   B = BigIntegerFromInt(0);
-  BigIntegerModExp(B, g, b, n);
+  BigIntegerModExpBase(B, g, b, n);
 
   v = BigIntegerFromBytes(ts->v.data, ts->v.len);
   BigIntegerAdd(B, B, v);
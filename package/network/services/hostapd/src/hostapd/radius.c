@@ -15,13 +15,23 @@
 #include <libubox/avl.h>
 #include <libubox/avl-cmp.h>
 #include <libubox/kvlist.h>
+#include <libubox/list.h>
 
+#include <sys/inotify.h>
 #include <sys/stat.h>
 #include <fnmatch.h>
+#include <time.h>
 
 #define VENDOR_ID_WISPR 14122
 #define VENDOR_ATTR_SIZE 6
 
+/* coalesce the burst of events an editor or a config writer produces */
+#define USERS_RELOAD_DELAY_MS	100
+/* stat() interval if inotify is not available */
+#define USERS_POLL_INTERVAL	5
+/* sessions keep pointers into the user state, see radius_userdb_retire() */
+#define USERS_RETIRE_TIMEOUT	60
+
 struct radius_parse_attr_data {
 	unsigned int vendor;
 	u8 type;
@@ -42,19 +52,61 @@ struct radius_user_state {
 	struct eap_user data;
 };
 
+struct radius_user_wildcard {
+	struct avl_node node;
+	struct blob_attr *data;
+	const char *pattern;
+	int index;
+};
+
 struct radius_user_data {
 	struct kvlist users;
 	struct avl_tree user_state;
 	struct blob_attr *wildcard;
+
+	/*
+	 * Compiled wildcard list. Patterns without glob characters go to
+	 * wc_exact, "prefix*" patterns to wc_prefix (keyed by the prefix,
+	 * probed once per distinct prefix length), everything else is
+	 * matched with fnmatch() in list order. The lowest index wins, as
+	 * with a linear scan.
+	 */
+	struct radius_user_wildcard *wc;
+	struct avl_tree wc_exact;
+	struct avl_tree wc_prefix;
+	int *prefix_len;
+	int n_prefix_len;
+	int *wc_glob;
+	int n_wc_glob;
+};
+
+struct radius_userdb {
+	struct list_head list;
+	struct radius_user_data phase1, phase2;
+};
+
+struct radius_user_stats {
+	unsigned long lookups;
+	unsigned long exact;
+	unsigned long wildcard;
+	unsigned long miss;
+	unsigned long long time_total;
+	unsigned long long time_max;
+	unsigned long reloads;
+	unsigned long reload_errors;
 };
 
 struct radius_state {
 	struct radius_server_data *radius;
 	struct eap_config eap;
 
-	struct radius_user_data phase1, phase2;
+	struct radius_userdb *users;
+	struct list_head retired;
 	const char *user_file;
 	time_t user_file_ts;
+	int inotify_fd;
+
+	struct radius_user_stats stats;
 
 	int n_attrs;
 	struct hostapd_radius_attr *attrs;
@@ -111,10 +163,21 @@ static void radius_tls_event(void *ctx, enum tls_event ev,
 	}
 }
 
+static unsigned long long radius_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 static void radius_userdata_init(struct radius_user_data *u)
 {
 	kvlist_init(&u->users, kvlist_blob_len);
 	avl_init(&u->user_state, avl_strcmp, false, NULL);
+	avl_init(&u->wc_exact, avl_strcmp, false, NULL);
+	avl_init(&u->wc_prefix, avl_strcmp, false, NULL);
 }
 
 static void radius_userdata_free(struct radius_user_data *u)
@@ -126,6 +189,93 @@ static void radius_userdata_free(struct radius_user_data *u)
 	u->wildcard = NULL;
 	avl_remove_all_elements(&u->user_state, s, node, tmp)
 		free(s);
+
+	/* the wildcard entries are owned by the wc array */
+	avl_init(&u->wc_exact, avl_strcmp, false, NULL);
+	avl_init(&u->wc_prefix, avl_strcmp, false, NULL);
+	free(u->wc);
+	u->wc = NULL;
+	free(u->prefix_len);
+	u->prefix_len = NULL;
+	u->n_prefix_len = 0;
+	free(u->wc_glob);
+	u->wc_glob = NULL;
+	u->n_wc_glob = 0;
+}
+
+static void
+radius_userdata_add_prefix_len(struct radius_user_data *u, int len)
+{
+	int i;
+
+	for (i = 0; i < u->n_prefix_len; i++) {
+		if (u->prefix_len[i] == len)
+			return;
+		if (u->prefix_len[i] > len)
+			break;
+	}
+
+	memmove(&u->prefix_len[i + 1], &u->prefix_len[i],
+		(u->n_prefix_len - i) * sizeof(*u->prefix_len));
+	u->prefix_len[i] = len;
+	u->n_prefix_len++;
+}
+
+static void
+radius_userdata_compile(struct radius_user_data *u)
+{
+	static const struct blobmsg_policy policy = {
+		"name", BLOBMSG_TYPE_STRING
+	};
+	struct radius_user_wildcard *wc;
+	struct blob_attr *cur, *pattern;
+	int n = 0, rem;
+
+	blobmsg_for_each_attr(cur, u->wildcard, rem)
+		n++;
+
+	if (!n)
+		return;
+
+	u->wc = calloc(n, sizeof(*u->wc));
+	u->prefix_len = calloc(n, sizeof(*u->prefix_len));
+	u->wc_glob = calloc(n, sizeof(*u->wc_glob));
+	if (!u->wc || !u->prefix_len || !u->wc_glob)
+		return;
+
+	n = 0;
+	blobmsg_for_each_attr(cur, u->wildcard, rem) {
+		const char *name, *glob;
+		size_t len;
+
+		if (blobmsg_type(cur) != BLOBMSG_TYPE_TABLE)
+			continue;
+
+		blobmsg_parse(&policy, 1, &pattern, blobmsg_data(cur), blobmsg_len(cur));
+		if (!pattern)
+			continue;
+
+		name = blobmsg_get_string(pattern);
+		wc = &u->wc[n];
+		wc->data = cur;
+		wc->pattern = name;
+		wc->index = n++;
+
+		len = strlen(name);
+		glob = strpbrk(name, "*?[\\");
+		if (!glob) {
+			wc->node.key = name;
+			avl_insert(&u->wc_exact, &wc->node);
+		} else if (glob == name + len - 1 && *glob == '*') {
+			/* NUL-terminate the prefix inside the private copy */
+			*(char *)glob = 0;
+			wc->node.key = name;
+			if (!avl_insert(&u->wc_prefix, &wc->node))
+				radius_userdata_add_prefix_len(u, len - 1);
+		} else {
+			u->wc_glob[u->n_wc_glob++] = wc->index;
+		}
+	}
 }
 
 static void
@@ -153,10 +303,19 @@ radius_userdata_load(struct radius_user_data *u, struct blob_attr *data)
 
 	if (tb[USERSTATE_WILDCARD])
 		u->wildcard = blob_memdup(tb[USERSTATE_WILDCARD]);
+
+	radius_userdata_compile(u);
 }
 
-static void
-load_userfile(struct radius_state *s)
+static void radius_userdb_free(struct radius_userdb *db)
+{
+	radius_userdata_free(&db->phase1);
+	radius_userdata_free(&db->phase2);
+	free(db);
+}
+
+static struct radius_userdb *
+radius_userdb_load(const char *file)
 {
 	enum {
 		USERDATA_PHASE1,
@@ -167,57 +326,228 @@ load_userfile(struct radius_state *s)
 		[USERDATA_PHASE1] = { "phase1", BLOBMSG_TYPE_TABLE },
 		[USERDATA_PHASE2] = { "phase2", BLOBMSG_TYPE_TABLE },
 	};
-	struct blob_attr *tb[__USERDATA_MAX], *cur;
+	struct blob_attr *tb[__USERDATA_MAX];
+	struct radius_userdb *db;
 	static struct blob_buf b;
-	struct stat st;
-	int rem;
 
-	if (stat(s->user_file, &st))
-		return;
+	blob_buf_init(&b, 0);
+	if (!blobmsg_add_json_from_file(&b, file))
+		return NULL;
 
-	if (s->user_file_ts == st.st_mtime)
-		return;
+	db = calloc(1, sizeof(*db));
+	if (!db)
+		return NULL;
 
-	s->user_file_ts = st.st_mtime;
-	radius_userdata_free(&s->phase1);
-	radius_userdata_free(&s->phase2);
+	radius_userdata_init(&db->phase1);
+	radius_userdata_init(&db->phase2);
 
-	blob_buf_init(&b, 0);
-	blobmsg_add_json_from_file(&b, s->user_file);
 	blobmsg_parse(policy, __USERDATA_MAX, tb, blob_data(b.head), blob_len(b.head));
-	radius_userdata_load(&s->phase1, tb[USERDATA_PHASE1]);
-	radius_userdata_load(&s->phase2, tb[USERDATA_PHASE2]);
+	radius_userdata_load(&db->phase1, tb[USERDATA_PHASE1]);
+	radius_userdata_load(&db->phase2, tb[USERDATA_PHASE2]);
 
 	blob_buf_free(&b);
+
+	return db;
 }
 
-static struct blob_attr *
-radius_user_get(struct radius_user_data *s, const char *name)
+static void radius_userdb_expire(void *eloop_ctx, void *timeout_ctx)
 {
-	struct blob_attr *cur;
-	int rem;
+	struct radius_userdb *db = timeout_ctx;
 
-	cur = kvlist_get(&s->users, name);
-	if (cur)
-		return cur;
+	list_del(&db->list);
+	radius_userdb_free(db);
+}
 
-	blobmsg_for_each_attr(cur, s->wildcard, rem) {
-		static const struct blobmsg_policy policy = {
-			"name", BLOBMSG_TYPE_STRING
-		};
-		struct blob_attr *pattern;
+/*
+ * Sessions in progress keep pointers to the accept attributes of the
+ * user state they were started with, so a replaced database is only
+ * freed once any session using it has timed out.
+ */
+static void
+radius_userdb_retire(struct radius_state *s, struct radius_userdb *db)
+{
+	list_add_tail(&db->list, &s->retired);
+	eloop_register_timeout(USERS_RETIRE_TIMEOUT, 0, radius_userdb_expire,
+			       s, db);
+}
 
-		if (blobmsg_type(cur) != BLOBMSG_TYPE_TABLE)
-			continue;
+static void
+radius_userdb_reload(struct radius_state *s)
+{
+	struct radius_userdb *db;
+	unsigned long long start = radius_time_ns();
+	struct stat st;
 
-		blobmsg_parse(&policy, 1, &pattern, blobmsg_data(cur), blobmsg_len(cur));
-		if (!name)
-			continue;
+	if (!stat(s->user_file, &st))
+		s->user_file_ts = st.st_mtime;
 
-		if (!fnmatch(blobmsg_get_string(pattern), name, 0))
-			return cur;
+	db = radius_userdb_load(s->user_file);
+	if (!db) {
+		s->stats.reload_errors++;
+		wpa_printf(MSG_ERROR, "radius: failed to load user file %s, keeping previous data",
+			   s->user_file);
+		return;
 	}
 
+	if (s->users)
+		radius_userdb_retire(s, s->users);
+	s->users = db;
+	s->stats.reloads++;
+
+	wpa_printf(MSG_DEBUG, "radius: loaded user file %s in %llu us",
+		   s->user_file, (radius_time_ns() - start) / 1000);
+}
+
+static void radius_userdb_reload_cb(void *eloop_ctx, void *timeout_ctx)
+{
+	radius_userdb_reload(eloop_ctx);
+}
+
+static void radius_userdb_schedule_reload(struct radius_state *s)
+{
+	eloop_cancel_timeout(radius_userdb_reload_cb, s, NULL);
+	eloop_register_timeout(0, USERS_RELOAD_DELAY_MS * 1000,
+			       radius_userdb_reload_cb, s, NULL);
+}
+
+static void radius_userdb_poll(void *eloop_ctx, void *timeout_ctx)
+{
+	struct radius_state *s = eloop_ctx;
+	struct stat st;
+
+	if (!stat(s->user_file, &st) && st.st_mtime != s->user_file_ts)
+		radius_userdb_reload(s);
+
+	eloop_register_timeout(USERS_POLL_INTERVAL, 0, radius_userdb_poll, s, NULL);
+}
+
+static void radius_userdb_inotify(int sock, void *eloop_ctx, void *sock_ctx)
+{
+	struct radius_state *s = eloop_ctx;
+	const char *file = sock_ctx;
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	bool changed = false;
+	ssize_t len;
+	char *ptr;
+
+	while ((len = read(sock, buf, sizeof(buf))) > 0) {
+		for (ptr = buf; ptr < buf + len; ptr += sizeof(*ev) + ev->len) {
+			ev = (const struct inotify_event *) ptr;
+			if (ev->len && !strcmp(ev->name, file))
+				changed = true;
+		}
+	}
+
+	if (changed)
+		radius_userdb_schedule_reload(s);
+}
+
+/*
+ * Watch the directory rather than the file, so that files replaced by
+ * rename() (as most config writers do) are picked up as well.
+ */
+static void radius_userdb_watch(struct radius_state *s)
+{
+	const char *file;
+	char *dir;
+
+	s->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (s->inotify_fd < 0)
+		goto poll;
+
+	dir = os_strdup(s->user_file);
+	if (!dir)
+		goto close;
+
+	file = strrchr(s->user_file, '/');
+	if (file) {
+		dir[file - s->user_file] = 0;
+		file++;
+	} else {
+		strcpy(dir, ".");
+		file = s->user_file;
+	}
+
+	if (inotify_add_watch(s->inotify_fd, *dir ? dir : "/",
+			      IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+		os_free(dir);
+		goto close;
+	}
+	os_free(dir);
+
+	if (eloop_register_read_sock(s->inotify_fd, radius_userdb_inotify,
+				     s, (void *) file))
+		goto close;
+
+	return;
+
+close:
+	close(s->inotify_fd);
+	s->inotify_fd = -1;
+poll:
+	wpa_printf(MSG_INFO, "radius: inotify unavailable, polling user file");
+	eloop_register_timeout(USERS_POLL_INTERVAL, 0, radius_userdb_poll, s, NULL);
+}
+
+static struct radius_user_wildcard *
+radius_user_get_wildcard(struct radius_user_data *u, const char *name)
+{
+	struct radius_user_wildcard *best, *wc;
+	size_t name_len = strlen(name);
+	char *prefix;
+	int i;
+
+	best = avl_find_element(&u->wc_exact, name, best, node);
+
+	if (u->n_prefix_len) {
+		prefix = alloca(name_len + 1);
+		for (i = 0; i < u->n_prefix_len; i++) {
+			size_t len = u->prefix_len[i];
+
+			if (len > name_len)
+				break;
+
+			memcpy(prefix, name, len);
+			prefix[len] = 0;
+			wc = avl_find_element(&u->wc_prefix, prefix, wc, node);
+			if (wc && (!best || wc->index < best->index))
+				best = wc;
+		}
+	}
+
+	for (i = 0; i < u->n_wc_glob; i++) {
+		wc = &u->wc[u->wc_glob[i]];
+		if (best && wc->index > best->index)
+			break;
+
+		if (!fnmatch(wc->pattern, name, 0))
+			return wc;
+	}
+
+	return best;
+}
+
+static struct blob_attr *
+radius_user_get(struct radius_state *s, struct radius_user_data *u,
+		const char *name)
+{
+	struct radius_user_wildcard *wc;
+	struct blob_attr *cur;
+
+	cur = kvlist_get(&u->users, name);
+	if (cur) {
+		s->stats.exact++;
+		return cur;
+	}
+
+	wc = radius_user_get_wildcard(u, name);
+	if (wc) {
+		s->stats.wildcard++;
+		return wc->data;
+	}
+
+	s->stats.miss++;
 	return NULL;
 }
 
@@ -520,28 +850,38 @@ static int radius_get_eap_user(void *ctx, const u8 *identity,
 			       struct eap_user *user)
 {
 	struct radius_state *s = ctx;
-	struct radius_user_data *u = phase2 ? &s->phase2 : &s->phase1;
+	struct radius_user_data *u;
+	unsigned long long start, elapsed;
 	struct blob_attr *entry;
-	struct eap_user *data;
+	struct eap_user *data = NULL;
 	char *id;
 
-	if (identity_len > 512)
+	if (identity_len > 512 || !s->users)
 		return -1;
 
-	load_userfile(s);
+	u = phase2 ? &s->users->phase2 : &s->users->phase1;
 
 	id = alloca(identity_len + 1);
 	memcpy(id, identity, identity_len);
 	id[identity_len] = 0;
 
-	entry = radius_user_get(u, id);
+	start = radius_time_ns();
+	entry = radius_user_get(s, u, id);
+	if (entry && user)
+		data = radius_user_get_state(u, entry, id);
+
+	elapsed = radius_time_ns() - start;
+	s->stats.lookups++;
+	s->stats.time_total += elapsed;
+	if (elapsed > s->stats.time_max)
+		s->stats.time_max = elapsed;
+
 	if (!entry)
 		return -1;
 
 	if (!user)
 		return 0;
 
-	data = radius_user_get_state(u, entry, id);
 	if (!data)
 		return -1;
 
@@ -590,23 +930,55 @@ static int radius_setup(struct radius_state *s, struct radius_config *c)
 	return 0;
 }
 
+static void radius_stats_dump(int sig, void *signal_ctx)
+{
+	struct radius_state *s = signal_ctx;
+	struct radius_user_stats *st = &s->stats;
+
+	wpa_printf(MSG_INFO, "radius: user lookups=%lu exact=%lu wildcard=%lu miss=%lu "
+		   "avg=%lluns max=%lluns reloads=%lu reload_errors=%lu",
+		   st->lookups, st->exact, st->wildcard, st->miss,
+		   st->lookups ? st->time_total / st->lookups : 0,
+		   st->time_max, st->reloads, st->reload_errors);
+}
+
+static void radius_reconfig(int sig, void *signal_ctx)
+{
+	radius_userdb_reload(signal_ctx);
+}
+
 static int radius_init(struct radius_state *s)
 {
 	memset(s, 0, sizeof(*s));
-	radius_userdata_init(&s->phase1);
-	radius_userdata_init(&s->phase2);
+	INIT_LIST_HEAD(&s->retired);
+	s->inotify_fd = -1;
 }
 
 static void radius_deinit(struct radius_state *s)
 {
+	struct radius_userdb *db, *tmp;
+
 	if (s->radius)
 		radius_server_deinit(s->radius);
 
 	if (s->eap.ssl_ctx)
 		tls_deinit(s->eap.ssl_ctx);
 
-	radius_userdata_free(&s->phase1);
-	radius_userdata_free(&s->phase2);
+	if (s->inotify_fd >= 0) {
+		eloop_unregister_read_sock(s->inotify_fd);
+		close(s->inotify_fd);
+	}
+
+	eloop_cancel_timeout(radius_userdb_reload_cb, s, NULL);
+	eloop_cancel_timeout(radius_userdb_poll, s, NULL);
+	eloop_cancel_timeout(radius_userdb_expire, s, ELOOP_ALL_CTX);
+
+	list_for_each_entry_safe(db, tmp, &s->retired, list)
+		radius_userdb_free(db);
+
+	if (s->users)
+		radius_userdb_free(s->users);
+	s->users = NULL;
 }
 
 static int usage(const char *progname)
@@ -704,7 +1076,10 @@ int radius_main(int argc, char **argv)
 	if (ret)
 		goto out;
 
-	load_userfile(&state);
+	radius_userdb_reload(&state);
+	radius_userdb_watch(&state);
+	eloop_register_signal(SIGUSR1, radius_stats_dump, &state);
+	eloop_register_signal_reconfig(radius_reconfig, &state);
 	eloop_run();
 
 out:
@@ -26,20 +26,31 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <unistd.h>
 #include <syslog.h>
+#include <net/if.h>
+
+#include <linux/nl80211.h>
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <netlink/genl/ctrl.h>
+#include <libubox/list.h>
+#include <libubox/utils.h>
+#include <libubox/uloop.h>
 
 #include "iwinfo.h"
 
 #define RUN_DIR			"/var/run"
 #define LEDS_BASEPATH		"/sys/class/leds/"
 #define BACKEND_RETRY_DELAY	500000
-
-char *ifname;
-int qual_max;
+/* safety net poll while nl80211 events drive the updates, in ms */
+#define EVENT_WATCHDOG_DELAY	10000
 
 struct led {
 	char *sysfspath;
@@ -57,6 +68,30 @@ struct rule {
 	rule_t *next;
 };
 
+struct iface {
+	struct list_head list;
+	struct uloop_timeout timer;
+	const struct iwinfo_ops *iw;
+	char *ifname;
+	int ifindex;
+	int refresh;
+	int threshold;
+	int qual_max;
+	int q0;
+	/* CQM RSSI threshold currently armed in the driver */
+	bool cqm_armed;
+	bool cqm_unsupported;
+	int cqm_thold;
+	rule_t *rules;
+};
+
+static LIST_HEAD(ifaces);
+
+static struct nl_sock *nl_cmd, *nl_event;
+static struct nl_cb *nl_event_cb;
+static struct uloop_fd nl_event_fd;
+static int nl80211_id = -1;
+
 void log_rules(rule_t *rules)
 {
 	rule_t *rule = rules;
@@ -158,20 +193,20 @@ void close_led(struct led **led)
 }
 
 
-int quality(const struct iwinfo_ops *iw, const char *ifname)
+int quality(struct iface *ifc)
 {
 	int qual;
 
-	if ( ! iw ) return -1;
+	if ( ! ifc->iw ) return -1;
 
-	if (qual_max < 1)
-		if (iw->quality_max(ifname, &qual_max))
+	if (ifc->qual_max < 1)
+		if (ifc->iw->quality_max(ifc->ifname, &ifc->qual_max))
 			return -1;
 
-	if (iw->quality(ifname, &qual))
+	if (ifc->iw->quality(ifc->ifname, &qual))
 		return -1;
 
-	return ( qual * 100 ) / qual_max ;
+	return ( qual * 100 ) / ifc->qual_max ;
 }
 
 int open_backend(const struct iwinfo_ops **iw, const char *ifname)
@@ -206,39 +241,371 @@ void update_leds(rule_t *rules, int q)
 	}
 }
 
-int main(int argc, char **argv)
+static int nl_error_handler(struct sockaddr_nl *nla, struct nlmsgerr *err,
+			    void *arg)
 {
-	int i,q,q0,r,s;
-	const struct iwinfo_ops *iw = NULL;
-	rule_t *headrule = NULL, *currentrule = NULL;
+	int *ret = arg;
 
-	if (argc < 9 || ( (argc-4) % 5 != 0 ) )
-	{
-		printf("syntax: %s (ifname) (refresh) (threshold) (rule) [rule] ...\n", argv[0]);
-		printf("  rule: (sysfs-name) (minq) (maxq) (offset) (factore)\n");
-		return 1;
+	*ret = err->error;
+	return NL_STOP;
+}
+
+static int nl_finish_handler(struct nl_msg *msg, void *arg)
+{
+	int *ret = arg;
+
+	*ret = 0;
+	return NL_SKIP;
+}
+
+static int nl_ack_handler(struct nl_msg *msg, void *arg)
+{
+	int *ret = arg;
+
+	*ret = 0;
+	return NL_STOP;
+}
+
+static int nl_no_seq_check(struct nl_msg *msg, void *arg)
+{
+	return NL_OK;
+}
+
+/* send msg on the command socket and wait for the ack, consumes msg */
+static int nl_request(struct nl_msg *msg,
+		      int (*handler)(struct nl_msg *, void *), void *arg)
+{
+	struct nl_cb *cb;
+	int err = -ENOMEM;
+
+	cb = nl_cb_alloc(NL_CB_DEFAULT);
+	if (!cb)
+		goto out;
+
+	err = nl_send_auto_complete(nl_cmd, msg);
+	if (err < 0)
+		goto out;
+
+	err = 1;
+	nl_cb_err(cb, NL_CB_CUSTOM, nl_error_handler, &err);
+	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, nl_finish_handler, &err);
+	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, nl_ack_handler, &err);
+	if (handler)
+		nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, handler, arg);
+
+	while (err > 0)
+		if (nl_recvmsgs(nl_cmd, cb) < 0 && err > 0)
+			err = -EIO;
+
+out:
+	if (cb)
+		nl_cb_put(cb);
+	nlmsg_free(msg);
+	return err;
+}
+
+struct mcast_group {
+	const char *name;
+	int id;
+};
+
+static int mcast_group_handler(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[CTRL_ATTR_MAX + 1];
+	struct nlattr *grp[CTRL_ATTR_MCAST_GRP_MAX + 1];
+	struct mcast_group *group = arg;
+	struct nlattr *cur;
+	int rem;
+
+	nla_parse(tb, CTRL_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (!tb[CTRL_ATTR_MCAST_GROUPS])
+		return NL_SKIP;
+
+	nla_for_each_nested(cur, tb[CTRL_ATTR_MCAST_GROUPS], rem) {
+		nla_parse(grp, CTRL_ATTR_MCAST_GRP_MAX, nla_data(cur),
+			  nla_len(cur), NULL);
+
+		if (!grp[CTRL_ATTR_MCAST_GRP_NAME] ||
+		    !grp[CTRL_ATTR_MCAST_GRP_ID])
+			continue;
+
+		if (strcmp(nla_data(grp[CTRL_ATTR_MCAST_GRP_NAME]), group->name))
+			continue;
+
+		group->id = nla_get_u32(grp[CTRL_ATTR_MCAST_GRP_ID]);
+		break;
+	}
+
+	return NL_SKIP;
+}
+
+static int nl80211_mcast_group(const char *name)
+{
+	struct mcast_group group = { .name = name, .id = -1 };
+	struct nl_msg *msg;
+	int ctrl_id;
+
+	ctrl_id = genl_ctrl_resolve(nl_cmd, "nlctrl");
+	if (ctrl_id < 0)
+		return ctrl_id;
+
+	msg = nlmsg_alloc();
+	if (!msg)
+		return -ENOMEM;
+
+	genlmsg_put(msg, NL_AUTO_PID, NL_AUTO_SEQ, ctrl_id, 0, 0,
+		    CTRL_CMD_GETFAMILY, 0);
+	nla_put_string(msg, CTRL_ATTR_FAMILY_NAME, "nl80211");
+
+	if (nl_request(msg, mcast_group_handler, &group))
+		return -1;
+
+	return group.id;
+}
+
+/*
+ * Arm a CQM RSSI threshold at the current signal level: the driver then
+ * reports once the signal moved by more than hyst dB in either direction,
+ * which is all the LEDs need to know. Returns -EOPNOTSUPP for drivers and
+ * interface modes without CQM support, e.g. AP interfaces.
+ */
+static int iface_set_cqm(struct iface *ifc, int thold, int hyst)
+{
+	struct nl_msg *msg;
+	struct nlattr *cqm;
+
+	msg = nlmsg_alloc();
+	if (!msg)
+		return -ENOMEM;
+
+	genlmsg_put(msg, NL_AUTO_PID, NL_AUTO_SEQ, nl80211_id, 0, 0,
+		    NL80211_CMD_SET_CQM, 0);
+	NLA_PUT_U32(msg, NL80211_ATTR_IFINDEX, ifc->ifindex);
+
+	cqm = nla_nest_start(msg, NL80211_ATTR_CQM);
+	if (!cqm)
+		goto nla_put_failure;
+	NLA_PUT_U32(msg, NL80211_ATTR_CQM_RSSI_THOLD, (uint32_t)thold);
+	NLA_PUT_U32(msg, NL80211_ATTR_CQM_RSSI_HYST, hyst);
+	nla_nest_end(msg, cqm);
+
+	return nl_request(msg, NULL, NULL);
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return -ENOBUFS;
+}
+
+static bool iface_arm_cqm(struct iface *ifc)
+{
+	int sig, hyst, err;
+
+	if (nl80211_id < 0 || ifc->cqm_unsupported || !ifc->ifindex)
+		return false;
+
+	if (ifc->iw->signal(ifc->ifname, &sig))
+		return false;
+
+	/* the LED threshold is in percent of the quality range, which
+	 * maps linearly onto dBm for the nl80211 backend */
+	hyst = ifc->threshold * ifc->qual_max / 100;
+	if (hyst < 1)
+		hyst = 1;
+
+	if (ifc->cqm_armed && sig >= ifc->cqm_thold - hyst &&
+	    sig <= ifc->cqm_thold + hyst)
+		return true;
+
+	err = iface_set_cqm(ifc, sig, hyst);
+	if (err == -EOPNOTSUPP) {
+		syslog(LOG_INFO, "%s: no CQM support, polling\n", ifc->ifname);
+		ifc->cqm_unsupported = true;
+	}
+
+	ifc->cqm_armed = !err;
+	ifc->cqm_thold = sig;
+
+	return ifc->cqm_armed;
+}
+
+static void iface_poll(struct uloop_timeout *t)
+{
+	struct iface *ifc = container_of(t, struct iface, timer);
+	int q;
+
+	if (!ifc->iw) {
+		if (open_backend(&ifc->iw, ifc->ifname)) {
+			uloop_timeout_set(t, BACKEND_RETRY_DELAY / 1000);
+			return;
+		}
+
+		ifc->ifindex = if_nametoindex(ifc->ifname);
+	}
+
+	q = quality(ifc);
+	if ( q < ifc->q0 - ifc->threshold || q > ifc->q0 + ifc->threshold ) {
+		update_leds(ifc->rules, q);
+		ifc->q0 = q;
+	}
+
+	if ( q == -1 && ifc->q0 == -1 ) {
+		/* interface gone or not associated, look up the backend
+		 * again, connect and interface events bring us back early */
+		ifc->iw = NULL;
+		ifc->qual_max = 0;
+		ifc->cqm_armed = false;
+		uloop_timeout_set(t, nl80211_id < 0 || ifc->cqm_unsupported ?
+				  BACKEND_RETRY_DELAY / 1000 :
+				  EVENT_WATCHDOG_DELAY);
+		return;
+	}
+
+	if (iface_arm_cqm(ifc))
+		uloop_timeout_set(t, EVENT_WATCHDOG_DELAY);
+	else
+		uloop_timeout_set(t, ifc->refresh / 1000 ? : 1);
+}
+
+static int nl_event_handler(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct iface *ifc;
+	const char *ifname = NULL;
+	int ifindex = 0;
+
+	switch (gnlh->cmd) {
+	case NL80211_CMD_NOTIFY_CQM:
+	case NL80211_CMD_CONNECT:
+	case NL80211_CMD_DISCONNECT:
+	case NL80211_CMD_NEW_INTERFACE:
+		break;
+	default:
+		return NL_SKIP;
+	}
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (tb[NL80211_ATTR_IFINDEX])
+		ifindex = nla_get_u32(tb[NL80211_ATTR_IFINDEX]);
+	if (tb[NL80211_ATTR_IFNAME])
+		ifname = nla_get_string(tb[NL80211_ATTR_IFNAME]);
+
+	list_for_each_entry(ifc, &ifaces, list) {
+		if (ifc->ifindex != ifindex &&
+		    (!ifname || strcmp(ifc->ifname, ifname)))
+			continue;
+
+		/* association changes may reset the CQM configuration */
+		if (gnlh->cmd != NL80211_CMD_NOTIFY_CQM)
+			ifc->cqm_armed = false;
+
+		uloop_timeout_set(&ifc->timer, 0);
+	}
+
+	return NL_SKIP;
+}
+
+static void nl_event_read(struct uloop_fd *fd, unsigned int events)
+{
+	nl_recvmsgs(nl_event, nl_event_cb);
+}
+
+static int nl_init(void)
+{
+	const char *groups[] = { "mlme", "config" };
+	int i, id;
+
+	nl_cmd = nl_socket_alloc();
+	nl_event = nl_socket_alloc();
+	nl_event_cb = nl_cb_alloc(NL_CB_DEFAULT);
+	if (!nl_cmd || !nl_event || !nl_event_cb)
+		return -1;
+
+	if (genl_connect(nl_cmd) || genl_connect(nl_event))
+		return -1;
+
+	nl80211_id = genl_ctrl_resolve(nl_cmd, "nl80211");
+	if (nl80211_id < 0)
+		return -1;
+
+	for (i = 0; i < ARRAY_SIZE(groups); i++) {
+		id = nl80211_mcast_group(groups[i]);
+		if (id < 0 || nl_socket_add_membership(nl_event, id))
+			goto err;
 	}
 
-	ifname = argv[1];
+	nl_cb_set(nl_event_cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM,
+		  nl_no_seq_check, NULL);
+	nl_cb_set(nl_event_cb, NL_CB_VALID, NL_CB_CUSTOM,
+		  nl_event_handler, NULL);
+
+	/* a wakeup without a complete message must not stall the event loop */
+	if (nl_socket_set_nonblocking(nl_event))
+		goto err;
+
+	nl_event_fd.fd = nl_socket_get_fd(nl_event);
+	nl_event_fd.cb = nl_event_read;
+	uloop_fd_add(&nl_event_fd, ULOOP_READ);
+
+	return 0;
+
+err:
+	nl80211_id = -1;
+	return -1;
+}
+
+static void nl_free(void)
+{
+	if (nl_event_fd.registered)
+		uloop_fd_delete(&nl_event_fd);
+	if (nl_event_cb)
+		nl_cb_put(nl_event_cb);
+	if (nl_event)
+		nl_socket_free(nl_event);
+	if (nl_cmd)
+		nl_socket_free(nl_cmd);
+}
+
+/* (ifname) (refresh) (threshold) (rule) [rule] ... */
+static int add_iface(char **argv, int argc)
+{
+	rule_t *currentrule = NULL;
+	struct iface *ifc;
+	int i;
+
+	if (argc < 8 || ( (argc-3) % 5 != 0 ) )
+		return 1;
+
+	ifc = calloc(sizeof(*ifc), 1);
+	if (!ifc)
+		return 1;
+
+	ifc->ifname = argv[0];
+	ifc->q0 = -1;
+	ifc->timer.cb = iface_poll;
 
 	/* refresh interval */
-	if ( sscanf(argv[2], "%d", &r) != 1 )
+	if ( sscanf(argv[1], "%d", &ifc->refresh) != 1 )
 		return 1;
 
 	/* sustain threshold */
-	if ( sscanf(argv[3], "%d", &s) != 1 )
+	if ( sscanf(argv[2], "%d", &ifc->threshold) != 1 )
 		return 1;
 
-	openlog("rssileds", LOG_PID, LOG_DAEMON);
-	syslog(LOG_INFO, "monitoring %s, refresh rate %d, threshold %d\n", ifname, r, s);
+	syslog(LOG_INFO, "monitoring %s, refresh rate %d, threshold %d\n",
+		ifc->ifname, ifc->refresh, ifc->threshold);
 
-	currentrule = headrule;
-	for (i=4; i<argc; i=i+5) {
+	for (i=3; i<argc; i=i+5) {
 		if (! currentrule)
 		{
 			/* first element in the list */
 			currentrule = calloc(sizeof(rule_t),1);
-			headrule = currentrule;
+			ifc->rules = currentrule;
 		}
 		else
 		{
@@ -249,42 +616,70 @@ int main(int argc, char **argv)
 
 		if ( init_led(&(currentrule->led), argv[i]) )
 			return 1;
-		
+
 		if ( sscanf(argv[i+1], "%d", &(currentrule->minq)) != 1 )
 			return 1;
 
 		if ( sscanf(argv[i+2], "%d", &(currentrule->maxq)) != 1 )
 			return 1;
-		
+
 		if ( sscanf(argv[i+3], "%d", &(currentrule->boffset)) != 1 )
 			return 1;
-		
+
 		if ( sscanf(argv[i+4], "%d", &(currentrule->bfactor)) != 1 )
 			return 1;
 	}
-	log_rules(headrule);
-
-	q0 = -1;
-	do {
-		q = quality(iw, ifname);
-		if ( q < q0 - s || q > q0 + s ) {
-			update_leds(headrule, q);
-			q0=q;
-		};
-		// re-open backend...
-		if ( q == -1 && q0 == -1 ) {
-			if (iw) {
-				iwinfo_finish();
-				iw=NULL;
-				usleep(BACKEND_RETRY_DELAY);
-			}
-			while (open_backend(&iw, ifname))
-				usleep(BACKEND_RETRY_DELAY);
-		}
-		usleep(r);
-	} while(1);
+	log_rules(ifc->rules);
+
+	list_add_tail(&ifc->list, &ifaces);
+	uloop_timeout_set(&ifc->timer, 0);
 
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	char *name = argv[0];
+	bool events = true;
+	int i, start;
+
+	if (argc > 1 && !strcmp(argv[1], "-p")) {
+		events = false;
+		argv++;
+		argc--;
+	}
+
+	if (argc < 9)
+		goto usage;
+
+	openlog("rssileds", LOG_PID, LOG_DAEMON);
+	uloop_init();
+
+	/* one process serves any number of interfaces, separated by -- */
+	for (i = start = 1; i <= argc; i++) {
+		if (i < argc && strcmp(argv[i], "--"))
+			continue;
+
+		if (add_iface(argv + start, i - start))
+			goto usage;
+
+		start = i + 1;
+	}
+
+	if (events && nl_init())
+		syslog(LOG_INFO, "nl80211 events unavailable, polling\n");
+
+	uloop_run();
+
+	nl_free();
+	uloop_done();
 	iwinfo_finish();
 
 	return 0;
+
+usage:
+	printf("syntax: %s [-p] (ifname) (refresh) (threshold) (rule) [rule] ... [-- (ifname) ...]\n", name);
+	printf("  rule: (sysfs-name) (minq) (maxq) (offset) (factore)\n");
+	printf("  -p: poll only, do not use nl80211 CQM events\n");
+	return 1;
 }
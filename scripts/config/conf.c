@@ -36,6 +36,7 @@ enum input_mode {
 	yes2modconfig,
 	mod2yesconfig,
 	fatalrecursive,
+	traceexpansions,
 };
 static enum input_mode input_mode = oldaskconfig;
 static int input_mode_opt;
@@ -698,6 +699,7 @@ static const struct option long_opts[] = {
 	{"yes2modconfig", no_argument,       &input_mode_opt, yes2modconfig},
 	{"mod2yesconfig", no_argument,       &input_mode_opt, mod2yesconfig},
 	{"fatalrecursive",no_argument,       NULL, fatalrecursive},
+	{"trace-expansions", no_argument,    NULL, traceexpansions},
 	{NULL, 0, NULL, 0}
 };
 
@@ -709,6 +711,7 @@ static void conf_usage(const char *progname)
 	printf("  -h, --help              Print this message and exit.\n");
 	printf("  -s, --silent            Do not print log.\n");
 	printf("      --fatalrecursive    Treat recursive depenendencies as a fatal error\n");
+	printf("      --trace-expansions  Report the time spent in each macro expansion\n");
 	printf("\n");
 	printf("Mode options:\n");
 	printf("  --listnewconfig         List new options\n");
@@ -752,6 +755,9 @@ int main(int ac, char **av)
 		case fatalrecursive:
 			recursive_is_error = 1;
 			continue;
+		case traceexpansions:
+			trace_expansions = 1;
+			continue;
 		case 'r':
 			input_file = optarg;
 			break;
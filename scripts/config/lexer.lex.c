@@ -4127,6 +4127,8 @@ void zconf_nextfile(const char *name)
 	int i;
 	char path[PATH_MAX], *p;
 
+	pcache_add_glob(name, current_file->name);
+
 	err = glob(name, GLOB_ERR | GLOB_MARK, NULL, &gl);
 
 	/* ignore wildcard patterns that return no result */
@@ -39,6 +39,7 @@ void zconf_nextfile(const char *name);
 int zconf_lineno(void);
 const char *zconf_curname(void);
 extern int recursive_is_error;
+extern int trace_expansions;
 
 /* confdata.c */
 const char *conf_get_configname(void);
@@ -79,6 +80,14 @@ void str_append(struct gstr *gs, const char *s);
 void str_printf(struct gstr *gs, const char *fmt, ...);
 const char *str_get(struct gstr *gs);
 
+/* parsecache.c */
+bool pcache_begin(const char *name);
+void pcache_end(const char *name);
+void pcache_add_env(const char *name, const char *value);
+void pcache_add_shell(const char *cmd, const char *output);
+void pcache_add_glob(const char *pattern, const char *parent);
+void pcache_taint(void);
+
 /* menu.c */
 void _menu_init(void);
 void menu_warn(struct menu *menu, const char *fmt, ...);
@@ -26,6 +26,7 @@ void sym_calc_value(struct symbol *sym);
 enum symbol_type sym_get_type(struct symbol *sym);
 bool sym_tristate_within_range(struct symbol *sym,tristate tri);
 bool sym_set_tristate_value(struct symbol *sym,tristate tri);
+struct menu **sym_get_affected_menus(void);
 tristate sym_toggle_tristate_value(struct symbol *sym);
 bool sym_string_valid(struct symbol *sym, const char *newval);
 bool sym_string_within_range(struct symbol *sym, const char *str);
@@ -42,7 +43,10 @@ enum variable_flavor {
 	VAR_RECURSIVE,
 	VAR_APPEND,
 };
+void env_add(const char *name, const char *value);
 void env_write_dep(FILE *f, const char *auto_conf_name);
+char *run_shell(const char *cmd);
+char *shell_output(const char *cmd);
 void variable_add(const char *name, const char *value,
 		  enum variable_flavor flavor);
 void variable_all_del(void);
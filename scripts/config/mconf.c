@@ -233,7 +233,7 @@ save_config_help[] =
 	"leave this blank.\n",
 search_help[] =
 	"\n"
-	"Search for symbols and display their relations.\n"
+	"Search for symbols by name or prompt and display their relations.\n"
 	"Regular expressions are allowed.\n"
 	"Example: search for \"^FOO\"\n"
 	"Result:\n"
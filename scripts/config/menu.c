@@ -803,6 +803,7 @@ static void get_symbol_str(struct gstr *r, struct symbol *sym,
 	struct property *prop;
 
 	if (sym && sym->name) {
+		sym_calc_value(sym);
 		str_printf(r, "Symbol: %s [=%s]\n", sym->name,
 			   sym_get_string_value(sym));
 		str_printf(r, "Type  : %s\n", sym_type_name(sym->type));
@@ -0,0 +1,1185 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Cache of the parsed Kconfig tree.
+ *
+ * Parsing the whole OpenWrt menu tree, including the generated
+ * tmp/.config-*.in files, dominates the runtime of every conf, mconf and
+ * qconf invocation.  When KCONFIG_CACHE names a file, the symbol, property,
+ * menu and expression graph is written there after a successful parse,
+ * together with everything the result depends on:
+ *  - the content hash of every file that was read,
+ *  - the files matched by every 'source' statement,
+ *  - the value of every referenced environment variable,
+ *  - the output of every $(shell,...) call.
+ * The next run checks those and restores the graph instead of parsing when
+ * nothing changed.  Diagnostics printed while parsing are stored along with
+ * the graph and replayed, so a cached run looks exactly like a full one.
+ */
+
+#include <glob.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lkc.h"
+#include "internal.h"
+
+#define PCACHE_ENV	"KCONFIG_CACHE"
+#define PCACHE_MAGIC	0x4b435043	/* "CPCK" */
+#define PCACHE_VERSION	1
+#define PCACHE_NONE	UINT32_MAX
+
+enum pcache_dep_type {
+	PCACHE_DEP_FILE,
+	PCACHE_DEP_GLOB,
+	PCACHE_DEP_ENV,
+	PCACHE_DEP_SHELL,
+	PCACHE_DEP_CWD,
+};
+
+struct pcache_dep {
+	struct list_head node;
+	enum pcache_dep_type type;
+	char *name;
+	char *value;
+};
+
+static LIST_HEAD(dep_list);
+static bool pcache_tainted;
+
+/* stderr is captured while parsing so that diagnostics can be replayed */
+static FILE *diag_file;
+static int diag_fd = -1;
+
+static const char *pcache_name(void)
+{
+	const char *name = getenv(PCACHE_ENV);
+
+	return name && *name ? name : NULL;
+}
+
+static uint64_t pcache_hash(const void *data, size_t len, uint64_t hash)
+{
+	const unsigned char *p = data;
+
+	/* 64 bit FNV-1a */
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+#define PCACHE_HASH_INIT	0xcbf29ce484222325ULL
+
+static char *pcache_file_hash(const char *name)
+{
+	char buf[65536], out[17];
+	uint64_t hash = PCACHE_HASH_INIT;
+	size_t n;
+	FILE *f;
+
+	f = zconf_fopen(name);
+	if (!f)
+		return NULL;
+
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		hash = pcache_hash(buf, n, hash);
+
+	if (ferror(f)) {
+		fclose(f);
+		return NULL;
+	}
+	fclose(f);
+
+	snprintf(out, sizeof(out), "%016llx", (unsigned long long)hash);
+	return xstrdup(out);
+}
+
+/* Same lookup as zconf_nextfile(), reduced to the list of matched paths */
+static char *pcache_glob(const char *pattern, const char *parent)
+{
+	char path[PATH_MAX], *p;
+	struct gstr gs;
+	glob_t gl;
+	size_t i;
+	int err;
+
+	err = glob(pattern, GLOB_ERR | GLOB_MARK, NULL, &gl);
+	if (err == GLOB_NOMATCH && !strchr(pattern, '*') && parent) {
+		globfree(&gl);
+		p = xstrdup(parent);
+		snprintf(path, sizeof(path), "%s/%s", dirname(p), pattern);
+		free(p);
+		err = glob(path, GLOB_ERR | GLOB_MARK, NULL, &gl);
+	}
+
+	gs = str_new();
+	if (err) {
+		str_printf(&gs, "error %d", err);
+	} else {
+		for (i = 0; i < gl.gl_pathc; i++) {
+			str_append(&gs, gl.gl_pathv[i]);
+			str_append(&gs, "\n");
+		}
+	}
+	globfree(&gl);
+
+	p = xstrdup(str_get(&gs));
+	str_free(&gs);
+
+	return p;
+}
+
+static char *pcache_cwd(void)
+{
+	char path[PATH_MAX];
+
+	return getcwd(path, sizeof(path)) ? xstrdup(path) : NULL;
+}
+
+static void pcache_add_dep(enum pcache_dep_type type, const char *name,
+			   const char *value)
+{
+	struct pcache_dep *dep;
+
+	if (!pcache_name())
+		return;
+
+	dep = xmalloc(sizeof(*dep));
+	dep->type = type;
+	dep->name = xstrdup(name);
+	dep->value = value ? xstrdup(value) : NULL;
+	list_add_tail(&dep->node, &dep_list);
+}
+
+void pcache_add_env(const char *name, const char *value)
+{
+	pcache_add_dep(PCACHE_DEP_ENV, name, value);
+}
+
+void pcache_add_shell(const char *cmd, const char *output)
+{
+	pcache_add_dep(PCACHE_DEP_SHELL, cmd, output);
+}
+
+void pcache_add_glob(const char *pattern, const char *parent)
+{
+	struct pcache_dep *dep;
+
+	if (!pcache_name())
+		return;
+
+	dep = xmalloc(sizeof(*dep));
+	dep->type = PCACHE_DEP_GLOB;
+	/* the parent is only needed for the relative lookup */
+	dep->name = xmalloc(strlen(pattern) + strlen(parent) + 2);
+	sprintf(dep->name, "%s%c%s", pattern, 0, parent);
+	dep->value = pcache_glob(pattern, parent);
+	list_add_tail(&dep->node, &dep_list);
+}
+
+/* The parse has side effects that cannot be replayed, e.g. $(info,...) */
+void pcache_taint(void)
+{
+	pcache_tainted = true;
+}
+
+/* Returns true if the dependency still has the recorded value */
+static bool pcache_dep_valid(enum pcache_dep_type type, const char *name,
+			     size_t name_len, const char *value)
+{
+	const char *parent;
+	char *cur;
+	bool ret;
+
+	switch (type) {
+	case PCACHE_DEP_FILE:
+		cur = pcache_file_hash(name);
+		break;
+	case PCACHE_DEP_GLOB:
+		parent = name + strlen(name) + 1;
+		if (parent >= name + name_len)
+			return false;
+		cur = pcache_glob(name, parent);
+		break;
+	case PCACHE_DEP_ENV:
+		cur = getenv(name);
+		if (!cur || !value)
+			return !cur && !value;
+		return !strcmp(cur, value);
+	case PCACHE_DEP_SHELL:
+		cur = shell_output(name);
+		break;
+	case PCACHE_DEP_CWD:
+		cur = pcache_cwd();
+		break;
+	default:
+		return false;
+	}
+
+	ret = cur && value && !strcmp(cur, value);
+	free(cur);
+
+	return ret;
+}
+
+/*
+ * Diagnostics capture.  An exit() in the middle of the parse still gets
+ * its messages out through the atexit() handler.
+ */
+static char *pcache_diag_end(size_t *len);
+
+static void pcache_diag_atexit(void)
+{
+	size_t len;
+
+	free(pcache_diag_end(&len));
+}
+
+static void pcache_diag_begin(void)
+{
+	static bool registered;
+
+	diag_file = tmpfile();
+	if (!diag_file)
+		return;
+
+	fflush(stderr);
+	diag_fd = dup(STDERR_FILENO);
+	if (diag_fd < 0 || dup2(fileno(diag_file), STDERR_FILENO) < 0) {
+		if (diag_fd >= 0)
+			close(diag_fd);
+		diag_fd = -1;
+		fclose(diag_file);
+		diag_file = NULL;
+		return;
+	}
+
+	if (!registered) {
+		atexit(pcache_diag_atexit);
+		registered = true;
+	}
+}
+
+/* Restores stderr, copies the captured text to it and returns the text */
+static char *pcache_diag_end(size_t *len)
+{
+	char *buf;
+	long size;
+
+	*len = 0;
+	if (diag_fd < 0)
+		return NULL;
+
+	fflush(stderr);
+	dup2(diag_fd, STDERR_FILENO);
+	close(diag_fd);
+	diag_fd = -1;
+
+	size = ftell(diag_file);
+	if (size <= 0) {
+		fclose(diag_file);
+		diag_file = NULL;
+		return NULL;
+	}
+
+	buf = xmalloc(size);
+	rewind(diag_file);
+	if (fread(buf, 1, size, diag_file) != (size_t)size) {
+		free(buf);
+		buf = NULL;
+	} else {
+		fwrite(buf, 1, size, stderr);
+		*len = size;
+	}
+	fclose(diag_file);
+	diag_file = NULL;
+
+	return buf;
+}
+
+/*
+ * Object tables.  Every object of the graph gets an index, references are
+ * stored as indexes.  Symbols come first in hash bucket order so that the
+ * buckets can be rebuilt exactly as they were.
+ */
+struct pcache_map {
+	const void **keys;
+	uint32_t *vals;
+	uint32_t size;
+	uint32_t count;
+	const void **objs;
+	uint32_t nobjs;
+	uint32_t objs_size;
+};
+
+static uint32_t pcache_ptr_hash(const void *p)
+{
+	uintptr_t v = (uintptr_t)p;
+
+	v ^= v >> 17;
+	v *= 0xed5ad4bbU;
+	v ^= v >> 11;
+
+	return (uint32_t)v;
+}
+
+static void pcache_map_grow(struct pcache_map *map)
+{
+	struct pcache_map old = *map;
+	uint32_t i, j;
+
+	map->size = old.size ? old.size * 2 : 1024;
+	map->keys = xcalloc(map->size, sizeof(*map->keys));
+	map->vals = xcalloc(map->size, sizeof(*map->vals));
+
+	for (i = 0; i < old.size; i++) {
+		if (!old.keys[i])
+			continue;
+		j = pcache_ptr_hash(old.keys[i]) & (map->size - 1);
+		while (map->keys[j])
+			j = (j + 1) & (map->size - 1);
+		map->keys[j] = old.keys[i];
+		map->vals[j] = old.vals[i];
+	}
+
+	free(old.keys);
+	free(old.vals);
+}
+
+/* Returns the index of the object, or PCACHE_NONE if it is not known */
+static uint32_t pcache_map_get(const struct pcache_map *map, const void *p)
+{
+	uint32_t i;
+
+	if (!p || !map->size)
+		return PCACHE_NONE;
+
+	i = pcache_ptr_hash(p) & (map->size - 1);
+	while (map->keys[i]) {
+		if (map->keys[i] == p)
+			return map->vals[i];
+		i = (i + 1) & (map->size - 1);
+	}
+
+	return PCACHE_NONE;
+}
+
+/* Adds the object if it is not known yet, returns true if it was added */
+static bool pcache_map_add(struct pcache_map *map, const void *p)
+{
+	uint32_t i;
+
+	if (!p || pcache_map_get(map, p) != PCACHE_NONE)
+		return false;
+
+	if ((map->count + 1) * 2 > map->size)
+		pcache_map_grow(map);
+
+	i = pcache_ptr_hash(p) & (map->size - 1);
+	while (map->keys[i])
+		i = (i + 1) & (map->size - 1);
+	map->keys[i] = p;
+	map->vals[i] = map->nobjs;
+	map->count++;
+
+	if (map->nobjs == map->objs_size) {
+		map->objs_size = map->objs_size ? map->objs_size * 2 : 1024;
+		map->objs = xrealloc(map->objs,
+				     map->objs_size * sizeof(*map->objs));
+	}
+	map->objs[map->nobjs++] = p;
+
+	return true;
+}
+
+static void pcache_map_free(struct pcache_map *map)
+{
+	free(map->keys);
+	free(map->vals);
+	free(map->objs);
+}
+
+struct pcache_writer {
+	FILE *out;
+	bool error;
+	struct pcache_map files, syms, props, menus, exprs;
+};
+
+static void w_data(struct pcache_writer *w, const void *data, size_t len)
+{
+	if (len && fwrite(data, len, 1, w->out) != 1)
+		w->error = true;
+}
+
+static void w_u32(struct pcache_writer *w, uint32_t v)
+{
+	w_data(w, &v, sizeof(v));
+}
+
+static void w_str(struct pcache_writer *w, const char *s)
+{
+	if (!s) {
+		w_u32(w, PCACHE_NONE);
+		return;
+	}
+	w_u32(w, strlen(s));
+	w_data(w, s, strlen(s));
+}
+
+static void w_blob(struct pcache_writer *w, const char *s, size_t len)
+{
+	w_u32(w, len);
+	w_data(w, s, len);
+}
+
+/* Writes a reference, an unknown non-NULL object makes the cache unusable */
+static void w_ref(struct pcache_writer *w, struct pcache_map *map,
+		  const void *p)
+{
+	uint32_t idx = pcache_map_get(map, p);
+
+	if (p && idx == PCACHE_NONE)
+		w->error = true;
+	w_u32(w, idx);
+}
+
+static void w_sym(struct pcache_writer *w, const struct symbol *sym)
+{
+	/* the constant y/m/n symbols are static, encode them specially */
+	if (sym == &symbol_yes)
+		w_u32(w, PCACHE_NONE - 1);
+	else if (sym == &symbol_mod)
+		w_u32(w, PCACHE_NONE - 2);
+	else if (sym == &symbol_no)
+		w_u32(w, PCACHE_NONE - 3);
+	else
+		w_ref(w, &w->syms, sym);
+}
+
+static void pcache_collect_expr(struct pcache_writer *w, struct expr *e)
+{
+	while (e && pcache_map_add(&w->exprs, e)) {
+		switch (e->type) {
+		case E_OR:
+		case E_AND:
+			pcache_collect_expr(w, e->right.expr);
+			/* fall through */
+		case E_NOT:
+		case E_LIST:
+			e = e->left.expr;
+			break;
+		default:
+			return;
+		}
+	}
+}
+
+static void pcache_collect_menu(struct pcache_writer *w, struct menu *menu)
+{
+	for (; menu; menu = menu->next) {
+		pcache_map_add(&w->menus, menu);
+		if (menu->prompt && pcache_map_add(&w->props, menu->prompt)) {
+			pcache_collect_expr(w, menu->prompt->visible.expr);
+			pcache_collect_expr(w, menu->prompt->expr);
+		}
+		pcache_collect_expr(w, menu->visibility);
+		pcache_collect_expr(w, menu->dep);
+		pcache_collect_menu(w, menu->list);
+	}
+}
+
+static void pcache_collect(struct pcache_writer *w)
+{
+	struct property *prop;
+	struct symbol *sym;
+	struct file *file;
+	int i;
+
+	for (file = file_list; file; file = file->next)
+		pcache_map_add(&w->files, file);
+
+	for (i = 0; i < SYMBOL_HASHSIZE; i++) {
+		for (sym = symbol_hash[i]; sym; sym = sym->next) {
+			pcache_map_add(&w->syms, sym);
+			pcache_collect_expr(w, sym->dir_dep.expr);
+			pcache_collect_expr(w, sym->rev_dep.expr);
+			pcache_collect_expr(w, sym->implied.expr);
+			for (prop = sym->prop; prop; prop = prop->next) {
+				pcache_map_add(&w->props, prop);
+				pcache_collect_expr(w, prop->visible.expr);
+				pcache_collect_expr(w, prop->expr);
+			}
+		}
+	}
+
+	pcache_map_add(&w->menus, &rootmenu);
+	pcache_collect_menu(w, &rootmenu);
+}
+
+static void w_expr(struct pcache_writer *w, const struct expr *e)
+{
+	w_u32(w, e->type);
+
+	switch (e->type) {
+	case E_OR:
+	case E_AND:
+		w_ref(w, &w->exprs, e->left.expr);
+		w_ref(w, &w->exprs, e->right.expr);
+		break;
+	case E_NOT:
+		w_ref(w, &w->exprs, e->left.expr);
+		w_u32(w, PCACHE_NONE);
+		break;
+	case E_LIST:
+		w_ref(w, &w->exprs, e->left.expr);
+		w_sym(w, e->right.sym);
+		break;
+	case E_SYMBOL:
+		w_sym(w, e->left.sym);
+		w_u32(w, PCACHE_NONE);
+		break;
+	case E_EQUAL:
+	case E_UNEQUAL:
+	case E_LTH:
+	case E_LEQ:
+	case E_GTH:
+	case E_GEQ:
+	case E_RANGE:
+		w_sym(w, e->left.sym);
+		w_sym(w, e->right.sym);
+		break;
+	default:
+		w_u32(w, PCACHE_NONE);
+		w_u32(w, PCACHE_NONE);
+		break;
+	}
+}
+
+static void w_graph(struct pcache_writer *w)
+{
+	const struct property *prop;
+	const struct symbol *sym;
+	const struct menu *menu;
+	const struct file *file;
+	uint32_t i;
+	int b;
+
+	w_u32(w, w->files.nobjs);
+	for (i = 0; i < w->files.nobjs; i++) {
+		file = w->files.objs[i];
+		w_str(w, file->name);
+		w_ref(w, &w->files, file->parent);
+		w_u32(w, file->lineno);
+	}
+
+	w_u32(w, w->syms.nobjs);
+	i = 0;
+	for (b = 0; b < SYMBOL_HASHSIZE; b++) {
+		for (sym = symbol_hash[b]; sym; sym = sym->next, i++) {
+			w_u32(w, b);
+			w_str(w, sym->name);
+			w_u32(w, sym->type);
+			w_u32(w, sym->visible);
+			w_u32(w, sym->flags);
+			w_ref(w, &w->props, sym->prop);
+			w_ref(w, &w->exprs, sym->dir_dep.expr);
+			w_u32(w, sym->dir_dep.tri);
+			w_ref(w, &w->exprs, sym->rev_dep.expr);
+			w_u32(w, sym->rev_dep.tri);
+			w_ref(w, &w->exprs, sym->implied.expr);
+			w_u32(w, sym->implied.tri);
+		}
+	}
+	if (i != w->syms.nobjs)
+		w->error = true;
+
+	w_u32(w, w->props.nobjs);
+	for (i = 0; i < w->props.nobjs; i++) {
+		prop = w->props.objs[i];
+		w_ref(w, &w->props, prop->next);
+		w_u32(w, prop->type);
+		w_str(w, prop->text);
+		w_ref(w, &w->exprs, prop->visible.expr);
+		w_u32(w, prop->visible.tri);
+		w_ref(w, &w->exprs, prop->expr);
+		w_ref(w, &w->menus, prop->menu);
+		w_ref(w, &w->files, prop->file);
+		w_u32(w, prop->lineno);
+	}
+
+	w_u32(w, w->menus.nobjs);
+	for (i = 0; i < w->menus.nobjs; i++) {
+		menu = w->menus.objs[i];
+		w_ref(w, &w->menus, menu->next);
+		w_ref(w, &w->menus, menu->parent);
+		w_ref(w, &w->menus, menu->list);
+		w_sym(w, menu->sym);
+		w_ref(w, &w->props, menu->prompt);
+		w_ref(w, &w->exprs, menu->visibility);
+		w_ref(w, &w->exprs, menu->dep);
+		w_u32(w, menu->flags);
+		w_str(w, menu->help);
+		w_ref(w, &w->files, menu->file);
+		w_u32(w, menu->lineno);
+	}
+
+	w_u32(w, w->exprs.nobjs);
+	for (i = 0; i < w->exprs.nobjs; i++)
+		w_expr(w, w->exprs.objs[i]);
+
+	w_sym(w, modules_sym);
+	w_ref(w, &w->files, current_file);
+}
+
+static void w_header(struct pcache_writer *w)
+{
+	w_u32(w, PCACHE_MAGIC);
+	w_u32(w, PCACHE_VERSION);
+	w_u32(w, sizeof(void *));
+	w_u32(w, sizeof(struct symbol));
+	w_u32(w, sizeof(struct property));
+	w_u32(w, sizeof(struct menu));
+	w_u32(w, sizeof(struct expr));
+	w_u32(w, SYMBOL_HASHSIZE);
+}
+
+static void pcache_save(const char *name, const char *diag, size_t diag_len)
+{
+	struct pcache_writer w = { 0 };
+	struct pcache_dep *dep;
+	const char *cache = pcache_name();
+	char *tmp;
+	struct file *file;
+	uint32_t ndeps = 0;
+
+	if (!cache || pcache_tainted)
+		return;
+
+	/* every file read and where the parse was run from */
+	for (file = file_list; file; file = file->next)
+		pcache_add_dep(PCACHE_DEP_FILE, file->name, NULL);
+	pcache_add_env(SRCTREE, getenv(SRCTREE));
+	pcache_add_dep(PCACHE_DEP_CWD, "", NULL);
+
+	list_for_each_entry(dep, &dep_list, node) {
+		if (dep->type == PCACHE_DEP_FILE) {
+			dep->value = pcache_file_hash(dep->name);
+			if (!dep->value)
+				return;
+		} else if (dep->type == PCACHE_DEP_CWD) {
+			dep->value = pcache_cwd();
+			if (!dep->value)
+				return;
+		}
+		ndeps++;
+	}
+
+	tmp = xmalloc(strlen(cache) + 16);
+	sprintf(tmp, "%s.%d", cache, (int)getpid());
+	w.out = fopen(tmp, "w");
+	if (!w.out) {
+		free(tmp);
+		return;
+	}
+
+	w_header(&w);
+	w_str(&w, name);
+
+	w_u32(&w, ndeps);
+	list_for_each_entry(dep, &dep_list, node) {
+		w_u32(&w, dep->type);
+		if (dep->type == PCACHE_DEP_GLOB)
+			w_blob(&w, dep->name, strlen(dep->name) + 1 +
+			       strlen(dep->name + strlen(dep->name) + 1));
+		else
+			w_str(&w, dep->name);
+		w_str(&w, dep->value);
+	}
+
+	w_blob(&w, diag ? diag : "", diag_len);
+
+	pcache_collect(&w);
+	w_graph(&w);
+
+	if (fclose(w.out))
+		w.error = true;
+
+	if (w.error || rename(tmp, cache))
+		unlink(tmp);
+
+	pcache_map_free(&w.files);
+	pcache_map_free(&w.syms);
+	pcache_map_free(&w.props);
+	pcache_map_free(&w.menus);
+	pcache_map_free(&w.exprs);
+	free(tmp);
+}
+
+struct pcache_reader {
+	const char *buf;
+	size_t len;
+	size_t pos;
+	bool error;
+};
+
+static uint32_t r_u32(struct pcache_reader *r)
+{
+	uint32_t v;
+
+	if (r->error || r->len - r->pos < sizeof(v)) {
+		r->error = true;
+		return 0;
+	}
+	memcpy(&v, r->buf + r->pos, sizeof(v));
+	r->pos += sizeof(v);
+
+	return v;
+}
+
+/* Returns a pointer into the buffer and the length of a string or blob */
+static const char *r_data(struct pcache_reader *r, uint32_t *len)
+{
+	const char *p;
+
+	*len = r_u32(r);
+	if (r->error || *len == PCACHE_NONE)
+		return NULL;
+
+	if (r->len - r->pos < *len) {
+		r->error = true;
+		return NULL;
+	}
+	p = r->buf + r->pos;
+	r->pos += *len;
+
+	return p;
+}
+
+static char *r_str(struct pcache_reader *r)
+{
+	const char *p;
+	uint32_t len;
+
+	p = r_data(r, &len);
+	return p ? xstrndup(p, len) : NULL;
+}
+
+static void *r_ref(struct pcache_reader *r, void **objs, uint32_t n)
+{
+	uint32_t idx = r_u32(r);
+
+	if (idx == PCACHE_NONE)
+		return NULL;
+	if (idx >= n) {
+		r->error = true;
+		return NULL;
+	}
+
+	return objs[idx];
+}
+
+static struct symbol *r_sym(struct pcache_reader *r, void **syms, uint32_t n)
+{
+	uint32_t idx = r_u32(r);
+
+	switch (idx) {
+	case PCACHE_NONE:
+		return NULL;
+	case PCACHE_NONE - 1:
+		return &symbol_yes;
+	case PCACHE_NONE - 2:
+		return &symbol_mod;
+	case PCACHE_NONE - 3:
+		return &symbol_no;
+	}
+	if (idx >= n) {
+		r->error = true;
+		return NULL;
+	}
+
+	return syms[idx];
+}
+
+static void **pcache_alloc_objs(struct pcache_reader *r, uint32_t *n,
+				size_t size)
+{
+	void **objs;
+	uint32_t i;
+
+	*n = r_u32(r);
+	/* every object takes at least a few bytes in the file */
+	if (r->error || *n > r->len / sizeof(uint32_t)) {
+		r->error = true;
+		*n = 0;
+		return NULL;
+	}
+
+	objs = xcalloc(*n ? *n : 1, sizeof(*objs));
+	for (i = 0; i < *n; i++)
+		objs[i] = xcalloc(1, size);
+
+	return objs;
+}
+
+static bool pcache_read_graph(struct pcache_reader *r)
+{
+	struct symbol *hash[SYMBOL_HASHSIZE] = { 0 };
+	struct symbol **tail[SYMBOL_HASHSIZE];
+	void **files, **syms, **props, **menus, **exprs;
+	uint32_t nfiles, nsyms, nprops, nmenus, nexprs;
+	struct symbol *sym, *mod_sym;
+	struct property *prop;
+	struct menu *menu;
+	struct file *file, *cur_file;
+	struct expr *e;
+	size_t pos;
+	uint32_t i, b;
+	int j;
+
+	/*
+	 * Objects are referenced before they are read, so allocate all of
+	 * them first.  The counts are spread over the stream: read each
+	 * table once to find the next count, then rewind and fill in.
+	 */
+	for (j = 0; j < SYMBOL_HASHSIZE; j++)
+		tail[j] = &hash[j];
+
+	pos = r->pos;
+	files = pcache_alloc_objs(r, &nfiles, sizeof(struct file));
+	for (i = 0; i < nfiles && !r->error; i++) {
+		free(r_str(r));
+		r_u32(r);
+		r_u32(r);
+	}
+	syms = pcache_alloc_objs(r, &nsyms, sizeof(struct symbol));
+	for (i = 0; i < nsyms && !r->error; i++) {
+		r_u32(r);
+		free(r_str(r));
+		for (j = 0; j < 10; j++)
+			r_u32(r);
+	}
+	props = pcache_alloc_objs(r, &nprops, sizeof(struct property));
+	for (i = 0; i < nprops && !r->error; i++) {
+		r_u32(r);
+		r_u32(r);
+		free(r_str(r));
+		for (j = 0; j < 6; j++)
+			r_u32(r);
+	}
+	menus = pcache_alloc_objs(r, &nmenus, sizeof(struct menu));
+	for (i = 0; i < nmenus && !r->error; i++) {
+		for (j = 0; j < 8; j++)
+			r_u32(r);
+		free(r_str(r));
+		r_u32(r);
+		r_u32(r);
+	}
+	exprs = pcache_alloc_objs(r, &nexprs, sizeof(struct expr));
+	if (r->error || !nmenus)
+		return false;
+
+	r->pos = pos;
+
+	r_u32(r);
+	for (i = 0; i < nfiles; i++) {
+		file = files[i];
+		file->name = r_str(r);
+		file->parent = r_ref(r, files, nfiles);
+		file->lineno = r_u32(r);
+		file->next = i + 1 < nfiles ? files[i + 1] : NULL;
+	}
+
+	r_u32(r);
+	for (i = 0; i < nsyms; i++) {
+		sym = syms[i];
+		b = r_u32(r);
+		if (b >= SYMBOL_HASHSIZE) {
+			r->error = true;
+			break;
+		}
+		*tail[b] = sym;
+		tail[b] = &sym->next;
+
+		sym->name = r_str(r);
+		sym->type = r_u32(r);
+		sym->visible = r_u32(r);
+		/* values are calculated again on first use */
+		sym->flags = r_u32(r) & ~SYMBOL_VALID;
+		sym->prop = r_ref(r, props, nprops);
+		sym->dir_dep.expr = r_ref(r, exprs, nexprs);
+		sym->dir_dep.tri = r_u32(r);
+		sym->rev_dep.expr = r_ref(r, exprs, nexprs);
+		sym->rev_dep.tri = r_u32(r);
+		sym->implied.expr = r_ref(r, exprs, nexprs);
+		sym->implied.tri = r_u32(r);
+	}
+
+	r_u32(r);
+	for (i = 0; i < nprops; i++) {
+		prop = props[i];
+		prop->next = r_ref(r, props, nprops);
+		prop->type = r_u32(r);
+		prop->text = r_str(r);
+		prop->visible.expr = r_ref(r, exprs, nexprs);
+		prop->visible.tri = r_u32(r);
+		prop->expr = r_ref(r, exprs, nexprs);
+		prop->menu = r_ref(r, menus, nmenus);
+		prop->file = r_ref(r, files, nfiles);
+		prop->lineno = r_u32(r);
+	}
+
+	r_u32(r);
+	for (i = 0; i < nmenus; i++) {
+		menu = menus[i];
+		menu->next = r_ref(r, menus, nmenus);
+		menu->parent = r_ref(r, menus, nmenus);
+		menu->list = r_ref(r, menus, nmenus);
+		menu->sym = r_sym(r, syms, nsyms);
+		menu->prompt = r_ref(r, props, nprops);
+		menu->visibility = r_ref(r, exprs, nexprs);
+		menu->dep = r_ref(r, exprs, nexprs);
+		menu->flags = r_u32(r);
+		menu->help = r_str(r);
+		menu->file = r_ref(r, files, nfiles);
+		menu->lineno = r_u32(r);
+		menu->data = NULL;
+	}
+
+	r_u32(r);
+	for (i = 0; i < nexprs; i++) {
+		e = exprs[i];
+		e->type = r_u32(r);
+		switch (e->type) {
+		case E_OR:
+		case E_AND:
+			e->left.expr = r_ref(r, exprs, nexprs);
+			e->right.expr = r_ref(r, exprs, nexprs);
+			break;
+		case E_NOT:
+			e->left.expr = r_ref(r, exprs, nexprs);
+			r_u32(r);
+			break;
+		case E_LIST:
+			e->left.expr = r_ref(r, exprs, nexprs);
+			e->right.sym = r_sym(r, syms, nsyms);
+			break;
+		case E_SYMBOL:
+			e->left.sym = r_sym(r, syms, nsyms);
+			r_u32(r);
+			break;
+		default:
+			e->left.sym = r_sym(r, syms, nsyms);
+			e->right.sym = r_sym(r, syms, nsyms);
+			break;
+		}
+	}
+
+	mod_sym = r_sym(r, syms, nsyms);
+	cur_file = r_ref(r, files, nfiles);
+
+	if (r->error || r->pos != r->len)
+		return false;
+
+	/* all good, make it the live tree; the first menu is the root menu */
+	for (i = 0; i < nmenus; i++) {
+		menu = menus[i];
+		if (menu->next == menus[0])
+			menu->next = &rootmenu;
+		if (menu->parent == menus[0])
+			menu->parent = &rootmenu;
+		if (menu->list == menus[0])
+			menu->list = &rootmenu;
+	}
+	for (i = 0; i < nprops; i++) {
+		prop = props[i];
+		if (prop->menu == menus[0])
+			prop->menu = &rootmenu;
+	}
+	rootmenu = *(struct menu *)menus[0];
+	free(menus[0]);
+
+	for (j = 0; j < SYMBOL_HASHSIZE; j++)
+		*tail[j] = NULL;
+	memcpy(symbol_hash, hash, sizeof(hash));
+	file_list = nfiles ? files[0] : NULL;
+	current_file = cur_file;
+	modules_sym = mod_sym;
+	current_entry = current_menu = &rootmenu;
+
+	free(files);
+	free(syms);
+	free(props);
+	free(menus);
+	free(exprs);
+
+	return true;
+}
+
+/*
+ * Checks every recorded dependency, or with 'restore' set, replays the
+ * environment references into the preprocessor once the cache was taken.
+ */
+static bool pcache_read_deps(struct pcache_reader *r, bool restore)
+{
+	const char *name, *value;
+	uint32_t i, n, type, len, vlen;
+	char *str, *val;
+	bool ok;
+
+	n = r_u32(r);
+	for (i = 0; i < n && !r->error; i++) {
+		type = r_u32(r);
+		name = r_data(r, &len);
+		value = r_data(r, &vlen);
+		if (r->error || !name)
+			return false;
+
+		/* names and values are not terminated in the file */
+		str = xstrndup(name, len);
+		val = value ? xstrndup(value, vlen) : NULL;
+		if (restore) {
+			ok = true;
+			if (type == PCACHE_DEP_ENV && val && strcmp(str, SRCTREE))
+				env_add(str, val);
+		} else {
+			/* glob names carry the parent after an embedded NUL */
+			if (type == PCACHE_DEP_GLOB) {
+				free(str);
+				str = xmalloc(len + 1);
+				memcpy(str, name, len);
+				str[len] = 0;
+			}
+			ok = pcache_dep_valid(type, str, len, val);
+		}
+		free(str);
+		free(val);
+		if (!ok)
+			return false;
+	}
+
+	return !r->error;
+}
+
+static bool pcache_load(const char *name)
+{
+	struct pcache_reader r = { 0 };
+	const char *cache = pcache_name();
+	const char *p;
+	char *buf, *str;
+	uint32_t len;
+	size_t deps;
+	long size;
+	FILE *f;
+	bool ok = false;
+
+	if (!cache)
+		return false;
+
+	f = fopen(cache, "r");
+	if (!f)
+		return false;
+
+	if (fseek(f, 0, SEEK_END) || (size = ftell(f)) <= 0) {
+		fclose(f);
+		return false;
+	}
+	rewind(f);
+	buf = xmalloc(size);
+	if (fread(buf, 1, size, f) != (size_t)size) {
+		fclose(f);
+		free(buf);
+		return false;
+	}
+	fclose(f);
+
+	r.buf = buf;
+	r.len = size;
+
+	if (r_u32(&r) != PCACHE_MAGIC ||
+	    r_u32(&r) != PCACHE_VERSION ||
+	    r_u32(&r) != sizeof(void *) ||
+	    r_u32(&r) != sizeof(struct symbol) ||
+	    r_u32(&r) != sizeof(struct property) ||
+	    r_u32(&r) != sizeof(struct menu) ||
+	    r_u32(&r) != sizeof(struct expr) ||
+	    r_u32(&r) != SYMBOL_HASHSIZE)
+		goto out;
+
+	str = r_str(&r);
+	if (!str || strcmp(str, name)) {
+		free(str);
+		goto out;
+	}
+	free(str);
+
+	deps = r.pos;
+	if (!pcache_read_deps(&r, false))
+		goto out;
+
+	p = r_data(&r, &len);
+	if (r.error)
+		goto out;
+
+	ok = pcache_read_graph(&r);
+	if (!ok)
+		goto out;
+
+	if (p && len)
+		fwrite(p, 1, len, stderr);
+
+	/* the referenced environment is needed for auto.conf.cmd */
+	r.pos = deps;
+	pcache_read_deps(&r, true);
+out:
+	free(buf);
+
+	return ok;
+}
+
+/*
+ * Called by conf_parse(): returns true if the tree was restored from the
+ * cache, otherwise starts recording what the parse depends on.
+ */
+bool pcache_begin(const char *name)
+{
+	if (!pcache_name())
+		return false;
+
+	/* a traced run has to do the expansions, and prints the report */
+	if (trace_expansions)
+		pcache_taint();
+	else if (pcache_load(name))
+		return true;
+
+	pcache_diag_begin();
+
+	return false;
+}
+
+/* Called by conf_parse() once the tree is complete */
+void pcache_end(const char *name)
+{
+	struct pcache_dep *dep, *tmp;
+	size_t len;
+	char *diag;
+
+	if (!pcache_name())
+		return;
+
+	diag = pcache_diag_end(&len);
+	pcache_save(name, diag, len);
+	free(diag);
+
+	list_for_each_entry_safe(dep, tmp, &dep_list, node) {
+		list_del(&dep->node);
+		free(dep->name);
+		free(dep->value);
+		free(dep);
+	}
+}
@@ -1951,6 +1951,11 @@ void conf_parse(const char *name)
 	struct symbol *sym;
 	int i;
 
+	if (pcache_begin(name)) {
+		conf_set_changed(true);
+		return;
+	}
+
 	zconf_initscan(name);
 
 	_menu_init();
@@ -1981,6 +1986,7 @@ void conf_parse(const char *name)
 	}
 	if (yynerrs)
 		exit(1);
+	pcache_end(name);
 	conf_set_changed(true);
 }
 
@@ -8,6 +8,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "list.h"
 #include "lkc.h"
@@ -30,6 +33,107 @@ static void __attribute__((noreturn)) pperror(const char *format, ...)
 	exit(1);
 }
 
+/*
+ * Expansion statistics for --trace-expansions
+ */
+int trace_expansions;
+
+struct trace {
+	char *name;
+	unsigned long calls;
+	unsigned long hits;
+	double time;
+	struct list_head node;
+};
+
+static LIST_HEAD(trace_list);
+
+static double trace_now(void)
+{
+	struct timespec ts;
+
+	if (!trace_expansions)
+		return 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void trace_add(const char *kind, const char *name, double start,
+		      bool hit)
+{
+	struct trace *t;
+	char *key;
+
+	if (!trace_expansions)
+		return;
+
+	key = xmalloc(strlen(kind) + strlen(name) + 2);
+	sprintf(key, "%s %s", kind, name);
+
+	list_for_each_entry(t, &trace_list, node) {
+		if (!strcmp(t->name, key))
+			break;
+	}
+	if (&t->node == &trace_list) {
+		t = xcalloc(1, sizeof(*t));
+		t->name = key;
+		list_add_tail(&t->node, &trace_list);
+	} else {
+		free(key);
+	}
+
+	t->calls++;
+	if (hit)
+		t->hits++;
+	t->time += trace_now() - start;
+}
+
+static int trace_cmp(const void *a, const void *b)
+{
+	const struct trace *t1 = *(const struct trace **)a;
+	const struct trace *t2 = *(const struct trace **)b;
+
+	return t1->time < t2->time ? 1 : t1->time > t2->time ? -1 : 0;
+}
+
+static void trace_report(void)
+{
+	struct trace *t, *tmp, **arr;
+	int i, n = 0;
+
+	list_for_each_entry(t, &trace_list, node)
+		n++;
+	if (!n)
+		return;
+
+	arr = xmalloc(n * sizeof(*arr));
+	i = 0;
+	list_for_each_entry(t, &trace_list, node)
+		arr[i++] = t;
+	qsort(arr, n, sizeof(*arr), trace_cmp);
+
+	fprintf(stderr, "%10s %8s %8s  %s\n", "msec", "calls", "cached",
+		"expansion");
+	for (i = 0; i < n; i++)
+		fprintf(stderr, "%10.3f %8lu %8lu  %s\n", arr[i]->time * 1000,
+			arr[i]->calls, arr[i]->hits, arr[i]->name);
+	free(arr);
+
+	list_for_each_entry_safe(t, tmp, &trace_list, node) {
+		list_del(&t->node);
+		free(t->name);
+		free(t);
+	}
+}
+
+/*
+ * Expansions that depend on where they happen or print something can not
+ * be cached, this counts them.
+ */
+static unsigned long impure_calls;
+
 /*
  * Environment variables
  */
@@ -41,7 +145,7 @@ struct env {
 	struct list_head node;
 };
 
-static void env_add(const char *name, const char *value)
+void env_add(const char *name, const char *value)
 {
 	struct env *e;
 
@@ -75,6 +179,7 @@ static char *env_expand(const char *name)
 	}
 
 	value = getenv(name);
+	pcache_add_env(name, value);
 	if (!value)
 		return NULL;
 
@@ -111,6 +216,7 @@ struct function {
 
 static char *do_error_if(int argc, char *argv[])
 {
+	impure_calls++;
 	if (!strcmp(argv[0], "y"))
 		pperror("%s", argv[1]);
 
@@ -119,12 +225,16 @@ static char *do_error_if(int argc, char *argv[])
 
 static char *do_filename(int argc, char *argv[])
 {
+	impure_calls++;
 	return xstrdup(current_file->name);
 }
 
 static char *do_info(int argc, char *argv[])
 {
+	impure_calls++;
 	printf("%s\n", argv[0]);
+	/* stdout output cannot be replayed from the parse cache */
+	pcache_taint();
 
 	return xstrdup("");
 }
@@ -133,21 +243,20 @@ static char *do_lineno(int argc, char *argv[])
 {
 	char buf[16];
 
+	impure_calls++;
 	sprintf(buf, "%d", yylineno);
 
 	return xstrdup(buf);
 }
 
-static char *do_shell(int argc, char *argv[])
+/* The returned pointer must be freed when done */
+char *run_shell(const char *cmd)
 {
 	FILE *p;
 	char buf[256];
-	char *cmd;
 	size_t nread;
 	int i;
 
-	cmd = argv[0];
-
 	p = popen(cmd, "r");
 	if (!p) {
 		perror(cmd);
@@ -178,8 +287,261 @@ static char *do_shell(int argc, char *argv[])
 	return xstrdup(buf);
 }
 
+/*
+ * $(shell,...) results.  Within a run every command is only executed once.
+ * When KCONFIG_SHELL_CACHE names a file, the results are kept there across
+ * runs, keyed by the environment and by the state of every path the command
+ * names, so that probes like [ -f foo ] are run again once foo changes.
+ */
+struct shell_result {
+	char *cmd;
+	char *output;
+	/* stat of the paths named by cmd when it ran, see shell_probe() */
+	char *probe;
+	struct list_head node;
+};
+
+static LIST_HEAD(shell_list);
+static bool shell_cache_loaded;
+static bool shell_cache_dirty;
+
+/* variables that differ between runs without affecting any command */
+static const char * const shell_env_ignore[] = {
+	"MAKEFLAGS", "MAKELEVEL", "MAKE_JOBSERVER", "MFLAGS", "OLDPWD",
+	"SCAN_COOKIE", "_",
+};
+
+static unsigned long long shell_env_hash(void)
+{
+	extern char **environ;
+	unsigned long long hash, sum = 0;
+	const char *p;
+	char **env;
+	size_t len;
+	int i;
+
+	for (env = environ; *env; env++) {
+		len = strcspn(*env, "=");
+		for (i = 0; i < ARRAY_SIZE(shell_env_ignore); i++) {
+			if (strlen(shell_env_ignore[i]) == len &&
+			    !strncmp(*env, shell_env_ignore[i], len))
+				break;
+		}
+		if (i < ARRAY_SIZE(shell_env_ignore))
+			continue;
+
+		/* FNV-1a of each entry, summed so that the order is irrelevant */
+		hash = 0xcbf29ce484222325ULL;
+		for (p = *env; *p; p++) {
+			hash ^= (unsigned char)*p;
+			hash *= 0x100000001b3ULL;
+		}
+		sum += hash;
+	}
+
+	return sum;
+}
+
+/*
+ * Records size and mtime, or absence, of every word of the command taken as
+ * a path, so a file showing up, going away or changing is noticed.  Paths a
+ * command only finds indirectly, e.g. through a glob or a variable, are not
+ * covered.
+ */
+static char *shell_probe(const char *cmd)
+{
+	static const char delims[] = " \t\n;&|()<>'\"`=";
+	struct gstr gs = str_new();
+	struct stat st;
+	char *buf, *word;
+	char *ret;
+
+	buf = xstrdup(cmd);
+	for (word = strtok(buf, delims); word; word = strtok(NULL, delims)) {
+		if (stat(word, &st))
+			str_printf(&gs, "%s:-,", word);
+		else
+			str_printf(&gs, "%s:%llx:%llx,", word,
+				   (unsigned long long)st.st_size,
+				   (unsigned long long)st.st_mtime);
+	}
+	free(buf);
+
+	ret = xstrdup(str_get(&gs));
+	str_free(&gs);
+
+	return ret;
+}
+
+static void shell_result_add(const char *cmd, const char *output,
+			     const char *probe)
+{
+	struct shell_result *r;
+
+	r = xmalloc(sizeof(*r));
+	r->cmd = xstrdup(cmd);
+	r->output = xstrdup(output);
+	r->probe = xstrdup(probe);
+	list_add_tail(&r->node, &shell_list);
+}
+
+/* Undoes shell_cache_escape() in place */
+static void shell_cache_unescape(char *s)
+{
+	char *d = s;
+
+	for (; *s; s++) {
+		if (*s == '\\' && s[1]) {
+			s++;
+			*d++ = *s == 't' ? '\t' : *s == 'n' ? '\n' : *s;
+		} else {
+			*d++ = *s;
+		}
+	}
+	*d = 0;
+}
+
+static void shell_cache_escape(FILE *f, const char *s)
+{
+	for (; *s; s++) {
+		if (*s == '\\')
+			fputs("\\\\", f);
+		else if (*s == '\t')
+			fputs("\\t", f);
+		else if (*s == '\n')
+			fputs("\\n", f);
+		else
+			fputc(*s, f);
+	}
+}
+
+static void shell_cache_load(void)
+{
+	const char *name = getenv("KCONFIG_SHELL_CACHE");
+	char *line = NULL, *tab, *tab2, *probe;
+	unsigned long long hash;
+	size_t size = 0;
+	ssize_t len;
+	FILE *f;
+
+	shell_cache_loaded = true;
+	if (!name || !*name)
+		return;
+
+	f = fopen(name, "r");
+	if (!f)
+		return;
+
+	/* the first line is the environment all the results belong to */
+	if (getline(&line, &size, f) < 0 ||
+	    sscanf(line, "# env2 %llx", &hash) != 1 ||
+	    hash != shell_env_hash()) {
+		free(line);
+		fclose(f);
+		return;
+	}
+
+	while ((len = getline(&line, &size, f)) > 0) {
+		if (line[len - 1] == '\n')
+			line[len - 1] = 0;
+		tab = strchr(line, '\t');
+		if (!tab)
+			continue;
+		*tab++ = 0;
+		tab2 = strchr(tab, '\t');
+		if (!tab2)
+			continue;
+		*tab2++ = 0;
+		shell_cache_unescape(line);
+		shell_cache_unescape(tab);
+		shell_cache_unescape(tab2);
+
+		/* drop results whose probed paths have changed since */
+		probe = shell_probe(line);
+		if (!strcmp(probe, tab2))
+			shell_result_add(line, tab, probe);
+		else
+			shell_cache_dirty = true;
+		free(probe);
+	}
+
+	free(line);
+	fclose(f);
+}
+
+static void shell_cache_write(void)
+{
+	const char *name = getenv("KCONFIG_SHELL_CACHE");
+	struct shell_result *r;
+	char *tmp;
+	FILE *f;
+
+	if (!name || !*name || !shell_cache_dirty)
+		return;
+
+	tmp = xmalloc(strlen(name) + 16);
+	sprintf(tmp, "%s.%d", name, (int)getpid());
+	f = fopen(tmp, "w");
+	if (!f) {
+		free(tmp);
+		return;
+	}
+
+	fprintf(f, "# env2 %llx\n", shell_env_hash());
+	list_for_each_entry(r, &shell_list, node) {
+		shell_cache_escape(f, r->cmd);
+		fputc('\t', f);
+		shell_cache_escape(f, r->output);
+		fputc('\t', f);
+		shell_cache_escape(f, r->probe);
+		fputc('\n', f);
+	}
+
+	if (fclose(f) || rename(tmp, name))
+		unlink(tmp);
+	free(tmp);
+	shell_cache_dirty = false;
+}
+
+/* Like run_shell(), but every command is only run once */
+char *shell_output(const char *cmd)
+{
+	struct shell_result *r;
+	double start = trace_now();
+	char *out, *probe;
+
+	if (!shell_cache_loaded)
+		shell_cache_load();
+
+	list_for_each_entry(r, &shell_list, node) {
+		if (!strcmp(r->cmd, cmd)) {
+			trace_add("shell", cmd, start, true);
+			return xstrdup(r->output);
+		}
+	}
+
+	probe = shell_probe(cmd);
+	out = run_shell(cmd);
+	shell_result_add(cmd, out, probe);
+	free(probe);
+	shell_cache_dirty = true;
+	trace_add("shell", cmd, start, false);
+
+	return out;
+}
+
+static char *do_shell(int argc, char *argv[])
+{
+	char *out = shell_output(argv[0]);
+
+	pcache_add_shell(argv[0], out);
+
+	return out;
+}
+
 static char *do_warning_if(int argc, char *argv[])
 {
+	impure_calls++;
 	if (!strcmp(argv[0], "y"))
 		fprintf(stderr, "%s:%d: %s\n",
 			current_file->name, yylineno, argv[1]);
@@ -202,6 +564,8 @@ static const struct function function_table[] = {
 static char *function_expand(const char *name, int argc, char *argv[])
 {
 	const struct function *f;
+	double start;
+	char *res;
 	int i;
 
 	for (i = 0; i < ARRAY_SIZE(function_table); i++) {
@@ -217,7 +581,11 @@ static char *function_expand(const char *name, int argc, char *argv[])
 			pperror("too many function arguments passed to '%s'",
 				name);
 
-		return f->func(argc, argv);
+		start = trace_now();
+		res = f->func(argc, argv);
+		trace_add("function", name, start, false);
+
+		return res;
 	}
 
 	return NULL;
@@ -233,9 +601,15 @@ struct variable {
 	char *value;
 	enum variable_flavor flavor;
 	int exp_count;
+	/* expansion of a recursive variable, valid while cache_gen matches */
+	char *cache;
+	unsigned int cache_gen;
 	struct list_head node;
 };
 
+/* bumped whenever a variable changes, invalidating all cached expansions */
+static unsigned int variable_gen = 1;
+
 static struct variable *variable_lookup(const char *name)
 {
 	struct variable *v;
@@ -251,6 +625,9 @@ static struct variable *variable_lookup(const char *name)
 static char *variable_expand(const char *name, int argc, char *argv[])
 {
 	struct variable *v;
+	unsigned long impure;
+	unsigned int gen;
+	double start;
 	char *res;
 
 	v = variable_lookup(name);
@@ -264,6 +641,14 @@ static char *variable_expand(const char *name, int argc, char *argv[])
 	if (v->exp_count > 1000)
 		pperror("Too deep recursive expansion");
 
+	start = trace_now();
+	if (argc == 0 && v->cache && v->cache_gen == variable_gen) {
+		trace_add("variable", name, start, true);
+		return xstrdup(v->cache);
+	}
+
+	impure = impure_calls;
+	gen = variable_gen;
 	v->exp_count++;
 
 	if (v->flavor == VAR_RECURSIVE)
@@ -273,6 +658,19 @@ static char *variable_expand(const char *name, int argc, char *argv[])
 
 	v->exp_count--;
 
+	/*
+	 * Without arguments the result only depends on other variables, the
+	 * environment and $(shell,...), so it can be reused until one of the
+	 * variables changes.
+	 */
+	if (argc == 0 && v->flavor == VAR_RECURSIVE &&
+	    impure == impure_calls && gen == variable_gen) {
+		free(v->cache);
+		v->cache = xstrdup(res);
+		v->cache_gen = gen;
+	}
+	trace_add("variable", name, start, false);
+
 	return res;
 }
 
@@ -300,6 +698,7 @@ void variable_add(const char *name, const char *value,
 		v = xmalloc(sizeof(*v));
 		v->name = xstrdup(name);
 		v->exp_count = 0;
+		v->cache = NULL;
 		list_add_tail(&v->node, &variable_list);
 	}
 
@@ -319,6 +718,8 @@ void variable_add(const char *name, const char *value,
 	} else {
 		v->value = new_value;
 	}
+
+	variable_gen++;
 }
 
 static void variable_del(struct variable *v)
@@ -326,6 +727,7 @@ static void variable_del(struct variable *v)
 	list_del(&v->node);
 	free(v->name);
 	free(v->value);
+	free(v->cache);
 	free(v);
 }
 
@@ -335,6 +737,12 @@ void variable_all_del(void)
 
 	list_for_each_entry_safe(v, tmp, &variable_list, node)
 		variable_del(v);
+	variable_gen++;
+
+	/* the parse is done, keep the $(shell,...) results for the next run */
+	shell_cache_write();
+	if (trace_expansions)
+		trace_report();
 }
 
 /*
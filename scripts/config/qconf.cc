@@ -284,7 +284,7 @@ void ConfigItemDelegate::setModelData(QWidget *editor,
 
 	success = sym_set_string_value(sym, lineEdit->text().toUtf8().data());
 	if (success) {
-		ConfigList::updateListForAll();
+		ConfigList::updateAffectedForAll();
 	} else {
 		QMessageBox::information(editor, "qconf",
 			"Cannot set the data (maybe due to out of range).\n"
@@ -313,6 +313,8 @@ ConfigList::ConfigList(QWidget *parent, const char *name)
 
 	connect(this, &ConfigList::itemSelectionChanged,
 		this, &ConfigList::updateSelection);
+	connect(this, &ConfigList::itemExpanded,
+		this, &ConfigList::populateItem);
 
 	if (name) {
 		configSettings->beginGroup(name);
@@ -482,6 +484,103 @@ void ConfigList::updateListAllForAll()
 	}
 }
 
+/*
+ * Refresh only the entries a value change can have affected.  Entries that
+ * appear or disappear are handled by refreshing the children of their
+ * parent.
+ */
+void ConfigList::updateAffected(struct menu **menus)
+{
+	QList<struct menu *> parents;
+	struct menu *menu, *parent;
+	ConfigItem *item;
+	enum prop_type type;
+
+	updateAll = true;
+	for (; *menus; menus++) {
+		menu = *menus;
+		item = findConfigItem(menu);
+		if (mode != listMode && (item ? menuSkip(menu) : !menuSkip(menu))) {
+			if (!parents.contains(menu->parent))
+				parents.append(menu->parent);
+			continue;
+		}
+		if (item)
+			item->testUpdateMenu(menu_is_visible(menu));
+	}
+
+	for (int i = 0; i < parents.size(); i++) {
+		parent = parents.at(i);
+		item = parent ? findConfigItem(parent) : nullptr;
+		if (!item) {
+			if (parent == rootEntry)
+				updateMenuList(rootEntry);
+			continue;
+		}
+		/* closed branches are filled in when they are opened */
+		if (mode == fullMode && !item->isExpanded())
+			continue;
+		type = parent->prompt ? parent->prompt->type : P_UNKNOWN;
+		if (parent == rootEntry || mode == fullMode ||
+		    mode == menuMode || type != P_MENU)
+			updateMenuList(item, parent);
+	}
+	updateAll = false;
+}
+
+void ConfigList::updateAffectedForAll()
+{
+	QListIterator<ConfigList *> it(allLists);
+	struct menu **menus;
+
+	menus = sym_get_affected_menus();
+	if (!menus) {
+		updateListForAll();
+		return;
+	}
+
+	while (it.hasNext()) {
+		ConfigList *list = it.next();
+
+		list->updateAffected(menus);
+	}
+	free(menus);
+}
+
+/*
+ * The full view only fills in a branch when it is opened
+ */
+void ConfigList::populateItem(QTreeWidgetItem *i)
+{
+	ConfigItem *item = (ConfigItem *)i;
+
+	if (mode != fullMode || !item->menu)
+		return;
+
+	updateAll = true;
+	updateMenuList(item, item->menu);
+	updateAll = false;
+	item->setChildIndicatorPolicy(
+		QTreeWidgetItem::DontShowIndicatorWhenChildless);
+}
+
+/*
+ * Open the branches leading to a menu entry, so that it has an item
+ */
+void ConfigList::expandToMenu(struct menu *menu)
+{
+	struct menu *parent = menu->parent;
+	ConfigItem *item;
+
+	if (!parent || parent == rootEntry)
+		return;
+
+	expandToMenu(parent);
+	item = findConfigItem(parent);
+	if (item)
+		item->setExpanded(true);
+}
+
 void ConfigList::setValue(ConfigItem* item, tristate val)
 {
 	struct symbol* sym;
@@ -502,7 +601,7 @@ void ConfigList::setValue(ConfigItem* item, tristate val)
 			return;
 		if (oldval == no && item->menu->list)
 			item->setExpanded(true);
-		ConfigList::updateListForAll();
+		ConfigList::updateAffectedForAll();
 		break;
 	}
 }
@@ -536,7 +635,7 @@ void ConfigList::changeValue(ConfigItem* item)
 				item->setExpanded(true);
 		}
 		if (oldexpr != newexpr)
-			ConfigList::updateListForAll();
+			ConfigList::updateAffectedForAll();
 		break;
 	default:
 		break;
@@ -637,7 +736,11 @@ void ConfigList::updateMenuList(ConfigItem *parent, struct menu* menu)
 			else
 				item->testUpdateMenu(visible);
 
-			if (mode == fullMode || mode == menuMode || type != P_MENU)
+			if (mode == fullMode && !item->isExpanded())
+				item->setChildIndicatorPolicy(child->list ?
+					QTreeWidgetItem::ShowIndicator :
+					QTreeWidgetItem::DontShowIndicator);
+			else if (mode == fullMode || mode == menuMode || type != P_MENU)
 				updateMenuList(item, child);
 			else
 				updateMenuList(item, 0);
@@ -702,7 +805,11 @@ void ConfigList::updateMenuList(struct menu *menu)
 			else
 				item->testUpdateMenu(visible);
 
-			if (mode == fullMode || mode == menuMode || type != P_MENU)
+			if (mode == fullMode && !item->isExpanded())
+				item->setChildIndicatorPolicy(child->list ?
+					QTreeWidgetItem::ShowIndicator :
+					QTreeWidgetItem::DontShowIndicator);
+			else if (mode == fullMode || mode == menuMode || type != P_MENU)
 				updateMenuList(item, child);
 			else
 				updateMenuList(item, 0);
@@ -1238,6 +1345,8 @@ ConfigSearchWindow::ConfigSearchWindow(ConfigMainWindow *parent)
 	editField = new QLineEdit(this);
 	connect(editField, &QLineEdit::returnPressed,
 		this, &ConfigSearchWindow::search);
+	connect(editField, &QLineEdit::textChanged,
+		this, &ConfigSearchWindow::searchAsYouType);
 	layout2->addWidget(editField);
 	searchButton = new QPushButton("Search", this);
 	searchButton->setAutoDefault(false);
@@ -1311,6 +1420,15 @@ void ConfigSearchWindow::search(void)
 	}
 }
 
+/*
+ * Short strings match most of the tree, only search for those on request
+ */
+void ConfigSearchWindow::searchAsYouType(const QString &text)
+{
+	if (text.length() >= 3)
+		search();
+}
+
 /*
  * Construct the complete config widget
  */
@@ -1644,6 +1762,7 @@ void ConfigMainWindow::setMenuLink(struct menu *menu)
 		break;
 	case fullMode:
 		list = configList;
+		list->expandToMenu(menu);
 		break;
 	default:
 		break;
@@ -72,6 +72,7 @@ public slots:
 	void saveSettings(void);
 	void setOptionMode(QAction *action);
 	void setShowName(bool on);
+	void populateItem(QTreeWidgetItem *item);
 
 signals:
 	void menuChanged(struct menu *menu);
@@ -90,6 +91,8 @@ public:
 	}
 	void setAllOpen(bool open);
 	void setParentMenu(void);
+	void expandToMenu(struct menu *menu);
+	void updateAffected(struct menu **menus);
 
 	bool menuSkip(struct menu *);
 
@@ -109,6 +112,7 @@ public:
 	static QList<ConfigList *> allLists;
 	static void updateListForAll();
 	static void updateListAllForAll();
+	static void updateAffectedForAll();
 
 	static QAction *showNormalAction, *showAllAction, *showPromptAction;
 };
@@ -223,6 +227,7 @@ public:
 public slots:
 	void saveSettings(void);
 	void search(void);
+	void searchAsYouType(const QString &text);
 
 protected:
 	QLineEdit* editField;
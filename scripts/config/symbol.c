@@ -456,6 +456,271 @@ void sym_clear_all_valid(void)
 	sym_calc_value(modules_sym);
 }
 
+/*
+ * Reverse dependencies, so that front ends only have to refresh what a
+ * value change can have affected.  Every symbol lists the symbols whose
+ * value or visibility is calculated from it and the menu entries whose
+ * visibility depends on it.  The table is built on first use.
+ */
+struct sym_rdep {
+	struct symbol *sym;
+	struct symbol **syms;
+	int nsyms, ssyms;
+	struct menu **menus;
+	int nmenus, smenus;
+	unsigned int gen;
+};
+
+static struct sym_rdep *sym_rdeps;
+static unsigned int sym_rdeps_size;
+static unsigned int sym_rdeps_gen;
+
+/*
+ * Symbols set by the user since the last sym_get_affected_menus().  Only
+ * recorded once a front end has asked for them, the others never drain the
+ * list.
+ */
+static struct symbol **sym_pending;
+static int sym_npending, sym_spending;
+static bool sym_pending_used;
+
+static struct sym_rdep *sym_rdep_get(struct symbol *sym)
+{
+	unsigned int i;
+
+	i = ((unsigned long)sym >> 4) & (sym_rdeps_size - 1);
+	while (sym_rdeps[i].sym && sym_rdeps[i].sym != sym)
+		i = (i + 1) & (sym_rdeps_size - 1);
+	sym_rdeps[i].sym = sym;
+
+	return &sym_rdeps[i];
+}
+
+static void sym_rdep_add_sym(struct symbol *dep, struct symbol *sym)
+{
+	struct sym_rdep *r;
+
+	if (!dep || dep == sym || dep->flags & SYMBOL_CONST)
+		return;
+
+	r = sym_rdep_get(dep);
+	if (r->nsyms && r->syms[r->nsyms - 1] == sym)
+		return;
+	if (r->nsyms >= r->ssyms) {
+		r->ssyms = r->ssyms ? r->ssyms * 2 : 4;
+		r->syms = xrealloc(r->syms, r->ssyms * sizeof(*r->syms));
+	}
+	r->syms[r->nsyms++] = sym;
+}
+
+static void sym_rdep_add_menu(struct symbol *dep, struct menu *menu)
+{
+	struct sym_rdep *r;
+
+	if (!dep || dep->flags & SYMBOL_CONST)
+		return;
+
+	r = sym_rdep_get(dep);
+	if (r->nmenus && r->menus[r->nmenus - 1] == menu)
+		return;
+	if (r->nmenus >= r->smenus) {
+		r->smenus = r->smenus ? r->smenus * 2 : 4;
+		r->menus = xrealloc(r->menus, r->smenus * sizeof(*r->menus));
+	}
+	r->menus[r->nmenus++] = menu;
+}
+
+/*
+ * Records the symbols referenced by the expression as dependencies of sym,
+ * or of menu if sym is NULL
+ */
+static void sym_rdep_expr(struct expr *e, struct symbol *sym, struct menu *menu)
+{
+	struct symbol *l = NULL, *r = NULL;
+
+	for (; e; e = e->left.expr) {
+		switch (e->type) {
+		case E_OR:
+		case E_AND:
+			sym_rdep_expr(e->right.expr, sym, menu);
+			continue;
+		case E_NOT:
+			continue;
+		case E_LIST:
+			r = e->right.sym;
+			break;
+		case E_SYMBOL:
+			l = e->left.sym;
+			break;
+		case E_EQUAL:
+		case E_UNEQUAL:
+		case E_LTH:
+		case E_LEQ:
+		case E_GTH:
+		case E_GEQ:
+		case E_RANGE:
+			l = e->left.sym;
+			r = e->right.sym;
+			break;
+		default:
+			break;
+		}
+
+		if (sym) {
+			sym_rdep_add_sym(l, sym);
+			sym_rdep_add_sym(r, sym);
+		} else {
+			sym_rdep_add_menu(l, menu);
+			sym_rdep_add_menu(r, menu);
+		}
+		if (e->type != E_LIST)
+			break;
+		l = r = NULL;
+	}
+}
+
+static void sym_rdep_menu(struct menu *menu)
+{
+	for (; menu; menu = menu->next) {
+		sym_rdep_expr(menu->dep, NULL, menu);
+		sym_rdep_expr(menu->visibility, NULL, menu);
+		if (menu->prompt)
+			sym_rdep_expr(menu->prompt->visible.expr, NULL, menu);
+		if (menu->sym)
+			sym_rdep_add_menu(menu->sym, menu);
+		sym_rdep_menu(menu->list);
+	}
+}
+
+static void sym_rdep_build(void)
+{
+	struct property *prop;
+	struct symbol *sym;
+	unsigned int n = 0;
+	int i;
+
+	for_all_symbols(i, sym)
+		n++;
+	for (sym_rdeps_size = 64; sym_rdeps_size < 2 * n; sym_rdeps_size *= 2)
+		;
+	sym_rdeps = xcalloc(sym_rdeps_size, sizeof(*sym_rdeps));
+
+	for_all_symbols(i, sym) {
+		sym_rdep_expr(sym->dir_dep.expr, sym, NULL);
+		sym_rdep_expr(sym->rev_dep.expr, sym, NULL);
+		sym_rdep_expr(sym->implied.expr, sym, NULL);
+		for (prop = sym->prop; prop; prop = prop->next) {
+			sym_rdep_expr(prop->visible.expr, sym, NULL);
+			sym_rdep_expr(prop->expr, sym, NULL);
+		}
+	}
+
+	sym_rdep_menu(&rootmenu);
+}
+
+static void sym_add_pending(struct symbol *sym)
+{
+	if (!sym_pending_used)
+		return;
+	if (sym_npending && sym_pending[sym_npending - 1] == sym)
+		return;
+	if (sym_npending >= sym_spending) {
+		sym_spending = sym_spending ? sym_spending * 2 : 4;
+		sym_pending = xrealloc(sym_pending,
+				       sym_spending * sizeof(*sym_pending));
+	}
+	sym_pending[sym_npending++] = sym;
+}
+
+static int sym_menu_cmp(const void *a, const void *b)
+{
+	const struct menu *m1 = *(const struct menu **)a;
+	const struct menu *m2 = *(const struct menu **)b;
+
+	return m1 < m2 ? -1 : m1 > m2;
+}
+
+/*
+ * Returns the NULL terminated list of menu entries whose value or
+ * visibility can have changed through the symbols set since the last call,
+ * or NULL if everything has to be refreshed.  The list must be freed.
+ */
+struct menu **sym_get_affected_menus(void)
+{
+	struct symbol **queue = NULL, *sym;
+	struct menu **menus = NULL;
+	int qlen = 0, qsize = 0, nmenus = 0, smenus = 0, i, j, k;
+	struct sym_rdep *r;
+
+	/* nothing was recorded before the first call */
+	if (!sym_pending_used) {
+		sym_pending_used = true;
+		return NULL;
+	}
+
+	if (!sym_npending)
+		return NULL;
+
+	/* everything tristate depends on the modules symbol */
+	for (i = 0; i < sym_npending; i++) {
+		if (sym_pending[i] == modules_sym) {
+			sym_npending = 0;
+			return NULL;
+		}
+	}
+
+	if (!sym_rdeps)
+		sym_rdep_build();
+	sym_rdeps_gen++;
+
+	for (i = 0; i < sym_npending; i++) {
+		r = sym_rdep_get(sym_pending[i]);
+		if (r->gen == sym_rdeps_gen)
+			continue;
+		r->gen = sym_rdeps_gen;
+		if (qlen >= qsize) {
+			qsize = qsize ? qsize * 2 : 64;
+			queue = xrealloc(queue, qsize * sizeof(*queue));
+		}
+		queue[qlen++] = sym_pending[i];
+	}
+	sym_npending = 0;
+
+	for (i = 0; i < qlen; i++) {
+		r = sym_rdep_get(queue[i]);
+		for (j = 0; j < r->nmenus; j++) {
+			if (nmenus + 1 >= smenus) {
+				smenus = smenus ? smenus * 2 : 64;
+				menus = xrealloc(menus, smenus * sizeof(*menus));
+			}
+			menus[nmenus++] = r->menus[j];
+		}
+		for (j = 0; j < r->nsyms; j++) {
+			sym = r->syms[j];
+			if (sym_rdep_get(sym)->gen == sym_rdeps_gen)
+				continue;
+			sym_rdep_get(sym)->gen = sym_rdeps_gen;
+			if (qlen >= qsize) {
+				qsize *= 2;
+				queue = xrealloc(queue, qsize * sizeof(*queue));
+			}
+			queue[qlen++] = sym;
+		}
+	}
+	free(queue);
+
+	if (!menus)
+		menus = xmalloc(sizeof(*menus));
+
+	qsort(menus, nmenus, sizeof(*menus), sym_menu_cmp);
+	for (i = k = 0; i < nmenus; i++)
+		if (!k || menus[k - 1] != menus[i])
+			menus[k++] = menus[i];
+	menus[k] = NULL;
+
+	return menus;
+}
+
 bool sym_tristate_within_range(struct symbol *sym, tristate val)
 {
 	int type = sym_get_type(sym);
@@ -505,8 +770,10 @@ bool sym_set_tristate_value(struct symbol *sym, tristate val)
 	}
 
 	sym->def[S_DEF_USER].tri = val;
-	if (oldval != val)
+	if (oldval != val) {
+		sym_add_pending(sym);
 		sym_clear_all_valid();
+	}
 
 	return true;
 }
@@ -663,6 +930,7 @@ bool sym_set_string_value(struct symbol *sym, const char *newval)
 
 	strcpy(val, newval);
 	free((void *)oldval);
+	sym_add_pending(sym);
 	sym_clear_all_valid();
 
 	return true;
@@ -897,10 +1165,13 @@ const char *sym_escape_string_value(const char *in)
 struct sym_match {
 	struct symbol	*sym;
 	off_t		so, eo;
+	/* matched one of the prompts rather than the name */
+	bool		prompt;
 };
 
 /* Compare matched symbols as thus:
  * - first, symbols that match exactly
+ * - then, symbols whose name matched
  * - then, alphabetical sort
  */
 static int sym_rel_comp(const void *sym1, const void *sym2)
@@ -918,22 +1189,176 @@ static int sym_rel_comp(const void *sym1, const void *sym2)
 	 * exactly; if this is the case, we can't decide which comes first,
 	 * and we fallback to sorting alphabetically.
 	 */
-	exact1 = (s1->eo - s1->so) == strlen(s1->sym->name);
-	exact2 = (s2->eo - s2->so) == strlen(s2->sym->name);
+	exact1 = !s1->prompt && (s1->eo - s1->so) == strlen(s1->sym->name);
+	exact2 = !s2->prompt && (s2->eo - s2->so) == strlen(s2->sym->name);
 	if (exact1 && !exact2)
 		return -1;
 	if (!exact1 && exact2)
 		return 1;
 
+	if (!s1->prompt && s2->prompt)
+		return -1;
+	if (s1->prompt && !s2->prompt)
+		return 1;
+
 	/* As a fallback, sort symbols alphabetically */
 	return strcmp(s1->sym->name, s2->sym->name);
 }
 
+/*
+ * Search index.  Every named symbol gets an entry holding its name and
+ * prompts in lower case, and every trigram of that text lists the entries
+ * it appears in.  A search for a plain string only looks at the entries
+ * listed for all of its trigrams, and a search for a string extending the
+ * previous one (search as you type) only at the previous candidates.
+ * Regular expressions still work, they just scan every entry.
+ */
+#define SYM_INDEX_GRAMS		4096
+
+struct sym_index_entry {
+	struct symbol *sym;
+	char *text;
+};
+
+struct sym_index_list {
+	int *idx;
+	int cnt, size;
+};
+
+static struct sym_index {
+	struct sym_index_entry *entries;
+	int cnt;
+	struct sym_index_list grams[SYM_INDEX_GRAMS];
+	/* literal of the last search and the entries containing it */
+	char *last;
+	struct sym_index_list cands;
+} *sym_index;
+
+static unsigned int sym_index_gram(const char *s)
+{
+	return ((unsigned char)s[0] * 31 * 31 + (unsigned char)s[1] * 31 +
+		(unsigned char)s[2]) % SYM_INDEX_GRAMS;
+}
+
+static void sym_index_list_add(struct sym_index_list *l, int idx)
+{
+	if (l->cnt && l->idx[l->cnt - 1] == idx)
+		return;
+	if (l->cnt >= l->size) {
+		l->size = l->size ? l->size * 2 : 16;
+		l->idx = xrealloc(l->idx, l->size * sizeof(*l->idx));
+	}
+	l->idx[l->cnt++] = idx;
+}
+
+static void sym_index_build(void)
+{
+	struct sym_index_entry *e;
+	struct property *prop;
+	struct symbol *sym;
+	struct gstr text;
+	char *p;
+	int i, n;
+
+	sym_index = xcalloc(1, sizeof(*sym_index));
+
+	n = 0;
+	for_all_symbols(i, sym)
+		n++;
+	sym_index->entries = xcalloc(n ? n : 1, sizeof(*sym_index->entries));
+
+	for_all_symbols(i, sym) {
+		if (sym->flags & SYMBOL_CONST || !sym->name)
+			continue;
+
+		text = str_new();
+		str_append(&text, sym->name);
+		for_all_prompts(sym, prop) {
+			str_append(&text, "\n");
+			str_append(&text, prop->text);
+		}
+
+		e = &sym_index->entries[sym_index->cnt];
+		e->sym = sym;
+		e->text = xstrdup(str_get(&text));
+		str_free(&text);
+
+		for (p = e->text; *p; p++)
+			*p = tolower((unsigned char)*p);
+		for (p = e->text; p[0] && p[1] && p[2]; p++)
+			sym_index_list_add(&sym_index->grams[sym_index_gram(p)],
+					   sym_index->cnt);
+		sym_index->cnt++;
+	}
+}
+
+/*
+ * Returns the pattern in lower case if it is a plain string, optionally
+ * anchored, or NULL if it is a real regular expression.
+ */
+static char *sym_index_literal(const char *pattern)
+{
+	char *lit, *p;
+	size_t len;
+
+	if (*pattern == '^')
+		pattern++;
+	len = strlen(pattern);
+	if (len && pattern[len - 1] == '$')
+		len--;
+
+	lit = xstrndup(pattern, len);
+	for (p = lit; *p; p++) {
+		if (strchr(".[]()*+?{}|\\^$", *p)) {
+			free(lit);
+			return NULL;
+		}
+		*p = tolower((unsigned char)*p);
+	}
+
+	return lit;
+}
+
+/* Collects the entries whose text contains the literal */
+static void sym_index_lookup(const char *lit, struct sym_index_list *out)
+{
+	struct sym_index_list *l, *best = NULL;
+	const struct sym_index_list *from;
+	struct sym_index_list all = { 0 };
+	size_t len = strlen(lit);
+	int i;
+
+	if (sym_index->last && strstr(lit, sym_index->last)) {
+		/* refines the previous search */
+		from = &sym_index->cands;
+	} else if (len >= 3) {
+		for (i = 0; i + 2 < len; i++) {
+			l = &sym_index->grams[sym_index_gram(lit + i)];
+			if (!best || l->cnt < best->cnt)
+				best = l;
+		}
+		from = best;
+	} else {
+		for (i = 0; i < sym_index->cnt; i++)
+			sym_index_list_add(&all, i);
+		from = &all;
+	}
+
+	for (i = 0; i < from->cnt; i++)
+		if (strstr(sym_index->entries[from->idx[i]].text, lit))
+			sym_index_list_add(out, from->idx[i]);
+
+	free(all.idx);
+}
+
 struct symbol **sym_re_search(const char *pattern)
 {
 	struct symbol *sym, **sym_arr = NULL;
 	struct sym_match *sym_match_arr = NULL;
-	int i, cnt, size;
+	struct sym_index_list cands = { 0 };
+	struct property *prop;
+	int i, cnt, size, n;
+	char *lit;
 	regex_t re;
 	regmatch_t match[1];
 
@@ -944,11 +1369,31 @@ struct symbol **sym_re_search(const char *pattern)
 	if (regcomp(&re, pattern, REG_EXTENDED|REG_ICASE))
 		return NULL;
 
-	for_all_symbols(i, sym) {
-		if (sym->flags & SYMBOL_CONST || !sym->name)
-			continue;
-		if (regexec(&re, sym->name, 1, match, 0))
-			continue;
+	if (!sym_index)
+		sym_index_build();
+
+	lit = sym_index_literal(pattern);
+	if (lit) {
+		sym_index_lookup(lit, &cands);
+		free(sym_index->last);
+		free(sym_index->cands.idx);
+		sym_index->last = lit;
+		sym_index->cands = cands;
+		n = cands.cnt;
+	} else {
+		n = sym_index->cnt;
+	}
+
+	for (i = 0; i < n; i++) {
+		sym = sym_index->entries[lit ? cands.idx[i] : i].sym;
+		prop = NULL;
+		if (regexec(&re, sym->name, 1, match, 0)) {
+			for_all_prompts(sym, prop)
+				if (!regexec(&re, prop->text, 1, match, 0))
+					break;
+			if (!prop)
+				continue;
+		}
 		if (cnt >= size) {
 			void *tmp;
 			size += 16;
@@ -957,12 +1402,14 @@ struct symbol **sym_re_search(const char *pattern)
 				goto sym_re_search_free;
 			sym_match_arr = tmp;
 		}
-		sym_calc_value(sym);
 		/* As regexec returned 0, we know we have a match, so
-		 * we can use match[0].rm_[se]o without further checks
+		 * we can use match[0].rm_[se]o without further checks.
+		 * Values are calculated by the front ends, for the results
+		 * they actually show.
 		 */
 		sym_match_arr[cnt].so = match[0].rm_so;
 		sym_match_arr[cnt].eo = match[0].rm_eo;
+		sym_match_arr[cnt].prompt = prop != NULL;
 		sym_match_arr[cnt++].sym = sym;
 	}
 	if (sym_match_arr) {
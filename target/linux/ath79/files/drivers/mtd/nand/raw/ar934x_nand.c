@@ -169,6 +169,7 @@ struct mtd_partition;
 struct ar934x_nfc;
 
 struct ar934x_nfc {
+	struct nand_controller controller;
 	struct nand_chip nand_chip;
 	struct device *parent;
 	void __iomem *base;
@@ -194,12 +195,10 @@ struct ar934x_nfc {
 	unsigned int buf_size;
 	int buf_index;
 
-	bool read_id;
-
-	int erase1_page_addr;
+	bool read_status;
 
+	/* page held in the bounce buffer, -1 if none */
 	int rndout_page_addr;
-	int rndout_read_cmd;
 
 	int seqin_page_addr;
 	int seqin_column;
@@ -233,13 +232,10 @@ static inline void nfc_debug_data(const char *label, void *data, int len) {}
 
 static void ar934x_nfc_restart(struct ar934x_nfc *nfc);
 
-static inline bool is_all_ff(u8 *buf, int len)
+static inline bool is_all_ff(const u8 *buf, int len)
 {
-	while (len--)
-		if (buf[len] != 0xff)
-			return false;
-
-	return true;
+	/* memchr_inv() compares a machine word at a time */
+	return !memchr_inv(buf, 0xff, len);
 }
 
 static inline void ar934x_nfc_wr(struct ar934x_nfc *nfc, unsigned reg, u32 val)
@@ -386,6 +382,21 @@ static void ar934x_nfc_free_buf(struct ar934x_nfc *nfc)
 	dma_free_coherent(nfc->parent, nfc->buf_size, nfc->buf, nfc->buf_dma);
 }
 
+/*
+ * The DMA engine can transfer straight to and from the caller's buffer
+ * if it lives in the linear mapping and does not share cache lines with
+ * anything else, otherwise the transfer goes through nfc->buf.
+ */
+static bool ar934x_nfc_dma_capable(struct ar934x_nfc *nfc, const void *buf,
+				   int len)
+{
+	unsigned int align = dma_get_cache_alignment();
+
+	return virt_addr_valid(buf) &&
+	       IS_ALIGNED((unsigned long)buf, align) &&
+	       IS_ALIGNED(len, align);
+}
+
 static void ar934x_nfc_get_addr(struct ar934x_nfc *nfc, int column,
 				int page_addr, u32 *addr0, u32 *addr1)
 {
@@ -414,6 +425,9 @@ static void ar934x_nfc_get_addr(struct ar934x_nfc *nfc, int column,
 			if (nfc->addr_count0 > 4)
 				a1 = (page_addr >> 16) & 0xf;
 		}
+	} else {
+		/* READID, single address cycle */
+		a0 = column & 0xff;
 	}
 
 	*addr0 = a0;
@@ -437,20 +451,17 @@ static void ar934x_nfc_send_cmd(struct ar934x_nfc *nfc, unsigned command)
 
 static int ar934x_nfc_do_rw_command(struct ar934x_nfc *nfc, int column,
 				    int page_addr, int len, u32 cmd_reg,
-				    u32 ctrl_reg, bool write)
+				    u32 ctrl_reg, bool write, void *buf)
 {
 	u32 addr0, addr1;
 	u32 dma_ctrl;
-	int dir;
+	dma_addr_t dma_addr;
+	enum dma_data_direction dir;
 	int err;
 	int retries = 0;
 
 	WARN_ON(len & 3);
 
-	if (WARN_ON(len > nfc->buf_size))
-		dev_err(nfc->parent, "len=%d > buf_size=%d", len,
-			nfc->buf_size);
-
 	if (write) {
 		dma_ctrl = AR934X_NFC_DMA_CTRL_DMA_DIR_WRITE;
 		dir = DMA_TO_DEVICE;
@@ -459,6 +470,22 @@ static int ar934x_nfc_do_rw_command(struct ar934x_nfc *nfc, int column,
 		dir = DMA_FROM_DEVICE;
 	}
 
+	if (buf) {
+		dma_addr = dma_map_single(nfc->parent, buf, len, dir);
+		if (dma_mapping_error(nfc->parent, dma_addr))
+			return -ENOMEM;
+	} else {
+		if (WARN_ON(len > nfc->buf_size))
+			dev_err(nfc->parent, "len=%d > buf_size=%d", len,
+				nfc->buf_size);
+
+		dma_addr = nfc->buf_dma;
+	}
+
+	/* the bounce buffer no longer holds the last page read */
+	if (write || !buf)
+		nfc->rndout_page_addr = -1;
+
 	ar934x_nfc_get_addr(nfc, column, page_addr, &addr0, &addr1);
 
 	dma_ctrl |= AR934X_NFC_DMA_CTRL_DMA_START |
@@ -476,7 +503,7 @@ retry:
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_INT_STATUS, 0);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_ADDR0_0, addr0);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_ADDR0_1, addr1);
-	ar934x_nfc_wr(nfc, AR934X_NFC_REG_DMA_ADDR, nfc->buf_dma);
+	ar934x_nfc_wr(nfc, AR934X_NFC_REG_DMA_ADDR, dma_addr);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_DMA_COUNT, len);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_DATA_SIZE, len);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_CTRL, ctrl_reg);
@@ -505,21 +532,26 @@ retry:
 			(write) ? "write" : "read", page_addr);
 	}
 
+	if (buf)
+		dma_unmap_single(nfc->parent, dma_addr, len, dir);
+
 	return err;
 }
 
-static int ar934x_nfc_send_readid(struct ar934x_nfc *nfc, unsigned command)
+static int ar934x_nfc_send_readid(struct ar934x_nfc *nfc, unsigned command,
+				  u8 addr)
 {
 	u32 cmd_reg;
 	int err;
 
-	nfc_dbg(nfc, "readid, cmd:%02x\n", command);
+	nfc_dbg(nfc, "readid, cmd:%02x addr:%02x\n", command, addr);
 
 	cmd_reg = AR934X_NFC_CMD_SEQ_1C1AXR;
 	cmd_reg |= (command & AR934X_NFC_CMD_CMD0_M) << AR934X_NFC_CMD_CMD0_S;
 
-	err = ar934x_nfc_do_rw_command(nfc, -1, -1, AR934X_NFC_ID_BUF_SIZE,
-				       cmd_reg, nfc->ctrl_reg, false);
+	/* the single address cycle is taken from the low byte of ADDR0 */
+	err = ar934x_nfc_do_rw_command(nfc, addr, -1, AR934X_NFC_ID_BUF_SIZE,
+				       cmd_reg, nfc->ctrl_reg, false, NULL);
 
 	nfc_debug_data("[id] ", nfc->buf, AR934X_NFC_ID_BUF_SIZE);
 
@@ -527,7 +559,7 @@ static int ar934x_nfc_send_readid(struct ar934x_nfc *nfc, unsigned command)
 }
 
 static int ar934x_nfc_send_read(struct ar934x_nfc *nfc, unsigned command,
-				int column, int page_addr, int len)
+				int column, int page_addr, int len, void *buf)
 {
 	u32 cmd_reg;
 	int err;
@@ -545,9 +577,9 @@ static int ar934x_nfc_send_read(struct ar934x_nfc *nfc, unsigned command,
 	}
 
 	err = ar934x_nfc_do_rw_command(nfc, column, page_addr, len,
-				       cmd_reg, nfc->ctrl_reg, false);
+				       cmd_reg, nfc->ctrl_reg, false, buf);
 
-	nfc_debug_data("[data] ", nfc->buf, len);
+	nfc_debug_data("[data] ", buf ? buf : nfc->buf, len);
 
 	return err;
 }
@@ -590,24 +622,26 @@ static void ar934x_nfc_send_erase(struct ar934x_nfc *nfc, unsigned command,
 }
 
 static int ar934x_nfc_send_write(struct ar934x_nfc *nfc, unsigned command,
-				 int column, int page_addr, int len)
+				 int column, int page_addr, int len,
+				 const void *buf)
 {
 	u32 cmd_reg;
 
 	nfc_dbg(nfc, "write, column=%d page=%d len=%d\n",
 		column, page_addr, len);
 
-	nfc_debug_data("[data] ", nfc->buf, len);
+	nfc_debug_data("[data] ", buf ? buf : nfc->buf, len);
 
 	cmd_reg = NAND_CMD_SEQIN << AR934X_NFC_CMD_CMD0_S;
 	cmd_reg |= command << AR934X_NFC_CMD_CMD1_S;
 	cmd_reg |= AR934X_NFC_CMD_SEQ_12;
 
 	return ar934x_nfc_do_rw_command(nfc, column, page_addr, len,
-					cmd_reg, nfc->ctrl_reg, true);
+					cmd_reg, nfc->ctrl_reg, true,
+					(void *)buf);
 }
 
-static void ar934x_nfc_read_status(struct ar934x_nfc *nfc)
+static u8 ar934x_nfc_read_status(struct ar934x_nfc *nfc)
 {
 	u32 cmd_reg;
 	u32 status;
@@ -626,188 +660,334 @@ static void ar934x_nfc_read_status(struct ar934x_nfc *nfc)
 	nfc_dbg(nfc, "read status, cmd:%08x status:%02x\n",
 		cmd_reg, (status & 0xff));
 
-	if (nfc->swap_dma)
-		nfc->buf[0 ^ 3] = status;
-	else
-		nfc->buf[0] = status;
+	return status & 0xff;
 }
 
-static void ar934x_nfc_cmdfunc(struct nand_chip *nand, unsigned int command,
-			       int column, int page_addr)
+struct ar934x_nfc_op {
+	u8 cmds[3];
+	unsigned int ncmds;
+	u8 addrs[NAND_MAX_ADDR_CYCLES];
+	unsigned int naddrs;
+	const struct nand_op_instr *data;
+};
+
+/*
+ * The controller runs whole command sequences instead of single bus
+ * cycles, so collect the opcodes, the address bytes and the data phase of
+ * an operation and map it onto one of the supported sequences.  R/B# is
+ * waited for at the end of every sequence, WAITRDY needs no handling.
+ */
+static int ar934x_nfc_parse_op(const struct nand_operation *op,
+			       struct ar934x_nfc_op *nop)
 {
-	struct mtd_info *mtd = nand_to_mtd(nand);
-	struct ar934x_nfc *nfc = nand->priv;
+	const struct nand_op_instr *instr;
+	unsigned int i, j;
 
-	nfc->read_id = false;
-	if (command != NAND_CMD_PAGEPROG)
-		nfc->buf_index = 0;
+	memset(nop, 0, sizeof(*nop));
 
-	switch (command) {
-	case NAND_CMD_RESET:
-		ar934x_nfc_send_cmd(nfc, command);
-		break;
+	if (op->cs)
+		return -ENOTSUPP;
 
-	case NAND_CMD_READID:
-		nfc->read_id = true;
-		ar934x_nfc_send_readid(nfc, command);
-		break;
+	for (i = 0; i < op->ninstrs; i++) {
+		instr = &op->instrs[i];
 
-	case NAND_CMD_READ0:
-	case NAND_CMD_READ1:
-		if (nfc->small_page) {
-			ar934x_nfc_send_read(nfc, command, column, page_addr,
-					     mtd->writesize + mtd->oobsize);
-		} else {
-			ar934x_nfc_send_read(nfc, command, 0, page_addr,
-					     mtd->writesize + mtd->oobsize);
-			nfc->buf_index = column;
-			nfc->rndout_page_addr = page_addr;
-			nfc->rndout_read_cmd = command;
-		}
-		break;
-
-	case NAND_CMD_READOOB:
-		if (nfc->small_page)
-			ar934x_nfc_send_read(nfc, NAND_CMD_READOOB,
-					     column, page_addr,
-					     mtd->oobsize);
-		else
-			ar934x_nfc_send_read(nfc, NAND_CMD_READ0,
-					     mtd->writesize, page_addr,
-					     mtd->oobsize);
-		break;
-
-	case NAND_CMD_RNDOUT:
-		if (WARN_ON(nfc->small_page))
+		switch (instr->type) {
+		case NAND_OP_CMD_INSTR:
+			if (nop->ncmds >= ARRAY_SIZE(nop->cmds))
+				return -ENOTSUPP;
+			nop->cmds[nop->ncmds++] = instr->ctx.cmd.opcode;
 			break;
 
-		/* emulate subpage read */
-		ar934x_nfc_send_read(nfc, nfc->rndout_read_cmd, 0,
-				     nfc->rndout_page_addr,
-				     mtd->writesize + mtd->oobsize);
-		nfc->buf_index = column;
-		break;
-
-	case NAND_CMD_ERASE1:
-		nfc->erase1_page_addr = page_addr;
-		break;
-
-	case NAND_CMD_ERASE2:
-		ar934x_nfc_send_erase(nfc, command, -1, nfc->erase1_page_addr);
-		break;
-
-	case NAND_CMD_STATUS:
-		ar934x_nfc_read_status(nfc);
-		break;
+		case NAND_OP_ADDR_INSTR:
+			if (nop->naddrs + instr->ctx.addr.naddrs >
+			    ARRAY_SIZE(nop->addrs))
+				return -ENOTSUPP;
+			for (j = 0; j < instr->ctx.addr.naddrs; j++)
+				nop->addrs[nop->naddrs++] =
+					instr->ctx.addr.addrs[j];
+			break;
 
-	case NAND_CMD_SEQIN:
-		if (nfc->small_page) {
-			/* output read command */
-			if (column >= mtd->writesize) {
-				column -= mtd->writesize;
-				nfc->seqin_read_cmd = NAND_CMD_READOOB;
-			} else if (column < 256) {
-				nfc->seqin_read_cmd = NAND_CMD_READ0;
-			} else {
-				column -= 256;
-				nfc->seqin_read_cmd = NAND_CMD_READ1;
-			}
-		} else {
-			nfc->seqin_read_cmd = NAND_CMD_READ0;
-		}
-		nfc->seqin_column = column;
-		nfc->seqin_page_addr = page_addr;
-		break;
+		case NAND_OP_DATA_IN_INSTR:
+		case NAND_OP_DATA_OUT_INSTR:
+			if (nop->data)
+				return -ENOTSUPP;
+			nop->data = instr;
+			break;
 
-	case NAND_CMD_PAGEPROG:
-		if (nand->ecc.engine_type == NAND_ECC_ENGINE_TYPE_ON_HOST) {
-			/* the data is already written */
+		case NAND_OP_WAITRDY_INSTR:
 			break;
 		}
-
-		if (nfc->small_page)
-			ar934x_nfc_send_cmd(nfc, nfc->seqin_read_cmd);
-
-		ar934x_nfc_send_write(nfc, command, nfc->seqin_column,
-				      nfc->seqin_page_addr,
-				      nfc->buf_index);
-		break;
-
-	default:
-		dev_err(nfc->parent,
-			"unsupported command: %x, column:%d page_addr=%d\n",
-			command, column, page_addr);
-		break;
 	}
+
+	return 0;
 }
 
-static int ar934x_nfc_dev_ready(struct nand_chip *chip)
+static bool ar934x_nfc_op_has_cmd(const struct ar934x_nfc_op *nop, u8 cmd)
 {
-	struct ar934x_nfc *nfc = chip->priv;
+	unsigned int i;
+
+	for (i = 0; i < nop->ncmds; i++)
+		if (nop->cmds[i] == cmd)
+			return true;
 
-	return __ar934x_nfc_dev_ready(nfc);
+	return false;
 }
 
-static u8 ar934x_nfc_read_byte(struct nand_chip *chip)
+static void ar934x_nfc_op_get_addr(struct ar934x_nfc *nfc,
+				   const struct ar934x_nfc_op *nop,
+				   int *column, int *page_addr)
 {
-	struct ar934x_nfc *nfc = chip->priv;
-	u8 data;
-
-	WARN_ON(nfc->buf_index >= nfc->buf_size);
+	unsigned int ncol = nfc->small_page ? 1 : 2;
+	unsigned int i;
 
-	if (nfc->swap_dma || nfc->read_id)
-		data = nfc->buf[nfc->buf_index ^ 3];
-	else
-		data = nfc->buf[nfc->buf_index];
-
-	nfc->buf_index++;
+	*column = 0;
+	*page_addr = 0;
 
-	return data;
+	for (i = 0; i < nop->naddrs; i++) {
+		if (i < ncol)
+			*column |= nop->addrs[i] << (8 * i);
+		else
+			*page_addr |= nop->addrs[i] << (8 * (i - ncol));
+	}
 }
 
-static void ar934x_nfc_write_buf(struct nand_chip *chip, const u8 *buf, int len)
+static int ar934x_nfc_buf_in(struct ar934x_nfc *nfc, u8 *buf, int len,
+			     bool swap)
 {
-	struct ar934x_nfc *nfc = chip->priv;
+	int buf_index = nfc->buf_index;
 	int i;
 
-	WARN_ON(nfc->buf_index + len > nfc->buf_size);
+	if (WARN_ON(buf_index + len > nfc->buf_size))
+		return -EINVAL;
 
-	if (nfc->swap_dma) {
+	if (swap) {
 		for (i = 0; i < len; i++) {
-			nfc->buf[nfc->buf_index ^ 3] = buf[i];
-			nfc->buf_index++;
+			buf[i] = nfc->buf[buf_index ^ 3];
+			buf_index++;
 		}
 	} else {
-		for (i = 0; i < len; i++) {
-			nfc->buf[nfc->buf_index] = buf[i];
-			nfc->buf_index++;
-		}
+		memcpy(buf, &nfc->buf[buf_index], len);
+		buf_index += len;
 	}
+
+	nfc->buf_index = buf_index;
+	return 0;
 }
 
-static void ar934x_nfc_read_buf(struct nand_chip *chip, u8 *buf, int len)
+static int ar934x_nfc_buf_out(struct ar934x_nfc *nfc, const u8 *buf, int len)
 {
-	struct ar934x_nfc *nfc = chip->priv;
-	int buf_index;
+	int buf_index = nfc->buf_index;
 	int i;
 
-	WARN_ON(nfc->buf_index + len > nfc->buf_size);
-
-	buf_index = nfc->buf_index;
+	if (WARN_ON(buf_index + len > nfc->buf_size))
+		return -EINVAL;
 
-	if (nfc->swap_dma || nfc->read_id) {
+	if (nfc->swap_dma) {
 		for (i = 0; i < len; i++) {
-			buf[i] = nfc->buf[buf_index ^ 3];
+			nfc->buf[buf_index ^ 3] = buf[i];
 			buf_index++;
 		}
 	} else {
-		for (i = 0; i < len; i++) {
-			buf[i] = nfc->buf[buf_index];
-			buf_index++;
-		}
+		memcpy(&nfc->buf[buf_index], buf, len);
+		buf_index += len;
 	}
 
 	nfc->buf_index = buf_index;
+	return 0;
+}
+
+static int ar934x_nfc_exec_data(struct ar934x_nfc *nfc,
+				const struct nand_op_instr *instr, bool swap)
+{
+	unsigned int i;
+	u8 *buf;
+
+	if (!instr)
+		return 0;
+
+	if (instr->type == NAND_OP_DATA_OUT_INSTR)
+		return ar934x_nfc_buf_out(nfc, instr->ctx.data.buf.out,
+					  instr->ctx.data.len);
+
+	buf = instr->ctx.data.buf.in;
+
+	if (nfc->read_status) {
+		/* status polling, every read returns a fresh value */
+		for (i = 0; i < instr->ctx.data.len; i++)
+			buf[i] = ar934x_nfc_read_status(nfc);
+		return 0;
+	}
+
+	return ar934x_nfc_buf_in(nfc, buf, instr->ctx.data.len, swap);
+}
+
+static int ar934x_nfc_exec_read(struct ar934x_nfc *nfc,
+				const struct ar934x_nfc_op *nop)
+{
+	struct mtd_info *mtd = ar934x_nfc_to_mtd(nfc);
+	int column, page_addr;
+	int err;
+
+	/* a bare READ0 leaves the status mode, nothing to send */
+	if (!nop->naddrs)
+		return ar934x_nfc_exec_data(nfc, nop->data, nfc->swap_dma);
+
+	ar934x_nfc_op_get_addr(nfc, nop, &column, &page_addr);
+
+	if (nfc->small_page) {
+		err = ar934x_nfc_send_read(nfc, nop->cmds[0], column, page_addr,
+					   nop->cmds[0] == NAND_CMD_READOOB ?
+					   mtd->oobsize :
+					   mtd->writesize + mtd->oobsize,
+					   NULL);
+		nfc->buf_index = 0;
+	} else {
+		/*
+		 * Fetch the whole page so that the column changes and the
+		 * data reads following this operation are served from the
+		 * buffer without another trip to the chip.
+		 */
+		err = ar934x_nfc_send_read(nfc, NAND_CMD_READ0, 0, page_addr,
+					   mtd->writesize + mtd->oobsize,
+					   NULL);
+		nfc->buf_index = column;
+		if (!err)
+			nfc->rndout_page_addr = page_addr;
+	}
+
+	if (err)
+		return err;
+
+	return ar934x_nfc_exec_data(nfc, nop->data, nfc->swap_dma);
+}
+
+static int ar934x_nfc_exec_prog(struct ar934x_nfc *nfc,
+				const struct ar934x_nfc_op *nop)
+{
+	int column, page_addr;
+	int err;
+
+	if (ar934x_nfc_op_has_cmd(nop, NAND_CMD_SEQIN)) {
+		ar934x_nfc_op_get_addr(nfc, nop, &column, &page_addr);
+
+		/*
+		 * On small page chips the core puts the pointer command
+		 * selecting the area to be written in front of SEQIN.
+		 */
+		if (nfc->small_page && nop->cmds[0] != NAND_CMD_SEQIN)
+			nfc->seqin_read_cmd = nop->cmds[0];
+		else
+			nfc->seqin_read_cmd = NAND_CMD_READ0;
+
+		nfc->seqin_column = column;
+		nfc->seqin_page_addr = page_addr;
+		nfc->buf_index = 0;
+	}
+
+	err = ar934x_nfc_exec_data(nfc, nop->data, false);
+	if (err || !ar934x_nfc_op_has_cmd(nop, NAND_CMD_PAGEPROG))
+		return err;
+
+	if (nfc->small_page)
+		ar934x_nfc_send_cmd(nfc, nfc->seqin_read_cmd);
+
+	return ar934x_nfc_send_write(nfc, NAND_CMD_PAGEPROG, nfc->seqin_column,
+				     nfc->seqin_page_addr, nfc->buf_index,
+				     NULL);
+}
+
+static int ar934x_nfc_exec_op(struct nand_chip *chip,
+			      const struct nand_operation *op,
+			      bool check_only)
+{
+	struct ar934x_nfc *nfc = nand_get_controller_data(chip);
+	struct ar934x_nfc_op nop;
+	int column, page_addr;
+	unsigned int i;
+	int err;
+
+	err = ar934x_nfc_parse_op(op, &nop);
+	if (err)
+		return err;
+
+	switch (nop.ncmds ? nop.cmds[0] : NAND_CMD_NONE) {
+	case NAND_CMD_NONE:
+	case NAND_CMD_RESET:
+	case NAND_CMD_READID:
+	case NAND_CMD_STATUS:
+	case NAND_CMD_READ0:
+	case NAND_CMD_READ1:
+	case NAND_CMD_READOOB:
+	case NAND_CMD_RNDOUT:
+	case NAND_CMD_SEQIN:
+	case NAND_CMD_PAGEPROG:
+		break;
+
+	case NAND_CMD_ERASE1:
+		if (nop.ncmds == 2 && nop.cmds[1] == NAND_CMD_ERASE2)
+			break;
+		fallthrough;
+
+	default:
+		return -ENOTSUPP;
+	}
+
+	if (check_only)
+		return 0;
+
+	if (!nop.ncmds)
+		return ar934x_nfc_exec_data(nfc, nop.data, nfc->swap_dma);
+
+	nfc->read_status = false;
+
+	if (ar934x_nfc_op_has_cmd(&nop, NAND_CMD_SEQIN) ||
+	    nop.cmds[0] == NAND_CMD_PAGEPROG)
+		return ar934x_nfc_exec_prog(nfc, &nop);
+
+	switch (nop.cmds[0]) {
+	case NAND_CMD_RESET:
+		ar934x_nfc_send_cmd(nfc, NAND_CMD_RESET);
+		return 0;
+
+	case NAND_CMD_READID:
+		err = ar934x_nfc_send_readid(nfc, NAND_CMD_READID,
+					     nop.naddrs ? nop.addrs[0] : 0);
+		if (err)
+			return err;
+
+		nfc->buf_index = 0;
+		return ar934x_nfc_exec_data(nfc, nop.data, true);
+
+	case NAND_CMD_STATUS:
+		nfc->read_status = true;
+		return ar934x_nfc_exec_data(nfc, nop.data, false);
+
+	case NAND_CMD_READ0:
+	case NAND_CMD_READ1:
+	case NAND_CMD_READOOB:
+		return ar934x_nfc_exec_read(nfc, &nop);
+
+	case NAND_CMD_RNDOUT:
+		/* served from the page fetched by the preceding READ0 */
+		if (nfc->small_page || nfc->rndout_page_addr < 0)
+			return -EIO;
+
+		ar934x_nfc_op_get_addr(nfc, &nop, &column, &page_addr);
+		nfc->buf_index = column;
+		return ar934x_nfc_exec_data(nfc, nop.data, nfc->swap_dma);
+
+	case NAND_CMD_ERASE1:
+		/* erase takes row address cycles only */
+		page_addr = 0;
+		for (i = 0; i < nop.naddrs; i++)
+			page_addr |= nop.addrs[i] << (8 * i);
+
+		ar934x_nfc_send_erase(nfc, NAND_CMD_ERASE2, -1, page_addr);
+		nfc->rndout_page_addr = -1;
+		return 0;
+	}
+
+	return -ENOTSUPP;
 }
 
 static inline void ar934x_nfc_enable_hwecc(struct ar934x_nfc *nfc)
@@ -818,10 +998,30 @@ static inline void ar934x_nfc_enable_hwecc(struct ar934x_nfc *nfc)
 
 static inline void ar934x_nfc_disable_hwecc(struct ar934x_nfc *nfc)
 {
-	nfc->ctrl_reg &= ~AR934X_NFC_CTRL_ECC_EN;
+	nfc->ctrl_reg &= ~(AR934X_NFC_CTRL_ECC_EN | AR934X_NFC_CTRL_SPARE_EN);
 	nfc->ctrl_reg |= AR934X_NFC_CTRL_CUSTOM_SIZE_EN;
 }
 
+/*
+ * The core keeps the OOB buffer right behind its page buffer, a combined
+ * data+OOB transfer can only go there directly.
+ */
+static bool ar934x_nfc_page_dma_capable(struct ar934x_nfc *nfc,
+					const u8 *buf, bool oob)
+{
+	struct nand_chip *chip = &nfc->nand_chip;
+	struct mtd_info *mtd = ar934x_nfc_to_mtd(nfc);
+	int len = mtd->writesize;
+
+	if (oob) {
+		if (buf + mtd->writesize != chip->oob_poi)
+			return false;
+		len += mtd->oobsize;
+	}
+
+	return ar934x_nfc_dma_capable(nfc, buf, len);
+}
+
 static int ar934x_nfc_read_oob(struct nand_chip *chip,
 			       int page)
 {
@@ -832,7 +1032,7 @@ static int ar934x_nfc_read_oob(struct nand_chip *chip,
 	nfc_dbg(nfc, "read_oob: page:%d\n", page);
 
 	err = ar934x_nfc_send_read(nfc, NAND_CMD_READ0, mtd->writesize, page,
-				   mtd->oobsize);
+				   mtd->oobsize, NULL);
 	if (err)
 		return err;
 
@@ -851,7 +1051,7 @@ static int ar934x_nfc_write_oob(struct nand_chip *chip,
 	memcpy(nfc->buf, chip->oob_poi, mtd->oobsize);
 
 	return ar934x_nfc_send_write(nfc, NAND_CMD_PAGEPROG, mtd->writesize,
-				     page, mtd->oobsize);
+				     page, mtd->oobsize, NULL);
 }
 
 static int ar934x_nfc_read_page_raw(
@@ -860,6 +1060,7 @@ static int ar934x_nfc_read_page_raw(
 {
 	struct ar934x_nfc *nfc = chip->priv;
 	struct mtd_info *mtd = ar934x_nfc_to_mtd(nfc);
+	bool direct;
 	int len;
 	int err;
 
@@ -869,8 +1070,11 @@ static int ar934x_nfc_read_page_raw(
 	if (oob_required)
 		len += mtd->oobsize;
 
-	err = ar934x_nfc_send_read(nfc, NAND_CMD_READ0, 0, page, len);
-	if (err)
+	direct = ar934x_nfc_page_dma_capable(nfc, buf, oob_required);
+
+	err = ar934x_nfc_send_read(nfc, NAND_CMD_READ0, 0, page, len,
+				   direct ? buf : NULL);
+	if (err || direct)
 		return err;
 
 	memcpy(buf, nfc->buf, mtd->writesize);
@@ -890,46 +1094,60 @@ static int ar934x_nfc_read_page(struct nand_chip *chip,
 	int max_bitflips = 0;
 	bool ecc_failed;
 	bool ecc_corrected;
+	bool direct;
+	u8 *oob;
+	int len;
 	int err;
 
 	nfc_dbg(nfc, "read_page: page:%d oob:%d\n", page, oob_required);
 
+	len = mtd->writesize;
+	direct = ar934x_nfc_page_dma_capable(nfc, buf, oob_required);
+
 	ar934x_nfc_enable_hwecc(nfc);
-	err = ar934x_nfc_send_read(nfc, NAND_CMD_READ0, 0, page,
-				   mtd->writesize);
+	if (oob_required) {
+		/* fetch the spare area in the same transfer */
+		nfc->ctrl_reg |= AR934X_NFC_CTRL_SPARE_EN;
+		len += mtd->oobsize;
+	}
+	err = ar934x_nfc_send_read(nfc, NAND_CMD_READ0, 0, page, len,
+				   direct ? buf : NULL);
 	ar934x_nfc_disable_hwecc(nfc);
 
 	if (err)
 		return err;
 
-	/* TODO: optimize to avoid memcpy */
-	memcpy(buf, nfc->buf, mtd->writesize);
+	if (!direct) {
+		memcpy(buf, nfc->buf, mtd->writesize);
+		if (oob_required)
+			memcpy(chip->oob_poi, &nfc->buf[mtd->writesize],
+			       mtd->oobsize);
+	}
 
 	/* read the ECC status */
 	ecc_ctrl = ar934x_nfc_rr(nfc, AR934X_NFC_REG_ECC_CTRL);
 	ecc_failed = ecc_ctrl & AR934X_NFC_ECC_CTRL_ERR_UNCORRECT;
 	ecc_corrected = ecc_ctrl & AR934X_NFC_ECC_CTRL_ERR_CORRECT;
 
-	if (oob_required || ecc_failed) {
-		err = ar934x_nfc_send_read(nfc, NAND_CMD_READ0, mtd->writesize,
-					   page, mtd->oobsize);
-		if (err)
-			return err;
-
-		if (oob_required)
-			memcpy(chip->oob_poi, nfc->buf, mtd->oobsize);
-	}
-
 	if (ecc_failed) {
 		/*
 		 * The hardware ECC engine reports uncorrectable errors
 		 * on empty pages. Check the ECC bytes and the data. If
 		 * both contains 0xff bytes only, dont report a failure.
-		 *
-		 * TODO: prebuild a buffer with 0xff bytes and use memcmp
-		 * for better performance?
 		 */
-		if (!is_all_ff(&nfc->buf[nfc->ecc_oob_pos], chip->ecc.total) ||
+		if (oob_required) {
+			oob = chip->oob_poi;
+		} else {
+			err = ar934x_nfc_send_read(nfc, NAND_CMD_READ0,
+						   mtd->writesize, page,
+						   mtd->oobsize, NULL);
+			if (err)
+				return err;
+
+			oob = nfc->buf;
+		}
+
+		if (!is_all_ff(&oob[nfc->ecc_oob_pos], chip->ecc.total) ||
 		    !is_all_ff(buf, mtd->writesize))
 				mtd->ecc_stats.failed++;
 	} else if (ecc_corrected) {
@@ -964,15 +1182,20 @@ static int ar934x_nfc_write_page_raw(
 
 	nfc_dbg(nfc, "write_page_raw: page:%d oob:%d\n", page, oob_required);
 
-	memcpy(nfc->buf, buf, mtd->writesize);
 	len = mtd->writesize;
+	if (oob_required)
+		len += mtd->oobsize;
 
-	if (oob_required) {
+	if (ar934x_nfc_page_dma_capable(nfc, buf, oob_required))
+		return ar934x_nfc_send_write(nfc, NAND_CMD_PAGEPROG, 0, page,
+					     len, buf);
+
+	memcpy(nfc->buf, buf, mtd->writesize);
+	if (oob_required)
 		memcpy(&nfc->buf[mtd->writesize], chip->oob_poi, mtd->oobsize);
-		len += mtd->oobsize;
-	}
 
-	return ar934x_nfc_send_write(nfc, NAND_CMD_PAGEPROG, 0, page, len);
+	return ar934x_nfc_send_write(nfc, NAND_CMD_PAGEPROG, 0, page, len,
+				     NULL);
 }
 
 static int ar934x_nfc_write_page(struct nand_chip *chip,
@@ -980,6 +1203,7 @@ static int ar934x_nfc_write_page(struct nand_chip *chip,
 {
 	struct ar934x_nfc *nfc = chip->priv;
 	struct mtd_info *mtd = ar934x_nfc_to_mtd(nfc);
+	bool direct;
 	int err;
 
 	nfc_dbg(nfc, "write_page: page:%d oob:%d\n", page, oob_required);
@@ -992,12 +1216,13 @@ static int ar934x_nfc_write_page(struct nand_chip *chip,
 			return err;
 	}
 
-	/* TODO: optimize to avoid memcopy */
-	memcpy(nfc->buf, buf, mtd->writesize);
+	direct = ar934x_nfc_page_dma_capable(nfc, buf, false);
+	if (!direct)
+		memcpy(nfc->buf, buf, mtd->writesize);
 
 	ar934x_nfc_enable_hwecc(nfc);
 	err = ar934x_nfc_send_write(nfc, NAND_CMD_PAGEPROG, 0, page,
-				    mtd->writesize);
+				    mtd->writesize, direct ? buf : NULL);
 	ar934x_nfc_disable_hwecc(nfc);
 
 	return err;
@@ -1346,14 +1571,9 @@ static int ar934x_nfc_attach_chip(struct nand_chip *nand)
 
 static u64 ar934x_nfc_dma_mask = DMA_BIT_MASK(32);
 
-static void ar934x_nfc_cmd_ctrl(struct nand_chip *chip, int dat,
-				unsigned int ctrl)
-{
-	WARN_ON(dat != NAND_CMD_NONE);
-}
-
 static const struct nand_controller_ops ar934x_nfc_controller_ops = {
 	.attach_chip = ar934x_nfc_attach_chip,
+	.exec_op = ar934x_nfc_exec_op,
 };
 
 static int ar934x_nfc_probe(struct platform_device *pdev)
@@ -1416,15 +1636,15 @@ static int ar934x_nfc_probe(struct platform_device *pdev)
 	mtd->dev.parent = &pdev->dev;
 	mtd->name = AR934X_NFC_DRIVER_NAME;
 
+	nand_controller_init(&nfc->controller);
+	nfc->controller.ops = &ar934x_nfc_controller_ops;
+	nfc->rndout_page_addr = -1;
+
 	nand_set_controller_data(nand, nfc);
 	nand_set_flash_node(nand, pdev->dev.of_node);
-	nand->legacy.chip_delay = 25;
-	nand->legacy.dev_ready = ar934x_nfc_dev_ready;
-	nand->legacy.cmdfunc = ar934x_nfc_cmdfunc;
-	nand->legacy.cmd_ctrl = ar934x_nfc_cmd_ctrl;	/* dummy */
-	nand->legacy.read_byte = ar934x_nfc_read_byte;
-	nand->legacy.write_buf = ar934x_nfc_write_buf;
-	nand->legacy.read_buf = ar934x_nfc_read_buf;
+	nand->controller = &nfc->controller;
+	nand->options |= NAND_USES_DMA;
+	nand->buf_align = dma_get_cache_alignment();
 	nand->ecc.engine_type = NAND_ECC_ENGINE_TYPE_ON_HOST;	/* default */
 	nand->priv = nfc;
 	platform_set_drvdata(pdev, nfc);
@@ -1439,7 +1659,6 @@ static int ar934x_nfc_probe(struct platform_device *pdev)
 		goto err_free_buf;
 	}
 
-	nand->legacy.dummy_controller.ops = &ar934x_nfc_controller_ops;
 	ret = nand_scan(nand, 1);
 	if (ret) {
 		dev_err(&pdev->dev, "nand_scan failed, err:%d\n", ret);
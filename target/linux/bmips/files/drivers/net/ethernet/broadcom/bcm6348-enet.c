@@ -12,6 +12,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/etherdevice.h>
+#include <linux/ethtool.h>
 #include <linux/if_vlan.h>
 #include <linux/interrupt.h>
 #include <linux/module.h>
@@ -25,6 +26,7 @@
 #include <linux/phy.h>
 #include <linux/platform_device.h>
 #include <linux/reset.h>
+#include <linux/u64_stats_sync.h>
 
 /* DMA channels */
 #define DMA_CHAN_WIDTH			0x10
@@ -301,11 +303,13 @@ module_platform_driver(bcm6348_iudma_driver);
 #define ENET_TAG_SIZE			6
 #define ENET_MTU_OVERHEAD		(VLAN_ETH_HLEN + VLAN_HLEN + \
 					 ENET_TAG_SIZE)
+#define ENET_FRAG_SIZE(x)		(SKB_DATA_ALIGN(NET_SKB_PAD + x + \
+					 SKB_DATA_ALIGN(sizeof(struct skb_shared_info))))
 
 /* Default number of descriptor */
 #define ENET_DEF_RX_DESC		64
 #define ENET_DEF_TX_DESC		32
-#define ENET_DEF_CPY_BREAK		128
+#define ENET_DEF_CPY_BREAK		0
 
 /* Maximum burst len for dma (4 bytes unit) */
 #define ENET_DMA_MAXBURST		8
@@ -404,6 +408,48 @@ module_platform_driver(bcm6348_iudma_driver);
  */
 #define ENET_TX_FIFO_TRESH		32
 
+struct bcm6348_emac_rx_stats {
+	u64 packets;
+	u64 bytes;
+	u64 copybreak;
+	u64 dropped;
+	u64 alloc_errors;
+	u64 refills;
+	struct u64_stats_sync syncp;
+};
+
+struct bcm6348_emac_tx_stats {
+	u64 packets;
+	u64 bytes;
+	u64 errors;
+	struct u64_stats_sync syncp;
+};
+
+struct bcm6348_emac_stat {
+	char name[ETH_GSTRING_LEN];
+	unsigned int offset;
+};
+
+#define ENET_RX_STAT(n, m) \
+	{ "rx_queue_0_" n, offsetof(struct bcm6348_emac_rx_stats, m) }
+#define ENET_TX_STAT(n, m) \
+	{ "tx_queue_0_" n, offsetof(struct bcm6348_emac_tx_stats, m) }
+
+static const struct bcm6348_emac_stat bcm6348_emac_rx_stats[] = {
+	ENET_RX_STAT("packets", packets),
+	ENET_RX_STAT("bytes", bytes),
+	ENET_RX_STAT("copybreak", copybreak),
+	ENET_RX_STAT("dropped", dropped),
+	ENET_RX_STAT("alloc_errors", alloc_errors),
+	ENET_RX_STAT("refills", refills),
+};
+
+static const struct bcm6348_emac_stat bcm6348_emac_tx_stats[] = {
+	ENET_TX_STAT("packets", packets),
+	ENET_TX_STAT("bytes", bytes),
+	ENET_TX_STAT("errors", errors),
+};
+
 struct bcm6348_emac {
 	struct bcm6348_iudma *iudma;
 	void __iomem *base;
@@ -414,7 +460,9 @@ struct bcm6348_emac {
 	struct reset_control **reset;
 	unsigned int num_resets;
 
-	int copybreak;
+	/* frames shorter than this are copied, 0 hands every buffer
+	 * to the stack, set with ethtool --set-tunable rx-copybreak */
+	unsigned int copybreak;
 
 	int irq_rx;
 	int irq_tx;
@@ -447,19 +495,25 @@ struct bcm6348_emac {
 	/* next dirty rx descriptor to refill */
 	int rx_dirty_desc;
 
-	/* size of allocated rx skbs */
-	unsigned int rx_skb_size;
+	/* size of allocated rx buffer */
+	unsigned int rx_buf_size;
+
+	/* size of allocated rx frag */
+	unsigned int rx_frag_size;
 
-	/* list of skb given to hw for rx */
-	struct sk_buff **rx_skb;
+	/* list of buffer given to hw for rx */
+	unsigned char **rx_buf;
 
-	/* used when rx skb allocation failed, so we defer rx queue
+	/* used when rx buffer allocation failed, so we defer rx queue
 	 * refill */
 	struct timer_list rx_timeout;
 
 	/* lock rx_timeout against rx normal operation */
 	spinlock_t rx_lock;
 
+	/* rx queue counters, updated under rx_lock */
+	struct bcm6348_emac_rx_stats rx_stats;
+
 	/* dma channel id for tx */
 	int tx_chan;
 
@@ -484,6 +538,9 @@ struct bcm6348_emac {
 	/* lock used by tx reclaim and xmit */
 	spinlock_t tx_lock;
 
+	/* tx queue counters, updated by tx reclaim */
+	struct bcm6348_emac_tx_stats tx_stats;
+
 	/* network device reference */
 	struct net_device *net_dev;
 
@@ -512,34 +569,50 @@ static inline u32 emac_readl(struct bcm6348_emac *emac, u32 off)
 /*
  * refill rx queue
  */
-static int bcm6348_emac_refill_rx(struct net_device *ndev)
+static int bcm6348_emac_refill_rx(struct net_device *ndev, bool napi_mode)
 {
 	struct bcm6348_emac *emac = netdev_priv(ndev);
 	struct bcm6348_iudma *iudma = emac->iudma;
 	struct platform_device *pdev = emac->pdev;
 	struct device *dev = &pdev->dev;
+	unsigned int armed = 0;
+	bool failed = false;
 
 	while (emac->rx_desc_count < emac->rx_ring_size) {
 		struct bcm6348_iudma_desc *desc;
-		struct sk_buff *skb;
-		dma_addr_t p;
 		int desc_idx;
 		u32 len_stat;
 
 		desc_idx = emac->rx_dirty_desc;
 		desc = &emac->rx_desc_cpu[desc_idx];
 
-		if (!emac->rx_skb[desc_idx]) {
-			skb = netdev_alloc_skb(ndev, emac->rx_skb_size);
-			if (!skb)
+		if (!emac->rx_buf[desc_idx]) {
+			unsigned char *buf;
+			dma_addr_t p;
+
+			if (likely(napi_mode))
+				buf = napi_alloc_frag(emac->rx_frag_size);
+			else
+				buf = netdev_alloc_frag(emac->rx_frag_size);
+
+			if (unlikely(!buf)) {
+				failed = true;
 				break;
-			emac->rx_skb[desc_idx] = skb;
-			p = dma_map_single(dev, skb->data, emac->rx_skb_size,
-					   DMA_FROM_DEVICE);
+			}
+
+			p = dma_map_single(dev, buf + NET_SKB_PAD,
+					   emac->rx_buf_size, DMA_FROM_DEVICE);
+			if (unlikely(dma_mapping_error(dev, p))) {
+				skb_free_frag(buf);
+				failed = true;
+				break;
+			}
+
+			emac->rx_buf[desc_idx] = buf;
 			desc->address = p;
 		}
 
-		len_stat = emac->rx_skb_size << DMADESC_LENGTH_SHIFT;
+		len_stat = emac->rx_buf_size << DMADESC_LENGTH_SHIFT;
 		len_stat |= DMADESC_OWNER_MASK;
 		if (emac->rx_dirty_desc == emac->rx_ring_size - 1) {
 			len_stat |= DMADESC_WRAP_MASK;
@@ -551,11 +624,20 @@ static int bcm6348_emac_refill_rx(struct net_device *ndev)
 		desc->len_stat = len_stat;
 
 		emac->rx_desc_count++;
-
-		/* tell dma engine we allocated one buffer */
-		dma_writel(iudma, 1, DMA_BUFALLOC_REG(emac->rx_chan));
+		armed++;
 	}
 
+	/* tell dma engine how many buffers we allocated */
+	if (armed)
+		dma_writel(iudma, armed, DMA_BUFALLOC_REG(emac->rx_chan));
+
+	u64_stats_update_begin(&emac->rx_stats.syncp);
+	if (armed)
+		emac->rx_stats.refills++;
+	if (failed)
+		emac->rx_stats.alloc_errors++;
+	u64_stats_update_end(&emac->rx_stats.syncp);
+
 	/* If rx ring is still empty, set a timer to try allocating
 	 * again at a later time. */
 	if (emac->rx_desc_count == 0 && netif_running(ndev)) {
@@ -576,7 +658,7 @@ static void bcm6348_emac_refill_rx_timer(struct timer_list *t)
 	struct net_device *ndev = emac->net_dev;
 
 	spin_lock(&emac->rx_lock);
-	bcm6348_emac_refill_rx(ndev);
+	bcm6348_emac_refill_rx(ndev, false);
 	spin_unlock(&emac->rx_lock);
 }
 
@@ -586,9 +668,12 @@ static void bcm6348_emac_refill_rx_timer(struct timer_list *t)
 static int bcm6348_emac_receive_queue(struct net_device *ndev, int budget)
 {
 	struct bcm6348_emac *emac = netdev_priv(ndev);
-	struct bcm6348_iudma *iudma = emac->iudma;
 	struct platform_device *pdev = emac->pdev;
 	struct device *dev = &pdev->dev;
+	struct bcm6348_emac_rx_stats *stats = &emac->rx_stats;
+	unsigned int copybreak = READ_ONCE(emac->copybreak);
+	unsigned int copied = 0, dropped = 0;
+	unsigned int packets = 0, bytes = 0;
 	int processed = 0;
 
 	/* don't scan ring further than number of refilled
@@ -599,6 +684,7 @@ static int bcm6348_emac_receive_queue(struct net_device *ndev, int budget)
 	do {
 		struct bcm6348_iudma_desc *desc;
 		struct sk_buff *skb;
+		unsigned char *buf;
 		int desc_idx;
 		u32 len_stat;
 		unsigned int len;
@@ -626,52 +712,62 @@ static int bcm6348_emac_receive_queue(struct net_device *ndev, int budget)
 		 * end of packet flag set, then just recycle it */
 		if ((len_stat & DMADESC_ESOP_MASK) != DMADESC_ESOP_MASK) {
 			ndev->stats.rx_dropped++;
+			dropped++;
 			continue;
 		}
 
 		/* valid packet */
-		skb = emac->rx_skb[desc_idx];
+		buf = emac->rx_buf[desc_idx];
 		len = (len_stat & DMADESC_LENGTH_MASK)
 		      >> DMADESC_LENGTH_SHIFT;
 		/* don't include FCS */
 		len -= 4;
 
-		if (len < emac->copybreak) {
-			struct sk_buff *nskb;
-
-			nskb = napi_alloc_skb(&emac->napi, len);
-			if (!nskb) {
+		if (len < copybreak) {
+			skb = napi_alloc_skb(&emac->napi, len);
+			if (unlikely(!skb)) {
 				/* forget packet, just rearm desc */
 				ndev->stats.rx_dropped++;
+				dropped++;
 				continue;
 			}
 
 			dma_sync_single_for_cpu(dev, desc->address,
 						len, DMA_FROM_DEVICE);
-			memcpy(nskb->data, skb->data, len);
+			memcpy(skb->data, buf + NET_SKB_PAD, len);
 			dma_sync_single_for_device(dev, desc->address,
 						   len, DMA_FROM_DEVICE);
-			skb = nskb;
+			copied++;
 		} else {
 			dma_unmap_single(dev, desc->address,
-					 emac->rx_skb_size, DMA_FROM_DEVICE);
-			emac->rx_skb[desc_idx] = NULL;
+					 emac->rx_buf_size, DMA_FROM_DEVICE);
+			emac->rx_buf[desc_idx] = NULL;
+
+			skb = napi_build_skb(buf, emac->rx_frag_size);
+			if (unlikely(!skb)) {
+				skb_free_frag(buf);
+				ndev->stats.rx_dropped++;
+				dropped++;
+				continue;
+			}
+			skb_reserve(skb, NET_SKB_PAD);
 		}
 
 		skb_put(skb, len);
 		skb->protocol = eth_type_trans(skb, ndev);
 		ndev->stats.rx_packets++;
 		ndev->stats.rx_bytes += len;
-		netif_receive_skb(skb);
+		packets++;
+		bytes += len;
+		napi_gro_receive(&emac->napi, skb);
 	} while (--budget > 0);
 
-	if (processed || !emac->rx_desc_count) {
-		bcm6348_emac_refill_rx(ndev);
-
-		/* kick rx dma */
-		dmac_writel(iudma, DMAC_CHANCFG_EN_MASK, DMAC_CHANCFG_REG,
-			    emac->rx_chan);
-	}
+	u64_stats_update_begin(&stats->syncp);
+	stats->packets += packets;
+	stats->bytes += bytes;
+	stats->copybreak += copied;
+	stats->dropped += dropped;
+	u64_stats_update_end(&stats->syncp);
 
 	return processed;
 }
@@ -684,7 +780,9 @@ static int bcm6348_emac_tx_reclaim(struct net_device *ndev, int force)
 	struct bcm6348_emac *emac = netdev_priv(ndev);
 	struct platform_device *pdev = emac->pdev;
 	struct device *dev = &pdev->dev;
+	unsigned int bytes = 0;
 	int released = 0;
+	int errors = 0;
 
 	while (emac->tx_desc_count < emac->tx_ring_size) {
 		struct bcm6348_iudma_desc *desc;
@@ -716,13 +814,22 @@ static int bcm6348_emac_tx_reclaim(struct net_device *ndev, int force)
 
 		spin_unlock(&emac->tx_lock);
 
-		if (desc->len_stat & DMADESC_UNDER_MASK)
+		if (desc->len_stat & DMADESC_UNDER_MASK) {
 			ndev->stats.tx_errors++;
+			errors++;
+		}
 
+		bytes += skb->len;
 		dev_kfree_skb(skb);
 		released++;
 	}
 
+	u64_stats_update_begin(&emac->tx_stats.syncp);
+	emac->tx_stats.packets += released;
+	emac->tx_stats.bytes += bytes;
+	emac->tx_stats.errors += errors;
+	u64_stats_update_end(&emac->tx_stats.syncp);
+
 	if (netif_queue_stopped(ndev) && released)
 		netif_wake_queue(ndev);
 
@@ -748,6 +855,15 @@ static int bcm6348_emac_poll(struct napi_struct *napi, int budget)
 
 	spin_lock(&emac->rx_lock);
 	rx_work_done = bcm6348_emac_receive_queue(ndev, budget);
+
+	/* rearm everything the stack took in one go */
+	if (rx_work_done || !emac->rx_desc_count) {
+		bcm6348_emac_refill_rx(ndev, true);
+
+		/* kick rx dma */
+		dmac_writel(iudma, DMAC_CHANCFG_EN_MASK, DMAC_CHANCFG_REG,
+			    emac->rx_chan);
+	}
 	spin_unlock(&emac->rx_lock);
 
 	if (rx_work_done >= budget) {
@@ -1147,11 +1263,11 @@ static int bcm6348_emac_open(struct net_device *ndev)
 	emac->tx_curr_desc = 0;
 	spin_lock_init(&emac->tx_lock);
 
-	/* init & fill rx ring with skbs */
-	emac->rx_skb = kzalloc(sizeof(struct sk_buff *) * emac->rx_ring_size,
+	/* init & fill rx ring with buffers */
+	emac->rx_buf = kzalloc(sizeof(unsigned char *) * emac->rx_ring_size,
 			       GFP_KERNEL);
-	if (!emac->rx_skb) {
-		dev_err(dev, "cannot allocate rx skb queue\n");
+	if (!emac->rx_buf) {
+		dev_err(dev, "cannot allocate rx buffer queue\n");
 		ret = -ENOMEM;
 		goto out_free_tx_skb;
 	}
@@ -1164,8 +1280,8 @@ static int bcm6348_emac_open(struct net_device *ndev)
 	dma_writel(iudma, DMA_BUFALLOC_FORCE_MASK | 0,
 		   DMA_BUFALLOC_REG(emac->rx_chan));
 
-	if (bcm6348_emac_refill_rx(ndev)) {
-		dev_err(dev, "cannot allocate rx skb queue\n");
+	if (bcm6348_emac_refill_rx(ndev, false)) {
+		dev_err(dev, "cannot allocate rx buffer queue\n");
 		ret = -ENOMEM;
 		goto out;
 	}
@@ -1243,15 +1359,15 @@ out:
 	for (i = 0; i < emac->rx_ring_size; i++) {
 		struct bcm6348_iudma_desc *desc;
 
-		if (!emac->rx_skb[i])
+		if (!emac->rx_buf[i])
 			continue;
 
 		desc = &emac->rx_desc_cpu[i];
-		dma_unmap_single(dev, desc->address, emac->rx_skb_size,
+		dma_unmap_single(dev, desc->address, emac->rx_buf_size,
 				 DMA_FROM_DEVICE);
-		kfree_skb(emac->rx_skb[i]);
+		skb_free_frag(emac->rx_buf[i]);
 	}
-	kfree(emac->rx_skb);
+	kfree(emac->rx_buf);
 
 out_free_tx_skb:
 	kfree(emac->tx_skb);
@@ -1304,22 +1420,22 @@ static int bcm6348_emac_stop(struct net_device *ndev)
 	/* force reclaim of all tx buffers */
 	bcm6348_emac_tx_reclaim(ndev, 1);
 
-	/* free the rx skb ring */
+	/* free the rx buffer ring */
 	for (i = 0; i < emac->rx_ring_size; i++) {
 		struct bcm6348_iudma_desc *desc;
 
-		if (!emac->rx_skb[i])
+		if (!emac->rx_buf[i])
 			continue;
 
 		desc = &emac->rx_desc_cpu[i];
-		dma_unmap_single_attrs(dev, desc->address, emac->rx_skb_size,
+		dma_unmap_single_attrs(dev, desc->address, emac->rx_buf_size,
 				       DMA_FROM_DEVICE,
 				       DMA_ATTR_SKIP_CPU_SYNC);
-		kfree_skb(emac->rx_skb[i]);
+		skb_free_frag(emac->rx_buf[i]);
 	}
 
 	/* free remaining allocated memory */
-	kfree(emac->rx_skb);
+	kfree(emac->rx_buf);
 	kfree(emac->tx_skb);
 	dma_free_coherent(dev, emac->rx_desc_alloc_size, emac->rx_desc_cpu,
 			  emac->rx_desc_dma);
@@ -1334,6 +1450,112 @@ static int bcm6348_emac_stop(struct net_device *ndev)
 	return 0;
 }
 
+static void bcm6348_emac_get_drvinfo(struct net_device *ndev,
+				     struct ethtool_drvinfo *info)
+{
+	strscpy(info->driver, "bcm6348-emac", sizeof(info->driver));
+	strscpy(info->bus_info, dev_name(ndev->dev.parent),
+		sizeof(info->bus_info));
+}
+
+static int bcm6348_emac_get_sset_count(struct net_device *ndev, int sset)
+{
+	if (sset != ETH_SS_STATS)
+		return -EOPNOTSUPP;
+
+	return ARRAY_SIZE(bcm6348_emac_rx_stats) +
+	       ARRAY_SIZE(bcm6348_emac_tx_stats);
+}
+
+static void bcm6348_emac_get_strings(struct net_device *ndev, u32 sset,
+				     u8 *data)
+{
+	int i;
+
+	if (sset != ETH_SS_STATS)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(bcm6348_emac_rx_stats); i++) {
+		memcpy(data, bcm6348_emac_rx_stats[i].name, ETH_GSTRING_LEN);
+		data += ETH_GSTRING_LEN;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(bcm6348_emac_tx_stats); i++) {
+		memcpy(data, bcm6348_emac_tx_stats[i].name, ETH_GSTRING_LEN);
+		data += ETH_GSTRING_LEN;
+	}
+}
+
+static void bcm6348_emac_get_ethtool_stats(struct net_device *ndev,
+					   struct ethtool_stats *stats,
+					   u64 *data)
+{
+	struct bcm6348_emac *emac = netdev_priv(ndev);
+	const u8 *rx = (const u8 *)&emac->rx_stats;
+	const u8 *tx = (const u8 *)&emac->tx_stats;
+	unsigned int start;
+	int i;
+
+	do {
+		start = u64_stats_fetch_begin(&emac->rx_stats.syncp);
+		for (i = 0; i < ARRAY_SIZE(bcm6348_emac_rx_stats); i++)
+			data[i] = *(const u64 *)(rx +
+				bcm6348_emac_rx_stats[i].offset);
+	} while (u64_stats_fetch_retry(&emac->rx_stats.syncp, start));
+	data += ARRAY_SIZE(bcm6348_emac_rx_stats);
+
+	do {
+		start = u64_stats_fetch_begin(&emac->tx_stats.syncp);
+		for (i = 0; i < ARRAY_SIZE(bcm6348_emac_tx_stats); i++)
+			data[i] = *(const u64 *)(tx +
+				bcm6348_emac_tx_stats[i].offset);
+	} while (u64_stats_fetch_retry(&emac->tx_stats.syncp, start));
+}
+
+static int bcm6348_emac_get_tunable(struct net_device *ndev,
+				    const struct ethtool_tunable *tuna,
+				    void *data)
+{
+	struct bcm6348_emac *emac = netdev_priv(ndev);
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		*(u32 *)data = emac->copybreak;
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static int bcm6348_emac_set_tunable(struct net_device *ndev,
+				    const struct ethtool_tunable *tuna,
+				    const void *data)
+{
+	struct bcm6348_emac *emac = netdev_priv(ndev);
+	u32 val;
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		val = *(const u32 *)data;
+		if (val > emac->rx_buf_size)
+			return -EINVAL;
+		WRITE_ONCE(emac->copybreak, val);
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static const struct ethtool_ops bcm6348_emac_ethtool_ops = {
+	.get_drvinfo = bcm6348_emac_get_drvinfo,
+	.get_link = ethtool_op_get_link,
+	.get_sset_count = bcm6348_emac_get_sset_count,
+	.get_strings = bcm6348_emac_get_strings,
+	.get_ethtool_stats = bcm6348_emac_get_ethtool_stats,
+	.get_tunable = bcm6348_emac_get_tunable,
+	.set_tunable = bcm6348_emac_set_tunable,
+};
+
 static const struct net_device_ops bcm6348_emac_ops = {
 	.ndo_open = bcm6348_emac_open,
 	.ndo_stop = bcm6348_emac_stop,
@@ -1572,9 +1794,11 @@ static int bcm6348_emac_probe(struct platform_device *pdev)
 		dev_info(dev, "random mac %pM\n", ndev->dev_addr);
 	}
 
-	emac->rx_skb_size = ALIGN(ndev->mtu + ENET_MTU_OVERHEAD,
+	emac->rx_buf_size = ALIGN(ndev->mtu + ENET_MTU_OVERHEAD,
 				  ENET_DMA_MAXBURST * 4);
 
+	emac->rx_frag_size = ENET_FRAG_SIZE(emac->rx_buf_size);
+
 	emac->num_clocks = of_clk_get_parent_count(node);
 	if (emac->num_clocks) {
 		emac->clock = devm_kcalloc(dev, emac->num_clocks,
@@ -1632,6 +1856,8 @@ static int bcm6348_emac_probe(struct platform_device *pdev)
 		return ret;
 
 	spin_lock_init(&emac->rx_lock);
+	u64_stats_init(&emac->rx_stats.syncp);
+	u64_stats_init(&emac->tx_stats.syncp);
 
 	timer_setup(&emac->rx_timeout, bcm6348_emac_refill_rx_timer, 0);
 
@@ -1641,6 +1867,7 @@ static int bcm6348_emac_probe(struct platform_device *pdev)
 
 	/* register netdevice */
 	ndev->netdev_ops = &bcm6348_emac_ops;
+	ndev->ethtool_ops = &bcm6348_emac_ethtool_ops;
 	ndev->min_mtu = ETH_ZLEN - ETH_HLEN;
 	ndev->mtu = ETH_DATA_LEN - VLAN_ETH_HLEN;
 	ndev->max_mtu = ENET_MAX_MTU - VLAN_ETH_HLEN;
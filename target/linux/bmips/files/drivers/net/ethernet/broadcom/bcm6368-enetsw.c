@@ -20,6 +20,7 @@
 #include <linux/pm_domain.h>
 #include <linux/pm_runtime.h>
 #include <linux/reset.h>
+#include <linux/u64_stats_sync.h>
 
 /* MTU */
 #define ENETSW_TAG_SIZE			(6 + VLAN_HLEN)
@@ -31,7 +32,7 @@
 /* default number of descriptor */
 #define ENETSW_DEF_RX_DESC		64
 #define ENETSW_DEF_TX_DESC		32
-#define ENETSW_DEF_CPY_BREAK		128
+#define ENETSW_DEF_CPY_BREAK		0
 
 /* maximum burst len for dma (4 bytes unit) */
 #define ENETSW_DMA_MAXBURST		8
@@ -124,6 +125,48 @@ struct bcm6368_enetsw_desc {
 					 DMADESC_CRC_MASK | \
 					 DMADESC_OV_MASK)
 
+struct bcm6368_enetsw_rx_stats {
+	u64 packets;
+	u64 bytes;
+	u64 copybreak;
+	u64 dropped;
+	u64 alloc_errors;
+	u64 refills;
+	struct u64_stats_sync syncp;
+};
+
+struct bcm6368_enetsw_tx_stats {
+	u64 packets;
+	u64 bytes;
+	u64 errors;
+	struct u64_stats_sync syncp;
+};
+
+struct bcm6368_enetsw_stat {
+	char name[ETH_GSTRING_LEN];
+	unsigned int offset;
+};
+
+#define ENETSW_RX_STAT(n, m) \
+	{ "rx_queue_0_" n, offsetof(struct bcm6368_enetsw_rx_stats, m) }
+#define ENETSW_TX_STAT(n, m) \
+	{ "tx_queue_0_" n, offsetof(struct bcm6368_enetsw_tx_stats, m) }
+
+static const struct bcm6368_enetsw_stat bcm6368_enetsw_rx_stats[] = {
+	ENETSW_RX_STAT("packets", packets),
+	ENETSW_RX_STAT("bytes", bytes),
+	ENETSW_RX_STAT("copybreak", copybreak),
+	ENETSW_RX_STAT("dropped", dropped),
+	ENETSW_RX_STAT("alloc_errors", alloc_errors),
+	ENETSW_RX_STAT("refills", refills),
+};
+
+static const struct bcm6368_enetsw_stat bcm6368_enetsw_tx_stats[] = {
+	ENETSW_TX_STAT("packets", packets),
+	ENETSW_TX_STAT("bytes", bytes),
+	ENETSW_TX_STAT("errors", errors),
+};
+
 struct bcm6368_enetsw {
 	void __iomem *dma_base;
 	void __iomem *dma_chan;
@@ -139,7 +182,9 @@ struct bcm6368_enetsw {
 	struct reset_control **reset;
 	unsigned int num_resets;
 
-	int copybreak;
+	/* frames shorter than this are copied, 0 hands every buffer
+	 * to the stack, set with ethtool --set-tunable rx-copybreak */
+	unsigned int copybreak;
 
 	int irq_rx;
 	int irq_tx;
@@ -188,6 +233,9 @@ struct bcm6368_enetsw {
 	/* lock rx_timeout against rx normal operation */
 	spinlock_t rx_lock;
 
+	/* rx queue counters, updated under rx_lock */
+	struct bcm6368_enetsw_rx_stats rx_stats;
+
 	/* dma channel id for tx */
 	int tx_chan;
 
@@ -212,6 +260,9 @@ struct bcm6368_enetsw {
 	/* lock used by tx reclaim and xmit */
 	spinlock_t tx_lock;
 
+	/* tx queue counters, updated by tx reclaim */
+	struct bcm6368_enetsw_tx_stats tx_stats;
+
 	/* network device reference */
 	struct net_device *net_dev;
 
@@ -249,6 +300,8 @@ static int bcm6368_enetsw_refill_rx(struct net_device *ndev, bool napi_mode)
 	struct bcm6368_enetsw *priv = netdev_priv(ndev);
 	struct platform_device *pdev = priv->pdev;
 	struct device *dev = &pdev->dev;
+	unsigned int armed = 0;
+	bool failed = false;
 
 	while (priv->rx_desc_count < priv->rx_ring_size) {
 		struct bcm6368_enetsw_desc *desc;
@@ -267,13 +320,16 @@ static int bcm6368_enetsw_refill_rx(struct net_device *ndev, bool napi_mode)
 			else
 				buf = netdev_alloc_frag(priv->rx_frag_size);
 
-			if (unlikely(!buf))
+			if (unlikely(!buf)) {
+				failed = true;
 				break;
+			}
 
 			p = dma_map_single(dev, buf + NET_SKB_PAD,
 					   priv->rx_buf_size, DMA_FROM_DEVICE);
 			if (unlikely(dma_mapping_error(dev, p))) {
 				skb_free_frag(buf);
+				failed = true;
 				break;
 			}
 
@@ -293,11 +349,20 @@ static int bcm6368_enetsw_refill_rx(struct net_device *ndev, bool napi_mode)
 		desc->len_stat = len_stat;
 
 		priv->rx_desc_count++;
-
-		/* tell dma engine we allocated one buffer */
-		dma_writel(priv, 1, DMA_BUFALLOC_REG(priv->rx_chan));
+		armed++;
 	}
 
+	/* tell dma engine how many buffers we allocated */
+	if (armed)
+		dma_writel(priv, armed, DMA_BUFALLOC_REG(priv->rx_chan));
+
+	u64_stats_update_begin(&priv->rx_stats.syncp);
+	if (armed)
+		priv->rx_stats.refills++;
+	if (failed)
+		priv->rx_stats.alloc_errors++;
+	u64_stats_update_end(&priv->rx_stats.syncp);
+
 	/* If rx ring is still empty, set a timer to try allocating
 	 * again at a later time. */
 	if (priv->rx_desc_count == 0 && netif_running(ndev)) {
@@ -330,12 +395,13 @@ static int bcm6368_enetsw_receive_queue(struct net_device *ndev, int budget)
 	struct bcm6368_enetsw *priv = netdev_priv(ndev);
 	struct platform_device *pdev = priv->pdev;
 	struct device *dev = &pdev->dev;
-	struct list_head rx_list;
+	struct bcm6368_enetsw_rx_stats *stats = &priv->rx_stats;
+	unsigned int copybreak = READ_ONCE(priv->copybreak);
+	unsigned int copied = 0, dropped = 0;
+	unsigned int packets = 0, bytes = 0;
 	struct sk_buff *skb;
 	int processed = 0;
 
-	INIT_LIST_HEAD(&rx_list);
-
 	/* don't scan ring further than number of refilled
 	 * descriptor */
 	if (budget > priv->rx_desc_count)
@@ -371,6 +437,7 @@ static int bcm6368_enetsw_receive_queue(struct net_device *ndev, int budget)
 		 * end of packet flag set, then just recycle it */
 		if ((len_stat & DMADESC_ESOP_MASK) != DMADESC_ESOP_MASK) {
 			ndev->stats.rx_dropped++;
+			dropped++;
 			continue;
 		}
 
@@ -381,13 +448,14 @@ static int bcm6368_enetsw_receive_queue(struct net_device *ndev, int budget)
 		/* don't include FCS */
 		len -= 4;
 
-		if (len < priv->copybreak) {
+		if (len < copybreak) {
 			unsigned int nfrag_size = ENETSW_FRAG_SIZE(len);
 			unsigned char *nbuf = napi_alloc_frag(nfrag_size);
 
 			if (unlikely(!nbuf)) {
 				/* forget packet, just rearm desc */
 				ndev->stats.rx_dropped++;
+				dropped++;
 				continue;
 			}
 
@@ -398,6 +466,7 @@ static int bcm6368_enetsw_receive_queue(struct net_device *ndev, int budget)
 						   len, DMA_FROM_DEVICE);
 			buf = nbuf;
 			frag_size = nfrag_size;
+			copied++;
 		} else {
 			dma_unmap_single(dev, desc->address,
 					 priv->rx_buf_size, DMA_FROM_DEVICE);
@@ -409,28 +478,28 @@ static int bcm6368_enetsw_receive_queue(struct net_device *ndev, int budget)
 		if (unlikely(!skb)) {
 			skb_free_frag(buf);
 			ndev->stats.rx_dropped++;
+			dropped++;
 			continue;
 		}
 
 		skb_reserve(skb, NET_SKB_PAD);
 		skb_put(skb, len);
+		skb->protocol = eth_type_trans(skb, ndev);
 		ndev->stats.rx_packets++;
 		ndev->stats.rx_bytes += len;
-		list_add_tail(&skb->list, &rx_list);
+		packets++;
+		bytes += len;
+		napi_gro_receive(&priv->napi, skb);
 	} while (processed < budget);
 
-	list_for_each_entry(skb, &rx_list, list)
-		skb->protocol = eth_type_trans(skb, ndev);
-	netif_receive_skb_list(&rx_list);
 	priv->rx_desc_count -= processed;
 
-	if (processed || !priv->rx_desc_count) {
-		bcm6368_enetsw_refill_rx(ndev, true);
-
-		/* kick rx dma */
-		dmac_writel(priv, DMAC_CHANCFG_EN_MASK,
-			    DMAC_CHANCFG_REG, priv->rx_chan);
-	}
+	u64_stats_update_begin(&stats->syncp);
+	stats->packets += packets;
+	stats->bytes += bytes;
+	stats->copybreak += copied;
+	stats->dropped += dropped;
+	u64_stats_update_end(&stats->syncp);
 
 	return processed;
 }
@@ -446,6 +515,7 @@ static int bcm6368_enetsw_tx_reclaim(struct net_device *ndev, int force,
 	struct device *dev = &pdev->dev;
 	unsigned int bytes = 0;
 	int released = 0;
+	int errors = 0;
 
 	while (priv->tx_desc_count < priv->tx_ring_size) {
 		struct bcm6368_enetsw_desc *desc;
@@ -478,8 +548,10 @@ static int bcm6368_enetsw_tx_reclaim(struct net_device *ndev, int force,
 
 		spin_unlock(&priv->tx_lock);
 
-		if (desc->len_stat & DMADESC_UNDER_MASK)
+		if (desc->len_stat & DMADESC_UNDER_MASK) {
 			ndev->stats.tx_errors++;
+			errors++;
+		}
 
 		bytes += skb->len;
 		napi_consume_skb(skb, budget);
@@ -488,6 +560,12 @@ static int bcm6368_enetsw_tx_reclaim(struct net_device *ndev, int force,
 
 	netdev_completed_queue(ndev, released, bytes);
 
+	u64_stats_update_begin(&priv->tx_stats.syncp);
+	priv->tx_stats.packets += released;
+	priv->tx_stats.bytes += bytes;
+	priv->tx_stats.errors += errors;
+	u64_stats_update_end(&priv->tx_stats.syncp);
+
 	if (netif_queue_stopped(ndev) && released)
 		netif_wake_queue(ndev);
 
@@ -514,6 +592,15 @@ static int bcm6368_enetsw_poll(struct napi_struct *napi, int budget)
 
 	spin_lock(&priv->rx_lock);
 	rx_work_done = bcm6368_enetsw_receive_queue(ndev, budget);
+
+	/* rearm everything the stack took in one go */
+	if (rx_work_done || !priv->rx_desc_count) {
+		bcm6368_enetsw_refill_rx(ndev, true);
+
+		/* kick rx dma */
+		dmac_writel(priv, DMAC_CHANCFG_EN_MASK,
+			    DMAC_CHANCFG_REG, priv->rx_chan);
+	}
 	spin_unlock(&priv->rx_lock);
 
 	if (rx_work_done >= budget) {
@@ -895,6 +982,112 @@ static int bcm6368_enetsw_stop(struct net_device *ndev)
 	return 0;
 }
 
+static void bcm6368_enetsw_get_drvinfo(struct net_device *ndev,
+				       struct ethtool_drvinfo *info)
+{
+	strscpy(info->driver, "bcm6368-enetsw", sizeof(info->driver));
+	strscpy(info->bus_info, dev_name(ndev->dev.parent),
+		sizeof(info->bus_info));
+}
+
+static int bcm6368_enetsw_get_sset_count(struct net_device *ndev, int sset)
+{
+	if (sset != ETH_SS_STATS)
+		return -EOPNOTSUPP;
+
+	return ARRAY_SIZE(bcm6368_enetsw_rx_stats) +
+	       ARRAY_SIZE(bcm6368_enetsw_tx_stats);
+}
+
+static void bcm6368_enetsw_get_strings(struct net_device *ndev, u32 sset,
+				       u8 *data)
+{
+	int i;
+
+	if (sset != ETH_SS_STATS)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(bcm6368_enetsw_rx_stats); i++) {
+		memcpy(data, bcm6368_enetsw_rx_stats[i].name, ETH_GSTRING_LEN);
+		data += ETH_GSTRING_LEN;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(bcm6368_enetsw_tx_stats); i++) {
+		memcpy(data, bcm6368_enetsw_tx_stats[i].name, ETH_GSTRING_LEN);
+		data += ETH_GSTRING_LEN;
+	}
+}
+
+static void bcm6368_enetsw_get_ethtool_stats(struct net_device *ndev,
+					     struct ethtool_stats *stats,
+					     u64 *data)
+{
+	struct bcm6368_enetsw *priv = netdev_priv(ndev);
+	const u8 *rx = (const u8 *)&priv->rx_stats;
+	const u8 *tx = (const u8 *)&priv->tx_stats;
+	unsigned int start;
+	int i;
+
+	do {
+		start = u64_stats_fetch_begin(&priv->rx_stats.syncp);
+		for (i = 0; i < ARRAY_SIZE(bcm6368_enetsw_rx_stats); i++)
+			data[i] = *(const u64 *)(rx +
+				bcm6368_enetsw_rx_stats[i].offset);
+	} while (u64_stats_fetch_retry(&priv->rx_stats.syncp, start));
+	data += ARRAY_SIZE(bcm6368_enetsw_rx_stats);
+
+	do {
+		start = u64_stats_fetch_begin(&priv->tx_stats.syncp);
+		for (i = 0; i < ARRAY_SIZE(bcm6368_enetsw_tx_stats); i++)
+			data[i] = *(const u64 *)(tx +
+				bcm6368_enetsw_tx_stats[i].offset);
+	} while (u64_stats_fetch_retry(&priv->tx_stats.syncp, start));
+}
+
+static int bcm6368_enetsw_get_tunable(struct net_device *ndev,
+				      const struct ethtool_tunable *tuna,
+				      void *data)
+{
+	struct bcm6368_enetsw *priv = netdev_priv(ndev);
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		*(u32 *)data = priv->copybreak;
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static int bcm6368_enetsw_set_tunable(struct net_device *ndev,
+				      const struct ethtool_tunable *tuna,
+				      const void *data)
+{
+	struct bcm6368_enetsw *priv = netdev_priv(ndev);
+	u32 val;
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		val = *(const u32 *)data;
+		if (val > priv->rx_buf_size)
+			return -EINVAL;
+		WRITE_ONCE(priv->copybreak, val);
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static const struct ethtool_ops bcm6368_enetsw_ethtool_ops = {
+	.get_drvinfo = bcm6368_enetsw_get_drvinfo,
+	.get_link = ethtool_op_get_link,
+	.get_sset_count = bcm6368_enetsw_get_sset_count,
+	.get_strings = bcm6368_enetsw_get_strings,
+	.get_ethtool_stats = bcm6368_enetsw_get_ethtool_stats,
+	.get_tunable = bcm6368_enetsw_get_tunable,
+	.set_tunable = bcm6368_enetsw_set_tunable,
+};
+
 static const struct net_device_ops bcm6368_enetsw_ops = {
 	.ndo_open = bcm6368_enetsw_open,
 	.ndo_stop = bcm6368_enetsw_stop,
@@ -1057,11 +1250,14 @@ static int bcm6368_enetsw_probe(struct platform_device *pdev)
 	}
 
 	spin_lock_init(&priv->rx_lock);
+	u64_stats_init(&priv->rx_stats.syncp);
+	u64_stats_init(&priv->tx_stats.syncp);
 
 	timer_setup(&priv->rx_timeout, bcm6368_enetsw_refill_rx_timer, 0);
 
 	/* register netdevice */
 	ndev->netdev_ops = &bcm6368_enetsw_ops;
+	ndev->ethtool_ops = &bcm6368_enetsw_ethtool_ops;
 	ndev->min_mtu = ETH_ZLEN;
 	ndev->mtu = ETH_DATA_LEN + ENETSW_TAG_SIZE;
 	ndev->max_mtu = ETH_DATA_LEN + ENETSW_TAG_SIZE;
@@ -23,6 +23,7 @@
 #include "cache.h"
 #include "printf.h"
 #include "LzmaDecode.h"
+#include "unlz4.h"
 
 #define KSEG0			0x80000000
 #define KSEG1			0xa0000000
@@ -47,6 +48,15 @@ static unsigned long lzma_datasize;
 static unsigned long lzma_outsize;
 static unsigned long kernel_la;
 
+static __inline__ unsigned long read_c0_count(void)
+{
+	unsigned long count;
+
+	__asm__ __volatile__("mfc0 %0, $9" : "=r" (count));
+
+	return count;
+}
+
 static void halt(void)
 {
 	printf("\nSystem halted!\n");
@@ -113,6 +123,21 @@ static int lzma_decompress(unsigned char *outStream)
 	return ret;
 }
 
+static int lz4_decompress(unsigned char *outStream)
+{
+	extern unsigned char _code_start[];
+	unsigned long limit = 0;
+
+	/* the kernel must not run into the loader, which is linked above it */
+	if (outStream < _code_start)
+		limit = _code_start - outStream;
+
+	if (unlz4(lzma_data, lzma_datasize, outStream, limit, &lzma_outsize))
+		return LZMA_RESULT_DATA_ERROR;
+
+	return LZMA_RESULT_OK;
+}
+
 static void lzma_init_data(void)
 {
 	extern unsigned char _lzma_data_start[];
@@ -128,8 +153,13 @@ void loader_main(unsigned long reg_a0, unsigned long reg_a1,
 {
 	void (*kernel_entry) (unsigned long, unsigned long, unsigned long,
 			      unsigned long);
+	unsigned long t_start, t_decomp;
+	unsigned long insize;
+	const char *format;
 	int res;
 
+	t_start = read_c0_count();
+
 	printf("\n\nOpenWrt kernel loader for BMIPS\n");
 	printf("Copyright (C) 2011 Gabor Juhos <juhosg@openwrt.org>\n");
 	printf("Copyright (C) 2014 Jonas Gorski <jogo@openwrt.org>\n");
@@ -137,15 +167,32 @@ void loader_main(unsigned long reg_a0, unsigned long reg_a1,
 
 	lzma_init_data();
 
-	res = lzma_init_props();
-	if (res != LZMA_RESULT_OK) {
-		printf("Incorrect LZMA stream properties!\n");
-		halt();
-	}
+	insize = lzma_datasize;
+
+	if (unlz4_probe(lzma_data, lzma_datasize)) {
+		format = "LZ4";
+
+		printf("Decompressing LZ4 kernel... ");
+
+		t_decomp = read_c0_count();
+		res = lz4_decompress((unsigned char *) kernel_la);
+		t_decomp = read_c0_count() - t_decomp;
+	} else {
+		format = "LZMA";
+
+		res = lzma_init_props();
+		if (res != LZMA_RESULT_OK) {
+			printf("Incorrect LZMA stream properties!\n");
+			halt();
+		}
 
-	printf("Decompressing kernel... ");
+		printf("Decompressing kernel... ");
+
+		t_decomp = read_c0_count();
+		res = lzma_decompress((unsigned char *) kernel_la);
+		t_decomp = read_c0_count() - t_decomp;
+	}
 
-	res = lzma_decompress((unsigned char *) kernel_la);
 	if (res != LZMA_RESULT_OK) {
 		printf("failed, ");
 		switch (res) {
@@ -162,6 +209,11 @@ void loader_main(unsigned long reg_a0, unsigned long reg_a1,
 
 	flush_cache(kernel_la, lzma_outsize);
 
+	/* CP0 count ticks at half the pipeline clock on most cores */
+	printf("%s %u -> %u bytes, decompression took %u ticks, "
+	       "loader %u ticks\n", format, insize, lzma_outsize, t_decomp,
+	       read_c0_count() - t_start);
+
 	printf("Starting kernel at %08x...\n\n", kernel_la);
 
 	kernel_entry = (void *) kernel_la;
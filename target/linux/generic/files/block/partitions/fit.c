@@ -20,6 +20,7 @@
 #include <linux/of_device.h>
 #include <linux/of_fdt.h>
 #include <linux/libfdt.h>
+#include <linux/fit_index.h>
 #include <linux/version.h>
 
 #include "check.h"
@@ -76,25 +77,21 @@ int parse_fit_partitions(struct parsed_partitions *state, u64 fit_start_sector,
 	struct block_device *bdev = state->disk->part0;
 	struct address_space *mapping = bdev->bd_inode->i_mapping;
 	struct page *page;
-	void *fit, *init_fit;
+	void *init_fit;
 	struct partition_meta_info *info;
 	char tmp[sizeof(info->volname)];
+	char source[sizeof(state->disk->disk_name) + 24];
+	struct fit_index *idx;
+	const struct fit_index_image *img;
 	u64 dsize, dsectors, imgmaxsect = 0;
-	u32 size, image_pos, image_len;
-	const u32 *image_offset_be, *image_len_be, *image_pos_be;
-	int ret = 1, node, images, config;
-	const char *image_name, *image_type, *image_description, *config_default,
-		*config_description, *config_loadables, *bootconf_c;
-	int image_name_len, image_type_len, image_description_len, config_default_len,
-		config_description_len, config_loadables_len, bootconf_len;
+	u32 size;
+	int ret = 1, bootconf_len;
+	const char *bootconf_c;
 	sector_t start_sect, nr_sects;
-	size_t label_min;
 	struct device_node *np = NULL;
 	char *bootconf = NULL, *bootconf_term;
-	const char *loadable;
 	const char *select_rootfs = NULL;
-	bool found;
-	int loadables_rem_len, loadable_len;
+	unsigned int i;
 
 	if (fit_start_sector % (1<<(PAGE_SHIFT - SECTOR_SHIFT)))
 		return -ERANGE;
@@ -137,11 +134,6 @@ int parse_fit_partitions(struct parsed_partitions *state, u64 fit_start_sector,
 		return -EFBIG;
 	}
 
-	fit = kmemdup(init_fit, size, GFP_KERNEL);
-	put_page(page);
-	if (!fit)
-		return -ENOMEM;
-
 	np = of_find_node_by_path("/chosen");
 	if (np) {
 		bootconf_c = of_get_property(np, "u-boot,bootconf", &bootconf_len);
@@ -155,105 +147,53 @@ int parse_fit_partitions(struct parsed_partitions *state, u64 fit_start_sector,
 			*bootconf_term = '\0';
 	}
 
-	config = fdt_path_offset(fit, FIT_CONFS_PATH);
-	if (config < 0) {
-		printk(KERN_ERR "FIT: Cannot find %s node: %d\n", FIT_CONFS_PATH, images);
-		ret = -ENOENT;
-		goto ret_out;
-	}
-
-	config_default = fdt_getprop(fit, config, FIT_DEFAULT_PROP, &config_default_len);
+	if (fit_start_sector)
+		snprintf(source, sizeof(source), "%s+%llu", state->disk->disk_name, fit_start_sector);
+	else
+		strscpy(source, state->disk->disk_name, sizeof(source));
 
-	if (!config_default && !bootconf) {
-		printk(KERN_ERR "FIT: Cannot find default configuration\n");
-		ret = -ENOENT;
+	idx = fit_index_get(source, fit_start_sector << SECTOR_SHIFT, dsize,
+			    init_fit, size, bootconf);
+	put_page(page);
+	if (IS_ERR(idx)) {
+		ret = PTR_ERR(idx);
 		goto ret_out;
 	}
 
-	node = fdt_subnode_offset(fit, config, bootconf?:config_default);
-	if (node < 0) {
-		printk(KERN_ERR "FIT: Cannot find %s node: %d\n", bootconf?:config_default, node);
+	if (idx->conf_err == -ENOENT) {
+		printk(KERN_ERR "FIT: Cannot find configuration \"%s\"\n", idx->conf);
 		ret = -ENOENT;
-		goto ret_out;
+		goto put_out;
 	}
 
-	config_description = fdt_getprop(fit, node, FIT_DESC_PROP, &config_description_len);
-	config_loadables = fdt_getprop(fit, node, FIT_LOADABLE_PROP, &config_loadables_len);
-
-	printk(KERN_DEBUG "FIT: %s configuration: \"%s\"%s%s%s\n",
-		bootconf?"Selected":"Default", bootconf?:config_default,
-		config_description?" (":"", config_description?:"", config_description?")":"");
-
-	if (!config_loadables || !config_loadables_len) {
-		printk(KERN_ERR "FIT: No loadables configured in \"%s\"\n", bootconf?:config_default);
+	if (idx->conf_err) {
+		printk(KERN_ERR "FIT: No loadables configured in \"%s\"\n", idx->conf);
 		ret = -ENOENT;
-		goto ret_out;
+		goto put_out;
 	}
 
-	images = fdt_path_offset(fit, FIT_IMAGES_PATH);
-	if (images < 0) {
-		printk(KERN_ERR "FIT: Cannot find %s node: %d\n", FIT_IMAGES_PATH, images);
-		ret = -EINVAL;
-		goto ret_out;
-	}
-
-	fdt_for_each_subnode(node, fit, images) {
-		image_name = fdt_get_name(fit, node, &image_name_len);
-		image_type = fdt_getprop(fit, node, FIT_TYPE_PROP, &image_type_len);
-		image_offset_be = fdt_getprop(fit, node, FIT_DATA_OFFSET_PROP, NULL);
-		image_pos_be = fdt_getprop(fit, node, FIT_DATA_POSITION_PROP, NULL);
-		image_len_be = fdt_getprop(fit, node, FIT_DATA_SIZE_PROP, NULL);
-		if (!image_name || !image_type || !image_len_be)
-			continue;
-
-		image_len = be32_to_cpu(*image_len_be);
-		if (!image_len)
-			continue;
+	for (i = 0; i < idx->nr_images; i++) {
+		img = &idx->images[i];
 
-		if (image_offset_be)
-			image_pos = be32_to_cpu(*image_offset_be) + size;
-		else if (image_pos_be)
-			image_pos = be32_to_cpu(*image_pos_be);
-		else
+		if (strcmp(img->type, FIT_FILESYSTEM_PROP))
 			continue;
 
-		image_description = fdt_getprop(fit, node, FIT_DESC_PROP, &image_description_len);
-
-		printk(KERN_DEBUG "FIT: %16s sub-image 0x%08x..0x%08x \"%s\" %s%s%s\n",
-			image_type, image_pos, image_pos + image_len - 1, image_name,
-			image_description?"(":"", image_description?:"", image_description?") ":"");
-
-		if (strcmp(image_type, FIT_FILESYSTEM_PROP))
-			continue;
-
-		/* check if sub-image is part of configured loadables */
-		found = false;
-		loadable = config_loadables;
-		loadables_rem_len = config_loadables_len;
-		while (loadables_rem_len > 1) {
-			loadable_len = strnlen(loadable, loadables_rem_len - 1) + 1;
-			loadables_rem_len -= loadable_len;
-			if (!strncmp(image_name, loadable, loadable_len)) {
-				found = true;
-				break;
-			}
-			loadable += loadable_len;
-		}
-		if (!found)
+		/* only external sub-images of the configured loadables */
+		if (!(img->flags & FIT_INDEX_LOADABLE) || (img->flags & FIT_INDEX_EMBEDDED))
 			continue;
 
-		if (image_pos & ((1 << PAGE_SHIFT)-1)) {
-			printk(KERN_ERR "FIT: image %s start not aligned to page boundaries, skipping\n", image_name);
+		if (img->pos & ((1 << PAGE_SHIFT)-1)) {
+			printk(KERN_ERR "FIT: image %s start not aligned to page boundaries, skipping\n", img->name);
 			continue;
 		}
 
-		if (image_len & ((1 << PAGE_SHIFT)-1)) {
-			printk(KERN_ERR "FIT: sub-image %s end not aligned to page boundaries, skipping\n", image_name);
+		if (img->len & ((1 << PAGE_SHIFT)-1)) {
+			printk(KERN_ERR "FIT: sub-image %s end not aligned to page boundaries, skipping\n", img->name);
 			continue;
 		}
 
-		start_sect = image_pos >> SECTOR_SHIFT;
-		nr_sects = image_len >> SECTOR_SHIFT;
+		start_sect = img->pos >> SECTOR_SHIFT;
+		nr_sects = img->len >> SECTOR_SHIFT;
 		imgmaxsect = (imgmaxsect < (start_sect + nr_sects))?(start_sect + nr_sects):imgmaxsect;
 
 		if (start_sect + nr_sects > dsectors) {
@@ -266,16 +206,14 @@ int parse_fit_partitions(struct parsed_partitions *state, u64 fit_start_sector,
 		state->parts[*slot].has_info = true;
 		info = &state->parts[*slot].info;
 
-		label_min = min_t(int, sizeof(info->volname) - 1, image_name_len);
-		strncpy(info->volname, image_name, label_min);
-		info->volname[label_min] = '\0';
+		strscpy(info->volname, img->name, sizeof(info->volname));
 
 		snprintf(tmp, sizeof(tmp), "(%s)", info->volname);
 		strlcat(state->pp_buf, tmp, PAGE_SIZE);
 
 		/* Mark first loadable listed to be mounted as rootfs */
-		if (!strcmp(image_name, config_loadables)) {
-			select_rootfs = image_name;
+		if (img->flags & FIT_INDEX_ROOTFS) {
+			select_rootfs = img->name;
 			state->parts[*slot].flags |= ADDPART_FLAG_ROOTDEV;
 		}
 	}
@@ -291,9 +229,10 @@ int parse_fit_partitions(struct parsed_partitions *state, u64 fit_start_sector,
 		snprintf(tmp, sizeof(tmp), "(%s)", REMAIN_VOLNAME);
 		strlcat(state->pp_buf, tmp, PAGE_SIZE);
 	}
+put_out:
+	fit_index_put(idx);
 ret_out:
 	kfree(bootconf);
-	kfree(fit);
 	return ret;
 }
 
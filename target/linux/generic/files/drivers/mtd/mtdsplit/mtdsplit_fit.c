@@ -23,172 +23,10 @@
 #include <linux/slab.h>
 #include <linux/libfdt.h>
 #include <linux/of_fdt.h>
+#include <linux/fit_index.h>
 
 #include "mtdsplit.h"
 
-// string macros from git://git.denx.de/u-boot.git/include/image.h
-
-#define FIT_IMAGES_PATH         "/images"
-#define FIT_DATA_PROP           "data"
-#define FIT_DATA_POSITION_PROP  "data-position"
-#define FIT_DATA_OFFSET_PROP    "data-offset"
-#define FIT_DATA_SIZE_PROP      "data-size"
-
-// functions from git://git.denx.de/u-boot.git/common/image-fit.c
-
-/**
- * fit_image_get_data - get data property and its size for a given component image node
- * @fit: pointer to the FIT format image header
- * @noffset: component image node offset
- * @data: double pointer to void, will hold data property's data address
- * @size: pointer to size_t, will hold data property's data size
- *
- * fit_image_get_data() finds data property in a given component image node.
- * If the property is found its data start address and size are returned to
- * the caller.
- *
- * returns:
- *     0, on success
- *     -1, on failure
- */
-static int fit_image_get_data(const void *fit, int noffset,
-		const void **data, size_t *size)
-{
-	int len;
-
-	*data = fdt_getprop(fit, noffset, FIT_DATA_PROP, &len);
-	if (*data == NULL) {
-		*size = 0;
-		return -1;
-	}
-
-	*size = len;
-	return 0;
-}
-
-
-/**
- * Get 'data-offset' property from a given image node.
- *
- * @fit: pointer to the FIT image header
- * @noffset: component image node offset
- * @data_offset: holds the data-offset property
- *
- * returns:
- *     0, on success
- *     -ENOENT if the property could not be found
- */
-static int fit_image_get_data_offset(const void *fit, int noffset, int *data_offset)
-{
-	const fdt32_t *val;
-
-	val = fdt_getprop(fit, noffset, FIT_DATA_OFFSET_PROP, NULL);
-	if (!val)
-		return -ENOENT;
-
-	*data_offset = fdt32_to_cpu(*val);
-
-	return 0;
-}
-
-/**
- * Get 'data-position' property from a given image node.
- *
- * @fit: pointer to the FIT image header
- * @noffset: component image node offset
- * @data_position: holds the data-position property
- *
- * returns:
- *     0, on success
- *     -ENOENT if the property could not be found
- */
-static int fit_image_get_data_position(const void *fit, int noffset,
-				int *data_position)
-{
-	const fdt32_t *val;
-
-	val = fdt_getprop(fit, noffset, FIT_DATA_POSITION_PROP, NULL);
-	if (!val)
-		return -ENOENT;
-
-	*data_position = fdt32_to_cpu(*val);
-
-	return 0;
-}
-
-/**
- * Get 'data-size' property from a given image node.
- *
- * @fit: pointer to the FIT image header
- * @noffset: component image node offset
- * @data_size: holds the data-size property
- *
- * returns:
- *     0, on success
- *     -ENOENT if the property could not be found
- */
-static int fit_image_get_data_size(const void *fit, int noffset, int *data_size)
-{
-	const fdt32_t *val;
-
-	val = fdt_getprop(fit, noffset, FIT_DATA_SIZE_PROP, NULL);
-	if (!val)
-		return -ENOENT;
-
-	*data_size = fdt32_to_cpu(*val);
-
-	return 0;
-}
-
-/**
- * fit_image_get_data_and_size - get data and its size including
- *				 both embedded and external data
- * @fit: pointer to the FIT format image header
- * @noffset: component image node offset
- * @data: double pointer to void, will hold data property's data address
- * @size: pointer to size_t, will hold data property's data size
- *
- * fit_image_get_data_and_size() finds data and its size including
- * both embedded and external data. If the property is found
- * its data start address and size are returned to the caller.
- *
- * returns:
- *     0, on success
- *     otherwise, on failure
- */
-static int fit_image_get_data_and_size(const void *fit, int noffset,
-				const void **data, size_t *size)
-{
-	bool external_data = false;
-	int offset;
-	int len;
-	int ret;
-
-	if (!fit_image_get_data_position(fit, noffset, &offset)) {
-		external_data = true;
-	} else if (!fit_image_get_data_offset(fit, noffset, &offset)) {
-		external_data = true;
-		/*
-		 * For FIT with external data, figure out where
-		 * the external images start. This is the base
-		 * for the data-offset properties in each image.
-		 */
-		offset += ((fdt_totalsize(fit) + 3) & ~3);
-	}
-
-	if (external_data) {
-		ret = fit_image_get_data_size(fit, noffset, &len);
-		if (!ret) {
-			*data = fit + offset;
-			*size = len;
-		}
-	} else {
-		ret = fit_image_get_data(fit, noffset, data, size);
-	}
-
-	return ret;
-}
-
 static int
 mtdsplit_fit_parse(struct mtd_info *mtd,
 		   const struct mtd_partition **pparts,
@@ -202,10 +40,11 @@ mtdsplit_fit_parse(struct mtd_info *mtd,
 	u32 offset_start = 0;
 	size_t fit_offset, fit_size;
 	size_t rootfs_offset, rootfs_size;
-	size_t data_size, img_total, max_size = 0;
+	size_t max_size;
+	ssize_t meta_size;
 	struct mtd_partition *parts;
-	int ret, ndepth, noffset, images_noffset;
-	const void *img_data;
+	struct fit_index *idx;
+	int ret;
 	void *fit;
 
 	of_property_read_string(np, "openwrt,cmdline-match", &cmdline_match);
@@ -291,36 +130,43 @@ mtdsplit_fit_parse(struct mtd_info *mtd,
 
 		return 2;
 	} else {
-		/* Search for rootfs_data after FIT external data */
-		fit = kzalloc(fit_size, GFP_KERNEL);
-		ret = mtd_read(mtd, offset, fit_size + offset_start, &retlen, fit);
+		/*
+		 * Search for rootfs_data after FIT external data. Only the
+		 * FDT header, structure and strings blocks are needed to
+		 * locate the end of the last sub-image.
+		 */
+		meta_size = fit_index_meta_size(&hdr);
+		if (meta_size < 0)
+			return -ENODEV;
+
+		fit = kmalloc(meta_size, GFP_KERNEL);
+		if (!fit)
+			return -ENOMEM;
+
+		ret = mtd_read(mtd, fit_offset + offset_start, meta_size, &retlen, fit);
+		if (!ret && retlen != meta_size)
+			ret = -EIO;
 		if (ret) {
 			pr_err("read error in \"%s\" at offset 0x%llx\n",
-			       mtd->name, (unsigned long long) offset);
+			       mtd->name, (unsigned long long) fit_offset);
+			kfree(fit);
 			return ret;
 		}
 
-		images_noffset = fdt_path_offset(fit, FIT_IMAGES_PATH);
-		if (images_noffset < 0) {
-			pr_err("Can't find images parent node '%s' (%s)\n",
-			FIT_IMAGES_PATH, fdt_strerror(images_noffset));
+		idx = fit_index_get(mtd->name, fit_offset + offset_start,
+				    mtd->size - fit_offset - offset_start,
+				    fit, meta_size, NULL);
+		kfree(fit);
+		if (IS_ERR(idx))
 			return -ENODEV;
-		}
-
-		for (ndepth = 0,
-		     noffset = fdt_next_node(fit, images_noffset, &ndepth);
-		     (noffset >= 0) && (ndepth > 0);
-		     noffset = fdt_next_node(fit, noffset, &ndepth)) {
-			if (ndepth == 1) {
-				ret = fit_image_get_data_and_size(fit, noffset, &img_data, &data_size);
-				if (ret)
-					return 0;
 
-				img_total = data_size + (img_data - fit);
+		max_size = idx->data_end;
+		fit_index_put(idx);
 
-				max_size = (max_size > img_total) ? max_size : img_total;
-			}
-		}
+		/* truncated image, the sub-images run past the partition */
+		if (fit_offset + mtd_rounddown_to_eb(max_size, mtd) +
+		    mtd->erasesize >= mtd->size)
+			return -ENODEV;
 
 		parts = kzalloc(sizeof(*parts), GFP_KERNEL);
 		if (!parts)
@@ -332,8 +178,6 @@ mtdsplit_fit_parse(struct mtd_info *mtd,
 
 		*pparts = parts;
 
-		kfree(fit);
-
 		return 1;
 	}
 }
@@ -19,6 +19,7 @@
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 #include <linux/delay.h>
+#include <linux/etherdevice.h>
 #include <linux/export.h>
 #include <linux/gpio.h>
 #include <linux/kernel.h>
@@ -368,6 +369,208 @@ static int b53_flush_arl(struct b53_device *dev)
 	return -EINVAL;
 }
 
+static int b53_arl_op_wait(struct b53_device *dev)
+{
+	unsigned int timeout = 10;
+	u8 reg;
+
+	do {
+		b53_read8(dev, B53_ARLIO_PAGE, B53_ARLTBL_RW_CTRL, &reg);
+		if (!(reg & ARLTBL_START_DONE))
+			return 0;
+
+		usleep_range(1000, 2000);
+	} while (timeout--);
+
+	return -ETIMEDOUT;
+}
+
+static int b53_arl_rw_op(struct b53_device *dev, bool read)
+{
+	u8 reg;
+
+	b53_read8(dev, B53_ARLIO_PAGE, B53_ARLTBL_RW_CTRL, &reg);
+
+	reg |= ARLTBL_START_DONE;
+	if (read)
+		reg |= ARLTBL_RW;
+	else
+		reg &= ~ARLTBL_RW;
+
+	/* hash the VID in only if the VLAN setup learns per VLAN */
+	if (dev->enable_vlan)
+		reg &= ~ARLTBL_IVL_SVL_SELECT;
+	else
+		reg |= ARLTBL_IVL_SVL_SELECT;
+
+	b53_write8(dev, B53_ARLIO_PAGE, B53_ARLTBL_RW_CTRL, reg);
+
+	return b53_arl_op_wait(dev);
+}
+
+static void b53_arl_to_entry(struct b53_arl_entry *ent, u64 mac_vid,
+			     u32 fwd_entry)
+{
+	memset(ent, 0, sizeof(*ent));
+	u64_to_ether_addr(mac_vid & ARLTBL_MAC_MASK, ent->mac);
+	ent->vid = (mac_vid >> ARLTBL_VID_S) & ARLTBL_VID_MASK;
+	ent->port = fwd_entry & ARLTBL_DATA_PORT_ID_MASK;
+	ent->is_valid = !!(fwd_entry & ARLTBL_VALID);
+	ent->is_age = !!(fwd_entry & ARLTBL_AGE);
+	ent->is_static = !!(fwd_entry & ARLTBL_STATIC);
+}
+
+/*
+ * Look for mac/vid in the bucket fetched by the last read operation.
+ * Returns 0 and the matching bin, -ENOENT and a free bin, or -ENOSPC.
+ */
+static int b53_arl_lookup(struct b53_device *dev, u64 mac, u16 vid, u8 *idx)
+{
+	int free = -1;
+	int i, ret;
+
+	ret = b53_arl_op_wait(dev);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < B53_ARLTBL_BINS; i++) {
+		u64 mac_vid;
+		u32 fwd_entry;
+
+		b53_read64(dev, B53_ARLIO_PAGE, B53_ARLTBL_MAC_VID_ENTRY(i),
+			   &mac_vid);
+		b53_read32(dev, B53_ARLIO_PAGE, B53_ARLTBL_DATA_ENTRY(i),
+			   &fwd_entry);
+
+		if (!(fwd_entry & ARLTBL_VALID)) {
+			if (free < 0)
+				free = i;
+			continue;
+		}
+
+		if ((mac_vid & ARLTBL_MAC_MASK) != mac)
+			continue;
+
+		if (dev->enable_vlan &&
+		    ((mac_vid >> ARLTBL_VID_S) & ARLTBL_VID_MASK) != vid)
+			continue;
+
+		*idx = i;
+		return 0;
+	}
+
+	if (free < 0)
+		return -ENOSPC;
+
+	*idx = free;
+	return -ENOENT;
+}
+
+/* add a static unicast entry for addr/vid on port, or remove it */
+static int b53_arl_write(struct b53_device *dev, const u8 *addr, u16 vid,
+			 int port, bool valid)
+{
+	u64 mac = ether_addr_to_u64(addr);
+	u64 mac_vid;
+	u32 fwd_entry = 0;
+	u8 idx = 0;
+	int ret;
+
+	mutex_lock(&dev->arl_mutex);
+
+	b53_write48(dev, B53_ARLIO_PAGE, B53_MAC_ADDR_IDX, mac);
+	b53_write16(dev, B53_ARLIO_PAGE, B53_VLAN_ID_IDX, vid);
+
+	ret = b53_arl_rw_op(dev, true);
+	if (ret)
+		goto out;
+
+	ret = b53_arl_lookup(dev, mac, vid, &idx);
+	if (!valid && ret == -ENOSPC)
+		ret = -ENOENT;
+	if (ret && (ret != -ENOENT || !valid))
+		goto out;
+
+	mac_vid = mac | ((u64)(vid & ARLTBL_VID_MASK) << ARLTBL_VID_S);
+	if (valid)
+		fwd_entry = (port & ARLTBL_DATA_PORT_ID_MASK) |
+			    ARLTBL_STATIC | ARLTBL_VALID;
+
+	b53_write64(dev, B53_ARLIO_PAGE, B53_ARLTBL_MAC_VID_ENTRY(idx), mac_vid);
+	b53_write32(dev, B53_ARLIO_PAGE, B53_ARLTBL_DATA_ENTRY(idx), fwd_entry);
+
+	ret = b53_arl_rw_op(dev, false);
+
+out:
+	mutex_unlock(&dev->arl_mutex);
+
+	return ret;
+}
+
+static int b53_arl_search_wait(struct b53_device *dev)
+{
+	unsigned int timeout = 1000;
+	u8 reg;
+
+	do {
+		b53_read8(dev, B53_ARLIO_PAGE, B53_ARL_SRCH_CTL, &reg);
+		if (!(reg & ARL_SRCH_STDN))
+			return -ENOENT;
+
+		if (reg & ARL_SRCH_VLID)
+			return 0;
+
+		usleep_range(1000, 2000);
+	} while (timeout--);
+
+	return -ETIMEDOUT;
+}
+
+/*
+ * Dump up to max valid entries with the search engine, which returns the
+ * next B53_ARL_SRCH_RESULTS valid entries per step, rather than issuing a
+ * read operation for each of the B53_ARLTBL_BUCKETS buckets.
+ */
+static int b53_arl_dump(struct b53_device *dev, struct b53_arl_entry *table,
+			int max)
+{
+	int steps = B53_ARLTBL_BINS * B53_ARLTBL_BUCKETS / B53_ARL_SRCH_RESULTS;
+	int i, n = 0, ret = 0;
+
+	mutex_lock(&dev->arl_mutex);
+
+	b53_write8(dev, B53_ARLIO_PAGE, B53_ARL_SRCH_CTL, ARL_SRCH_STDN);
+
+	while (n < max && steps--) {
+		ret = b53_arl_search_wait(dev);
+		if (ret)
+			break;
+
+		for (i = 0; i < B53_ARL_SRCH_RESULTS && n < max; i++) {
+			u64 mac_vid;
+			u32 fwd_entry;
+
+			b53_read64(dev, B53_ARLIO_PAGE,
+				   B53_ARL_SRCH_RSTL_MACVID(i), &mac_vid);
+			b53_read32(dev, B53_ARLIO_PAGE,
+				   B53_ARL_SRCH_RSTL(i), &fwd_entry);
+
+			b53_arl_to_entry(&table[n], mac_vid, fwd_entry);
+			if (table[n].is_valid)
+				n++;
+		}
+	}
+
+	mutex_unlock(&dev->arl_mutex);
+
+	if (ret == -ETIMEDOUT) {
+		pr_warn("time out while searching ARL\n");
+		return ret;
+	}
+
+	return n;
+}
+
 static void b53_enable_ports(struct b53_device *dev)
 {
 	unsigned i;
@@ -989,6 +1192,174 @@ static int b53_global_apply_config(struct switch_dev *dev)
 	return 0;
 }
 
+static int b53_global_get_arl_table(struct switch_dev *sw_dev,
+				    const struct switch_attr *attr,
+				    struct switch_val *val)
+{
+	struct b53_device *dev = sw_to_b53(sw_dev);
+	struct b53_arl_entry *a;
+	char *buf = dev->arl_buf;
+	int i, n, port, len = 0;
+
+	n = b53_arl_dump(dev, dev->arl_table, B53_NUM_ARL_RECORDS);
+	if (n < 0)
+		return n;
+
+	len += scnprintf(buf + len, B53_ARL_BUF_SIZE - len,
+			"address resolution table\n");
+
+	if (n == B53_NUM_ARL_RECORDS)
+		len += scnprintf(buf + len, B53_ARL_BUF_SIZE - len,
+				"Too many entries found, displaying the first %d only!\n",
+				B53_NUM_ARL_RECORDS);
+
+	b53_for_each_port(dev, port) {
+		for (i = 0; i < n; i++) {
+			a = &dev->arl_table[i];
+
+			/* multicast entries carry a port mask */
+			if (is_multicast_ether_addr(a->mac) ?
+			    !(a->port & BIT(port)) : a->port != port)
+				continue;
+
+			len += scnprintf(buf + len, B53_ARL_BUF_SIZE - len,
+					"Port %d: MAC %pM VLAN %u%s\n",
+					port, a->mac, a->vid,
+					a->is_static ? " static" : "");
+		}
+	}
+
+	val->value.s = buf;
+	val->len = len;
+
+	return 0;
+}
+
+/* "<mac> <port> [vid]" for arl_add, "<mac> [vid]" for arl_del */
+static int b53_global_set_arl_entry(struct switch_dev *sw_dev,
+				    const struct switch_attr *attr,
+				    struct switch_val *val)
+{
+	struct b53_device *dev = sw_to_b53(sw_dev);
+	bool add = !strcmp(attr->name, "arl_add");
+	char mac_str[18];
+	u8 mac[ETH_ALEN];
+	int port = 0, vid = 0, n;
+
+	if (add)
+		n = sscanf(val->value.s, "%17s %d %d", mac_str, &port, &vid);
+	else
+		n = sscanf(val->value.s, "%17s %d", mac_str, &vid);
+
+	if (n < (add ? 2 : 1) || !mac_pton(mac_str, mac))
+		return -EINVAL;
+
+	if (is_multicast_ether_addr(mac) || vid < 0 || vid > ARLTBL_VID_MASK)
+		return -EINVAL;
+
+	if (add && !(BIT(port) & dev->enabled_ports))
+		return -EINVAL;
+
+	return b53_arl_write(dev, mac, vid, port, add);
+}
+
+static int b53_global_flush_arl(struct switch_dev *sw_dev,
+				const struct switch_attr *attr,
+				struct switch_val *val)
+{
+	struct b53_device *dev = sw_to_b53(sw_dev);
+	int ret;
+
+	mutex_lock(&dev->arl_mutex);
+	ret = b53_flush_arl(dev);
+	mutex_unlock(&dev->arl_mutex);
+
+	return ret;
+}
+
+static const struct b53_mib_desc *b53_mib_table(struct b53_device *dev)
+{
+	if (is5365(dev))
+		return b53_mibs_65;
+	else if (is63xx(dev))
+		return b53_mibs_63xx;
+	else
+		return b53_mibs;
+}
+
+static u64 b53_mib_read(struct b53_device *dev, int port,
+			const struct b53_mib_desc *mib)
+{
+	u64 val;
+
+	if (mib->size == 8) {
+		b53_read64(dev, B53_MIB_PAGE(port), mib->offset, &val);
+	} else {
+		u32 val32;
+
+		b53_read32(dev, B53_MIB_PAGE(port), mib->offset, &val32);
+		val = val32;
+	}
+
+	return val;
+}
+
+static bool b53_mib_fresh(struct b53_device *dev, u16 valid,
+			  unsigned long stamp, int port)
+{
+	return dev->mib_cache_ms && (valid & BIT(port)) &&
+	       time_before(jiffies, stamp + msecs_to_jiffies(dev->mib_cache_ms));
+}
+
+/* returns the port's counters, read again if the snapshot expired */
+static u64 *b53_mib_snapshot(struct b53_device *dev, int port)
+{
+	const struct b53_mib_desc *mibs = b53_mib_table(dev);
+	u64 *values = &dev->mib_cache[port * dev->num_mibs];
+	int i;
+
+	lockdep_assert_held(&dev->mib_mutex);
+
+	if (b53_mib_fresh(dev, dev->mib_valid, dev->mib_stamp[port], port))
+		return values;
+
+	for (i = 0; mibs[i].size > 0; i++)
+		values[i] = b53_mib_read(dev, port, &mibs[i]);
+
+	dev->mib_stamp[port] = jiffies;
+	dev->mib_valid |= BIT(port);
+
+	return values;
+}
+
+static int b53_global_get_mib_cache_time(struct switch_dev *sw_dev,
+					 const struct switch_attr *attr,
+					 struct switch_val *val)
+{
+	struct b53_device *dev = sw_to_b53(sw_dev);
+
+	val->value.i = dev->mib_cache_ms;
+
+	return 0;
+}
+
+static int b53_global_set_mib_cache_time(struct switch_dev *sw_dev,
+					 const struct switch_attr *attr,
+					 struct switch_val *val)
+{
+	struct b53_device *dev = sw_to_b53(sw_dev);
+
+	if (val->value.i < 0)
+		return -EINVAL;
+
+	mutex_lock(&dev->mib_mutex);
+	dev->mib_cache_ms = val->value.i;
+	dev->mib_valid = 0;
+	dev->stats_valid = 0;
+	mutex_unlock(&dev->mib_mutex);
+
+	return 0;
+}
 
 static int b53_global_reset_mib(struct switch_dev *dev,
 				const struct switch_attr *attr,
@@ -1004,6 +1375,11 @@ static int b53_global_reset_mib(struct switch_dev *dev,
 	b53_write8(priv, B53_MGMT_PAGE, B53_GLOBAL_CONFIG, gc & ~GC_RESET_MIB);
 	mdelay(1);
 
+	mutex_lock(&priv->mib_mutex);
+	priv->mib_valid = 0;
+	priv->stats_valid = 0;
+	mutex_unlock(&priv->mib_mutex);
+
 	return 0;
 }
 
@@ -1012,42 +1388,27 @@ static int b53_port_get_mib(struct switch_dev *sw_dev,
 			    struct switch_val *val)
 {
 	struct b53_device *dev = sw_to_b53(sw_dev);
-	const struct b53_mib_desc *mibs;
+	const struct b53_mib_desc *mibs = b53_mib_table(dev);
 	int port = val->port_vlan;
-	int len = 0;
+	int i, len = 0;
+	u64 *values;
 
 	if (!(BIT(port) & dev->enabled_ports))
 		return -1;
 
-	if (is5365(dev)) {
-		if (port == 5)
-			port = 8;
-
-		mibs = b53_mibs_65;
-	} else if (is63xx(dev)) {
-		mibs = b53_mibs_63xx;
-	} else {
-		mibs = b53_mibs;
-	}
+	if (is5365(dev) && port == 5)
+		port = 8;
 
 	dev->buf[0] = 0;
 
-	for (; mibs->size > 0; mibs++) {
-		u64 val;
-
-		if (mibs->size == 8) {
-			b53_read64(dev, B53_MIB_PAGE(port), mibs->offset, &val);
-		} else {
-			u32 val32;
-
-			b53_read32(dev, B53_MIB_PAGE(port), mibs->offset,
-				   &val32);
-			val = val32;
-		}
+	mutex_lock(&dev->mib_mutex);
 
+	values = b53_mib_snapshot(dev, port);
+	for (i = 0; mibs[i].size > 0; i++)
 		len += snprintf(dev->buf + len, B53_BUF_SIZE - len,
-				"%-20s: %llu\n", mibs->name, val);
-	}
+				"%-20s: %llu\n", mibs[i].name, values[i]);
+
+	mutex_unlock(&dev->mib_mutex);
 
 	val->len = len;
 	val->value.s = dev->buf;
@@ -1059,7 +1420,7 @@ static int b53_port_get_stats(struct switch_dev *sw_dev, int port,
 				struct switch_port_stats *stats)
 {
 	struct b53_device *dev = sw_to_b53(sw_dev);
-	const struct b53_mib_desc *mibs;
+	const struct b53_mib_desc *mibs = b53_mib_table(dev);
 	int txb_id, rxb_id;
 	u64 rxb, txb;
 
@@ -1072,31 +1433,35 @@ static int b53_port_get_stats(struct switch_dev *sw_dev, int port,
 	if (is5365(dev)) {
 		if (port == 5)
 			port = 8;
-
-		mibs = b53_mibs_65;
 	} else if (is63xx(dev)) {
-		mibs = b53_mibs_63xx;
 		txb_id = B63XX_MIB_TXB_ID;
 		rxb_id = B63XX_MIB_RXB_ID;
-	} else {
-		mibs = b53_mibs;
 	}
 
-	dev->buf[0] = 0;
+	mutex_lock(&dev->mib_mutex);
 
-	if (mibs->size == 8) {
-		b53_read64(dev, B53_MIB_PAGE(port), mibs[txb_id].offset, &txb);
-		b53_read64(dev, B53_MIB_PAGE(port), mibs[rxb_id].offset, &rxb);
-	} else {
-		u32 val32;
+	/* polled by LED triggers, so reuse whatever is recent enough */
+	if (b53_mib_fresh(dev, dev->mib_valid, dev->mib_stamp[port], port)) {
+		u64 *values = &dev->mib_cache[port * dev->num_mibs];
 
-		b53_read32(dev, B53_MIB_PAGE(port), mibs[txb_id].offset, &val32);
-		txb = val32;
+		txb = values[txb_id];
+		rxb = values[rxb_id];
+	} else if (b53_mib_fresh(dev, dev->stats_valid, dev->stats_stamp[port],
+				 port)) {
+		txb = dev->stats_cache[port][0];
+		rxb = dev->stats_cache[port][1];
+	} else {
+		txb = b53_mib_read(dev, port, &mibs[txb_id]);
+		rxb = b53_mib_read(dev, port, &mibs[rxb_id]);
 
-		b53_read32(dev, B53_MIB_PAGE(port), mibs[rxb_id].offset, &val32);
-		rxb = val32;
+		dev->stats_cache[port][0] = txb;
+		dev->stats_cache[port][1] = rxb;
+		dev->stats_stamp[port] = jiffies;
+		dev->stats_valid |= BIT(port);
 	}
 
+	mutex_unlock(&dev->mib_mutex);
+
 	stats->tx_bytes = txb;
 	stats->rx_bytes = rxb;
 
@@ -1141,6 +1506,14 @@ static struct switch_attr b53_global_ops_65[] = {
 		.description = "Reset MIB counters",
 		.set = b53_global_reset_mib,
 	},
+	{
+		.type = SWITCH_TYPE_INT,
+		.name = "mib_cache_time",
+		.description = "MIB snapshot lifetime in ms (0 = always read)",
+		.set = b53_global_set_mib_cache_time,
+		.get = b53_global_get_mib_cache_time,
+		.max = 60000,
+	},
 };
 
 static struct switch_attr b53_global_ops[] = {
@@ -1180,6 +1553,38 @@ static struct switch_attr b53_global_ops[] = {
 		.get = b53_global_get_4095_enable,
 		.max = 1,
 	},
+	{
+		.type = SWITCH_TYPE_INT,
+		.name = "mib_cache_time",
+		.description = "MIB snapshot lifetime in ms (0 = always read)",
+		.set = b53_global_set_mib_cache_time,
+		.get = b53_global_get_mib_cache_time,
+		.max = 60000,
+	},
+	{
+		.type = SWITCH_TYPE_STRING,
+		.name = "arl_table",
+		.description = "Get ARL table",
+		.get = b53_global_get_arl_table,
+	},
+	{
+		.type = SWITCH_TYPE_STRING,
+		.name = "arl_add",
+		.description = "Add static ARL entry (<mac> <port> [vid])",
+		.set = b53_global_set_arl_entry,
+	},
+	{
+		.type = SWITCH_TYPE_STRING,
+		.name = "arl_del",
+		.description = "Delete ARL entry (<mac> [vid])",
+		.set = b53_global_set_arl_entry,
+	},
+	{
+		.type = SWITCH_TYPE_NOVAL,
+		.name = "flush_arl_table",
+		.description = "Flush ARL table",
+		.set = b53_global_flush_arl,
+	},
 };
 
 static struct switch_attr b53_port_ops[] = {
@@ -1515,6 +1920,7 @@ static int b53_switch_init_of(struct b53_device *dev)
 static int b53_switch_init(struct b53_device *dev)
 {
 	struct switch_dev *sw_dev = &dev->sw_dev;
+	const struct b53_mib_desc *mibs;
 	unsigned i;
 	int ret;
 
@@ -1600,6 +2006,25 @@ static int b53_switch_init(struct b53_device *dev)
 	if (!dev->buf)
 		return -ENOMEM;
 
+	for (mibs = b53_mib_table(dev); mibs->size > 0; mibs++)
+		dev->num_mibs++;
+
+	dev->mib_cache = devm_kcalloc(dev->dev, B53_N_PORTS * dev->num_mibs,
+				      sizeof(*dev->mib_cache), GFP_KERNEL);
+	if (!dev->mib_cache)
+		return -ENOMEM;
+
+	dev->mib_cache_ms = B53_MIB_CACHE_MS;
+
+	dev->arl_table = devm_kcalloc(dev->dev, B53_NUM_ARL_RECORDS,
+				      sizeof(*dev->arl_table), GFP_KERNEL);
+	if (!dev->arl_table)
+		return -ENOMEM;
+
+	dev->arl_buf = devm_kzalloc(dev->dev, B53_ARL_BUF_SIZE, GFP_KERNEL);
+	if (!dev->arl_buf)
+		return -ENOMEM;
+
 	dev->reset_gpio = b53_switch_get_reset_gpio(dev);
 	if (dev->reset_gpio >= 0) {
 		ret = devm_gpio_request_one(dev->dev, dev->reset_gpio,
@@ -1624,6 +2049,8 @@ struct b53_device *b53_swconfig_switch_alloc(struct device *base, struct b53_io_
 	dev->ops = ops;
 	dev->priv = priv;
 	mutex_init(&dev->reg_mutex);
+	mutex_init(&dev->arl_mutex);
+	mutex_init(&dev->mib_mutex);
 
 	return dev;
 }
@@ -69,6 +69,24 @@ struct b53_port {
 	unsigned int	pvid:12;
 };
 
+struct b53_arl_entry {
+	u8		mac[6];
+	u16		vid;
+	u16		port;
+	unsigned int	is_valid:1;
+	unsigned int	is_age:1;
+	unsigned int	is_static:1;
+};
+
+/* ARL entries shown by the arl_table attribute, bounded by the netlink
+ * message swconfig replies with.
+ */
+#define B53_NUM_ARL_RECORDS	64
+#define B53_ARL_BUF_SIZE	(B53_NUM_ARL_RECORDS * 48 + 256)
+
+/* default lifetime of a port's MIB snapshot */
+#define B53_MIB_CACHE_MS	1000
+
 struct b53_device {
 	struct switch_dev sw_dev;
 	struct b53_platform_data *pdata;
@@ -102,6 +120,25 @@ struct b53_device {
 	struct b53_vlan *vlans;
 
 	char *buf;
+
+	/* serializes multi register ARL table accesses */
+	struct mutex arl_mutex;
+	struct b53_arl_entry *arl_table;
+	char *arl_buf;
+
+	/*
+	 * MIB snapshots: the full counter set per port, and the byte
+	 * counters alone for get_port_stats, each reused for mib_cache_ms
+	 */
+	struct mutex mib_mutex;
+	unsigned int mib_cache_ms;
+	unsigned int num_mibs;
+	u64 *mib_cache;
+	u16 mib_valid;
+	u16 stats_valid;
+	unsigned long mib_stamp[B53_N_PORTS];
+	unsigned long stats_stamp[B53_N_PORTS];
+	u64 stats_cache[B53_N_PORTS][2];
 };
 
 #define b53_for_each_port(dev, i) \
@@ -216,6 +216,49 @@
 #define   VTE_UNTAG_S			9
 #define   VTE_UNTAG			(0x1ff << 9)
 
+/* ARL Table Read/Write Register (8 bit) */
+#define B53_ARLTBL_RW_CTRL		0x00
+#define   ARLTBL_RW			BIT(0)
+#define   ARLTBL_IVL_SVL_SELECT		BIT(6)
+#define   ARLTBL_START_DONE		BIT(7)
+
+/* MAC Address Index Register (48 bit) */
+#define B53_MAC_ADDR_IDX		0x02
+
+/* VLAN ID Index Register (16 bit) */
+#define B53_VLAN_ID_IDX			0x08
+
+/* ARL Table MAC/VID Entry N Registers (64 bit) */
+#define B53_ARLTBL_MAC_VID_ENTRY(n)	(0x10 + 0x10 * (n))
+#define   ARLTBL_MAC_MASK		0xffffffffffffULL
+#define   ARLTBL_VID_S			48
+#define   ARLTBL_VID_MASK		0xfff
+
+/* ARL Table Data Entry N Registers (32 bit) */
+#define B53_ARLTBL_DATA_ENTRY(n)	(0x18 + 0x10 * (n))
+#define   ARLTBL_DATA_PORT_ID_MASK	0x1ff
+#define   ARLTBL_AGE			BIT(14)
+#define   ARLTBL_STATIC			BIT(15)
+#define   ARLTBL_VALID			BIT(16)
+
+/* Bins per ARL bucket, not on BCM5325/BCM5365 */
+#define B53_ARLTBL_BINS			4
+#define B53_ARLTBL_BUCKETS		1024
+
+/* ARL Search Control Register (8 bit) */
+#define B53_ARL_SRCH_CTL		0x50
+#define   ARL_SRCH_VLID			BIT(0)
+#define   ARL_SRCH_STDN			BIT(7)
+
+/* ARL Search MAC/VID Result N Registers (64 bit) */
+#define B53_ARL_SRCH_RSTL_MACVID(n)	(0x60 + 0x10 * (n))
+
+/* ARL Search Data Result N Registers (32 bit) */
+#define B53_ARL_SRCH_RSTL(n)		(0x68 + 0x10 * (n))
+
+/* Search results returned per search step */
+#define B53_ARL_SRCH_RESULTS		2
+
 /*************************************************************************
  * Port VLAN Registers
  *************************************************************************/
@@ -1187,6 +1187,20 @@ unregister_switch(struct switch_dev *dev)
 }
 EXPORT_SYMBOL_GPL(unregister_switch);
 
+/**
+ * switch_port_link_changed - notify swconfig of a port link change
+ * @dev: switch the port belongs to
+ * @port: port whose link changed, or -1 for all ports
+ *
+ * May be called from any context.
+ */
+void
+switch_port_link_changed(struct switch_dev *dev, int port)
+{
+	swconfig_led_link_changed(dev, port);
+}
+EXPORT_SYMBOL_GPL(switch_port_link_changed);
+
 int
 switch_generic_set_link(struct switch_dev *dev, int port,
 			struct switch_port_link *link)
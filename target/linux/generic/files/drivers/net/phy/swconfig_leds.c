@@ -18,6 +18,8 @@
 #include <linux/workqueue.h>
 
 #define SWCONFIG_LED_TIMER_INTERVAL	(HZ / 10)
+/* traffic sampling backs off up to this while the counters are idle */
+#define SWCONFIG_LED_TIMER_MAX		(HZ)
 #define SWCONFIG_LED_NUM_PORTS		32
 
 #define SWCONFIG_LED_PORT_SPEED_NA	0x01	/* unknown speed */
@@ -44,7 +46,14 @@ struct switch_led_trigger {
 
 	struct delayed_work sw_led_work;
 	u32 port_mask;
+	/* ports watched by a LED in tx and/or rx mode */
+	u32 traffic_mask;
 	u32 port_link;
+	/* ports reported by switch_port_link_changed() */
+	atomic_t link_dirty;
+	/* current traffic sampling interval and next sample time */
+	unsigned long interval;
+	unsigned long next_sample;
 	unsigned long long port_tx_traffic[SWCONFIG_LED_NUM_PORTS];
 	unsigned long long port_rx_traffic[SWCONFIG_LED_NUM_PORTS];
 	u8 link_speed[SWCONFIG_LED_NUM_PORTS];
@@ -77,7 +86,7 @@ swconfig_trig_update_port_mask(struct led_trigger *trigger)
 {
 	struct list_head *entry;
 	struct switch_led_trigger *sw_trig;
-	u32 port_mask;
+	u32 port_mask, traffic_mask;
 
 	if (!trigger)
 		return;
@@ -85,6 +94,7 @@ swconfig_trig_update_port_mask(struct led_trigger *trigger)
 	sw_trig = (void *) trigger;
 
 	port_mask = 0;
+	traffic_mask = 0;
 	read_lock(&trigger->leddev_list_lock);
 	list_for_each(entry, &trigger->led_cdevs) {
 		struct led_classdev *led_cdev;
@@ -95,18 +105,25 @@ swconfig_trig_update_port_mask(struct led_trigger *trigger)
 		if (trig_data) {
 			read_lock(&trig_data->lock);
 			port_mask |= trig_data->port_mask;
+			if (trig_data->mode & SWCONFIG_LED_MODE_TXRX)
+				traffic_mask |= trig_data->port_mask;
 			read_unlock(&trig_data->lock);
 		}
 	}
 	read_unlock(&trigger->leddev_list_lock);
 
 	sw_trig->port_mask = port_mask;
-
-	if (port_mask)
-		schedule_delayed_work(&sw_trig->sw_led_work,
-				      SWCONFIG_LED_TIMER_INTERVAL);
-	else
+	sw_trig->traffic_mask = traffic_mask;
+	sw_trig->interval = SWCONFIG_LED_TIMER_INTERVAL;
+	sw_trig->next_sample = jiffies;
+
+	if (port_mask) {
+		/* (re)read the link state of every watched port once */
+		atomic_or(port_mask, &sw_trig->link_dirty);
+		mod_delayed_work(system_wq, &sw_trig->sw_led_work, 0);
+	} else {
 		cancel_delayed_work_sync(&sw_trig->sw_led_work);
+	}
 }
 
 static ssize_t
@@ -235,6 +252,7 @@ static ssize_t swconfig_trig_mode_store(struct device *dev,
 	char copybuf[128];
 	int new_mode = -1;
 	char *p, *token;
+	bool changed;
 
 	/* take a copy since we don't want to trash the inbound buffer when using strsep */
 	strncpy(copybuf, buf, sizeof(copybuf));
@@ -264,9 +282,13 @@ static ssize_t swconfig_trig_mode_store(struct device *dev,
 		return -EINVAL;
 
 	write_lock(&trig_data->lock);
+	changed = (trig_data->mode != new_mode);
 	trig_data->mode = (u8)new_mode;
 	write_unlock(&trig_data->lock);
 
+	if (changed)
+		swconfig_trig_update_port_mask(led_cdev->trigger);
+
 	return size;
 }
 
@@ -428,12 +450,90 @@ swconfig_trig_update_leds(struct switch_led_trigger *sw_trig)
 	read_unlock(&trigger->leddev_list_lock);
 }
 
+static bool
+swconfig_trig_read_link(struct switch_led_trigger *sw_trig, int port)
+{
+	struct switch_dev *swdev = sw_trig->swdev;
+	struct switch_port_link port_link;
+
+	sw_trig->link_speed[port] = 0;
+
+	memset(&port_link, '\0', sizeof(port_link));
+	swdev->ops->get_port_link(swdev, port, &port_link);
+
+	if (!port_link.link)
+		return false;
+
+	switch (port_link.speed) {
+	case SWITCH_PORT_SPEED_UNKNOWN:
+		sw_trig->link_speed[port] = SWCONFIG_LED_PORT_SPEED_NA;
+		break;
+	case SWITCH_PORT_SPEED_10:
+		sw_trig->link_speed[port] = SWCONFIG_LED_PORT_SPEED_10;
+		break;
+	case SWITCH_PORT_SPEED_100:
+		sw_trig->link_speed[port] = SWCONFIG_LED_PORT_SPEED_100;
+		break;
+	case SWITCH_PORT_SPEED_1000:
+		sw_trig->link_speed[port] = SWCONFIG_LED_PORT_SPEED_1000;
+		break;
+	default:
+		break;
+	}
+
+	return true;
+}
+
+/*
+ * Refresh the counter snapshot shared by all LEDs of the switch, returns
+ * true if any port moved traffic since the previous sample.
+ */
+static bool
+swconfig_trig_read_stats(struct switch_led_trigger *sw_trig, u32 port_mask)
+{
+	struct switch_dev *swdev = sw_trig->swdev;
+	bool changed = false;
+	int i;
+
+	if (!swdev->ops->get_port_stats)
+		return false;
+
+	for (i = 0; i < SWCONFIG_LED_NUM_PORTS; i++) {
+		struct switch_port_stats port_stats;
+
+		if (!(port_mask & BIT(i)))
+			continue;
+
+		memset(&port_stats, '\0', sizeof(port_stats));
+		swdev->ops->get_port_stats(swdev, i, &port_stats);
+
+		if (port_stats.tx_bytes != sw_trig->port_tx_traffic[i] ||
+		    port_stats.rx_bytes != sw_trig->port_rx_traffic[i])
+			changed = true;
+
+		sw_trig->port_tx_traffic[i] = port_stats.tx_bytes;
+		sw_trig->port_rx_traffic[i] = port_stats.rx_bytes;
+	}
+
+	return changed;
+}
+
+/*
+ * Switches that report link changes through switch_port_link_changed()
+ * only get their link state read for the ports that changed, the others
+ * are polled every SWCONFIG_LED_TIMER_INTERVAL. Traffic counters are
+ * only sampled for linked ports watched by a tx/rx LED, at an interval
+ * that backs off while they do not move. With link events and no such
+ * port the work is not rescheduled at all.
+ */
 static void
 swconfig_led_work_func(struct work_struct *work)
 {
 	struct switch_led_trigger *sw_trig;
 	struct switch_dev *swdev;
-	u32 port_mask;
+	unsigned long delay;
+	u32 port_mask, traffic_mask;
+	u32 dirty;
 	u32 link;
 	int i;
 
@@ -443,61 +543,59 @@ swconfig_led_work_func(struct work_struct *work)
 	port_mask = sw_trig->port_mask;
 	swdev = sw_trig->swdev;
 
-	link = 0;
-	for (i = 0; i < SWCONFIG_LED_NUM_PORTS; i++) {
-		u32 port_bit;
-
-		sw_trig->link_speed[i] = 0;
+	if (swdev->link_events)
+		dirty = atomic_xchg(&sw_trig->link_dirty, 0) & port_mask;
+	else
+		dirty = port_mask;
 
-		port_bit = BIT(i);
-		if ((port_mask & port_bit) == 0)
+	link = sw_trig->port_link & port_mask & ~dirty;
+	for (i = 0; i < SWCONFIG_LED_NUM_PORTS; i++) {
+		if (!(dirty & BIT(i)))
 			continue;
 
-		if (swdev->ops->get_port_link) {
-			struct switch_port_link port_link;
-
-			memset(&port_link, '\0', sizeof(port_link));
-			swdev->ops->get_port_link(swdev, i, &port_link);
-
-			if (port_link.link) {
-				link |= port_bit;
-				switch (port_link.speed) {
-				case SWITCH_PORT_SPEED_UNKNOWN:
-					sw_trig->link_speed[i] =
-						SWCONFIG_LED_PORT_SPEED_NA;
-					break;
-				case SWITCH_PORT_SPEED_10:
-					sw_trig->link_speed[i] =
-						SWCONFIG_LED_PORT_SPEED_10;
-					break;
-				case SWITCH_PORT_SPEED_100:
-					sw_trig->link_speed[i] =
-						SWCONFIG_LED_PORT_SPEED_100;
-					break;
-				case SWITCH_PORT_SPEED_1000:
-					sw_trig->link_speed[i] =
-						SWCONFIG_LED_PORT_SPEED_1000;
-					break;
-				}
-			}
-		}
-
-		if (swdev->ops->get_port_stats) {
-			struct switch_port_stats port_stats;
-
-			memset(&port_stats, '\0', sizeof(port_stats));
-			swdev->ops->get_port_stats(swdev, i, &port_stats);
-			sw_trig->port_tx_traffic[i] = port_stats.tx_bytes;
-			sw_trig->port_rx_traffic[i] = port_stats.rx_bytes;
-		}
+		if (swconfig_trig_read_link(sw_trig, i))
+			link |= BIT(i);
 	}
 
 	sw_trig->port_link = link;
 
+	traffic_mask = sw_trig->traffic_mask & link;
+	if (traffic_mask && time_after_eq(jiffies, sw_trig->next_sample)) {
+		if (swconfig_trig_read_stats(sw_trig, traffic_mask))
+			sw_trig->interval = SWCONFIG_LED_TIMER_INTERVAL;
+		else
+			sw_trig->interval = min_t(unsigned long,
+						  sw_trig->interval * 2,
+						  SWCONFIG_LED_TIMER_MAX);
+		sw_trig->next_sample = jiffies + sw_trig->interval;
+	}
+
 	swconfig_trig_update_leds(sw_trig);
 
-	schedule_delayed_work(&sw_trig->sw_led_work,
-			      SWCONFIG_LED_TIMER_INTERVAL);
+	if (!swdev->link_events)
+		delay = SWCONFIG_LED_TIMER_INTERVAL;
+	else if (traffic_mask && time_after(sw_trig->next_sample, jiffies))
+		delay = sw_trig->next_sample - jiffies;
+	else if (traffic_mask)
+		delay = 0;
+	else
+		return;
+
+	schedule_delayed_work(&sw_trig->sw_led_work, delay);
+}
+
+static void
+swconfig_led_link_changed(struct switch_dev *swdev, int port)
+{
+	struct switch_led_trigger *sw_trig = swdev->led_trigger;
+
+	if (!sw_trig)
+		return;
+
+	atomic_or(port < 0 ? ~0 : BIT(port), &sw_trig->link_dirty);
+
+	if (sw_trig->port_mask)
+		mod_delayed_work(system_wq, &sw_trig->sw_led_work, 0);
 }
 
 static int
@@ -540,6 +638,7 @@ swconfig_destroy_led_trigger(struct switch_dev *swdev)
 
 	sw_trig = swdev->led_trigger;
 	if (sw_trig) {
+		swdev->led_trigger = NULL;
 		cancel_delayed_work_sync(&sw_trig->sw_led_work);
 		led_trigger_unregister(&sw_trig->trig);
 		kfree(sw_trig);
@@ -552,4 +651,7 @@ swconfig_create_led_trigger(struct switch_dev *swdev) { return 0; }
 
 static inline void
 swconfig_destroy_led_trigger(struct switch_dev *swdev) { }
+
+static inline void
+swconfig_led_link_changed(struct switch_dev *swdev, int port) { }
 #endif /* CONFIG_SWCONFIG_LEDS */
@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Cached layout index of uImage.FIT metadata, shared by the FIT block
+ * partition parser and the mtdsplit FIT firmware parser.
+ */
+#ifndef _LINUX_FIT_INDEX_H
+#define _LINUX_FIT_INDEX_H
+
+#include <linux/kobject.h>
+#include <linux/list.h>
+#include <linux/types.h>
+
+#define FIT_INDEX_NAMELEN	64
+#define FIT_INDEX_TYPELEN	32
+
+/* sub-image is listed in the loadables of the selected configuration */
+#define FIT_INDEX_LOADABLE	BIT(0)
+/* sub-image is the first loadable, i.e. the root filesystem candidate */
+#define FIT_INDEX_ROOTFS	BIT(1)
+/* sub-image data is embedded in the FDT structure */
+#define FIT_INDEX_EMBEDDED	BIT(2)
+
+struct fit_index_image {
+	char name[FIT_INDEX_NAMELEN];
+	char type[FIT_INDEX_TYPELEN];
+	u32 pos;
+	u32 len;
+	unsigned int flags;
+};
+
+struct fit_index {
+	struct kobject kobj;
+	struct list_head list;
+	char source[FIT_INDEX_NAMELEN];
+	char conf[FIT_INDEX_NAMELEN];
+	int conf_err;
+	u32 hash;
+	u64 offset;
+	u64 size;
+	u32 totalsize;
+	u32 data_end;
+	unsigned int nr_images;
+	struct fit_index_image images[];
+};
+
+ssize_t fit_index_meta_size(const void *fit);
+struct fit_index *fit_index_get(const char *source, u64 offset, u64 size,
+				const void *fit, size_t len, const char *conf);
+void fit_index_put(struct fit_index *idx);
+
+#endif /* _LINUX_FIT_INDEX_H */
@@ -28,6 +28,7 @@ struct switch_led_trigger;
 
 int register_switch(struct switch_dev *dev, struct net_device *netdev);
 void unregister_switch(struct switch_dev *dev);
+void switch_port_link_changed(struct switch_dev *dev, int port);
 
 /**
  * struct switch_attrlist - attribute list
@@ -122,6 +123,10 @@ struct switch_dev {
 	unsigned int vlans;
 	unsigned int cpu_port;
 
+	/* set if the driver calls switch_port_link_changed() on every port
+	 * link change, LED triggers then stop polling the link state */
+	bool link_events;
+
 	/* the following fields are internal for swconfig */
 	unsigned int id;
 	struct list_head dev_list;
@@ -0,0 +1,365 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *  lib/fit_index.c
+ *  Cached layout index of uImage.FIT metadata
+ *
+ *  Walking the FIT device tree for every partition rescan is wasteful on
+ *  boards with large multi-configuration images. The index only needs the
+ *  FDT header, structure and strings blocks, records the position of every
+ *  sub-image once and keeps the result keyed by a CRC32 of those blocks and
+ *  the selected configuration, together with the offset of the image and
+ *  the size of the space it was found in. Cached entries are exported
+ *  read-only below /sys/kernel/fit/<hash>-<offset>/.
+ */
+
+#define pr_fmt(fmt) fmt
+
+#include <linux/crc32.h>
+#include <linux/err.h>
+#include <linux/fit_index.h>
+#include <linux/kernel.h>
+#include <linux/libfdt.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/sysfs.h>
+
+#define FIT_IMAGES_PATH		"/images"
+#define FIT_CONFS_PATH		"/configurations"
+
+#define FIT_DATA_PROP		"data"
+#define FIT_DATA_POSITION_PROP	"data-position"
+#define FIT_DATA_OFFSET_PROP	"data-offset"
+#define FIT_DATA_SIZE_PROP	"data-size"
+#define FIT_DESC_PROP		"description"
+#define FIT_TYPE_PROP		"type"
+#define FIT_LOADABLE_PROP	"loadables"
+#define FIT_DEFAULT_PROP	"default"
+
+#define FIT_INDEX_MAX_ENTRIES	8
+
+static LIST_HEAD(fit_index_list);
+static DEFINE_MUTEX(fit_index_lock);
+static unsigned int fit_index_count;
+static struct kset *fit_index_kset;
+
+#define to_fit_index(k)	container_of(k, struct fit_index, kobj)
+
+static ssize_t source_show(struct kobject *kobj, struct kobj_attribute *attr,
+			   char *buf)
+{
+	return sysfs_emit(buf, "%s\n", to_fit_index(kobj)->source);
+}
+
+static ssize_t configuration_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%s\n", to_fit_index(kobj)->conf);
+}
+
+static ssize_t data_end_show(struct kobject *kobj, struct kobj_attribute *attr,
+			     char *buf)
+{
+	return sysfs_emit(buf, "0x%08x\n", to_fit_index(kobj)->data_end);
+}
+
+static ssize_t images_show(struct kobject *kobj, struct kobj_attribute *attr,
+			   char *buf)
+{
+	struct fit_index *idx = to_fit_index(kobj);
+	const struct fit_index_image *img;
+	unsigned int i;
+	int len = 0;
+
+	for (i = 0; i < idx->nr_images; i++) {
+		img = &idx->images[i];
+		len += sysfs_emit_at(buf, len, "%s %s 0x%08x 0x%08x%s%s%s\n",
+				     img->name, img->type, img->pos, img->len,
+				     (img->flags & FIT_INDEX_LOADABLE) ? " loadable" : "",
+				     (img->flags & FIT_INDEX_ROOTFS) ? " rootfs" : "",
+				     (img->flags & FIT_INDEX_EMBEDDED) ? " embedded" : "");
+	}
+
+	return len;
+}
+
+static struct kobj_attribute fit_index_attr_source = __ATTR_RO(source);
+static struct kobj_attribute fit_index_attr_configuration = __ATTR_RO(configuration);
+static struct kobj_attribute fit_index_attr_data_end = __ATTR_RO(data_end);
+static struct kobj_attribute fit_index_attr_images = __ATTR_RO(images);
+
+static struct attribute *fit_index_attrs[] = {
+	&fit_index_attr_source.attr,
+	&fit_index_attr_configuration.attr,
+	&fit_index_attr_data_end.attr,
+	&fit_index_attr_images.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(fit_index);
+
+static void fit_index_release(struct kobject *kobj)
+{
+	kfree(to_fit_index(kobj));
+}
+
+static struct kobj_type fit_index_ktype = {
+	.release = fit_index_release,
+	.sysfs_ops = &kobj_sysfs_ops,
+	.default_groups = fit_index_groups,
+};
+
+/**
+ * fit_index_meta_size - number of bytes needed to index a FIT image
+ * @fit: FDT header of the FIT image, at least sizeof(struct fdt_header)
+ *
+ * Returns the length of the header, structure and strings blocks, which
+ * is all the index looks at, or a negative error if @fit does not start
+ * with an FDT header. Padding after the strings block is not included.
+ */
+ssize_t fit_index_meta_size(const void *fit)
+{
+	u32 totalsize, end_struct, end_strings;
+
+	if (fdt_magic(fit) != FDT_MAGIC)
+		return -EINVAL;
+
+	totalsize = fdt_totalsize(fit);
+	if (fdt_version(fit) < 17)
+		return totalsize;
+
+	end_struct = fdt_off_dt_struct(fit) + fdt_size_dt_struct(fit);
+	end_strings = fdt_off_dt_strings(fit) + fdt_size_dt_strings(fit);
+	if (end_struct < fdt_off_dt_struct(fit) ||
+	    end_strings < fdt_off_dt_strings(fit))
+		return -EINVAL;
+
+	return min(totalsize, max(end_struct, end_strings));
+}
+EXPORT_SYMBOL_GPL(fit_index_meta_size);
+
+static u32 fit_index_hash(const void *fit, size_t len, const char *conf)
+{
+	u32 hash;
+
+	hash = crc32_le(~0, fit, len);
+	if (conf)
+		hash = crc32_le(hash, conf, strlen(conf));
+
+	return hash;
+}
+
+static bool fit_index_is_loadable(const char *name, const char *loadables,
+				  int loadables_len)
+{
+	int len;
+
+	while (loadables_len > 1) {
+		len = strnlen(loadables, loadables_len - 1) + 1;
+		loadables_len -= len;
+		if (!strncmp(name, loadables, len))
+			return true;
+		loadables += len;
+	}
+
+	return false;
+}
+
+static struct fit_index *fit_index_build(const void *fit, u32 hash,
+					 u64 offset, u64 size, const char *conf)
+{
+	const char *name, *type, *desc, *loadables = NULL;
+	const char *conf_desc = NULL, *conf_name = conf;
+	const fdt32_t *pos_be, *offset_be, *len_be;
+	struct fit_index_image *img;
+	struct fit_index *idx;
+	int images, confs, node, len, loadables_len = 0;
+	unsigned int count = 0;
+	const void *data;
+	u32 base;
+
+	images = fdt_path_offset(fit, FIT_IMAGES_PATH);
+	if (images < 0) {
+		pr_err("FIT: Cannot find %s node: %d\n", FIT_IMAGES_PATH, images);
+		return ERR_PTR(-EINVAL);
+	}
+
+	fdt_for_each_subnode(node, fit, images)
+		count++;
+
+	idx = kzalloc(struct_size(idx, images, count), GFP_KERNEL);
+	if (!idx)
+		return ERR_PTR(-ENOMEM);
+
+	kobject_init(&idx->kobj, &fit_index_ktype);
+	INIT_LIST_HEAD(&idx->list);
+	idx->hash = hash;
+	idx->offset = offset;
+	idx->size = size;
+	idx->totalsize = fdt_totalsize(fit);
+
+	idx->conf_err = -ENOENT;
+	confs = fdt_path_offset(fit, FIT_CONFS_PATH);
+	if (confs >= 0 && !conf_name)
+		conf_name = fdt_getprop(fit, confs, FIT_DEFAULT_PROP, NULL);
+	if (confs >= 0 && conf_name) {
+		node = fdt_subnode_offset(fit, confs, conf_name);
+		if (node >= 0) {
+			conf_desc = fdt_getprop(fit, node, FIT_DESC_PROP, NULL);
+			loadables = fdt_getprop(fit, node, FIT_LOADABLE_PROP,
+						&loadables_len);
+			idx->conf_err = (loadables && loadables_len) ? 0 : -ENODATA;
+		}
+	}
+	strscpy(idx->conf, conf_name ?: "", sizeof(idx->conf));
+
+	if (!idx->conf_err)
+		printk(KERN_DEBUG "FIT: %s configuration: \"%s\"%s%s%s\n",
+			conf ? "Selected" : "Default", idx->conf,
+			conf_desc ? " (" : "", conf_desc ?: "", conf_desc ? ")" : "");
+
+	/* external data offsets are relative to the 4-byte aligned FDT end */
+	base = ALIGN(idx->totalsize, 4);
+
+	fdt_for_each_subnode(node, fit, images) {
+		name = fdt_get_name(fit, node, NULL);
+		type = fdt_getprop(fit, node, FIT_TYPE_PROP, NULL);
+		if (!name || !type)
+			continue;
+
+		img = &idx->images[idx->nr_images];
+		pos_be = fdt_getprop(fit, node, FIT_DATA_POSITION_PROP, NULL);
+		offset_be = fdt_getprop(fit, node, FIT_DATA_OFFSET_PROP, NULL);
+		len_be = fdt_getprop(fit, node, FIT_DATA_SIZE_PROP, NULL);
+
+		if (len_be && (pos_be || offset_be)) {
+			img->pos = pos_be ? be32_to_cpup(pos_be) :
+					    be32_to_cpup(offset_be) + base;
+			img->len = be32_to_cpup(len_be);
+		} else {
+			data = fdt_getprop(fit, node, FIT_DATA_PROP, &len);
+			if (!data)
+				continue;
+
+			img->pos = data - fit;
+			img->len = len;
+			img->flags |= FIT_INDEX_EMBEDDED;
+		}
+
+		if (!img->len)
+			continue;
+
+		strscpy(img->name, name, sizeof(img->name));
+		strscpy(img->type, type, sizeof(img->type));
+
+		if (loadables &&
+		    fit_index_is_loadable(name, loadables, loadables_len)) {
+			img->flags |= FIT_INDEX_LOADABLE;
+			if (!strcmp(name, loadables))
+				img->flags |= FIT_INDEX_ROOTFS;
+		}
+
+		idx->data_end = max(idx->data_end, img->pos + img->len);
+		idx->nr_images++;
+
+		desc = fdt_getprop(fit, node, FIT_DESC_PROP, NULL);
+		printk(KERN_DEBUG "FIT: %16s sub-image 0x%08x..0x%08x \"%s\" %s%s%s\n",
+			img->type, img->pos, img->pos + img->len - 1, img->name,
+			desc ? "(" : "", desc ?: "", desc ? ") " : "");
+	}
+
+	return idx;
+}
+
+static void fit_index_evict(struct fit_index *idx)
+{
+	list_del_init(&idx->list);
+	fit_index_count--;
+	kobject_del(&idx->kobj);
+	kobject_put(&idx->kobj);
+}
+
+static void fit_index_insert(struct fit_index *idx, const char *source)
+{
+	struct fit_index *old, *tmp;
+
+	strscpy(idx->source, source, sizeof(idx->source));
+
+	/* a rescan of a rewritten image supersedes the stale entry */
+	list_for_each_entry_safe(old, tmp, &fit_index_list, list)
+		if (!strcmp(old->source, idx->source))
+			fit_index_evict(old);
+
+	if (fit_index_count >= FIT_INDEX_MAX_ENTRIES)
+		fit_index_evict(list_last_entry(&fit_index_list,
+						struct fit_index, list));
+
+	list_add(&idx->list, &fit_index_list);
+	fit_index_count++;
+
+	if (!fit_index_kset)
+		fit_index_kset = kset_create_and_add("fit", NULL, kernel_kobj);
+	if (!fit_index_kset)
+		return;
+
+	idx->kobj.kset = fit_index_kset;
+	if (kobject_add(&idx->kobj, NULL, "%08x-%llx", idx->hash, idx->offset))
+		pr_warn("FIT: cannot export index %08x of %s\n",
+			idx->hash, idx->source);
+}
+
+/**
+ * fit_index_get - look up or build the layout index of a FIT image
+ * @source: name of the device the image was read from
+ * @offset: position of the image on @source
+ * @size: space available for the image at @offset
+ * @fit: FIT image, at least fit_index_meta_size() bytes of it
+ * @len: number of valid bytes at @fit
+ * @conf: configuration to resolve loadables for, NULL for the default
+ *
+ * Returns a referenced index which must be released with fit_index_put(),
+ * or an ERR_PTR() if @fit is not a usable FIT image.
+ */
+struct fit_index *fit_index_get(const char *source, u64 offset, u64 size,
+				const void *fit, size_t len, const char *conf)
+{
+	struct fit_index *idx;
+	ssize_t meta_size;
+	u32 hash;
+
+	meta_size = fit_index_meta_size(fit);
+	if (meta_size < 0)
+		return ERR_PTR(meta_size);
+
+	if (len < meta_size || fdt_check_header(fit))
+		return ERR_PTR(-EINVAL);
+
+	hash = fit_index_hash(fit, meta_size, conf);
+
+	mutex_lock(&fit_index_lock);
+	list_for_each_entry(idx, &fit_index_list, list) {
+		if (idx->hash == hash && idx->offset == offset &&
+		    idx->size == size && idx->totalsize == fdt_totalsize(fit)) {
+			list_move(&idx->list, &fit_index_list);
+			kobject_get(&idx->kobj);
+			goto out;
+		}
+	}
+
+	idx = fit_index_build(fit, hash, offset, size, conf);
+	if (IS_ERR(idx))
+		goto out;
+
+	fit_index_insert(idx, source);
+	kobject_get(&idx->kobj);
+out:
+	mutex_unlock(&fit_index_lock);
+
+	return idx;
+}
+EXPORT_SYMBOL_GPL(fit_index_get);
+
+void fit_index_put(struct fit_index *idx)
+{
+	kobject_put(&idx->kobj);
+}
+EXPORT_SYMBOL_GPL(fit_index_put);
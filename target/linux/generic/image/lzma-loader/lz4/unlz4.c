@@ -0,0 +1,138 @@
+/*
+ * LZ4 legacy format decoder for the kernel loader
+ *
+ * Decodes the output of "lz4 -l", the format the kernel itself uses for
+ * LZ4 compressed images: a magic number followed by independent blocks,
+ * each prefixed with its compressed size. Decompression needs no
+ * workspace and runs straight from the (possibly uncached) input.
+ * Nothing is written past out + out_max, so a corrupt image cannot run
+ * over whatever follows the kernel load address.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ */
+
+#include "unlz4.h"
+
+#define LZ4_MIN_MATCH		4
+
+static __inline__ unsigned long get_le32(const unsigned char *p)
+{
+	return ((unsigned long) p[0] +
+		((unsigned long) p[1] << 8) +
+		((unsigned long) p[2] << 16) +
+		((unsigned long) p[3] << 24));
+}
+
+static int lz4_get_len(const unsigned char **ip, const unsigned char *iend,
+		       unsigned long *len)
+{
+	unsigned char b;
+
+	do {
+		if (*ip >= iend)
+			return -1;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+
+	return 0;
+}
+
+static int lz4_decode_block(const unsigned char *ip, unsigned long size,
+			    unsigned char **outp, unsigned char *oend)
+{
+	const unsigned char *iend = ip + size;
+	unsigned char *ostart = *outp;
+	unsigned char *op = ostart;
+
+	for (;;) {
+		const unsigned char *match;
+		unsigned long offset;
+		unsigned long len;
+		unsigned char token;
+
+		if (ip >= iend)
+			return -1;
+		token = *ip++;
+
+		/* literals */
+		len = token >> 4;
+		if (len == 15 && lz4_get_len(&ip, iend, &len))
+			return -1;
+		if (len > (unsigned long) (iend - ip) ||
+		    len > (unsigned long) (oend - op))
+			return -1;
+		while (len--)
+			*op++ = *ip++;
+
+		/* the last sequence of a block has no match part */
+		if (ip == iend)
+			break;
+
+		/* match */
+		if (iend - ip < 2)
+			return -1;
+		offset = ip[0] + (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (unsigned long) (op - ostart))
+			return -1;
+
+		len = token & 15;
+		if (len == 15 && lz4_get_len(&ip, iend, &len))
+			return -1;
+		len += LZ4_MIN_MATCH;
+		if (len > (unsigned long) (oend - op))
+			return -1;
+
+		/* may overlap the output, copy byte by byte */
+		match = op - offset;
+		while (len--)
+			*op++ = *match++;
+	}
+
+	*outp = op;
+
+	return 0;
+}
+
+int unlz4_probe(const unsigned char *in, unsigned long in_size)
+{
+	return in_size >= 4 && get_le32(in) == LZ4_LEGACY_MAGIC;
+}
+
+int unlz4(const unsigned char *in, unsigned long in_size,
+	  unsigned char *out, unsigned long out_max, unsigned long *out_size)
+{
+	const unsigned char *iend = in + in_size;
+	unsigned char *oend = out + out_max;
+	unsigned char *op = out;
+
+	if (!unlz4_probe(in, in_size))
+		return -1;
+	in += 4;
+
+	while (iend - in >= 4) {
+		unsigned long chunk = get_le32(in);
+
+		in += 4;
+
+		/* concatenated streams repeat the magic */
+		if (chunk == LZ4_LEGACY_MAGIC)
+			continue;
+
+		if (chunk > (unsigned long) (iend - in))
+			return -1;
+
+		if (lz4_decode_block(in, chunk, &op, oend))
+			return -1;
+
+		in += chunk;
+	}
+
+	*out_size = op - out;
+
+	return 0;
+}
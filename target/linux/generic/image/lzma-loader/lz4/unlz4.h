@@ -0,0 +1,19 @@
+/*
+ * LZ4 legacy format decoder for the kernel loader
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ */
+
+#ifndef __UNLZ4_H
+#define __UNLZ4_H
+
+#define LZ4_LEGACY_MAGIC	0x184c2102
+
+int unlz4_probe(const unsigned char *in, unsigned long in_size);
+int unlz4(const unsigned char *in, unsigned long in_size,
+	  unsigned char *out, unsigned long out_max, unsigned long *out_size);
+
+#endif /* __UNLZ4_H */
@@ -80,20 +80,12 @@ static __inline__ void blast_dcache(unsigned long size, unsigned long lsize)
 
 unsigned char *data;
 
-static int read_byte(void *object, unsigned char **buffer, UInt32 *bufferSize)
-{
-	*bufferSize = 1;
-	*buffer = data;
-	++data;
-	return LZMA_RESULT_OK;
-}
-
+/* The payload sits in RAM next to us, so the decoder is handed the whole
+ * stream at once instead of pulling it through a per-byte callback.
+ */
 static __inline__ unsigned char get_byte(void)
 {
-	unsigned char *buffer;
-	UInt32 fake;
-	
-	return read_byte(0, &buffer, &fake), *buffer;
+	return *data++;
 }
 
 /* This puts lzma workspace 128k below RAM end. 
@@ -109,6 +101,7 @@ void entry(unsigned long icache_size, unsigned long icache_lsize,
 {
 	unsigned int i;  /* temp value */
 	unsigned int osize; /* uncompressed size */
+	SizeT isize, iprocessed;
 	volatile unsigned int arg0, arg1, arg2, arg3;
 
 	/* restore argument registers */
@@ -117,9 +110,7 @@ void entry(unsigned long icache_size, unsigned long icache_lsize,
 	__asm__ __volatile__ ("ori %0, $14, 0":"=r"(arg2));
 	__asm__ __volatile__ ("ori %0, $15, 0":"=r"(arg3));
 
-	ILzmaInCallback callback;
 	CLzmaDecoderState vs;
-	callback.Read = read_byte;
 
 	data = lzma_start;
 
@@ -145,7 +136,8 @@ void entry(unsigned long icache_size, unsigned long icache_lsize,
 		get_byte();
 
 	/* decompress kernel */
-	if ((i = LzmaDecode(&vs, &callback,
+	isize = (SizeT)(lzma_end - (char *)data);
+	if ((i = LzmaDecode(&vs, data, isize, &iprocessed,
 	(unsigned char*)KERNEL_ENTRY, osize, &osize)) == LZMA_RESULT_OK)
 	{
 		blast_dcache(dcache_size, dcache_lsize);
@@ -26,6 +26,7 @@
 #include "cache.h"
 #include "printf.h"
 #include "LzmaDecode.h"
+#include "unlz4.h"
 
 
 #define KSEG0			0x80000000
@@ -80,6 +81,15 @@ static const char *const kernel_argv[] = {
 };
 #endif /* CONFIG_KERNEL_CMDLINE */
 
+static __inline__ unsigned long read_c0_count(void)
+{
+	unsigned long count;
+
+	__asm__ __volatile__("mfc0 %0, $9" : "=r" (count));
+
+	return count;
+}
+
 static void halt(void)
 {
 	printf("\nSystem halted!\n");
@@ -156,6 +166,21 @@ static int lzma_decompress(unsigned char *outStream)
 	return ret;
 }
 
+static int lz4_decompress(unsigned char *outStream)
+{
+	extern unsigned char _code_start[];
+	unsigned long limit = 0;
+
+	/* the kernel must not run into the loader, which is linked above it */
+	if (outStream < _code_start)
+		limit = _code_start - outStream;
+
+	if (unlz4(lzma_data, lzma_datasize, outStream, limit, &lzma_outsize))
+		return LZMA_RESULT_DATA_ERROR;
+
+	return LZMA_RESULT_OK;
+}
+
 #if (LZMA_WRAPPER)
 static void lzma_init_data(void)
 {
@@ -218,8 +243,13 @@ void loader_main(unsigned long reg_a0, unsigned long reg_a1,
 {
 	void (*kernel_entry) (unsigned long, unsigned long, unsigned long,
 			      unsigned long);
+	unsigned long t_start, t_decomp;
+	unsigned long insize;
+	const char *format;
 	int res;
 
+	t_start = read_c0_count();
+
 	board_init();
 
 	printf("\n\nOpenWrt kernel loader for MIPS based SoC\n");
@@ -227,15 +257,32 @@ void loader_main(unsigned long reg_a0, unsigned long reg_a1,
 
 	lzma_init_data();
 
-	res = lzma_init_props();
-	if (res != LZMA_RESULT_OK) {
-		printf("Incorrect LZMA stream properties!\n");
-		halt();
-	}
+	insize = lzma_datasize;
+
+	if (unlz4_probe(lzma_data, lzma_datasize)) {
+		format = "LZ4";
+
+		printf("Decompressing LZ4 kernel... ");
+
+		t_decomp = read_c0_count();
+		res = lz4_decompress((unsigned char *) kernel_la);
+		t_decomp = read_c0_count() - t_decomp;
+	} else {
+		format = "LZMA";
+
+		res = lzma_init_props();
+		if (res != LZMA_RESULT_OK) {
+			printf("Incorrect LZMA stream properties!\n");
+			halt();
+		}
 
-	printf("Decompressing kernel... ");
+		printf("Decompressing kernel... ");
+
+		t_decomp = read_c0_count();
+		res = lzma_decompress((unsigned char *) kernel_la);
+		t_decomp = read_c0_count() - t_decomp;
+	}
 
-	res = lzma_decompress((unsigned char *) kernel_la);
 	if (res != LZMA_RESULT_OK) {
 		printf("failed, ");
 		switch (res) {
@@ -252,6 +299,11 @@ void loader_main(unsigned long reg_a0, unsigned long reg_a1,
 
 	flush_cache(kernel_la, lzma_outsize);
 
+	/* CP0 count ticks at half the pipeline clock on most cores */
+	printf("%s %u -> %u bytes, decompression took %u ticks, "
+	       "loader %u ticks\n", format, insize, lzma_outsize, t_decomp,
+	       read_c0_count() - t_start);
+
 	printf("Starting kernel at %08x...\n\n", kernel_la);
 
 #ifdef CONFIG_KERNEL_CMDLINE
@@ -30,6 +30,7 @@
 #include <rtl8367c_asicdrv_svlan.h>
 #include <rtl8367c_asicdrv_cputag.h>
 #include <rtl8367c_asicdrv_mib.h>
+#include <rtl8367c_asicdrv_table.h>
 
 CONST_T rtk_uint8 filter_templateField[RTL8367C_ACLTEMPLATENO][RTL8367C_ACLRULEFIELDNO] = {
     {ACL_DMAC0,             ACL_DMAC1,          ACL_DMAC2,          ACL_SMAC0,          ACL_SMAC1,          ACL_SMAC2,          ACL_ETHERTYPE,      ACL_FIELD_SELECT15},
@@ -1134,7 +1135,13 @@ rtk_api_ret_t rtk_filter_igrAcl_cfg_delAll(void)
             return ret;
     }
 
-    return rtl8367c_setAsicRegBit(RTL8367C_REG_ACL_RESET_CFG, RTL8367C_ACL_RESET_CFG_OFFSET, TRUE);;
+    if((ret = rtl8367c_setAsicRegBit(RTL8367C_REG_ACL_RESET_CFG, RTL8367C_ACL_RESET_CFG_OFFSET, TRUE)) != RT_ERR_OK)
+        return ret;
+
+    /* The reset clears the action table behind the cache's back */
+    rtl8367c_clearAsicTableCache(TB_TARGET_ACLACT);
+
+    return RT_ERR_OK;
 }
 
 /* Function Name:
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2013 Realtek Semiconductor Corp.
+ * All Rights Reserved.
+ *
+ * Unless you and Realtek execute a separate written software license
+ * agreement governing use of this software, this software is licensed
+ * to you under the terms of the GNU General Public License version 2,
+ * available at https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ *
+ * Purpose : RTL8367C switch high-level API for RTL8367C
+ * Feature : Indirect table access engine
+ *
+ */
+
+#ifndef _RTL8367C_ASICDRV_TABLE_H_
+#define _RTL8367C_ASICDRV_TABLE_H_
+
+/****************************************************************/
+/* Header File inclusion                                        */
+/****************************************************************/
+#include <rtl8367c_asicdrv.h>
+
+/****************************************************************/
+/* Constant Definition                                          */
+/****************************************************************/
+#define RTL8367C_TABLE_WRDATA_LEN       (10)
+#define RTL8367C_TABLE_ENTRY_MAXLEN     RTL8367C_TABLE_WRDATA_LEN
+#define RTL8367C_TABLE_STAGE_MAX        (64)
+#define RTL8367C_TABLE_BUSY_CHECK_NO    (10)
+
+/****************************************************************/
+/* Type Definition                                              */
+/****************************************************************/
+typedef struct rtl8367c_tblentry_s
+{
+    rtk_uint16  target;
+    rtk_uint16  addr;
+    rtk_uint16  len;
+    rtk_uint16  data[RTL8367C_TABLE_ENTRY_MAXLEN];
+}rtl8367c_tblentry_t;
+
+/* Switch access lock, provided by the platform glue next to mii_mgr_read() */
+extern void rtk_gsw_lock(void);
+extern void rtk_gsw_unlock(void);
+extern void rtk_gsw_assert_locked(void);
+
+extern ret_t rtl8367c_getAsicTableShadow(rtk_uint32 reg, rtk_uint32 *pValue);
+extern void rtl8367c_setAsicTableShadow(rtk_uint32 reg, rtk_uint32 value);
+extern void rtl8367c_dropAsicTableShadow(rtk_uint32 reg);
+extern void rtl8367c_resetAsicTableCache(void);
+extern void rtl8367c_clearAsicTableCache(rtk_uint32 target);
+extern ret_t rtl8367c_setAsicTableEntry(rtk_uint32 target, rtk_uint32 addr, rtk_uint16 *pData, rtk_uint32 len);
+extern ret_t rtl8367c_getAsicTableEntry(rtk_uint32 target, rtk_uint32 addr, rtk_uint16 *pData, rtk_uint32 len);
+extern ret_t rtl8367c_setAsicTableStage(rtk_uint32 enabled);
+extern ret_t rtl8367c_getAsicTableStage(rtk_uint32 *pEnabled);
+
+#endif /*#ifndef _RTL8367C_ASICDRV_TABLE_H_*/
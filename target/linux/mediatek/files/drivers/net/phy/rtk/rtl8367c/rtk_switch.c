@@ -25,6 +25,7 @@
 #include <rtl8367c_asicdrv_lut.h>
 #include <rtl8367c_asicdrv_rma.h>
 #include <rtl8367c_asicdrv_mirror.h>
+#include <rtl8367c_asicdrv_table.h>
 
 #if defined(FORCE_PROBE_RTL8367C)
 static init_state_t    init_state = INIT_COMPLETED;
@@ -1369,6 +1370,9 @@ rtk_api_ret_t rtk_switch_init(void)
     rtl8367c_rma_t rmaCfg;
     switch_chip_t   switchChip;
 
+    /* Shadowed registers and cached tables do not survive a switch reset */
+    rtl8367c_resetAsicTableCache();
+
     /* probe switch */
     if((retVal = rtk_switch_probe(&switchChip)) != RT_ERR_OK)
         return retVal;
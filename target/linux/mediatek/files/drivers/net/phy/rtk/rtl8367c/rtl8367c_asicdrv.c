@@ -16,6 +16,7 @@
  */
 
 #include <rtl8367c_asicdrv.h>
+#include <rtl8367c_asicdrv_table.h>
 
 #if defined(RTK_X86_ASICDRV)
 #include <I2Clib.h>
@@ -38,6 +39,40 @@ extern void setReg(rtk_uint16, rtk_uint16);
 extern rtk_uint16 getReg(rtk_uint16);
 #endif
 
+#if !defined(RTK_X86_ASICDRV) && !defined(CONFIG_RTL8367C_ASICDRV_TEST) && !defined(EMBEDDED_SUPPORT)
+/* The caller holds rtk_gsw_lock(), which keeps the shadow in line with the ASIC */
+static rtk_int32 _rtl8367c_smiRead(rtk_uint32 reg, rtk_uint32 *pValue)
+{
+    rtk_gsw_assert_locked();
+
+    /* Table write data registers are answered from their shadow */
+    if(rtl8367c_getAsicTableShadow(reg, pValue) == RT_ERR_OK)
+        return RT_ERR_OK;
+
+    return smi_read(reg, pValue);
+}
+
+static rtk_int32 _rtl8367c_smiWrite(rtk_uint32 reg, rtk_uint32 value)
+{
+    rtk_uint32 shadow;
+    rtk_int32 retVal;
+
+    rtk_gsw_assert_locked();
+
+    if(rtl8367c_getAsicTableShadow(reg, &shadow) == RT_ERR_OK && shadow == value)
+        return RT_ERR_OK;
+
+    /* A failed write leaves the register in an unknown state */
+    retVal = smi_write(reg, value);
+    if(retVal == RT_ERR_OK)
+        rtl8367c_setAsicTableShadow(reg, value);
+    else
+        rtl8367c_dropAsicTableShadow(reg);
+
+    return retVal;
+}
+#endif
+
 /* Function Name:
  *      rtl8367c_setAsicRegBit
  * Description:
@@ -123,7 +158,7 @@ ret_t rtl8367c_setAsicRegBit(rtk_uint32 reg, rtk_uint32 bit, rtk_uint32 value)
     if(bit >= RTL8367C_REGBITLENGTH)
         return RT_ERR_INPUT;
 
-    retVal = smi_read(reg, &regData);
+    retVal = _rtl8367c_smiRead(reg, &regData);
     if(retVal != RT_ERR_OK)
         return RT_ERR_SMI;
 
@@ -136,7 +171,7 @@ ret_t rtl8367c_setAsicRegBit(rtk_uint32 reg, rtk_uint32 bit, rtk_uint32 value)
     else
         regData = regData & (~(1 << bit));
 
-    retVal = smi_write(reg, regData);
+    retVal = _rtl8367c_smiWrite(reg, regData);
     if(retVal != RT_ERR_OK)
         return RT_ERR_SMI;
 
@@ -212,7 +247,7 @@ ret_t rtl8367c_getAsicRegBit(rtk_uint32 reg, rtk_uint32 bit, rtk_uint32 *pValue)
     rtk_uint32 regData;
     ret_t retVal;
 
-    retVal = smi_read(reg, &regData);
+    retVal = _rtl8367c_smiRead(reg, &regData);
     if(retVal != RT_ERR_OK)
         return RT_ERR_SMI;
 
@@ -366,7 +401,7 @@ ret_t rtl8367c_setAsicRegBits(rtk_uint32 reg, rtk_uint32 bits, rtk_uint32 value)
     if(valueShifted > RTL8367C_REGDATAMAX)
         return RT_ERR_INPUT;
 
-    retVal = smi_read(reg, &regData);
+    retVal = _rtl8367c_smiRead(reg, &regData);
     if(retVal != RT_ERR_OK)
         return RT_ERR_SMI;
   #ifdef CONFIG_RTL865X_CLE
@@ -377,7 +412,7 @@ ret_t rtl8367c_setAsicRegBits(rtk_uint32 reg, rtk_uint32 bits, rtk_uint32 value)
     regData = regData & (~bits);
     regData = regData | (valueShifted & bits);
 
-    retVal = smi_write(reg, regData);
+    retVal = _rtl8367c_smiWrite(reg, regData);
     if(retVal != RT_ERR_OK)
         return RT_ERR_SMI;
   #ifdef CONFIG_RTL865X_CLE
@@ -492,7 +527,7 @@ ret_t rtl8367c_getAsicRegBits(rtk_uint32 reg, rtk_uint32 bits, rtk_uint32 *pValu
             return RT_ERR_INPUT;
     }
 
-    retVal = smi_read(reg, &regData);
+    retVal = _rtl8367c_smiRead(reg, &regData);
     if(retVal != RT_ERR_OK) return RT_ERR_SMI;
 
     *pValue = (regData & bits) >> bitsShift;
@@ -559,7 +594,7 @@ ret_t rtl8367c_setAsicReg(rtk_uint32 reg, rtk_uint32 value)
 #else
     ret_t retVal;
 
-    retVal = smi_write(reg, value);
+    retVal = _rtl8367c_smiWrite(reg, value);
     if(retVal != RT_ERR_OK)
         return RT_ERR_SMI;
   #ifdef CONFIG_RTL865X_CLE
@@ -622,7 +657,7 @@ ret_t rtl8367c_getAsicReg(rtk_uint32 reg, rtk_uint32 *pValue)
     rtk_uint32 regData;
     ret_t retVal;
 
-    retVal = smi_read(reg, &regData);
+    retVal = _rtl8367c_smiRead(reg, &regData);
     if(retVal != RT_ERR_OK)
         return RT_ERR_SMI;
 
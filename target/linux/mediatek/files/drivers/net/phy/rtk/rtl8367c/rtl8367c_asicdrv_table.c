@@ -0,0 +1,556 @@
+/*
+ * Copyright (C) 2013 Realtek Semiconductor Corp.
+ * All Rights Reserved.
+ *
+ * Unless you and Realtek execute a separate written software license
+ * agreement governing use of this software, this software is licensed
+ * to you under the terms of the GNU General Public License version 2,
+ * available at https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ *
+ * Purpose : RTL8367C switch high-level API for RTL8367C
+ * Feature : Indirect table access engine
+ *
+ *           Every register access over MDC/MDIO costs four bus transactions,
+ *           so table entries are written through a shadow of the table write
+ *           data registers (unchanged words are not rewritten) and the access
+ *           control register is written directly instead of read-modify-write.
+ *           Entries may be staged and flushed in an order that maximises the
+ *           words shared between consecutive entries. Tables only changed by
+ *           software (4K VLAN, ACL action) are cached so reads do not touch
+ *           the bus.
+ *
+ *           None of this is reentrant: every caller holds the switch access
+ *           lock (rtk_gsw_lock()) around its whole register or table sequence.
+ *
+ */
+#include <rtl8367c_asicdrv_table.h>
+#include <rtl8367c_asicdrv_vlan.h>
+#include <rtl8367c_asicdrv_acl.h>
+
+#include <string.h>
+
+typedef struct rtl8367c_tblcache_s
+{
+    rtk_uint32  target;
+    rtk_uint32  entries;
+    rtk_uint32  len;
+    rtk_uint16  *pData;
+    rtk_uint32  *pValid;
+}rtl8367c_tblcache_t;
+
+static rtk_uint16 tblWrData[RTL8367C_TABLE_WRDATA_LEN];
+static rtk_uint32 tblWrDataValid;
+
+static rtk_uint16 tblCvlanData[RTL8367C_VIDMAX + 1][RTL8367C_VLAN_4KTABLE_LEN];
+static rtk_uint32 tblCvlanValid[(RTL8367C_VIDMAX + 32) / 32];
+static rtk_uint16 tblAclActData[RTL8367C_ACLRULENO][RTL8367C_ACL_ACT_TABLE_LEN];
+static rtk_uint32 tblAclActValid[(RTL8367C_ACLRULENO + 31) / 32];
+
+static rtl8367c_tblcache_t tblCache[] =
+{
+    {TB_TARGET_CVLAN,  RTL8367C_VIDMAX + 1, RTL8367C_VLAN_4KTABLE_LEN,  &tblCvlanData[0][0],  tblCvlanValid},
+    {TB_TARGET_ACLACT, RTL8367C_ACLRULENO,  RTL8367C_ACL_ACT_TABLE_LEN, &tblAclActData[0][0], tblAclActValid},
+};
+
+static rtl8367c_tblentry_t tblStage[RTL8367C_TABLE_STAGE_MAX];
+static rtk_uint32 tblStageNum;
+static rtk_uint32 tblStageDepth;
+
+static rtl8367c_tblcache_t *_rtl8367c_tableCacheFind(rtk_uint32 target, rtk_uint32 addr, rtk_uint32 len)
+{
+    rtk_uint32 i;
+
+    for(i = 0; i < sizeof(tblCache) / sizeof(tblCache[0]); i++)
+    {
+        if(tblCache[i].target == target)
+        {
+            if(addr >= tblCache[i].entries || len != tblCache[i].len)
+                return NULL;
+
+            return &tblCache[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void _rtl8367c_tableCacheSet(rtk_uint32 target, rtk_uint32 addr, rtk_uint16 *pData, rtk_uint32 len)
+{
+    rtl8367c_tblcache_t *pCache;
+
+    pCache = _rtl8367c_tableCacheFind(target, addr, len);
+    if(pCache == NULL)
+        return;
+
+    memcpy(pCache->pData + addr * pCache->len, pData, sizeof(rtk_uint16) * len);
+    pCache->pValid[addr / 32] |= (1U << (addr % 32));
+}
+
+static void _rtl8367c_tableCacheInvalidate(rtk_uint32 target, rtk_uint32 addr)
+{
+    rtk_uint32 i;
+
+    for(i = 0; i < sizeof(tblCache) / sizeof(tblCache[0]); i++)
+    {
+        if(tblCache[i].target == target && addr < tblCache[i].entries)
+            tblCache[i].pValid[addr / 32] &= ~(1U << (addr % 32));
+    }
+}
+
+static ret_t _rtl8367c_tableCacheGet(rtk_uint32 target, rtk_uint32 addr, rtk_uint16 *pData, rtk_uint32 len)
+{
+    rtl8367c_tblcache_t *pCache;
+
+    pCache = _rtl8367c_tableCacheFind(target, addr, len);
+    if(pCache == NULL)
+        return RT_ERR_FAILED;
+
+    if(!(pCache->pValid[addr / 32] & (1U << (addr % 32))))
+        return RT_ERR_FAILED;
+
+    memcpy(pData, pCache->pData + addr * pCache->len, sizeof(rtk_uint16) * len);
+    return RT_ERR_OK;
+}
+
+static ret_t _rtl8367c_tableBusyWait(void)
+{
+    ret_t retVal;
+    rtk_uint32 regData;
+    rtk_uint32 busyCounter;
+
+    busyCounter = RTL8367C_TABLE_BUSY_CHECK_NO;
+    while(busyCounter)
+    {
+        retVal = rtl8367c_getAsicRegBit(RTL8367C_TABLE_ACCESS_STATUS_REG, RTL8367C_TABLE_LUT_ADDR_BUSY_FLAG_OFFSET, &regData);
+        if(retVal != RT_ERR_OK)
+            return retVal;
+
+        if(regData == 0)
+            return RT_ERR_OK;
+
+        busyCounter --;
+    }
+
+    return RT_ERR_BUSYWAIT_TIMEOUT;
+}
+
+static ret_t _rtl8367c_tableWrite(rtl8367c_tblentry_t *pEntry)
+{
+    ret_t retVal;
+    rtk_uint32 i;
+
+    /* The previous command has to complete before its data is replaced */
+    retVal = _rtl8367c_tableBusyWait();
+    if(retVal != RT_ERR_OK)
+        return retVal;
+
+    /* Unchanged words are skipped by the write data shadow */
+    for(i = 0; i < pEntry->len; i++)
+    {
+        retVal = rtl8367c_setAsicReg(RTL8367C_TABLE_ACCESS_WRDATA_REG(i), pEntry->data[i]);
+        if(retVal != RT_ERR_OK)
+            return retVal;
+    }
+
+    retVal = rtl8367c_setAsicReg(RTL8367C_TABLE_ACCESS_ADDR_REG, pEntry->addr);
+    if(retVal != RT_ERR_OK)
+        return retVal;
+
+    /* The remaining control fields only matter for L2 lookups, which always set them */
+    return rtl8367c_setAsicReg(RTL8367C_TABLE_ACCESS_CTRL_REG, RTL8367C_TABLE_ACCESS_REG_DATA(TB_OP_WRITE, pEntry->target));
+}
+
+static rtk_int32 _rtl8367c_tableEntryCmp(rtl8367c_tblentry_t *pA, rtl8367c_tblentry_t *pB)
+{
+    rtk_uint32 i;
+
+    if(pA->target != pB->target)
+        return (rtk_int32)pA->target - (rtk_int32)pB->target;
+
+    for(i = 0; i < RTL8367C_TABLE_ENTRY_MAXLEN; i++)
+    {
+        if(pA->data[i] != pB->data[i])
+            return (rtk_int32)pA->data[i] - (rtk_int32)pB->data[i];
+    }
+
+    return (rtk_int32)pA->addr - (rtk_int32)pB->addr;
+}
+
+static ret_t _rtl8367c_tableStageFlush(void)
+{
+    rtl8367c_tblentry_t entry;
+    ret_t retVal = RT_ERR_OK;
+    rtk_uint32 i, j;
+
+    /* Sort by content so consecutive entries share as many data words as possible */
+    for(i = 1; i < tblStageNum; i++)
+    {
+        entry = tblStage[i];
+        for(j = i; j > 0 && _rtl8367c_tableEntryCmp(&tblStage[j - 1], &entry) > 0; j--)
+            tblStage[j] = tblStage[j - 1];
+        tblStage[j] = entry;
+    }
+
+    for(i = 0; i < tblStageNum; i++)
+    {
+        if(retVal == RT_ERR_OK)
+            retVal = _rtl8367c_tableWrite(&tblStage[i]);
+
+        /* Entries which did not reach the ASIC must not be served from cache */
+        if(retVal != RT_ERR_OK)
+            _rtl8367c_tableCacheInvalidate(tblStage[i].target, tblStage[i].addr);
+    }
+
+    tblStageNum = 0;
+    return retVal;
+}
+
+static ret_t _rtl8367c_tableStageAdd(rtl8367c_tblentry_t *pEntry)
+{
+    ret_t retVal;
+    rtk_uint32 i;
+
+    /* A later write to the same entry replaces the staged one */
+    for(i = 0; i < tblStageNum; i++)
+    {
+        if(tblStage[i].target == pEntry->target && tblStage[i].addr == pEntry->addr)
+        {
+            tblStage[i] = *pEntry;
+            return RT_ERR_OK;
+        }
+    }
+
+    if(tblStageNum == RTL8367C_TABLE_STAGE_MAX)
+    {
+        retVal = _rtl8367c_tableStageFlush();
+        if(retVal != RT_ERR_OK)
+            return retVal;
+    }
+
+    tblStage[tblStageNum++] = *pEntry;
+    return RT_ERR_OK;
+}
+
+/* Function Name:
+ *      rtl8367c_getAsicTableShadow
+ * Description:
+ *      Get the shadowed value of a table write data register
+ * Input:
+ *      reg     - register's address
+ *      pValue  - shadowed value
+ * Output:
+ *      None
+ * Return:
+ *      RT_ERR_OK       - Success
+ *      RT_ERR_FAILED   - Register is not shadowed
+ * Note:
+ *      The table write data registers are only changed by software, so their
+ *      last written value can be returned without an SMI read.
+ */
+ret_t rtl8367c_getAsicTableShadow(rtk_uint32 reg, rtk_uint32 *pValue)
+{
+    rtk_uint32 idx;
+
+    rtk_gsw_assert_locked();
+
+    if(reg < RTL8367C_TABLE_ACCESS_WRDATA_BASE || reg >= RTL8367C_TABLE_ACCESS_WRDATA_REG(RTL8367C_TABLE_WRDATA_LEN))
+        return RT_ERR_FAILED;
+
+    idx = reg - RTL8367C_TABLE_ACCESS_WRDATA_BASE;
+    if(!(tblWrDataValid & (1U << idx)))
+        return RT_ERR_FAILED;
+
+    *pValue = tblWrData[idx];
+    return RT_ERR_OK;
+}
+/* Function Name:
+ *      rtl8367c_setAsicTableShadow
+ * Description:
+ *      Record a value written to a table write data register
+ * Input:
+ *      reg     - register's address
+ *      value   - value written to register
+ * Output:
+ *      None
+ * Return:
+ *      None
+ * Note:
+ *      Writes to other registers are ignored.
+ */
+void rtl8367c_setAsicTableShadow(rtk_uint32 reg, rtk_uint32 value)
+{
+    rtk_uint32 idx;
+
+    rtk_gsw_assert_locked();
+
+    if(reg < RTL8367C_TABLE_ACCESS_WRDATA_BASE || reg >= RTL8367C_TABLE_ACCESS_WRDATA_REG(RTL8367C_TABLE_WRDATA_LEN))
+        return;
+
+    idx = reg - RTL8367C_TABLE_ACCESS_WRDATA_BASE;
+    tblWrData[idx] = value;
+    tblWrDataValid |= (1U << idx);
+}
+/* Function Name:
+ *      rtl8367c_dropAsicTableShadow
+ * Description:
+ *      Forget the shadowed value of a table write data register
+ * Input:
+ *      reg     - register's address
+ * Output:
+ *      None
+ * Return:
+ *      None
+ * Note:
+ *      The next access to the register goes to the ASIC again.
+ */
+void rtl8367c_dropAsicTableShadow(rtk_uint32 reg)
+{
+    rtk_gsw_assert_locked();
+
+    if(reg < RTL8367C_TABLE_ACCESS_WRDATA_BASE || reg >= RTL8367C_TABLE_ACCESS_WRDATA_REG(RTL8367C_TABLE_WRDATA_LEN))
+        return;
+
+    tblWrDataValid &= ~(1U << (reg - RTL8367C_TABLE_ACCESS_WRDATA_BASE));
+}
+/* Function Name:
+ *      rtl8367c_resetAsicTableCache
+ * Description:
+ *      Drop all shadowed registers, cached and staged table entries
+ * Input:
+ *      None
+ * Output:
+ *      None
+ * Return:
+ *      None
+ * Note:
+ *      Must be called whenever the ASIC has been reset.
+ */
+void rtl8367c_resetAsicTableCache(void)
+{
+    rtk_uint32 i;
+
+    rtk_gsw_assert_locked();
+
+    tblWrDataValid = 0;
+    tblStageNum = 0;
+    tblStageDepth = 0;
+
+    for(i = 0; i < sizeof(tblCache) / sizeof(tblCache[0]); i++)
+        memset(tblCache[i].pValid, 0x00, sizeof(rtk_uint32) * ((tblCache[i].entries + 31) / 32));
+}
+/* Function Name:
+ *      rtl8367c_clearAsicTableCache
+ * Description:
+ *      Mark all cached entries of a table as cleared
+ * Input:
+ *      target  - table type
+ * Output:
+ *      None
+ * Return:
+ *      None
+ * Note:
+ *      Used after the ASIC has cleared a table by itself. Staged writes
+ *      to the table are dropped, they would have been cleared as well.
+ */
+void rtl8367c_clearAsicTableCache(rtk_uint32 target)
+{
+    rtk_uint32 i, j;
+
+    rtk_gsw_assert_locked();
+
+    for(i = 0, j = 0; i < tblStageNum; i++)
+    {
+        if(tblStage[i].target != target)
+            tblStage[j++] = tblStage[i];
+    }
+    tblStageNum = j;
+
+    for(i = 0; i < sizeof(tblCache) / sizeof(tblCache[0]); i++)
+    {
+        if(tblCache[i].target != target)
+            continue;
+
+        memset(tblCache[i].pData, 0x00, sizeof(rtk_uint16) * tblCache[i].entries * tblCache[i].len);
+        memset(tblCache[i].pValid, 0xFF, sizeof(rtk_uint32) * ((tblCache[i].entries + 31) / 32));
+    }
+}
+/* Function Name:
+ *      rtl8367c_setAsicTableEntry
+ * Description:
+ *      Write an entry through the indirect table access registers
+ * Input:
+ *      target  - table type
+ *      addr    - entry address
+ *      pData   - entry data words
+ *      len     - number of data words (1~10)
+ * Output:
+ *      None
+ * Return:
+ *      RT_ERR_OK       - Success
+ *      RT_ERR_SMI      - SMI access error
+ *      RT_ERR_INPUT    - Invalid input parameter
+ * Note:
+ *      While staging is enabled the entry is only queued and written by
+ *      rtl8367c_setAsicTableStage(DISABLED).
+ */
+ret_t rtl8367c_setAsicTableEntry(rtk_uint32 target, rtk_uint32 addr, rtk_uint16 *pData, rtk_uint32 len)
+{
+    rtl8367c_tblentry_t entry;
+    ret_t retVal;
+
+    rtk_gsw_assert_locked();
+
+    if(len == 0 || len > RTL8367C_TABLE_ENTRY_MAXLEN)
+        return RT_ERR_INPUT;
+
+    if(addr > RTL8367C_TABLE_ACCESS_ADDR_MASK)
+        return RT_ERR_INPUT;
+
+    memset(&entry, 0x00, sizeof(rtl8367c_tblentry_t));
+    entry.target = target;
+    entry.addr = addr;
+    entry.len = len;
+    memcpy(entry.data, pData, sizeof(rtk_uint16) * len);
+
+    _rtl8367c_tableCacheSet(target, addr, pData, len);
+
+    if(tblStageDepth)
+        return _rtl8367c_tableStageAdd(&entry);
+
+    retVal = _rtl8367c_tableWrite(&entry);
+    if(retVal != RT_ERR_OK)
+        _rtl8367c_tableCacheInvalidate(target, addr);
+
+    return retVal;
+}
+/* Function Name:
+ *      rtl8367c_getAsicTableEntry
+ * Description:
+ *      Read an entry through the indirect table access registers
+ * Input:
+ *      target  - table type
+ *      addr    - entry address
+ *      len     - number of data words (1~10)
+ * Output:
+ *      pData   - entry data words
+ * Return:
+ *      RT_ERR_OK               - Success
+ *      RT_ERR_SMI              - SMI access error
+ *      RT_ERR_INPUT            - Invalid input parameter
+ *      RT_ERR_BUSYWAIT_TIMEOUT - Table access is busy
+ * Note:
+ *      Cached tables are answered without SMI access.
+ */
+ret_t rtl8367c_getAsicTableEntry(rtk_uint32 target, rtk_uint32 addr, rtk_uint16 *pData, rtk_uint32 len)
+{
+    ret_t retVal;
+    rtk_uint32 regData;
+    rtk_uint32 i;
+
+    rtk_gsw_assert_locked();
+
+    if(len == 0 || len > RTL8367C_TABLE_ENTRY_MAXLEN)
+        return RT_ERR_INPUT;
+
+    if(addr > RTL8367C_TABLE_ACCESS_ADDR_MASK)
+        return RT_ERR_INPUT;
+
+    if(_rtl8367c_tableCacheGet(target, addr, pData, len) == RT_ERR_OK)
+        return RT_ERR_OK;
+
+    /* Staged entries have to reach the ASIC before it is read back */
+    if(tblStageNum)
+    {
+        retVal = _rtl8367c_tableStageFlush();
+        if(retVal != RT_ERR_OK)
+            return retVal;
+    }
+
+    /* Polling status */
+    retVal = _rtl8367c_tableBusyWait();
+    if(retVal != RT_ERR_OK)
+        return retVal;
+
+    retVal = rtl8367c_setAsicReg(RTL8367C_TABLE_ACCESS_ADDR_REG, addr);
+    if(retVal != RT_ERR_OK)
+        return retVal;
+
+    retVal = rtl8367c_setAsicReg(RTL8367C_TABLE_ACCESS_CTRL_REG, RTL8367C_TABLE_ACCESS_REG_DATA(TB_OP_READ, target));
+    if(retVal != RT_ERR_OK)
+        return retVal;
+
+    /* Polling status */
+    retVal = _rtl8367c_tableBusyWait();
+    if(retVal != RT_ERR_OK)
+        return retVal;
+
+    for(i = 0; i < len; i++)
+    {
+        retVal = rtl8367c_getAsicReg(RTL8367C_TABLE_ACCESS_RDDATA_REG(i), &regData);
+        if(retVal != RT_ERR_OK)
+            return retVal;
+
+        pData[i] = (rtk_uint16)regData;
+    }
+
+    _rtl8367c_tableCacheSet(target, addr, pData, len);
+
+    return RT_ERR_OK;
+}
+/* Function Name:
+ *      rtl8367c_setAsicTableStage
+ * Description:
+ *      Enable or disable staging of table writes
+ * Input:
+ *      enabled - ENABLED: queue table writes, DISABLED: flush queued writes
+ * Output:
+ *      None
+ * Return:
+ *      RT_ERR_OK       - Success
+ *      RT_ERR_SMI      - SMI access error
+ *      RT_ERR_INPUT    - Invalid input parameter
+ * Note:
+ *      Calls nest, entries are flushed when the outermost stage is disabled.
+ */
+ret_t rtl8367c_setAsicTableStage(rtk_uint32 enabled)
+{
+    rtk_gsw_assert_locked();
+
+    if(enabled >= RTK_ENABLE_END)
+        return RT_ERR_INPUT;
+
+    if(enabled == ENABLED)
+    {
+        tblStageDepth++;
+        return RT_ERR_OK;
+    }
+
+    if(tblStageDepth == 0)
+        return RT_ERR_INPUT;
+
+    if(--tblStageDepth)
+        return RT_ERR_OK;
+
+    return _rtl8367c_tableStageFlush();
+}
+/* Function Name:
+ *      rtl8367c_getAsicTableStage
+ * Description:
+ *      Get staging state of table writes
+ * Input:
+ *      None
+ * Output:
+ *      pEnabled - ENABLED while table writes are being staged
+ * Return:
+ *      RT_ERR_OK       - Success
+ * Note:
+ *      None
+ */
+ret_t rtl8367c_getAsicTableStage(rtk_uint32 *pEnabled)
+{
+    rtk_gsw_assert_locked();
+
+    *pEnabled = tblStageDepth ? ENABLED : DISABLED;
+
+    return RT_ERR_OK;
+}
@@ -24,6 +24,7 @@
 #include  "./rtl8367c/include/vlan.h"
 #include  "./rtl8367c/include/stat.h"
 #include  "./rtl8367c/include/port.h"
+#include  "./rtl8367c/include/rtl8367c_asicdrv_table.h"
 
 #define RTL8367C_SW_CPU_PORT    6
 
@@ -275,7 +276,13 @@ static int rtl8367_sw_reset_mibs(struct switch_dev *dev,
 				  const struct switch_attr *attr,
 				  struct switch_val *val)
 {
-	return rtl8367c_reset_mibs();
+	int err;
+
+	rtk_gsw_lock();
+	err = rtl8367c_reset_mibs();
+	rtk_gsw_unlock();
+
+	return err;
 }
 
 
@@ -283,13 +290,17 @@ static int rtl8367_sw_reset_port_mibs(struct switch_dev *dev,
 				       const struct switch_attr *attr,
 				       struct switch_val *val)
 {
-	int port;
+	int port, err;
 
 	port = val->port_vlan;
 	if (port >= RTL8367C_NUM_PORTS)
 		return -EINVAL;
 
-	return rtl8367c_reset_port_mibs(port);
+	rtk_gsw_lock();
+	err = rtl8367c_reset_port_mibs(port);
+	rtk_gsw_unlock();
+
+	return err;
 }
 
 static int rtl8367_sw_get_port_mib(struct switch_dev *dev,
@@ -307,6 +318,7 @@ static int rtl8367_sw_get_port_mib(struct switch_dev *dev,
 			"Port %d MIB counters\n",
 			val->port_vlan);	
 
+	rtk_gsw_lock();
 	for (i = 0; i <rtl8367c_get_mibs_num(); ++i) {
 		len += snprintf(mib_buf + len, sizeof(mib_buf) - len,
 				"%-36s: ",rtl8367c_get_mib_name(i));
@@ -318,6 +330,7 @@ static int rtl8367_sw_get_port_mib(struct switch_dev *dev,
 			len += snprintf(mib_buf + len, sizeof(mib_buf) - len,
 					"%s\n", "N/A");
 	}
+	rtk_gsw_unlock();
 
 	val->value.s = mib_buf;
 	val->len = len;
@@ -340,7 +353,9 @@ static int rtl8367_sw_get_vlan_info(struct switch_dev *dev,
 
 	memset(vlan_buf, '\0', sizeof(vlan_buf));
 
+	rtk_gsw_lock();
 	err = rtl8367c_get_vlan(val->port_vlan, &vlan);
+	rtk_gsw_unlock();
 	if (err)
 		return err;
 
@@ -370,12 +385,15 @@ static int rtl8367_sw_get_vlan_ports(struct switch_dev *dev, struct switch_val *
 {
 	struct switch_port *port;
 	struct rtl8367_vlan_info vlan;
-	int i;	
+	int i, err;
 	
 	if (!rtl8367c_is_vlan_valid(val->port_vlan))
 		return -EINVAL;
 
-	if(rtl8367c_get_vlan(val->port_vlan, &vlan))
+	rtk_gsw_lock();
+	err = rtl8367c_get_vlan(val->port_vlan, &vlan);
+	rtk_gsw_unlock();
+	if (err)
 		return -EINVAL;
 
 	port = &val->value.ports[0];
@@ -406,6 +424,8 @@ static int rtl8367_sw_set_vlan_ports(struct switch_dev *dev, struct switch_val *
 	if (!rtl8367c_is_vlan_valid(val->port_vlan))
 		return -EINVAL;
 
+	rtk_gsw_lock();
+
 	port = &val->value.ports[0];
 	for (i = 0; i < val->len; i++, port++) {
 		int pvid = 0;
@@ -420,30 +440,45 @@ static int rtl8367_sw_set_vlan_ports(struct switch_dev *dev, struct switch_val *
 		 */
 		err = rtl8367c_get_pvid(port->id, &pvid);
 		if (err < 0)
-			return err;
+			goto out;
 		if (pvid == 0) {
 			err = rtl8367c_set_pvid(port->id, val->port_vlan);
 			if (err < 0)
-				return err;
+				goto out;
 		}
 	}
 
 	//pr_info("[%s] vid=%d , mem=%x,untag=%x,fid=%d \n",__func__,val->port_vlan,member,untag,fid);
 
-	return rtl8367c_set_vlan(val->port_vlan, member, untag, fid);	
+	err = rtl8367c_set_vlan(val->port_vlan, member, untag, fid);	
+out:
+	rtk_gsw_unlock();
 
+	return err;
 }
 
 
 static int rtl8367_sw_get_port_pvid(struct switch_dev *dev, int port, int *val)
 {
-	return rtl8367c_get_pvid(port, val);
+	int err;
+
+	rtk_gsw_lock();
+	err = rtl8367c_get_pvid(port, val);
+	rtk_gsw_unlock();
+
+	return err;
 }
 
 
 static int rtl8367_sw_set_port_pvid(struct switch_dev *dev, int port, int val)
 {	
-	return rtl8367c_set_pvid(port, val);
+	int err;
+
+	rtk_gsw_lock();
+	err = rtl8367c_set_pvid(port, val);
+	rtk_gsw_unlock();
+
+	return err;
 }
 
 
@@ -460,13 +495,16 @@ static int rtl8367_sw_reset_switch(struct switch_dev *dev)
 static int rtl8367_sw_get_port_link(struct switch_dev *dev, int port,
 				    struct switch_port_link *link)
 {	
-	int speed;
+	int speed, err;
 
 	if (port >= RTL8367C_NUM_PORTS)
 		return -EINVAL;
 
-	if(rtl8367c_get_port_link(port,(int *)&link->link,(int *)&speed,(int *)&link->duplex))
-		return -EINVAL;		
+	rtk_gsw_lock();
+	err = rtl8367c_get_port_link(port,(int *)&link->link,(int *)&speed,(int *)&link->duplex);
+	rtk_gsw_unlock();
+	if (err)
+		return -EINVAL;
 
 	if (!link->link)
 		return 0;	
@@ -0,0 +1,929 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Ingress ACL rule set compiler: a rule set written to /proc/rtk_gsw/acl
+ * is parsed, compacted into as few ACL entries as possible and programmed
+ * in one go. Reading the file shows the compiled rules with hit counters.
+ *
+ * One rule per line, '#' starts a comment:
+ *
+ *   <action> [in <ports>] [proto tcp|udp|icmp] [src <mac>] [dst <mac>]
+ *            [sip <ip>[/<len>]] [dip <ip>[/<len>]]
+ *            [sport <port>[-<port>]] [dport <port>[-<port>]] [vid <vid>]
+ *
+ *   action: drop | trap | redirect <ports> | isolate <ports>
+ *   ports:  comma separated list of switch ports or port ranges (0-4,16)
+ *
+ * Every write replaces the whole rule set, an empty write removes it.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/etherdevice.h>
+#include <linux/inet.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+#include <asm/unaligned.h>
+
+#include  "./rtl8367c/include/rtk_switch.h"
+#include  "./rtl8367c/include/acl.h"
+#include  "./rtl8367c/include/rate.h"
+#include  "./rtl8367c/include/stat.h"
+#include  "./rtl8367c/include/rtl8367c_asicdrv_acl.h"
+#include  "./rtl8367c/include/rtl8367c_asicdrv_mib.h"
+#include  "./rtl8367c/include/rtl8367c_asicdrv_table.h"
+
+#define RTK_ACL_BUF_MAX		16384
+#define RTK_ACL_RULES_MAX	256
+#define RTK_ACL_FIELDS_MAX	8
+/* a 32 bit packet counter wraps after about 48 minutes at 1G line rate */
+#define RTK_ACL_HARVEST_INTERVAL	(60 * HZ)
+
+enum rtk_acl_action {
+	RTK_ACL_DROP,
+	RTK_ACL_TRAP,
+	RTK_ACL_REDIRECT,
+	RTK_ACL_ISOLATE,
+};
+
+enum rtk_acl_proto {
+	RTK_ACL_PROTO_ANY,
+	RTK_ACL_PROTO_TCP,
+	RTK_ACL_PROTO_UDP,
+	RTK_ACL_PROTO_ICMP,
+};
+
+/* fields two rules may differ in and still be merged into one */
+#define RTK_ACL_DIFF_PORTS	BIT(0)
+#define RTK_ACL_DIFF_SPORT	BIT(1)
+#define RTK_ACL_DIFF_DPORT	BIT(2)
+#define RTK_ACL_DIFF_SIP	BIT(3)
+#define RTK_ACL_DIFF_DIP	BIT(4)
+#define RTK_ACL_DIFF_OTHER	BIT(5)
+
+struct rtk_acl_range {
+	u16 lo;
+	u16 hi;
+};
+
+struct rtk_acl_rule {
+	enum rtk_acl_action action;
+	u32 act_ports;
+	/* ingress ports, 0 for all */
+	u32 in_ports;
+	enum rtk_acl_proto proto;
+	bool has_smac, has_dmac, has_vid;
+	u8 smac[ETH_ALEN];
+	u8 dmac[ETH_ALEN];
+	u16 vid;
+	u32 sip, sip_mask;
+	u32 dip, dip_mask;
+	struct rtk_acl_range sport, dport;
+	/* source line of the first rule and number of rules merged into it */
+	int line;
+	int merged;
+	/* range checkers, ACL entries and logging counter used */
+	int sport_chk, dport_chk;
+	int entry, entries;
+	int counter;
+	u32 cnt_last;
+	u64 hits;
+};
+
+struct rtk_acl_checker {
+	rtk_filter_portrange_t type;
+	struct rtk_acl_range r;
+};
+
+/* rule set and ASIC state are both protected by rtk_gsw_lock() */
+static struct rtk_acl_rule *rtk_acl_rules;
+static int rtk_acl_count;
+static struct rtk_acl_checker rtk_acl_chk[RTL8367C_ACLRANGENO];
+static int rtk_acl_nchk;
+/* ACL entries currently programmed, all of them from 0 up */
+static int rtk_acl_used;
+static bool rtk_acl_ready;
+
+static void rtk_acl_harvest_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(rtk_acl_work, rtk_acl_harvest_work);
+
+static bool rtk_acl_range_any(const struct rtk_acl_range *r)
+{
+	return r->lo == 0 && r->hi == 0xffff;
+}
+
+/* A range covering an aligned power of two block is matched by value and
+ * mask, anything else needs one of the hardware range checkers.
+ */
+static bool rtk_acl_range_mask(const struct rtk_acl_range *r, u16 *mask)
+{
+	u32 size = (u32)r->hi - r->lo + 1;
+
+	if (size & (size - 1) || r->lo & (size - 1))
+		return false;
+
+	*mask = ~(size - 1);
+	return true;
+}
+
+static char *rtk_acl_token(char **s)
+{
+	char *tok;
+
+	do {
+		tok = strsep(s, " \t");
+	} while (tok && !*tok);
+
+	return tok;
+}
+
+static int rtk_acl_parse_ports(char *s, u32 *mask)
+{
+	char *tok, *dash;
+	unsigned int lo, hi;
+
+	*mask = 0;
+	while ((tok = strsep(&s, ",")) != NULL) {
+		dash = strchr(tok, '-');
+		if (dash)
+			*dash++ = '\0';
+
+		if (kstrtouint(tok, 10, &lo))
+			return -EINVAL;
+		hi = lo;
+		if (dash && kstrtouint(dash, 10, &hi))
+			return -EINVAL;
+		if (lo > hi || hi > 31)
+			return -EINVAL;
+
+		*mask |= GENMASK(hi, lo);
+	}
+
+	return *mask ? 0 : -EINVAL;
+}
+
+static int rtk_acl_parse_range(char *s, struct rtk_acl_range *r)
+{
+	char *dash = strchr(s, '-');
+	u16 lo, hi;
+
+	if (dash)
+		*dash++ = '\0';
+
+	if (kstrtou16(s, 10, &lo))
+		return -EINVAL;
+	hi = lo;
+	if (dash && kstrtou16(dash, 10, &hi))
+		return -EINVAL;
+	if (lo > hi)
+		return -EINVAL;
+
+	r->lo = lo;
+	r->hi = hi;
+	return 0;
+}
+
+static int rtk_acl_parse_prefix(char *s, u32 *addr, u32 *mask)
+{
+	const char *end;
+	unsigned int len = 32;
+	u8 buf[4];
+
+	if (!in4_pton(s, -1, buf, '/', &end))
+		return -EINVAL;
+	if (*end == '/' && kstrtouint(end + 1, 10, &len))
+		return -EINVAL;
+	if (len > 32)
+		return -EINVAL;
+
+	*mask = len ? ~0U << (32 - len) : 0;
+	*addr = get_unaligned_be32(buf) & *mask;
+	return 0;
+}
+
+static int rtk_acl_parse_line(char *line, struct rtk_acl_rule *r)
+{
+	char *tok, *arg;
+	int err = 0;
+
+	memset(r, 0, sizeof(*r));
+	r->sport.hi = r->dport.hi = 0xffff;
+	r->sport_chk = r->dport_chk = -1;
+	r->counter = -1;
+	r->merged = 1;
+
+	tok = rtk_acl_token(&line);
+	if (!tok)
+		return -EINVAL;
+
+	if (!strcmp(tok, "drop")) {
+		r->action = RTK_ACL_DROP;
+	} else if (!strcmp(tok, "trap")) {
+		r->action = RTK_ACL_TRAP;
+	} else if (!strcmp(tok, "redirect") || !strcmp(tok, "isolate")) {
+		r->action = tok[0] == 'r' ? RTK_ACL_REDIRECT : RTK_ACL_ISOLATE;
+		arg = rtk_acl_token(&line);
+		if (!arg || rtk_acl_parse_ports(arg, &r->act_ports))
+			return -EINVAL;
+	} else {
+		return -EINVAL;
+	}
+
+	while (!err && (tok = rtk_acl_token(&line)) != NULL) {
+		arg = rtk_acl_token(&line);
+		if (!arg)
+			return -EINVAL;
+
+		if (!strcmp(tok, "in")) {
+			err = rtk_acl_parse_ports(arg, &r->in_ports);
+		} else if (!strcmp(tok, "proto")) {
+			if (!strcmp(arg, "tcp"))
+				r->proto = RTK_ACL_PROTO_TCP;
+			else if (!strcmp(arg, "udp"))
+				r->proto = RTK_ACL_PROTO_UDP;
+			else if (!strcmp(arg, "icmp"))
+				r->proto = RTK_ACL_PROTO_ICMP;
+			else
+				err = -EINVAL;
+		} else if (!strcmp(tok, "src")) {
+			r->has_smac = mac_pton(arg, r->smac);
+			err = r->has_smac ? 0 : -EINVAL;
+		} else if (!strcmp(tok, "dst")) {
+			r->has_dmac = mac_pton(arg, r->dmac);
+			err = r->has_dmac ? 0 : -EINVAL;
+		} else if (!strcmp(tok, "sip")) {
+			err = rtk_acl_parse_prefix(arg, &r->sip, &r->sip_mask);
+		} else if (!strcmp(tok, "dip")) {
+			err = rtk_acl_parse_prefix(arg, &r->dip, &r->dip_mask);
+		} else if (!strcmp(tok, "sport")) {
+			err = rtk_acl_parse_range(arg, &r->sport);
+		} else if (!strcmp(tok, "dport")) {
+			err = rtk_acl_parse_range(arg, &r->dport);
+		} else if (!strcmp(tok, "vid")) {
+			err = kstrtou16(arg, 10, &r->vid);
+			if (!err && r->vid > 4095)
+				err = -EINVAL;
+			r->has_vid = true;
+		} else {
+			err = -EINVAL;
+		}
+	}
+
+	if (err)
+		return err;
+
+	/* TCP and UDP ports share the L4 header fields */
+	if ((!rtk_acl_range_any(&r->sport) || !rtk_acl_range_any(&r->dport)) &&
+	    r->proto != RTK_ACL_PROTO_TCP && r->proto != RTK_ACL_PROTO_UDP)
+		return -EINVAL;
+
+	return 0;
+}
+
+static u32 rtk_acl_diff(const struct rtk_acl_rule *a, const struct rtk_acl_rule *b)
+{
+	u32 diff = 0;
+
+	if (a->in_ports != b->in_ports)
+		diff |= RTK_ACL_DIFF_PORTS;
+	if (a->sport.lo != b->sport.lo || a->sport.hi != b->sport.hi)
+		diff |= RTK_ACL_DIFF_SPORT;
+	if (a->dport.lo != b->dport.lo || a->dport.hi != b->dport.hi)
+		diff |= RTK_ACL_DIFF_DPORT;
+	if (a->sip != b->sip || a->sip_mask != b->sip_mask)
+		diff |= RTK_ACL_DIFF_SIP;
+	if (a->dip != b->dip || a->dip_mask != b->dip_mask)
+		diff |= RTK_ACL_DIFF_DIP;
+
+	if (a->action != b->action || a->act_ports != b->act_ports ||
+	    a->proto != b->proto || a->has_vid != b->has_vid ||
+	    (a->has_vid && a->vid != b->vid) ||
+	    a->has_smac != b->has_smac ||
+	    (a->has_smac && !ether_addr_equal(a->smac, b->smac)) ||
+	    a->has_dmac != b->has_dmac ||
+	    (a->has_dmac && !ether_addr_equal(a->dmac, b->dmac)))
+		diff |= RTK_ACL_DIFF_OTHER;
+
+	return diff;
+}
+
+static bool rtk_acl_merge_range(struct rtk_acl_range *a, const struct rtk_acl_range *b)
+{
+	if ((u32)a->lo > (u32)b->hi + 1 || (u32)b->lo > (u32)a->hi + 1)
+		return false;
+
+	a->lo = min(a->lo, b->lo);
+	a->hi = max(a->hi, b->hi);
+	return true;
+}
+
+/* Merge prefixes if one contains the other or if they are the two halves
+ * of the next shorter prefix.
+ */
+static bool rtk_acl_merge_prefix(u32 *addr, u32 *mask, u32 baddr, u32 bmask)
+{
+	if ((*mask & bmask) == bmask && (*addr & bmask) == baddr) {
+		*addr = baddr;
+		*mask = bmask;
+		return true;
+	}
+
+	if ((*mask & bmask) == *mask && (baddr & *mask) == *addr)
+		return true;
+
+	if (*mask == bmask && *mask && (*addr ^ baddr) == (*mask & -*mask)) {
+		*mask <<= 1;
+		*addr &= *mask;
+		return true;
+	}
+
+	return false;
+}
+
+/* Try to fold rule b into rule a, both must have the same action */
+static bool rtk_acl_merge(struct rtk_acl_rule *a, const struct rtk_acl_rule *b)
+{
+	u32 diff = rtk_acl_diff(a, b);
+	bool merged;
+
+	if (diff & RTK_ACL_DIFF_OTHER || hweight32(diff) > 1)
+		return false;
+
+	switch (diff) {
+	case 0:
+		merged = true;
+		break;
+	case RTK_ACL_DIFF_PORTS:
+		a->in_ports = (a->in_ports && b->in_ports) ?
+			      a->in_ports | b->in_ports : 0;
+		merged = true;
+		break;
+	case RTK_ACL_DIFF_SPORT:
+		merged = rtk_acl_merge_range(&a->sport, &b->sport);
+		break;
+	case RTK_ACL_DIFF_DPORT:
+		merged = rtk_acl_merge_range(&a->dport, &b->dport);
+		break;
+	case RTK_ACL_DIFF_SIP:
+		merged = rtk_acl_merge_prefix(&a->sip, &a->sip_mask, b->sip, b->sip_mask);
+		break;
+	case RTK_ACL_DIFF_DIP:
+		merged = rtk_acl_merge_prefix(&a->dip, &a->dip_mask, b->dip, b->dip_mask);
+		break;
+	default:
+		merged = false;
+	}
+
+	if (merged)
+		a->merged += b->merged;
+
+	return merged;
+}
+
+/* Rules of consecutive lines with the same action can be reordered freely,
+ * so within such a run any two rules that differ in a single field are
+ * merged until nothing changes anymore.
+ */
+static int rtk_acl_compact(struct rtk_acl_rule *rules, int n)
+{
+	int start, end, i, j, k;
+	bool again;
+
+	for (start = 0; start < n; start = end) {
+		for (end = start + 1; end < n; end++)
+			if (rules[end].action != rules[start].action ||
+			    rules[end].act_ports != rules[start].act_ports)
+				break;
+
+		do {
+			again = false;
+			for (i = start; i < end; i++) {
+				for (j = i + 1; j < end; j++) {
+					if (!rtk_acl_merge(&rules[i], &rules[j]))
+						continue;
+
+					for (k = j; k < n - 1; k++)
+						rules[k] = rules[k + 1];
+					n--;
+					end--;
+					j--;
+					again = true;
+				}
+			}
+		} while (again);
+	}
+
+	return n;
+}
+
+static int rtk_acl_checker_get(struct rtk_acl_checker *chk, int *nchk,
+			       rtk_filter_portrange_t type,
+			       const struct rtk_acl_range *r)
+{
+	int i;
+
+	for (i = 0; i < *nchk; i++)
+		if (chk[i].type == type && chk[i].r.lo == r->lo && chk[i].r.hi == r->hi)
+			return i;
+
+	if (*nchk == RTL8367C_ACLRANGENO)
+		return -ENOSPC;
+
+	chk[*nchk].type = type;
+	chk[*nchk].r = *r;
+	return (*nchk)++;
+}
+
+/* Number of ACL entries a rule takes: one per template it uses */
+static int rtk_acl_entries(const struct rtk_acl_rule *r)
+{
+	bool t0 = r->has_smac || r->has_dmac;
+	bool t1 = r->sip_mask || r->dip_mask ||
+		  (!rtk_acl_range_any(&r->sport) && r->sport_chk < 0) ||
+		  (!rtk_acl_range_any(&r->dport) && r->dport_chk < 0);
+	bool t4 = r->has_vid || r->sport_chk >= 0 || r->dport_chk >= 0;
+
+	return max(t0 + t1 + t4, 1);
+}
+
+/* Assign range checkers, logging counters and entry indices */
+static int rtk_acl_allocate(struct rtk_acl_rule *rules, int n,
+			    struct rtk_acl_checker *chk, int *nchk)
+{
+	int entry = 0, i;
+	u16 mask;
+
+	*nchk = 0;
+	for (i = 0; i < n; i++) {
+		struct rtk_acl_rule *r = &rules[i];
+
+		if (!rtk_acl_range_any(&r->sport) && !rtk_acl_range_mask(&r->sport, &mask)) {
+			r->sport_chk = rtk_acl_checker_get(chk, nchk, PORTRANGE_SPORT, &r->sport);
+			if (r->sport_chk < 0)
+				return r->sport_chk;
+		}
+
+		if (!rtk_acl_range_any(&r->dport) && !rtk_acl_range_mask(&r->dport, &mask)) {
+			r->dport_chk = rtk_acl_checker_get(chk, nchk, PORTRANGE_DPORT, &r->dport);
+			if (r->dport_chk < 0)
+				return r->dport_chk;
+		}
+
+		r->counter = i < RTL8367C_MAX_LOG_CNT_NUM ? i : -1;
+		r->entry = entry;
+		r->entries = rtk_acl_entries(r);
+		entry += r->entries;
+	}
+
+	return entry > RTL8367C_ACLRULENO ? -ENOSPC : 0;
+}
+
+static void rtk_acl_l4_field(rtk_filter_field_t *f, const struct rtk_acl_rule *r,
+			     bool dst, int chk)
+{
+	const struct rtk_acl_range *range = dst ? &r->dport : &r->sport;
+	rtk_filter_value_t *v;
+	u16 mask;
+
+	if (chk >= 0) {
+		f->fieldType = FILTER_FIELD_PORT_RANGE;
+		f->filter_pattern_union.inData.value = BIT(chk);
+		f->filter_pattern_union.inData.mask = BIT(chk);
+		return;
+	}
+
+	rtk_acl_range_mask(range, &mask);
+	if (r->proto == RTK_ACL_PROTO_TCP) {
+		f->fieldType = dst ? FILTER_FIELD_TCP_DPORT : FILTER_FIELD_TCP_SPORT;
+		v = dst ? &f->filter_pattern_union.tcpDstPort : &f->filter_pattern_union.tcpSrcPort;
+	} else {
+		f->fieldType = dst ? FILTER_FIELD_UDP_DPORT : FILTER_FIELD_UDP_SPORT;
+		v = dst ? &f->filter_pattern_union.udpDstPort : &f->filter_pattern_union.udpSrcPort;
+	}
+	v->dataType = FILTER_FIELD_DATA_MASK;
+	v->value = range->lo;
+	v->mask = mask;
+}
+
+static void rtk_acl_mac_field(rtk_filter_field_t *f, rtk_filter_field_type_t type,
+			      const u8 *addr)
+{
+	f->fieldType = type;
+	f->filter_pattern_union.mac.dataType = FILTER_FIELD_DATA_MASK;
+	memcpy(f->filter_pattern_union.mac.value.octet, addr, ETH_ALEN);
+	memset(f->filter_pattern_union.mac.mask.octet, 0xff, ETH_ALEN);
+}
+
+static void rtk_acl_ip_field(rtk_filter_field_t *f, rtk_filter_field_type_t type,
+			     u32 addr, u32 mask)
+{
+	f->fieldType = type;
+	f->filter_pattern_union.ip.dataType = FILTER_FIELD_DATA_MASK;
+	f->filter_pattern_union.ip.value = addr;
+	f->filter_pattern_union.ip.mask = mask;
+}
+
+static int rtk_acl_program(const struct rtk_acl_rule *r)
+{
+	rtk_filter_field_t fields[RTK_ACL_FIELDS_MAX];
+	rtk_filter_action_t act;
+	rtk_filter_cfg_t cfg;
+	rtk_filter_number_t num;
+	int nf = 0, i;
+
+	memset(fields, 0, sizeof(fields));
+	memset(&act, 0, sizeof(act));
+	memset(&cfg, 0, sizeof(cfg));
+
+	if (r->in_ports)
+		cfg.activeport.value.bits[0] = r->in_ports;
+	else
+		RTK_PORTMASK_ALLPORT_SET(cfg.activeport.value);
+	RTK_PORTMASK_ALLPORT_SET(cfg.activeport.mask);
+
+	switch (r->proto) {
+	case RTK_ACL_PROTO_TCP:
+		cfg.careTag.tagType[CARE_TAG_TCP].value = 1;
+		cfg.careTag.tagType[CARE_TAG_TCP].mask = 1;
+		break;
+	case RTK_ACL_PROTO_UDP:
+		cfg.careTag.tagType[CARE_TAG_UDP].value = 1;
+		cfg.careTag.tagType[CARE_TAG_UDP].mask = 1;
+		break;
+	case RTK_ACL_PROTO_ICMP:
+		cfg.careTag.tagType[CARE_TAG_ICMP].value = 1;
+		cfg.careTag.tagType[CARE_TAG_ICMP].mask = 1;
+		break;
+	default:
+		break;
+	}
+
+	if (r->has_smac)
+		rtk_acl_mac_field(&fields[nf++], FILTER_FIELD_SMAC, r->smac);
+	if (r->has_dmac)
+		rtk_acl_mac_field(&fields[nf++], FILTER_FIELD_DMAC, r->dmac);
+	if (r->sip_mask)
+		rtk_acl_ip_field(&fields[nf++], FILTER_FIELD_IPV4_SIP, r->sip, r->sip_mask);
+	if (r->dip_mask)
+		rtk_acl_ip_field(&fields[nf++], FILTER_FIELD_IPV4_DIP, r->dip, r->dip_mask);
+	if (!rtk_acl_range_any(&r->sport))
+		rtk_acl_l4_field(&fields[nf++], r, false, r->sport_chk);
+	if (!rtk_acl_range_any(&r->dport))
+		rtk_acl_l4_field(&fields[nf++], r, true, r->dport_chk);
+	if (r->has_vid) {
+		fields[nf].fieldType = FILTER_FIELD_CTAG;
+		fields[nf].filter_pattern_union.l2tag.vid.value = r->vid;
+		fields[nf].filter_pattern_union.l2tag.vid.mask = 0xfff;
+		nf++;
+	}
+
+	/* a rule without fields still needs one entry to hold the port mask */
+	if (!nf && r->proto == RTK_ACL_PROTO_ANY) {
+		fields[nf].fieldType = FILTER_FIELD_ETHERTYPE;
+		fields[nf].filter_pattern_union.etherType.dataType = FILTER_FIELD_DATA_MASK;
+		nf++;
+	}
+
+	for (i = 0; i < nf; i++)
+		if (rtk_filter_igrAcl_field_add(&cfg, &fields[i]) != RT_ERR_OK)
+			return -EINVAL;
+
+	switch (r->action) {
+	case RTK_ACL_DROP:
+		act.actEnable[FILTER_ENACT_DROP] = TRUE;
+		break;
+	case RTK_ACL_TRAP:
+		act.actEnable[FILTER_ENACT_TRAP_CPU] = TRUE;
+		break;
+	case RTK_ACL_REDIRECT:
+		act.actEnable[FILTER_ENACT_REDIRECT] = TRUE;
+		act.filterPortmask.bits[0] = r->act_ports;
+		break;
+	case RTK_ACL_ISOLATE:
+		act.actEnable[FILTER_ENACT_ISOLATION] = TRUE;
+		act.filterPortmask.bits[0] = r->act_ports;
+		break;
+	}
+
+	/* policing indices past the meters select a logging counter */
+	if (r->counter >= 0) {
+		act.actEnable[FILTER_ENACT_POLICING_0] = TRUE;
+		act.filterPolicingIdx[0] = RTK_METER_NUM + r->counter;
+	}
+
+	/* rtk_filter_igrAcl_cfg_add() only takes free entries */
+	for (i = r->entry; i < r->entry + r->entries && i < rtk_acl_used; i++)
+		if (rtk_filter_igrAcl_cfg_del(i) != RT_ERR_OK)
+			return -EIO;
+
+	if (rtk_filter_igrAcl_cfg_add(r->entry, &cfg, &act, &num) != RT_ERR_OK)
+		return -EIO;
+
+	/* the entries of the next rule were allocated from our estimate */
+	if (num != r->entries)
+		return -EIO;
+
+	return 0;
+}
+
+/* Replace the rules in the ASIC. The new set is written over the old one
+ * entry by entry, each entry is only invalid while its own rule is being
+ * rewritten, and entries the new set does not reach are cleared last. The
+ * range checkers are switched before the rules, so an old rule still in
+ * place may briefly match on the new ranges. The table stage is not used:
+ * rtk_filter_igrAcl_cfg_add() writes the action of an entry before its rule,
+ * and a staged action would leave the rule live on a stale action until the
+ * flush.
+ */
+static int rtk_acl_apply(struct rtk_acl_rule *rules, int n,
+			 const struct rtk_acl_checker *chk, int nchk)
+{
+	int err = 0, end = 0, i;
+
+	if (!rtk_acl_ready) {
+		if (rtk_filter_igrAcl_init() != RT_ERR_OK)
+			return -EIO;
+		rtk_acl_ready = true;
+		rtk_acl_used = 0;
+	}
+
+	for (i = 0; !err && i < RTL8367C_ACLRANGENO; i++) {
+		if (i < nchk)
+			err = rtk_filter_portrange_set(i, chk[i].type, chk[i].r.hi, chk[i].r.lo);
+		else
+			err = rtk_filter_portrange_set(i, PORTRANGE_UNUSED, 0, 0);
+		err = err != RT_ERR_OK ? -EIO : 0;
+	}
+
+	for (i = 0; !err && i < min(n, RTL8367C_MAX_LOG_CNT_NUM); i += 2)
+		if (rtk_stat_logging_counterCfg_set(i, LOGGING_MODE_32BIT,
+						    LOGGING_TYPE_PACKET) != RT_ERR_OK)
+			err = -EIO;
+
+	for (i = 0; !err && i < n; i++) {
+		if (rules[i].counter >= 0)
+			rtk_stat_logging_counter_reset(rules[i].counter);
+		rules[i].cnt_last = 0;
+		err = rtk_acl_program(&rules[i]);
+		end = rules[i].entry + rules[i].entries;
+	}
+
+	for (i = end; !err && i < rtk_acl_used; i++)
+		if (rtk_filter_igrAcl_cfg_del(i) != RT_ERR_OK)
+			err = -EIO;
+
+	/* leave no half programmed rule set behind */
+	if (err) {
+		rtk_filter_igrAcl_cfg_delAll();
+		end = 0;
+	}
+	rtk_acl_used = end;
+
+	return err;
+}
+
+static void rtk_acl_drop(void)
+{
+	kfree(rtk_acl_rules);
+	rtk_acl_rules = NULL;
+	rtk_acl_count = 0;
+	rtk_acl_nchk = 0;
+}
+
+/* Fold the logging counters into the 64 bit hit counts before they wrap */
+static bool rtk_acl_harvest(struct rtk_acl_rule *r)
+{
+	rtk_uint32 cnt;
+
+	if (r->counter < 0 ||
+	    rtk_stat_logging_counter_get(r->counter, &cnt) != RT_ERR_OK)
+		return false;
+
+	r->hits += (u32)(cnt - r->cnt_last);
+	r->cnt_last = cnt;
+	return true;
+}
+
+static void rtk_acl_harvest_work(struct work_struct *work)
+{
+	bool active;
+	int i;
+
+	rtk_gsw_lock();
+	for (i = 0; i < rtk_acl_count; i++)
+		rtk_acl_harvest(&rtk_acl_rules[i]);
+	active = rtk_acl_count > 0;
+	rtk_gsw_unlock();
+
+	if (active)
+		schedule_delayed_work(&rtk_acl_work, RTK_ACL_HARVEST_INTERVAL);
+}
+
+/* A switch reset wipes the ACL table and templates, write the rule set
+ * back. Called with rtk_gsw_lock() held once the switch is up again.
+ */
+void rtl8367s_acl_reset(void)
+{
+	rtk_gsw_assert_locked();
+
+	rtk_acl_ready = false;
+	if (!rtk_acl_count)
+		return;
+
+	/* hits counted since the last harvest went with the reset */
+	if (rtk_acl_apply(rtk_acl_rules, rtk_acl_count, rtk_acl_chk, rtk_acl_nchk)) {
+		pr_err("rtl8367s: acl: failed to restore the rule set\n");
+		rtk_acl_drop();
+	}
+}
+
+static int rtk_acl_load(char *buf)
+{
+	struct rtk_acl_checker chk[RTL8367C_ACLRANGENO];
+	struct rtk_acl_rule *rules;
+	char *line, *hash;
+	int n = 0, lineno = 0, nchk, err;
+
+	rules = kcalloc(RTK_ACL_RULES_MAX, sizeof(*rules), GFP_KERNEL);
+	if (!rules)
+		return -ENOMEM;
+
+	while ((line = strsep(&buf, "\n")) != NULL) {
+		lineno++;
+
+		hash = strchr(line, '#');
+		if (hash)
+			*hash = '\0';
+		line = strim(line);
+		if (!*line)
+			continue;
+
+		if (n == RTK_ACL_RULES_MAX) {
+			err = -ENOSPC;
+			goto out;
+		}
+
+		err = rtk_acl_parse_line(line, &rules[n]);
+		if (err) {
+			pr_err("rtl8367s: acl: invalid rule on line %d\n", lineno);
+			goto out;
+		}
+		rules[n++].line = lineno;
+	}
+
+	n = rtk_acl_compact(rules, n);
+
+	err = rtk_acl_allocate(rules, n, chk, &nchk);
+	if (err) {
+		pr_err("rtl8367s: acl: rule set does not fit into the ACL table\n");
+		goto out;
+	}
+
+	rtk_gsw_lock();
+	err = rtk_acl_apply(rules, n, chk, nchk);
+	if (!err) {
+		swap(rtk_acl_rules, rules);
+		rtk_acl_count = n;
+		memcpy(rtk_acl_chk, chk, sizeof(chk[0]) * nchk);
+		rtk_acl_nchk = nchk;
+	} else {
+		rtk_acl_drop();
+	}
+	rtk_gsw_unlock();
+
+	if (!err && n)
+		schedule_delayed_work(&rtk_acl_work, RTK_ACL_HARVEST_INTERVAL);
+
+out:
+	kfree(rules);
+	return err;
+}
+
+static void rtk_acl_show_ports(struct seq_file *seq, const char *key, u32 mask)
+{
+	unsigned long ports = mask;
+	const char *sep = "";
+	int port;
+
+	seq_printf(seq, key ? " %s " : " ", key);
+	for_each_set_bit(port, &ports, 32) {
+		seq_printf(seq, "%s%d", sep, port);
+		sep = ",";
+	}
+}
+
+static void rtk_acl_show_range(struct seq_file *seq, const char *key,
+			       const struct rtk_acl_range *r)
+{
+	if (rtk_acl_range_any(r))
+		return;
+
+	if (r->lo == r->hi)
+		seq_printf(seq, " %s %u", key, r->lo);
+	else
+		seq_printf(seq, " %s %u-%u", key, r->lo, r->hi);
+}
+
+static void rtk_acl_show_prefix(struct seq_file *seq, const char *key,
+				u32 addr, u32 mask)
+{
+	if (mask)
+		seq_printf(seq, " %s %pI4h/%d", key, &addr, hweight32(mask));
+}
+
+static void rtk_acl_show_rule(struct seq_file *seq, struct rtk_acl_rule *r)
+{
+	static const char * const actions[] = { "drop", "trap", "redirect", "isolate" };
+	static const char * const protos[] = { NULL, "tcp", "udp", "icmp" };
+
+	if (rtk_acl_harvest(r))
+		seq_printf(seq, "%3d %2d %12llu", r->entry, r->entries, r->hits);
+	else
+		seq_printf(seq, "%3d %2d %12s", r->entry, r->entries, "-");
+
+	seq_printf(seq, " %4d %3d  %s", r->line, r->merged, actions[r->action]);
+	if (r->action == RTK_ACL_REDIRECT || r->action == RTK_ACL_ISOLATE)
+		rtk_acl_show_ports(seq, NULL, r->act_ports);
+	if (r->in_ports)
+		rtk_acl_show_ports(seq, "in", r->in_ports);
+	if (protos[r->proto])
+		seq_printf(seq, " proto %s", protos[r->proto]);
+	if (r->has_smac)
+		seq_printf(seq, " src %pM", r->smac);
+	if (r->has_dmac)
+		seq_printf(seq, " dst %pM", r->dmac);
+	rtk_acl_show_prefix(seq, "sip", r->sip, r->sip_mask);
+	rtk_acl_show_prefix(seq, "dip", r->dip, r->dip_mask);
+	rtk_acl_show_range(seq, "sport", &r->sport);
+	rtk_acl_show_range(seq, "dport", &r->dport);
+	if (r->has_vid)
+		seq_printf(seq, " vid %u", r->vid);
+	seq_putc(seq, '\n');
+}
+
+static int rtk_acl_show(struct seq_file *seq, void *v)
+{
+	int i;
+
+	seq_puts(seq, "idx  n         hits line cnt  rule\n");
+
+	rtk_gsw_lock();
+	for (i = 0; i < rtk_acl_count; i++)
+		rtk_acl_show_rule(seq, &rtk_acl_rules[i]);
+	rtk_gsw_unlock();
+
+	return 0;
+}
+
+static int rtk_acl_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rtk_acl_show, NULL);
+}
+
+static ssize_t rtk_acl_write(struct file *file, const char __user *buffer,
+			     size_t count, loff_t *data)
+{
+	char *buf;
+	int err;
+
+	if (count > RTK_ACL_BUF_MAX)
+		return -EFBIG;
+
+	buf = memdup_user_nul(buffer, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	err = rtk_acl_load(buf);
+	kfree(buf);
+
+	return err ? err : count;
+}
+
+const struct proc_ops rtl8367s_acl_fops = {
+	.proc_open = rtk_acl_open,
+	.proc_read = seq_read,
+	.proc_lseek = seq_lseek,
+	.proc_write = rtk_acl_write,
+	.proc_release = single_release
+};
+
+/* called once the proc entry is gone, the rules stay in the ASIC */
+void rtl8367s_acl_exit(void)
+{
+	cancel_delayed_work_sync(&rtk_acl_work);
+
+	rtk_gsw_lock();
+	rtk_acl_drop();
+	rtk_gsw_unlock();
+}
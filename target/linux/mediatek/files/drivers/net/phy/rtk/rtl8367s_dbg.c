@@ -14,6 +14,7 @@
 #include  "./rtl8367c/include/mirror.h"
 #include  "./rtl8367c/include/igmp.h"
 #include  "./rtl8367c/include/leaky.h"
+#include  "./rtl8367c/include/rtl8367c_asicdrv_table.h"
 
 static struct proc_dir_entry *proc_reg_dir;
 static struct proc_dir_entry *proc_esw_cnt;
@@ -23,6 +24,7 @@ static struct proc_dir_entry *proc_reg;
 static struct proc_dir_entry *proc_phyreg;
 static struct proc_dir_entry *proc_mirror;
 static struct proc_dir_entry *proc_igmp;
+static struct proc_dir_entry *proc_acl;
 
 #define PROCREG_ESW_CNT         "esw_cnt"
 #define PROCREG_VLAN            "vlan"
@@ -31,10 +33,13 @@ static struct proc_dir_entry *proc_igmp;
 #define PROCREG_PHYREG            "phyreg"
 #define PROCREG_MIRROR            "mirror"
 #define PROCREG_IGMP            "igmp"
+#define PROCREG_ACL             "acl"
 #define PROCREG_DIR             "rtk_gsw"
 
 #define RTK_SW_VID_RANGE        16
 
+extern const struct proc_ops rtl8367s_acl_fops;
+
 static void rtk_dump_mib_type(rtk_stat_port_type_t cntr_idx)
 {
 	rtk_port_t port;
@@ -210,7 +215,8 @@ static void rtk_hal_read_reg(unsigned int reg_addr)
         ret_t retVal;
 	 unsigned int reg_val;
 
-        retVal = smi_read(reg_addr, &reg_val);
+        /* through the register layer, which keeps the table shadow in sync */
+        retVal = rtl8367c_getAsicReg(reg_addr, &reg_val);
 
         if(retVal != RT_ERR_OK)
                 printk("switch reg read failed\n");
@@ -222,7 +228,7 @@ static void rtk_hal_write_reg(unsigned int reg_addr , unsigned int reg_val)
 {
         ret_t retVal;
 
-    retVal = smi_write(reg_addr, reg_val);
+    retVal = rtl8367c_setAsicReg(reg_addr, reg_val);
 
     if(retVal != RT_ERR_OK)
         printk("switch reg write failed\n");
@@ -343,7 +349,9 @@ static ssize_t mac_tbl_write(struct file *file,
                             const char __user *buffer, size_t count,
                             loff_t *data)
 {
+	rtk_gsw_lock();
 	rtk_hal_clear_table();
+	rtk_gsw_unlock();
 
         return count;
 }
@@ -368,15 +376,19 @@ static ssize_t phyreg_ops(struct file *file,
 
                 if(sscanf(buf, "w %d %x %x", &port,&offset,&val) == -1)
                         return -EFAULT;
-                else
-                        rtk_hal_set_phy_reg(port,offset,val);
+
+                rtk_gsw_lock();
+                rtk_hal_set_phy_reg(port,offset,val);
+                rtk_gsw_unlock();
 
         } else {
 
 		if(sscanf(buf, "r %d %x",&port, &offset) == -1)
                         return -EFAULT;
-                else
-                        rtk_hal_get_phy_reg(port,offset);
+
+                rtk_gsw_lock();
+                rtk_hal_get_phy_reg(port,offset);
+                rtk_gsw_unlock();
         }
 
         return count;
@@ -400,15 +412,19 @@ static ssize_t reg_ops(struct file *file,
 
                 if(sscanf(buf, "w %x %x", &offset,&val) == -1)
                         return -EFAULT;
-                else
-                        rtk_hal_write_reg(offset,val);
+
+                rtk_gsw_lock();
+                rtk_hal_write_reg(offset,val);
+                rtk_gsw_unlock();
 
         } else {
 
                 if(sscanf(buf, "r %x", &offset) == -1)
                         return -EFAULT;
-                else
-                        rtk_hal_read_reg(offset);
+
+                rtk_gsw_lock();
+                rtk_hal_read_reg(offset);
+                rtk_gsw_unlock();
         }
 
         return count;
@@ -429,8 +445,10 @@ static ssize_t mirror_ops(struct file *file,
 
 	if(sscanf(buf, "%d %x %x", &port,&rx_map,&tx_map) == -1)
 		return -EFAULT;
-	else
-		rtk_hal_set_port_mirror(port,rx_map,tx_map);
+
+	rtk_gsw_lock();
+	rtk_hal_set_port_mirror(port,rx_map,tx_map);
+	rtk_gsw_unlock();
 
         return count;
 }
@@ -449,12 +467,14 @@ static ssize_t igmp_ops(struct file *file,
 	if(sscanf(buf, "%d", &ops) == -1)
 		return -EFAULT;
 
+        rtk_gsw_lock();
         if(ops == 0)
                 rtk_hal_disable_igmpsnoop();
 	else if (ops == 1)
 		rtk_hal_enable_igmpsnoop(0);
 	else //hw igmp
 		rtk_hal_enable_igmpsnoop(1);
+        rtk_gsw_unlock();
 
         return count;
 }
@@ -462,19 +482,25 @@ static ssize_t igmp_ops(struct file *file,
 
 static int esw_cnt_read(struct seq_file *seq, void *v)
 {
+	rtk_gsw_lock();
 	rtk_hal_dump_mib();
+	rtk_gsw_unlock();
 	return 0;
 }
 
 static int vlan_read(struct seq_file *seq, void *v)
 {
+	rtk_gsw_lock();
 	rtk_hal_dump_vlan();
+	rtk_gsw_unlock();
 	return 0;
 }
 
 static int mac_tbl_read(struct seq_file *seq, void *v)
 {
+	rtk_gsw_lock();
 	rtk_hal_dump_table();
+	rtk_gsw_unlock();
 	return 0;
 }
 
@@ -636,6 +662,12 @@ int gsw_debug_proc_init(void)
 	if (!proc_igmp)
 		pr_err("!! FAIL to create %s PROC !!\n", PROCREG_IGMP);
 
+	proc_acl =
+	proc_create(PROCREG_ACL, 0, proc_reg_dir, &rtl8367s_acl_fops);
+
+	if (!proc_acl)
+		pr_err("!! FAIL to create %s PROC !!\n", PROCREG_ACL);
+
 	return 0;
 }
 
@@ -643,6 +675,9 @@ void gsw_debug_proc_exit(void)
 {
 	if (proc_esw_cnt)
 		remove_proc_entry(PROCREG_ESW_CNT, proc_reg_dir);
+
+	if (proc_acl)
+		remove_proc_entry(PROCREG_ACL, proc_reg_dir);
 }
 
 
@@ -0,0 +1,414 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Periodic LUT walker: mirrors the addresses learned by the switch into
+ * the Linux bridge as switchdev FDB notifications, so the bridge stops
+ * flooding towards the CPU port for stations it already knows about.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/etherdevice.h>
+#include <linux/hashtable.h>
+#include <linux/if_bridge.h>
+#include <linux/if_vlan.h>
+#include <linux/jhash.h>
+#include <linux/netdevice.h>
+#include <linux/of_net.h>
+#include <linux/rtnetlink.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <net/switchdev.h>
+#include <asm/unaligned.h>
+
+#include  "./rtl8367c/include/rtk_switch.h"
+#include  "./rtl8367c/include/l2.h"
+#include  "./rtl8367c/include/vlan.h"
+#include  "./rtl8367c/include/rtl8367c_asicdrv_table.h"
+
+/* walk interval bounds, the interval doubles while the LUT is quiet */
+#define RTK_FDB_INTERVAL_MIN	(HZ)
+#define RTK_FDB_INTERVAL_MAX	(16 * HZ)
+/* LUT entries read per work run, a full walk is split into slices */
+#define RTK_FDB_SLICE		128
+/* pause between two slices of the same walk */
+#define RTK_FDB_SLICE_DELAY	(HZ / 20)
+#define RTK_FDB_MAX_ENTRIES	(RTK_MAX_LUT_ADDRESS)
+#define RTK_FDB_HASH_BITS	8
+
+struct rtk_fdb_entry {
+	struct hlist_node node;
+	struct list_head event;
+	u8 addr[ETH_ALEN];
+	u16 vid;
+	u32 port;
+	u32 gen;
+	/* where the entry was announced, 0 if not announced */
+	int ifindex;
+	u16 br_vid;
+	bool add;
+};
+
+struct rtk_fdb {
+	struct delayed_work work;
+	struct device_node *np;
+	int conduit;
+	DECLARE_HASHTABLE(table, RTK_FDB_HASH_BITS);
+	struct list_head events;
+	unsigned int count;
+	unsigned long interval;
+	rtk_uint32 address;
+	u32 gen;
+	bool changed;
+	/* VLANs looked up during the current walk, and those reaching the
+	 * conduit through EXT_PORT0
+	 */
+	DECLARE_BITMAP(vlan_seen, VLAN_N_VID);
+	DECLARE_BITMAP(vlan_lan, VLAN_N_VID);
+};
+
+static struct rtk_fdb *_fdb;
+
+static u32 rtk_fdb_hash(const u8 *addr, u16 vid)
+{
+	return jhash_2words(get_unaligned((const u32 *)addr),
+			    get_unaligned((const u16 *)(addr + 4)) | (vid << 16),
+			    0);
+}
+
+static struct rtk_fdb_entry *rtk_fdb_find(struct rtk_fdb *fdb, const u8 *addr,
+					  u16 vid)
+{
+	struct rtk_fdb_entry *e;
+
+	hash_for_each_possible(fdb->table, e, node, rtk_fdb_hash(addr, vid))
+		if (e->vid == vid && ether_addr_equal(e->addr, addr))
+			return e;
+
+	return NULL;
+}
+
+static void rtk_fdb_queue(struct rtk_fdb *fdb, struct rtk_fdb_entry *e,
+			  bool add)
+{
+	e->add = add;
+	if (list_empty(&e->event))
+		list_add_tail(&e->event, &fdb->events);
+	fdb->changed = true;
+}
+
+/* Only addresses learned on front ports are of interest, anything behind
+ * the extension ports is the host itself.
+ */
+static bool rtk_fdb_port_valid(u32 port)
+{
+	return port <= UTP_PORT4;
+}
+
+/* Only VLANs with EXT_PORT0 as a member end up on the conduit, the WAN
+ * VLAN goes out through the other MAC and must not reach the LAN bridge.
+ */
+static bool rtk_fdb_vlan_lan(struct rtk_fdb *fdb, u32 port, rtk_uint32 ivl,
+			     rtk_uint32 cvid)
+{
+	rtk_vlan_cfg_t vlan;
+	rtk_vlan_t vid;
+	rtk_pri_t pri;
+
+	if (ivl)
+		vid = cvid;
+	else if (rtk_vlan_portPvid_get(port, &vid, &pri) != RT_ERR_OK)
+		return false;
+
+	if (vid >= VLAN_N_VID)
+		return false;
+
+	if (!test_and_set_bit(vid, fdb->vlan_seen)) {
+		memset(&vlan, 0, sizeof(vlan));
+		if (rtk_vlan_get(vid, &vlan) == RT_ERR_OK &&
+		    RTK_PORTMASK_IS_PORT_SET(vlan.mbr, EXT_PORT0))
+			set_bit(vid, fdb->vlan_lan);
+	}
+
+	return test_bit(vid, fdb->vlan_lan);
+}
+
+static void rtk_fdb_learn(struct rtk_fdb *fdb, rtk_l2_ucastAddr_t *l2)
+{
+	struct rtk_fdb_entry *e;
+	u16 vid = l2->ivl ? l2->cvid : 0;
+
+	if (l2->is_static || !rtk_fdb_port_valid(l2->port))
+		return;
+
+	if (!rtk_fdb_vlan_lan(fdb, l2->port, l2->ivl, l2->cvid))
+		return;
+
+	e = rtk_fdb_find(fdb, l2->mac.octet, vid);
+	if (!e) {
+		if (fdb->count >= RTK_FDB_MAX_ENTRIES)
+			return;
+
+		e = kzalloc(sizeof(*e), GFP_KERNEL);
+		if (!e)
+			return;
+
+		ether_addr_copy(e->addr, l2->mac.octet);
+		e->vid = vid;
+		e->port = l2->port;
+		INIT_LIST_HEAD(&e->event);
+		hash_add(fdb->table, &e->node, rtk_fdb_hash(e->addr, vid));
+		fdb->count++;
+		rtk_fdb_queue(fdb, e, true);
+	} else if (e->port != l2->port) {
+		/* station moved, the bridge updates the port on re-add */
+		e->port = l2->port;
+		rtk_fdb_queue(fdb, e, true);
+	}
+
+	e->gen = fdb->gen;
+}
+
+static void rtk_fdb_age(struct rtk_fdb *fdb)
+{
+	struct rtk_fdb_entry *e;
+	int bkt;
+
+	hash_for_each(fdb->table, bkt, e, node)
+		if (e->gen != fdb->gen)
+			rtk_fdb_queue(fdb, e, false);
+}
+
+/* The ethernet driver may probe after us, resolve the conduit lazily and
+ * remember it by ifindex so that no reference is held across walks.
+ */
+static void rtk_fdb_resolve_conduit(struct rtk_fdb *fdb)
+{
+	struct device_node *eth;
+	struct net_device *dev;
+
+	if (fdb->conduit)
+		return;
+
+	eth = of_parse_phandle(fdb->np, "mediatek,ethernet", 0);
+	if (!eth)
+		return;
+
+	dev = of_find_net_device_by_node(eth);
+	of_node_put(eth);
+
+	if (dev) {
+		fdb->conduit = dev->ifindex;
+		dev_put(dev);
+	}
+}
+
+/* Pick the bridge port carrying the VLAN: the 802.1Q upper of the conduit
+ * if there is one, the conduit itself otherwise.
+ */
+static struct net_device *rtk_fdb_brport(struct rtk_fdb *fdb, u16 vid,
+					 u16 *br_vid)
+{
+	struct net_device *conduit, *dev = NULL, *br;
+
+	conduit = __dev_get_by_index(&init_net, fdb->conduit);
+	if (!conduit)
+		return NULL;
+
+	if (vid)
+		dev = __vlan_find_dev_deep_rcu(conduit, htons(ETH_P_8021Q), vid);
+
+	if (dev) {
+		*br_vid = 0;
+	} else {
+		dev = conduit;
+		br = netdev_master_upper_dev_get(dev);
+		*br_vid = (br && br_vlan_enabled(br)) ? vid : 0;
+	}
+
+	return netif_is_bridge_port(dev) ? dev : NULL;
+}
+
+static void rtk_fdb_notify(struct net_device *dev, unsigned long type,
+			   const u8 *addr, u16 vid)
+{
+	struct switchdev_notifier_fdb_info info = {
+		.addr = addr,
+		.vid = vid,
+		.offloaded = true,
+	};
+
+	call_switchdev_notifiers(type, dev, &info.info, NULL);
+}
+
+/* Push the queued deltas to the bridge under a single rtnl section */
+static void rtk_fdb_flush_events(struct rtk_fdb *fdb)
+{
+	struct rtk_fdb_entry *e, *tmp;
+	struct net_device *dev;
+	u16 br_vid;
+
+	if (list_empty(&fdb->events))
+		return;
+
+	rtk_fdb_resolve_conduit(fdb);
+
+	rtnl_lock();
+	rcu_read_lock();
+
+	list_for_each_entry_safe(e, tmp, &fdb->events, event) {
+		list_del_init(&e->event);
+
+		if (e->ifindex) {
+			dev = __dev_get_by_index(&init_net, e->ifindex);
+			if (dev)
+				rtk_fdb_notify(dev, SWITCHDEV_FDB_DEL_TO_BRIDGE,
+					       e->addr, e->br_vid);
+			e->ifindex = 0;
+		}
+
+		if (!e->add) {
+			hash_del(&e->node);
+			fdb->count--;
+			kfree(e);
+			continue;
+		}
+
+		dev = rtk_fdb_brport(fdb, e->vid, &br_vid);
+		if (!dev)
+			continue;
+
+		rtk_fdb_notify(dev, SWITCHDEV_FDB_ADD_TO_BRIDGE, e->addr, br_vid);
+		e->ifindex = dev->ifindex;
+		e->br_vid = br_vid;
+	}
+
+	rcu_read_unlock();
+	rtnl_unlock();
+}
+
+static void rtk_fdb_work(struct work_struct *work)
+{
+	struct rtk_fdb *fdb = container_of(work, struct rtk_fdb, work.work);
+	rtk_l2_ucastAddr_t l2;
+	rtk_uint32 address;
+	int n;
+
+	/* the VLAN layout may change between walks, e.g. through swconfig */
+	if (!fdb->address) {
+		bitmap_zero(fdb->vlan_seen, VLAN_N_VID);
+		bitmap_zero(fdb->vlan_lan, VLAN_N_VID);
+	}
+
+	rtk_gsw_lock();
+	for (n = 0; n < RTK_FDB_SLICE; n++) {
+		address = fdb->address;
+		memset(&l2, 0, sizeof(l2));
+
+		if (rtk_l2_addr_next_get(READMETHOD_NEXT_L2UC, UTP_PORT0,
+					 &address, &l2) != RT_ERR_OK)
+			break;
+
+		rtk_fdb_learn(fdb, &l2);
+
+		fdb->address = address + 1;
+		if (fdb->address > RTK_MAX_LUT_ADDR_ID)
+			break;
+	}
+	rtk_gsw_unlock();
+
+	if (n == RTK_FDB_SLICE) {
+		/* more of this walk to go, announce what we have so far */
+		rtk_fdb_flush_events(fdb);
+		schedule_delayed_work(&fdb->work, RTK_FDB_SLICE_DELAY);
+		return;
+	}
+
+	/* walk complete, whatever was not seen has aged out */
+	rtk_fdb_age(fdb);
+	rtk_fdb_flush_events(fdb);
+
+	if (fdb->changed)
+		fdb->interval = RTK_FDB_INTERVAL_MIN;
+	else
+		fdb->interval = min(fdb->interval * 2, RTK_FDB_INTERVAL_MAX);
+
+	fdb->changed = false;
+	fdb->address = 0;
+	fdb->gen++;
+
+	schedule_delayed_work(&fdb->work, fdb->interval);
+}
+
+int rtl8367s_fdb_init(struct device_node *np)
+{
+	struct rtk_fdb *fdb;
+
+	if (!of_property_read_bool(np, "mediatek,ethernet"))
+		return 0;
+
+	fdb = kzalloc(sizeof(*fdb), GFP_KERNEL);
+	if (!fdb)
+		return -ENOMEM;
+
+	fdb->np = of_node_get(np);
+	hash_init(fdb->table);
+	INIT_LIST_HEAD(&fdb->events);
+	INIT_DELAYED_WORK(&fdb->work, rtk_fdb_work);
+	fdb->interval = RTK_FDB_INTERVAL_MIN;
+	fdb->gen = 1;
+
+	_fdb = fdb;
+
+	schedule_delayed_work(&fdb->work, fdb->interval);
+
+	return 0;
+}
+
+/* A switch reset flushes the LUT, keep the walker off the switch until it
+ * is done and restart the walk from the beginning afterwards.
+ */
+void rtl8367s_fdb_stop(void)
+{
+	if (_fdb)
+		cancel_delayed_work_sync(&_fdb->work);
+}
+
+void rtl8367s_fdb_start(void)
+{
+	struct rtk_fdb *fdb = _fdb;
+
+	if (!fdb)
+		return;
+
+	fdb->address = 0;
+	fdb->interval = RTK_FDB_INTERVAL_MIN;
+	schedule_delayed_work(&fdb->work, fdb->interval);
+}
+
+void rtl8367s_fdb_exit(void)
+{
+	struct rtk_fdb *fdb = _fdb;
+
+	if (!fdb)
+		return;
+
+	cancel_delayed_work_sync(&fdb->work);
+
+	/* withdraw everything that was announced */
+	fdb->gen++;
+	rtk_fdb_age(fdb);
+	rtk_fdb_flush_events(fdb);
+
+	of_node_put(fdb->np);
+	kfree(fdb);
+	_fdb = NULL;
+}
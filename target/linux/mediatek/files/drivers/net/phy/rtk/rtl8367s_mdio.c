@@ -16,6 +16,7 @@
 #include <linux/init.h>
 #include <linux/device.h>
 #include <linux/delay.h>
+#include <linux/mutex.h>
 #include <linux/of_mdio.h>
 #include <linux/of_platform.h>
 #include <linux/of_gpio.h>
@@ -25,6 +26,7 @@
 #include  "./rtl8367c/include/port.h"
 #include  "./rtl8367c/include/vlan.h"
 #include  "./rtl8367c/include/rtl8367c_asicdrv_port.h"
+#include  "./rtl8367c/include/rtl8367c_asicdrv_table.h"
 
 struct rtk_gsw {
  	struct device           *dev;
@@ -34,8 +36,36 @@ struct rtk_gsw {
 
 static struct rtk_gsw *_gsw;
 
+/* Serializes all switch access. The SDK register helpers, and the table
+ * write shadow, stage and cache behind them, are not reentrant, and most
+ * operations are multi-register sequences.
+ */
+static DEFINE_MUTEX(rtk_gsw_mutex);
+
+void rtk_gsw_lock(void)
+{
+	mutex_lock(&rtk_gsw_mutex);
+}
+
+void rtk_gsw_unlock(void)
+{
+	mutex_unlock(&rtk_gsw_mutex);
+}
+
+void rtk_gsw_assert_locked(void)
+{
+	lockdep_assert_held(&rtk_gsw_mutex);
+}
+
 extern int gsw_debug_proc_init(void);
 extern void gsw_debug_proc_exit(void);
+extern void rtl8367s_acl_exit(void);
+extern void rtl8367s_acl_reset(void);
+
+extern int rtl8367s_fdb_init(struct device_node *np);
+extern void rtl8367s_fdb_exit(void);
+extern void rtl8367s_fdb_stop(void);
+extern void rtl8367s_fdb_start(void);
 
 #ifdef CONFIG_SWCONFIG
 extern int rtl8367s_swconfig_init( void (*reset_func)(void) );
@@ -98,6 +128,9 @@ static int rtl8367s_hw_reset(void)
 static int rtl8367s_vlan_config(int want_at_p0)
 {
 	rtk_vlan_cfg_t vlan1, vlan2;
+
+	/* Stage the 4K table writes and flush them together */
+	rtl8367c_setAsicTableStage(ENABLED);
 	
 	/* Set LAN/WAN VLAN partition */
 	memset(&vlan1, 0x00, sizeof(rtk_vlan_cfg_t));
@@ -139,6 +172,8 @@ static int rtl8367s_vlan_config(int want_at_p0)
 	vlan2.ivl_en = 1;
 	rtk_vlan_set(2, &vlan2);
 
+	rtl8367c_setAsicTableStage(DISABLED);
+
 	rtk_vlan_portPvid_set(EXT_PORT0, 1, 0);
 	rtk_vlan_portPvid_set(UTP_PORT1, 1, 0);
 	rtk_vlan_portPvid_set(UTP_PORT2, 1, 0);
@@ -161,6 +196,9 @@ static int rtl8367s_hw_init(void)
 
 	rtl8367s_hw_reset();
 
+	/* nothing shadowed or cached survives the reset */
+	rtl8367c_resetAsicTableCache();
+
 	if(rtk_switch_init())
 	        return -1;
 
@@ -215,9 +253,16 @@ static void set_rtl8367s_rgmii(void)
 
 void init_gsw(void)
 {
+	rtl8367s_fdb_stop();
+
+	rtk_gsw_lock();
 	rtl8367s_hw_init();
 	set_rtl8367s_sgmii();
 	set_rtl8367s_rgmii();
+	rtl8367s_acl_reset();
+	rtk_gsw_unlock();
+
+	rtl8367s_fdb_start();
 }
 
 // bleow are platform driver
@@ -265,21 +310,31 @@ static int rtk_gsw_probe(struct platform_device *pdev)
 	if(!of_property_read_string(pdev->dev.of_node,
 						"mediatek,port_map", &pm)) {
 
+		rtk_gsw_lock();
 		if (!strcasecmp(pm, "wllll"))
 			rtl8367s_vlan_config(1); 
 		else
 			rtl8367s_vlan_config(0);
+		rtk_gsw_unlock();
 		
 		} else {
 #ifdef CONFIG_SWCONFIG		
 		rtl8367s_swconfig_init(&init_gsw);
 #else
+		rtk_gsw_lock();
 		rtl8367s_vlan_config(0);
+		rtk_gsw_unlock();
 #endif
 	}
 
 	gsw_debug_proc_init();
 
+	/* mirror learned addresses to the bridge, needs mediatek,ethernet
+	 * pointing at the MAC connected to the LAN side of the switch
+	 */
+	if (rtl8367s_fdb_init(np))
+		dev_warn(&pdev->dev, "learned address sync disabled\n");
+
 	platform_set_drvdata(pdev, gsw);
 
 	return 0;
@@ -289,7 +344,9 @@ static int rtk_gsw_probe(struct platform_device *pdev)
 static int rtk_gsw_remove(struct platform_device *pdev)
 {
 	platform_set_drvdata(pdev, NULL);
+	rtl8367s_fdb_exit();
 	gsw_debug_proc_exit();
+	rtl8367s_acl_exit();
 
 	return 0;
 }
@@ -43,11 +43,18 @@
 #include <linux/proc_fs.h>
 #include <linux/string.h>
 #include <linux/uaccess.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/spinlock.h>
 // #include <mach/mt6575_gpt.h> /* --- by chhung */
 #include "dbg.h"
 #include "mt6575_sd.h"
 #include <linux/seq_file.h>
 
+/* request statistics */
+static struct msdc_stats msdc_stats[MSDC_STATS_HOSTS];
+static DEFINE_SPINLOCK(msdc_stats_lock);
+
 /* for debug zone */
 unsigned int sd_debug_zone[4] = {
 	0,
@@ -305,3 +312,112 @@ void msdc_debug_proc_init(void)
 }
 EXPORT_SYMBOL_GPL(msdc_debug_proc_init);
 #endif
+
+//========== request statistics ===========
+void msdc_stats_update(int id, int read, u32 bytes, s64 us, int error)
+{
+	struct msdc_stats_dir *dir;
+	unsigned long flags;
+	u32 bucket;
+
+	if (id < 0 || id >= MSDC_STATS_HOSTS)
+		return;
+
+	if (us < 0)
+		us = 0;
+	if (us > U32_MAX)
+		us = U32_MAX;
+
+	/* bucket n holds latencies below 2^(n + 1) us */
+	bucket = us ? ilog2((u32)us) : 0;
+	if (bucket >= MSDC_STATS_BUCKETS)
+		bucket = MSDC_STATS_BUCKETS - 1;
+
+	spin_lock_irqsave(&msdc_stats_lock, flags);
+	dir = read ? &msdc_stats[id].rx : &msdc_stats[id].tx;
+	dir->count++;
+	dir->bytes += bytes;
+	dir->time_us += us;
+	if (us > dir->max_us)
+		dir->max_us = us;
+	if (error)
+		dir->errors++;
+	dir->lat[bucket]++;
+	spin_unlock_irqrestore(&msdc_stats_lock, flags);
+}
+
+static void msdc_stats_show_dir(struct seq_file *s, const char *name,
+				const struct msdc_stats_dir *dir)
+{
+	u32 kbps = 0;
+	int i;
+
+	if (dir->time_us)
+		kbps = div64_u64(dir->bytes * 1000, dir->time_us);
+
+	seq_printf(s, "  %s: count<%u> errors<%u> bytes<%llu> kB/s<%u> avg<%lluus> max<%uus>\n",
+		   name, dir->count, dir->errors, dir->bytes, kbps,
+		   dir->count ? div_u64(dir->time_us, dir->count) : 0,
+		   dir->max_us);
+
+	for (i = 0; i < MSDC_STATS_BUCKETS; i++) {
+		if (!dir->lat[i])
+			continue;
+		seq_printf(s, "    <%8uus: %u\n", 2U << i, dir->lat[i]);
+	}
+}
+
+static int msdc_stats_proc_read(struct seq_file *s, void *p)
+{
+	struct msdc_stats stats;
+	int id;
+
+	for (id = 0; id < MSDC_STATS_HOSTS; id++) {
+		spin_lock_irq(&msdc_stats_lock);
+		stats = msdc_stats[id];
+		spin_unlock_irq(&msdc_stats_lock);
+
+		if (!stats.rx.count && !stats.tx.count)
+			continue;
+
+		seq_printf(s, "MSDC[%d]\n", id);
+		msdc_stats_show_dir(s, "read ", &stats.rx);
+		msdc_stats_show_dir(s, "write", &stats.tx);
+	}
+
+	return 0;
+}
+
+/* any write clears the statistics */
+static ssize_t msdc_stats_proc_write(struct file *file,
+				     const char __user *buf, size_t count, loff_t *data)
+{
+	spin_lock_irq(&msdc_stats_lock);
+	memset(msdc_stats, 0, sizeof(msdc_stats));
+	spin_unlock_irq(&msdc_stats_lock);
+
+	return count;
+}
+
+static int msdc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msdc_stats_proc_read, NULL);
+}
+
+static const struct proc_ops msdc_stats_fops = {
+	.proc_open	= msdc_stats_open,
+	.proc_read	= seq_read,
+	.proc_write	= msdc_stats_proc_write,
+	.proc_lseek	= seq_lseek,
+	.proc_release	= single_release,
+};
+
+void msdc_stats_proc_init(void)
+{
+	proc_create("msdc_stats", 0644, NULL, &msdc_stats_fops);
+}
+
+void msdc_stats_proc_exit(void)
+{
+	remove_proc_entry("msdc_stats", NULL);
+}
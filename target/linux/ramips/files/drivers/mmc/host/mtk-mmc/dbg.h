@@ -145,6 +145,28 @@ do { \
 
 void msdc_debug_proc_init(void);
 
+/* per host request statistics, /proc/msdc_stats */
+#define MSDC_STATS_HOSTS    (4)
+#define MSDC_STATS_BUCKETS  (16)   /* latency buckets, 2^n us */
+
+struct msdc_stats_dir {
+	u64 bytes;
+	u64 time_us;          /* sum of request latencies */
+	u32 count;
+	u32 errors;
+	u32 max_us;
+	u32 lat[MSDC_STATS_BUCKETS];
+};
+
+struct msdc_stats {
+	struct msdc_stats_dir rx;
+	struct msdc_stats_dir tx;
+};
+
+void msdc_stats_update(int id, int read, u32 bytes, s64 us, int error);
+void msdc_stats_proc_init(void);
+void msdc_stats_proc_exit(void);
+
 #if 0 /* --- chhung */
 void msdc_init_gpt(void);
 extern void GPT_GetCounter64(UINT32 *cntL32, UINT32 *cntH32);
@@ -889,10 +889,14 @@ struct msdc_regs {
 	struct msdc_eco_ver_reg    eco_ver;       /* base+0x104h */
 };
 
+/* descriptor sets, one for the running request and one for the next */
+#define MSDC_DMA_SETS       (2)
+
 struct msdc_dma {
 	u32 sglen;                   /* size of scatter list */
 	struct scatterlist *sg;      /* I/O scatter list */
 	u8  mode;                    /* dma mode        */
+	u8  busy;                    /* owned by a request */
 
 	struct gpd *gpd;                  /* pointer to gpd array */
 	struct bd  *bd;                   /* pointer to bd array */
@@ -920,7 +924,7 @@ struct msdc_host {
 
 	u32                         xfer_size;      /* total transferred size */
 
-	struct msdc_dma             dma;            /* dma channel */
+	struct msdc_dma             dma[MSDC_DMA_SETS]; /* dma descriptor sets */
 	u32                         dma_xfer_size;  /* dma transfer size in bytes */
 
 	u32                         timeout_ns;     /* data timeout ns */
@@ -929,6 +933,9 @@ struct msdc_host {
 	int                         irq;            /* host interrupt */
 
 	struct delayed_work		card_delaywork;
+	struct workqueue_struct     *req_wq;        /* runs the requests */
+	struct work_struct          req_work;
+	ktime_t                     req_start;      /* for msdc_stats */
 
 	struct completion           cmd_done;
 	struct completion           xfer_done;
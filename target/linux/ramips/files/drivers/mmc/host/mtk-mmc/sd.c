@@ -40,6 +40,8 @@
 #include <linux/platform_device.h>
 #include <linux/interrupt.h>
 #include <linux/of.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
 
 #include <linux/mmc/host.h>
 #include <linux/mmc/mmc.h>
@@ -1048,11 +1050,8 @@ static u8 msdc_dma_calcs(u8 *buf, u32 len)
 static void msdc_dma_config(struct msdc_host *host, struct msdc_dma *dma)
 {
 	void __iomem *base = host->base;
-	//u32 i, j, num, bdlen, arg, xfersz;
-	u32 j, num;
-	struct scatterlist *sg;
+	struct scatterlist *sg = dma->sg;
 	struct gpd *gpd;
-	struct bd *bd;
 
 	switch (dma->mode) {
 	case MSDC_MODE_DMA_BASIC:
@@ -1072,37 +1071,17 @@ static void msdc_dma_config(struct msdc_host *host, struct msdc_dma *dma)
 		sdr_set_field(MSDC_DMA_CTRL, MSDC_DMA_CTRL_MODE, 0);
 		break;
 	case MSDC_MODE_DMA_DESC:
-
-		/* calculate the required number of gpd */
-		num = (dma->sglen + MAX_BD_PER_GPD - 1) / MAX_BD_PER_GPD;
-		BUG_ON(num != 1);
-
+		/* the bd list was built by msdc_dma_prepare(), hand the gpd
+		 * back to the hardware, which clears hwo on every run.
+		 */
 		gpd = dma->gpd;
-		bd  = dma->bd;
 
-		/* modify gpd*/
 		//gpd->intr = 0;
 		gpd->hwo = 1;  /* hw will clear it */
 		gpd->bdp = 1;
 		gpd->chksum = 0;  /* need to clear first. */
 		gpd->chksum = msdc_dma_calcs((u8 *)gpd, 16);
 
-		/* modify bd*/
-		for_each_sg(dma->sg, sg, dma->sglen, j) {
-			bd[j].blkpad = 0;
-			bd[j].dwpad = 0;
-			bd[j].ptr = (void *)sg_dma_address(sg);
-			bd[j].buflen = sg_dma_len(sg);
-
-			if (j == dma->sglen - 1)
-				bd[j].eol = 1;	/* the last bd */
-			else
-				bd[j].eol = 0;
-
-			bd[j].chksum = 0; /* checksume need to clear first */
-			bd[j].chksum = msdc_dma_calcs((u8 *)(&bd[j]), 16);
-		}
-
 		sdr_set_field(MSDC_DMA_CFG, MSDC_DMA_CFG_DECSEN, 1);
 		sdr_set_field(MSDC_DMA_CTRL, MSDC_DMA_CTRL_BRUSTSZ,
 			      MSDC_BRUST_64B);
@@ -1121,9 +1100,15 @@ static void msdc_dma_config(struct msdc_host *host, struct msdc_dma *dma)
 
 }
 
-static void msdc_dma_setup(struct msdc_host *host, struct msdc_dma *dma,
-			   struct scatterlist *sg, unsigned int sglen)
+/* build the bd list, touches descriptor memory only and may therefore run
+ * from pre_req while another request owns the controller.
+ */
+static void msdc_dma_prepare(struct msdc_host *host, struct msdc_dma *dma,
+			     struct scatterlist *sg, unsigned int sglen)
 {
+	struct bd *bd = dma->bd;
+	u32 j;
+
 	BUG_ON(sglen > MAX_BD_NUM); /* not support currently */
 
 	dma->sg = sg;
@@ -1131,10 +1116,75 @@ static void msdc_dma_setup(struct msdc_host *host, struct msdc_dma *dma,
 
 	dma->mode = MSDC_MODE_DMA_DESC;
 
+	for_each_sg(dma->sg, sg, dma->sglen, j) {
+		bd[j].blkpad = 0;
+		bd[j].dwpad = 0;
+		bd[j].ptr = (void *)sg_dma_address(sg);
+		bd[j].buflen = sg_dma_len(sg);
+
+		if (j == dma->sglen - 1)
+			bd[j].eol = 1;	/* the last bd */
+		else
+			bd[j].eol = 0;
+
+		bd[j].chksum = 0; /* checksume need to clear first */
+		bd[j].chksum = msdc_dma_calcs((u8 *)(&bd[j]), 16);
+	}
+
 	N_MSG(DMA, "DMA mode<%d> sglen<%d> xfersz<%d>", dma->mode, dma->sglen,
 	      host->xfer_size);
+}
+
+static struct msdc_dma *msdc_dma_get(struct msdc_host *host)
+{
+	int i;
+
+	for (i = 0; i < MSDC_DMA_SETS; i++) {
+		if (!host->dma[i].busy) {
+			host->dma[i].busy = 1;
+			return &host->dma[i];
+		}
+	}
 
-	msdc_dma_config(host, dma);
+	return NULL;
+}
+
+/* map the data and build its descriptors, returns the set index + 1 */
+static int msdc_dma_map(struct msdc_host *host, struct mmc_data *data)
+{
+	struct msdc_dma *dma;
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->lock, flags);
+	dma = msdc_dma_get(host);
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	if (!dma)
+		return 0;
+
+	data->sg_count = dma_map_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+				    mmc_get_dma_dir(data));
+	if (!data->sg_count) {
+		dma->busy = 0;
+		return 0;
+	}
+
+	msdc_dma_prepare(host, dma, data->sg, data->sg_count);
+
+	return dma - host->dma + 1;
+}
+
+static void msdc_dma_unmap(struct msdc_host *host, struct mmc_data *data,
+			   int cookie)
+{
+	unsigned long flags;
+
+	dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+		     mmc_get_dma_dir(data));
+
+	spin_lock_irqsave(&host->lock, flags);
+	host->dma[cookie - 1].busy = 0;
+	spin_unlock_irqrestore(&host->lock, flags);
 }
 
 static int msdc_do_request(struct mmc_host *mmc, struct mmc_request *mrq)
@@ -1146,6 +1196,7 @@ static int msdc_do_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	void __iomem *base = host->base;
 	//u32 intsts = 0;
 	int read = 1, send_type = 0;
+	int cookie = 0;
 
 #define SND_DAT 0
 #define SND_CMD 1
@@ -1186,6 +1237,27 @@ static int msdc_do_request(struct mmc_host *mmc, struct mmc_request *mrq)
 			}
 		}
 
+		/* mapped by pre_req already, or done here for the
+		 * requests which do not come through the block layer.
+		 */
+		cookie = data->host_cookie;
+		if (!cookie) {
+			spin_unlock(&host->lock);
+			cookie = msdc_dma_map(host, data);
+			spin_lock(&host->lock);
+			if (!cookie) {
+				ERR_MSG("XXX CMD<%d> no dma descriptors", cmd->opcode);
+				data->error = -ENOMEM;
+				goto done;
+			}
+		}
+
+		/* CMD23 for a pre-defined multi block transfer */
+		if (mrq->sbc) {
+			if (msdc_do_command(host, mrq->sbc, 1, CMD_TIMEOUT) != 0)
+				goto done;
+		}
+
 		sdr_write32(SDC_BLK_NUM, data->blocks);
 		//msdc_clr_fifo();  /* no need */
 
@@ -1196,11 +1268,7 @@ static int msdc_do_request(struct mmc_host *mmc, struct mmc_request *mrq)
 		if (msdc_command_start(host, cmd, 1, CMD_TIMEOUT) != 0)
 			goto done;
 
-		data->sg_count = dma_map_sg(mmc_dev(mmc), data->sg,
-					    data->sg_len,
-					    mmc_get_dma_dir(data));
-		msdc_dma_setup(host, &host->dma, data->sg,
-			       data->sg_count);
+		msdc_dma_config(host, &host->dma[cookie - 1]);
 
 		/* then wait command done */
 		if (msdc_command_resp(host, cmd, 1, CMD_TIMEOUT) != 0)
@@ -1227,8 +1295,10 @@ static int msdc_do_request(struct mmc_host *mmc, struct mmc_request *mrq)
 		spin_lock(&host->lock);
 		msdc_dma_stop(host);
 
-		/* Last: stop transfer */
-		if (data->stop) {
+		/* Last: stop transfer, CMD23 makes it needless unless the
+		 * transfer failed half way.
+		 */
+		if (data->stop && (!mrq->sbc || data->error)) {
 			if (msdc_do_command(host, data->stop, 0, CMD_TIMEOUT) != 0)
 				goto done;
 		}
@@ -1237,8 +1307,12 @@ static int msdc_do_request(struct mmc_host *mmc, struct mmc_request *mrq)
 done:
 	if (data != NULL) {
 		host->data = NULL;
-		dma_unmap_sg(mmc_dev(mmc), data->sg, data->sg_len,
-			     mmc_get_dma_dir(data));
+		/* pre_req mappings are released by post_req */
+		if (cookie && !data->host_cookie) {
+			spin_unlock(&host->lock);
+			msdc_dma_unmap(host, data, cookie);
+			spin_lock(&host->lock);
+		}
 		host->blksz = 0;
 
 #if 0 // don't stop twice!
@@ -1277,8 +1351,10 @@ done:
 #endif
 #endif /* end of --- */
 
+	if (mrq->sbc && mrq->sbc->error)
+		host->error = 0x1000;
 	if (mrq->cmd->error)
-		host->error = 0x001;
+		host->error |= 0x001;
 	if (mrq->data && mrq->data->error)
 		host->error |= 0x010;
 	if (mrq->stop && mrq->stop->error)
@@ -1651,10 +1727,12 @@ static int msdc_tune_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	return ret;
 }
 
-/* ops.request */
-static void msdc_ops_request(struct mmc_host *mmc, struct mmc_request *mrq)
+/* runs the request queued by msdc_ops_request() */
+static void msdc_request_work(struct work_struct *work)
 {
-	struct msdc_host *host = mmc_priv(mmc);
+	struct msdc_host *host = container_of(work, struct msdc_host, req_work);
+	struct mmc_host *mmc = host->mmc;
+	struct mmc_request *mrq = host->mrq;
 
 	//=== for sdio profile ===
 #if 0 /* --- by chhung */
@@ -1662,8 +1740,6 @@ static void msdc_ops_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	u32 ticks = 0, opcode = 0, sizes = 0, bRx = 0;
 #endif /* end of --- */
 
-	WARN_ON(host->mrq);
-
 	/* start to process */
 	spin_lock(&host->lock);
 #if 0 /* --- by chhung */
@@ -1673,8 +1749,6 @@ static void msdc_ops_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	}
 #endif /* end of --- */
 
-	host->mrq = mrq;
-
 	if (msdc_do_request(mmc, mrq)) {
 		if (host->hw->flags & MSDC_REMOVABLE && ralink_soc == MT762X_SOC_MT7621AT && mrq->data && mrq->data->error)
 			msdc_tune_request(mmc, mrq);
@@ -1713,9 +1787,56 @@ static void msdc_ops_request(struct mmc_host *mmc, struct mmc_request *mrq)
 #endif /* end of --- */
 	spin_unlock(&host->lock);
 
+	if (mrq->data)
+		msdc_stats_update(host->id, mrq->data->flags & MMC_DATA_READ,
+				  mrq->data->bytes_xfered,
+				  ktime_us_delta(ktime_get(), host->req_start),
+				  mrq->data->error);
+
 	mmc_request_done(mmc, mrq);
+}
+
+/* ops.request
+ *
+ * The request is run from an ordered workqueue so that the core gets control
+ * back at once and can prepare the next request through pre_req while this
+ * one is on the bus.
+ */
+static void msdc_ops_request(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct msdc_host *host = mmc_priv(mmc);
+
+	WARN_ON(host->mrq);
 
-	return;
+	host->mrq = mrq;
+	host->req_start = ktime_get();
+	queue_work(host->req_wq, &host->req_work);
+}
+
+/* ops.pre_req: map and build the descriptors ahead of time */
+static void msdc_ops_pre_req(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct msdc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (!data)
+		return;
+
+	data->host_cookie = msdc_dma_map(host, data);
+}
+
+/* ops.post_req: release what pre_req set up */
+static void msdc_ops_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			      int err)
+{
+	struct msdc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (!data || !data->host_cookie)
+		return;
+
+	msdc_dma_unmap(host, data, data->host_cookie);
+	data->host_cookie = 0;
 }
 
 /* called by ops.set_ios */
@@ -1875,6 +1996,8 @@ static int msdc_ops_get_cd(struct mmc_host *mmc)
 
 static struct mmc_host_ops mt_msdc_ops = {
 	.request         = msdc_ops_request,
+	.pre_req         = msdc_ops_pre_req,
+	.post_req        = msdc_ops_post_req,
 	.set_ios         = msdc_ops_set_ios,
 	.get_ro          = msdc_ops_get_ro,
 	.get_cd          = msdc_ops_get_cd,
@@ -2209,7 +2332,7 @@ static int msdc_drv_probe(struct platform_device *pdev)
 	struct mmc_host *mmc;
 	struct msdc_host *host;
 	struct msdc_hw *hw;
-	int ret;
+	int ret, i;
 
 	//FIXME: this should be done by pinconf and not by the sd driver
 	if ((ralink_soc == MT762X_SOC_MT7688 ||
@@ -2244,6 +2367,7 @@ static int msdc_drv_probe(struct platform_device *pdev)
 
 	//TODO: read this as bus-width from dt (via mmc_of_parse)
 	mmc->caps  |= MMC_CAP_4_BIT_DATA;
+	mmc->caps  |= MMC_CAP_CMD23;
 
 	cd_active_low = !of_property_read_bool(pdev->dev.of_node, "mediatek,cd-high");
 
@@ -2292,17 +2416,33 @@ static int msdc_drv_probe(struct platform_device *pdev)
 	dma_coerce_mask_and_coherent(mmc_dev(mmc), DMA_BIT_MASK(32));
 
 	/* using dma_alloc_coherent*/  /* todo: using 1, for all 4 slots */
-	host->dma.gpd = dma_alloc_coherent(&pdev->dev,
-					   MAX_GPD_NUM * sizeof(struct gpd),
-					   &host->dma.gpd_addr, GFP_KERNEL);
-	host->dma.bd =  dma_alloc_coherent(&pdev->dev,
-					   MAX_BD_NUM  * sizeof(struct bd),
-					   &host->dma.bd_addr,  GFP_KERNEL);
-	if (!host->dma.gpd || !host->dma.bd) {
+	host->dma[0].gpd = dma_alloc_coherent(&pdev->dev,
+					   MSDC_DMA_SETS * MAX_GPD_NUM * sizeof(struct gpd),
+					   &host->dma[0].gpd_addr, GFP_KERNEL);
+	host->dma[0].bd =  dma_alloc_coherent(&pdev->dev,
+					   MSDC_DMA_SETS * MAX_BD_NUM  * sizeof(struct bd),
+					   &host->dma[0].bd_addr,  GFP_KERNEL);
+	if (!host->dma[0].gpd || !host->dma[0].bd) {
+		ret = -ENOMEM;
+		goto release_mem;
+	}
+	for (i = 0; i < MSDC_DMA_SETS; i++) {
+		host->dma[i].gpd = host->dma[0].gpd + i * MAX_GPD_NUM;
+		host->dma[i].gpd_addr = host->dma[0].gpd_addr +
+					i * MAX_GPD_NUM * sizeof(struct gpd);
+		host->dma[i].bd = host->dma[0].bd + i * MAX_BD_NUM;
+		host->dma[i].bd_addr = host->dma[0].bd_addr +
+				       i * MAX_BD_NUM * sizeof(struct bd);
+		msdc_init_gpd_bd(host, &host->dma[i]);
+	}
+
+	host->req_wq = alloc_ordered_workqueue("msdc%d", WQ_MEM_RECLAIM | WQ_HIGHPRI,
+					       host->id);
+	if (!host->req_wq) {
 		ret = -ENOMEM;
 		goto release_mem;
 	}
-	msdc_init_gpd_bd(host, &host->dma);
+	INIT_WORK(&host->req_work, msdc_request_work);
 
 	INIT_DELAYED_WORK(&host->card_delaywork, msdc_tasklet_card);
 	spin_lock_init(&host->lock);
@@ -2341,12 +2481,14 @@ release:
 	cancel_delayed_work_sync(&host->card_delaywork);
 
 release_mem:
-	if (host->dma.gpd)
-		dma_free_coherent(&pdev->dev, MAX_GPD_NUM * sizeof(struct gpd),
-				  host->dma.gpd, host->dma.gpd_addr);
-	if (host->dma.bd)
-		dma_free_coherent(&pdev->dev, MAX_BD_NUM * sizeof(struct bd),
-				  host->dma.bd, host->dma.bd_addr);
+	if (host->req_wq)
+		destroy_workqueue(host->req_wq);
+	if (host->dma[0].gpd)
+		dma_free_coherent(&pdev->dev, MSDC_DMA_SETS * MAX_GPD_NUM * sizeof(struct gpd),
+				  host->dma[0].gpd, host->dma[0].gpd_addr);
+	if (host->dma[0].bd)
+		dma_free_coherent(&pdev->dev, MSDC_DMA_SETS * MAX_BD_NUM * sizeof(struct bd),
+				  host->dma[0].bd, host->dma[0].bd_addr);
 host_free:
 	mmc_free_host(mmc);
 
@@ -2372,11 +2514,12 @@ static int msdc_drv_remove(struct platform_device *pdev)
 	msdc_deinit_hw(host);
 
 	cancel_delayed_work_sync(&host->card_delaywork);
+	destroy_workqueue(host->req_wq);
 
-	dma_free_coherent(&pdev->dev, MAX_GPD_NUM * sizeof(struct gpd),
-			  host->dma.gpd, host->dma.gpd_addr);
-	dma_free_coherent(&pdev->dev, MAX_BD_NUM  * sizeof(struct bd),
-			  host->dma.bd,  host->dma.bd_addr);
+	dma_free_coherent(&pdev->dev, MSDC_DMA_SETS * MAX_GPD_NUM * sizeof(struct gpd),
+			  host->dma[0].gpd, host->dma[0].gpd_addr);
+	dma_free_coherent(&pdev->dev, MSDC_DMA_SETS * MAX_BD_NUM  * sizeof(struct bd),
+			  host->dma[0].bd,  host->dma[0].bd_addr);
 
 	mmc_free_host(host->mmc);
 
@@ -2447,11 +2590,13 @@ static int __init mt_msdc_init(void)
 #if defined(MT6575_SD_DEBUG)
 	msdc_debug_proc_init();
 #endif
+	msdc_stats_proc_init();
 	return 0;
 }
 
 static void __exit mt_msdc_exit(void)
 {
+	msdc_stats_proc_exit();
 	platform_driver_unregister(&mt_msdc_driver);
 }
 
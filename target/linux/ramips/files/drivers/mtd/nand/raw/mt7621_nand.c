@@ -14,12 +14,16 @@
 #include <linux/sizes.h>
 #include <linux/iopoll.h>
 #include <linux/kernel.h>
+#include <linux/math64.h>
 #include <linux/module.h>
+#include <linux/of.h>
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/rawnand.h>
 #include <linux/mtd/partitions.h>
 #include <linux/mtd/mtk_bmt.h>
 #include <linux/platform_device.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
 #include <asm/addrspace.h>
 
 /* NFI core registers */
@@ -207,8 +211,21 @@
 
 #define NFI_FDM_SIZE		8
 
+/* PIO_DIRDY polls before falling back to the timed wait */
+#define NFI_PIO_SPIN			1000
+
+/* array to data register transfer, covers tR and tRCBSY */
+#define NFI_CACHE_READ_TIMEOUT_MS	10
+
+#define NAND_CMD_READ_CACHE_SEQ		0x31
+#define NAND_CMD_READ_CACHE_END		0x3f
+
 #define MT7621_NFC_NAME			"mt7621-nand"
 
+static bool bench;
+module_param(bench, bool, 0444);
+MODULE_PARM_DESC(bench, "Measure page read throughput of the first block at probe");
+
 struct mt7621_nfc {
 	struct nand_controller controller;
 	struct nand_chip nand;
@@ -220,6 +237,11 @@ struct mt7621_nfc {
 	void __iomem *ecc_regs;
 
 	u32 spare_per_sector;
+
+	bool cache_read;	/* use READ CACHE SEQUENTIAL for sequential reads */
+	int cache_page;		/* page loading into the data register, or -1 */
+	int last_page;		/* last page read through hwecc */
+	bool pio_word;		/* poll before every word, benchmark baseline */
 };
 
 static const u16 mt7621_nfi_page_size[] = { SZ_512, SZ_2K, SZ_4K };
@@ -623,6 +645,60 @@ static void mt7621_nfc_write_data_empty(struct mt7621_nfc *nfc, u32 len)
 	}
 }
 
+static inline void mt7621_nfc_wait_pio_ready_fast(struct mt7621_nfc *nfc)
+{
+	int spin = NFI_PIO_SPIN;
+
+	while (spin--) {
+		if (nfi_read16(nfc, NFI_PIO_DIRDY) & PIO_DIRDY)
+			return;
+	}
+
+	mt7621_nfc_wait_pio_ready(nfc);
+}
+
+/*
+ * Sector sized transfers: the data FSM is set up once by the first word and
+ * stays in the custom data state until the sector is done, so the remaining
+ * words only need the cheap DIRDY poll.
+ */
+static void mt7621_nfc_read_burst(struct mt7621_nfc *nfc, u8 *buf, u32 len)
+{
+	u32 *p = (u32 *)buf;
+	u32 i;
+
+	if (nfc->pio_word || ((uintptr_t)buf & 3) || (len & 3) || !len) {
+		mt7621_nfc_read_data(nfc, buf, len);
+		return;
+	}
+
+	p[0] = mt7621_nfc_pio_read(nfc, false);
+
+	for (i = 1; i < len / 4; i++) {
+		mt7621_nfc_wait_pio_ready_fast(nfc);
+		p[i] = nfi_read32(nfc, NFI_DATAR);
+	}
+}
+
+static void mt7621_nfc_write_burst(struct mt7621_nfc *nfc, const u8 *buf,
+				   u32 len)
+{
+	const u32 *p = (const u32 *)buf;
+	u32 i;
+
+	if (nfc->pio_word || ((uintptr_t)buf & 3) || (len & 3) || !len) {
+		mt7621_nfc_write_data(nfc, buf, len);
+		return;
+	}
+
+	mt7621_nfc_pio_write(nfc, p[0], false);
+
+	for (i = 1; i < len / 4; i++) {
+		mt7621_nfc_wait_pio_ready_fast(nfc);
+		nfi_write32(nfc, NFI_DATAW, p[i]);
+	}
+}
+
 static int mt7621_nfc_dev_ready(struct mt7621_nfc *nfc,
 				unsigned int timeout_ms)
 {
@@ -665,6 +741,31 @@ static int mt7621_nfc_exec_instr(struct nand_chip *nand,
 	}
 }
 
+static int mt7621_nfc_cache_cmd(struct mt7621_nfc *nfc, u8 command)
+{
+	int ret;
+
+	mt7621_nfc_hw_reset(nfc);
+	nfi_write16(nfc, NFI_CSEL, 0);
+	nfi_write16(nfc, NFI_CNFG, CNFG_OP_CUSTOM << CNFG_OP_MODE_S);
+
+	ret = mt7621_nfc_send_command(nfc, command);
+	if (ret)
+		return ret;
+
+	return mt7621_nfc_dev_ready(nfc, NFI_CACHE_READ_TIMEOUT_MS);
+}
+
+/* leave cache read mode before any other operation reaches the chip */
+static void mt7621_nfc_cache_end(struct mt7621_nfc *nfc)
+{
+	if (nfc->cache_page < 0)
+		return;
+
+	nfc->cache_page = -1;
+	mt7621_nfc_cache_cmd(nfc, NAND_CMD_READ_CACHE_END);
+}
+
 static int mt7621_nfc_exec_op(struct nand_chip *nand,
 			      const struct nand_operation *op, bool check_only)
 {
@@ -674,6 +775,8 @@ static int mt7621_nfc_exec_op(struct nand_chip *nand,
 	if (check_only)
 		return 0;
 
+	mt7621_nfc_cache_end(nfc);
+
 	/* Only CS0 available */
 	nfi_write16(nfc, NFI_CSEL, 0);
 
@@ -1001,6 +1104,51 @@ static void mt7621_nfc_read_sector_fdm(struct mt7621_nfc *nfc, u32 sect)
 		oobptr[i + 4] = (valm >> (i * 8)) & 0xff;
 }
 
+/*
+ * Get a page ready for output. Once two consecutive pages of a block have
+ * been read, READ CACHE SEQUENTIAL lets the chip fetch the next page from the
+ * array while the current one is being transferred. The sequence ends with
+ * READ CACHE END at the block boundary or when anything else is issued.
+ */
+static int mt7621_nfc_read_page_start(struct nand_chip *nand, int page)
+{
+	struct mt7621_nfc *nfc = nand_get_controller_data(nand);
+	struct mtd_info *mtd = nand_to_mtd(nand);
+	u32 pages_per_block = mtd->erasesize / mtd->writesize;
+	bool next_in_block = (page + 1) % pages_per_block;
+	int ret;
+
+	if (nfc->cache_page == page) {
+		nfc->last_page = page;
+
+		if (next_in_block) {
+			nfc->cache_page = page + 1;
+			return mt7621_nfc_cache_cmd(nfc,
+						    NAND_CMD_READ_CACHE_SEQ);
+		}
+
+		nfc->cache_page = -1;
+		return mt7621_nfc_cache_cmd(nfc, NAND_CMD_READ_CACHE_END);
+	}
+
+	ret = nand_read_page_op(nand, page, 0, NULL, 0);
+	if (ret)
+		return ret;
+
+	if (nfc->cache_read && next_in_block && nfc->last_page >= 0 &&
+	    nfc->last_page == page - 1) {
+		ret = mt7621_nfc_cache_cmd(nfc, NAND_CMD_READ_CACHE_SEQ);
+		if (ret)
+			return ret;
+
+		nfc->cache_page = page + 1;
+	}
+
+	nfc->last_page = page;
+
+	return 0;
+}
+
 static int mt7621_nfc_read_page_hwecc(struct nand_chip *nand, uint8_t *buf,
 				      int oob_required, int page)
 {
@@ -1009,7 +1157,9 @@ static int mt7621_nfc_read_page_hwecc(struct nand_chip *nand, uint8_t *buf,
 	int bitflips = 0, ret = 0;
 	int rc, i;
 
-	nand_read_page_op(nand, page, 0, NULL, 0);
+	ret = mt7621_nfc_read_page_start(nand, page);
+	if (ret)
+		return ret;
 
 	nfi_write16(nfc, NFI_CNFG, (CNFG_OP_CUSTOM << CNFG_OP_MODE_S) |
 		    CNFG_READ_MODE | CNFG_AUTO_FMT_EN | CNFG_HW_ECC_EN);
@@ -1021,8 +1171,8 @@ static int mt7621_nfc_read_page_hwecc(struct nand_chip *nand, uint8_t *buf,
 
 	for (i = 0; i < nand->ecc.steps; i++) {
 		if (buf)
-			mt7621_nfc_read_data(nfc, page_data_ptr(nand, buf, i),
-					     nand->ecc.size);
+			mt7621_nfc_read_burst(nfc, page_data_ptr(nand, buf, i),
+					      nand->ecc.size);
 		else
 			mt7621_nfc_read_data_discard(nfc, nand->ecc.size);
 
@@ -1079,8 +1229,8 @@ static int mt7621_nfc_read_page_raw(struct nand_chip *nand, uint8_t *buf,
 	for (i = 0; i < nand->ecc.steps; i++) {
 		/* Read data */
 		if (buf)
-			mt7621_nfc_read_data(nfc, page_data_ptr(nand, buf, i),
-					     nand->ecc.size);
+			mt7621_nfc_read_burst(nfc, page_data_ptr(nand, buf, i),
+					      nand->ecc.size);
 		else
 			mt7621_nfc_read_data_discard(nfc, nand->ecc.size);
 
@@ -1162,7 +1312,7 @@ static int mt7621_nfc_write_page_hwecc(struct nand_chip *nand,
 		    CON_NFI_BWR | (nand->ecc.steps << CON_NFI_SEC_S));
 
 	if (buf)
-		mt7621_nfc_write_data(nfc, buf, mtd->writesize);
+		mt7621_nfc_write_burst(nfc, buf, mtd->writesize);
 	else
 		mt7621_nfc_write_data_empty(nfc, mtd->writesize);
 
@@ -1192,8 +1342,8 @@ static int mt7621_nfc_write_page_raw(struct nand_chip *nand,
 	for (i = 0; i < nand->ecc.steps; i++) {
 		/* Write data */
 		if (buf)
-			mt7621_nfc_write_data(nfc, page_data_ptr(nand, buf, i),
-					      nand->ecc.size);
+			mt7621_nfc_write_burst(nfc, page_data_ptr(nand, buf, i),
+					       nand->ecc.size);
 		else
 			mt7621_nfc_write_data_empty(nfc, nand->ecc.size);
 
@@ -1223,6 +1373,74 @@ static int mt7621_nfc_write_oob_raw(struct nand_chip *nand, int page)
 	return mt7621_nfc_write_page_raw(nand, NULL, 1, page);
 }
 
+static int mt7621_nfc_bench_mode(struct mt7621_nfc *nfc, u8 *buf, int loops)
+{
+	struct mtd_info *mtd = nand_to_mtd(&nfc->nand);
+	size_t retlen;
+	ktime_t start;
+	s64 us;
+	u64 kbps;
+	int i, ret;
+
+	start = ktime_get();
+
+	for (i = 0; i < loops; i++) {
+		ret = mtd_read(mtd, 0, mtd->erasesize, &retlen, buf);
+		if (ret < 0 && !mtd_is_bitflip(ret))
+			return ret;
+	}
+
+	us = ktime_us_delta(ktime_get(), start);
+	if (us <= 0)
+		us = 1;
+
+	kbps = div64_u64((u64)mtd->erasesize * loops * USEC_PER_SEC,
+			 (u64)us * 1024);
+
+	return min_t(u64, kbps, INT_MAX);
+}
+
+/* Compare page read throughput of the available data paths on block 0 */
+static void mt7621_nfc_bench(struct mt7621_nfc *nfc)
+{
+	static const char * const names[] = {
+		"word pio", "burst pio", "burst pio + cache read"
+	};
+	struct mtd_info *mtd = nand_to_mtd(&nfc->nand);
+	bool cache_read = nfc->cache_read;
+	int kbps[ARRAY_SIZE(names)];
+	int mode;
+	u8 *buf;
+
+	buf = kmalloc(mtd->erasesize, GFP_KERNEL);
+	if (!buf)
+		return;
+
+	for (mode = 0; mode < ARRAY_SIZE(names); mode++) {
+		if (mode == 2 && !cache_read)
+			break;
+
+		nfc->pio_word = mode == 0;
+		nfc->cache_read = mode == 2;
+
+		kbps[mode] = mt7621_nfc_bench_mode(nfc, buf, 4);
+		if (kbps[mode] < 0) {
+			dev_warn(nfc->dev, "benchmark read failed: %d\n",
+				 kbps[mode]);
+			break;
+		}
+
+		dev_info(nfc->dev, "%s: %d.%02d MB/s (%+d%%)\n", names[mode],
+			 kbps[mode] / 1024, (kbps[mode] % 1024) * 100 / 1024,
+			 kbps[0] ? (kbps[mode] - kbps[0]) * 100 / kbps[0] : 0);
+	}
+
+	nfc->pio_word = false;
+	nfc->cache_read = cache_read;
+
+	kfree(buf);
+}
+
 static int mt7621_nfc_init_chip(struct mt7621_nfc *nfc)
 {
 	struct nand_chip *nand = &nfc->nand;
@@ -1261,6 +1479,9 @@ static int mt7621_nfc_init_chip(struct mt7621_nfc *nfc)
 
 	mtk_bmt_attach(mtd);
 
+	if (bench)
+		mt7621_nfc_bench(nfc);
+
 	ret = mtd_device_register(mtd, NULL, 0);
 	if (ret) {
 		dev_err(nfc->dev, "Failed to register MTD: %d\n", ret);
@@ -1286,6 +1507,12 @@ static int mt7621_nfc_probe(struct platform_device *pdev)
 	nand_controller_init(&nfc->controller);
 	nfc->controller.ops = &mt7621_nfc_controller_ops;
 	nfc->dev = dev;
+	nfc->cache_page = -1;
+	nfc->last_page = -1;
+
+	/* not every chip implements READ CACHE SEQUENTIAL, opt in from DT */
+	nfc->cache_read = of_property_read_bool(dev->of_node,
+						"mediatek,nand-cache-read");
 
 	res = platform_get_resource_byname(pdev, IORESOURCE_MEM, "nfi");
 	nfc->nfi_base = res->start;
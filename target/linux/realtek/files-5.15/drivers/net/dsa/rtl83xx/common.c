@@ -580,9 +580,107 @@ int rtl83xx_packet_cntr_alloc(struct rtl838x_switch_priv *priv)
 
 	mutex_unlock(&priv->reg_mutex);
 
+	/* The counter may still hold the count of a previous user, take it as
+	 * the base the harvester accumulates from
+	 */
+	if (priv->cntr_acc) {
+		mutex_lock(&priv->cntr_mutex);
+		priv->cntr_raw[idx] = priv->r->packet_cntr_read(idx);
+		priv->cntr_acc[idx] = 0;
+		mutex_unlock(&priv->cntr_mutex);
+	}
+
 	return idx;
 }
 
+/* Return the number of packets counted since the counter was allocated,
+ * as of the last sweep of the harvester
+ */
+u64 rtl83xx_packet_cntr_get(struct rtl838x_switch_priv *priv, int counter)
+{
+	u64 v;
+
+	if (!priv->cntr_acc)
+		return priv->r->packet_cntr_read(counter);
+
+	mutex_lock(&priv->cntr_mutex);
+	v = priv->cntr_acc[counter];
+	mutex_unlock(&priv->cntr_mutex);
+
+	return v;
+}
+
+/* Sweep all LOG table entries up to the highest one in use and fold the
+ * 32 bit hardware counters into 64 bit totals. The interval is short enough
+ * for a counter not to wrap twice even at line rate on all ports.
+ */
+static void rtl83xx_cntr_harvest(struct work_struct *work)
+{
+	struct rtl838x_switch_priv *priv = container_of(work, struct rtl838x_switch_priv,
+							cntr_work.work);
+	u32 raw[2 * RTL83XX_CNTR_CHUNK];
+	int last;
+
+	mutex_lock(&priv->reg_mutex);
+	last = find_last_bit(priv->octet_cntr_use_bm, priv->n_counters);
+	mutex_unlock(&priv->reg_mutex);
+
+	if (last < priv->n_counters) {
+		mutex_lock(&priv->cntr_mutex);
+		for (int first = 0; first <= last; first += RTL83XX_CNTR_CHUNK) {
+			int n = min(RTL83XX_CNTR_CHUNK, last + 1 - first);
+
+			priv->r->packet_cntr_read_bulk(first, n, raw);
+			for (int i = 0; i < 2 * n; i++) {
+				int c = 2 * first + i;
+
+				priv->cntr_acc[c] += (u32)(raw[i] - priv->cntr_raw[c]);
+				priv->cntr_raw[c] = raw[i];
+			}
+		}
+		mutex_unlock(&priv->cntr_mutex);
+	}
+
+	schedule_delayed_work(&priv->cntr_work, RTL83XX_CNTR_INTERVAL);
+}
+
+static void rtl83xx_cntr_harvester_stop(void *data)
+{
+	struct rtl838x_switch_priv *priv = data;
+
+	cancel_delayed_work_sync(&priv->cntr_work);
+}
+
+static int rtl83xx_cntr_harvester_init(struct rtl838x_switch_priv *priv)
+{
+	int err;
+
+	if (!priv->n_counters || !priv->r->packet_cntr_read_bulk)
+		return 0;
+
+	priv->cntr_raw = devm_kcalloc(priv->dev, priv->n_counters * 2,
+				      sizeof(*priv->cntr_raw), GFP_KERNEL);
+	priv->cntr_acc = devm_kcalloc(priv->dev, priv->n_counters * 2,
+				      sizeof(*priv->cntr_acc), GFP_KERNEL);
+	if (!priv->cntr_raw || !priv->cntr_acc) {
+		priv->cntr_acc = NULL;
+		return -ENOMEM;
+	}
+
+	mutex_init(&priv->cntr_mutex);
+	INIT_DELAYED_WORK(&priv->cntr_work, rtl83xx_cntr_harvest);
+	schedule_delayed_work(&priv->cntr_work, RTL83XX_CNTR_INTERVAL);
+
+	/* Stop the work before devm releases priv, on probe failure and unbind */
+	err = devm_add_action_or_reset(priv->dev, rtl83xx_cntr_harvester_stop, priv);
+	if (err) {
+		priv->cntr_acc = NULL;
+		return err;
+	}
+
+	return 0;
+}
+
 /* Add an L2 nexthop entry for the L3 routing system / PIE forwarding in the SoC
  * Use VID and MAC in rtl838x_l2_entry to identify either a free slot in the L2 hash table
  * or mark an existing entry as a nexthop by setting it's nexthop bit
@@ -1612,6 +1710,10 @@ static int __init rtl83xx_sw_probe(struct platform_device *pdev)
 
 	priv->r->l3_setup(priv);
 
+	/* Without the harvester, counters are read from the table on demand */
+	if (rtl83xx_cntr_harvester_init(priv))
+		dev_warn(dev, "Failed to set up packet counter harvester\n");
+
 	/* Clear all destination ports for mirror groups */
 	for (int i = 0; i < 4; i++)
 		priv->mirror_group_ports[i] = -1;
@@ -2171,6 +2171,8 @@ const struct dsa_switch_ops rtl83xx_switch_ops = {
 
 	.port_pre_bridge_flags	= rtl83xx_port_pre_bridge_flags,
 	.port_bridge_flags	= rtl83xx_port_bridge_flags,
+
+	.port_setup_tc		= rtl83xx_port_setup_tc,
 };
 
 const struct dsa_switch_ops rtl930x_switch_ops = {
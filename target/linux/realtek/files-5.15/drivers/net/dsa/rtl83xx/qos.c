@@ -9,11 +9,6 @@
 static struct rtl838x_switch_priv *switch_priv;
 extern struct rtl83xx_soc_info soc_info;
 
-enum scheduler_type {
-	WEIGHTED_FAIR_QUEUE = 0,
-	WEIGHTED_ROUND_ROBIN,
-};
-
 int max_available_queue[] = {0, 1, 2, 3, 4, 5, 6, 7};
 int default_queue_weights[] = {1, 1, 1, 1, 1, 1, 1, 1};
 int dot1p_priority_remapping[] = {0, 1, 2, 3, 4, 5, 6, 7};
@@ -59,7 +54,7 @@ u32 rtl838x_get_egress_rate(struct rtl838x_switch_priv *priv, int port)
 	if (port > priv->cpu_port)
 		return 0;
 
-	return sw_r32(RTL838X_SCHED_P_EGR_RATE_CTRL(port)) & 0x3fff;
+	return sw_r32(RTL838X_SCHED_P_EGR_RATE_CTRL(port)) & 0x3ffff;
 }
 
 /* Sets the rate limit, 10MBit/s is equal to a rate value of 625 */
@@ -70,7 +65,7 @@ int rtl838x_set_egress_rate(struct rtl838x_switch_priv *priv, int port, u32 rate
 	if (port > priv->cpu_port)
 		return -1;
 
-	old_rate = sw_r32(RTL838X_SCHED_P_EGR_RATE_CTRL(port));
+	old_rate = sw_r32(RTL838X_SCHED_P_EGR_RATE_CTRL(port)) & 0x3ffff;
 	sw_w32(rate, RTL838X_SCHED_P_EGR_RATE_CTRL(port));
 
 	return old_rate;
@@ -594,6 +594,8 @@ typedef enum {
 #define N_FIXED_FIELDS 12
 #define N_FIXED_FIELDS_RTL931X 14
 #define MAX_COUNTERS 2048
+#define RTL83XX_CNTR_CHUNK 32		/* LOG entries read per table lock */
+#define RTL83XX_CNTR_INTERVAL (2 * HZ)
 #define MAX_ROUTES 512
 #define MAX_HOST_ROUTES 1536
 #define MAX_INTF_MTUS 8
@@ -636,6 +638,12 @@ struct rtl838x_port {
 	int sds_num;
 	int led_set;
 	const struct dsa_port *dp;
+	/* tc offload state: handle of the ETS/PRIO root qdisc and the
+	 * egress rate in place before a root TBF was offloaded
+	 */
+	u32 tc_root;
+	bool tbf_offloaded;
+	u32 tbf_saved_rate;
 };
 
 struct rtl838x_vlan_info {
@@ -725,7 +733,7 @@ struct pie_rule {
 	enum pie_phase phase;	/* Phase in which this template is applied */
 	int packet_cntr;	/* ID of a packet counter assigned to this rule */
 	int octet_cntr;		/* ID of a byte counter assigned to this rule */
-	u32 last_packet_cnt;
+	u64 last_packet_cnt;
 	u64 last_octet_cnt;
 
 	/* The following are requirements for the pie template */
@@ -1030,6 +1038,7 @@ struct rtl838x_reg {
 	void (*pie_rule_rm)(struct rtl838x_switch_priv *priv, struct pie_rule *rule);
 	void (*l2_learning_setup)(void);
 	u32 (*packet_cntr_read)(int counter);
+	void (*packet_cntr_read_bulk)(int first, int n, u32 *cntr);
 	void (*packet_cntr_clear)(int counter);
 	void (*route_read)(int idx, struct rtl83xx_route *rt);
 	void (*route_write)(int idx, struct rtl83xx_route *rt);
@@ -1088,6 +1097,10 @@ struct rtl838x_switch_priv {
 	int n_counters;
 	unsigned long int octet_cntr_use_bm[MAX_COUNTERS >> 5];
 	unsigned long int packet_cntr_use_bm[MAX_COUNTERS >> 4];
+	struct delayed_work cntr_work;	/* Periodic sweep of the LOG table */
+	struct mutex cntr_mutex;	/* Protects the counter snapshot below */
+	u32 *cntr_raw;			/* Hardware values seen by the last sweep */
+	u64 *cntr_acc;			/* 64 bit packet totals since allocation */
 	struct rhltable routes;
 	unsigned long int route_use_bm[MAX_ROUTES >> 5];
 	unsigned long int host_route_use_bm[MAX_HOST_ROUTES >> 5];
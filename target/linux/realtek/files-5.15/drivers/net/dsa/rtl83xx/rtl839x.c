@@ -1666,6 +1666,22 @@ static u32 rtl839x_packet_cntr_read(int counter)
 	return v;
 }
 
+/* Read the LOG table entries first to first + n - 1 under a single table lock,
+ * cntr receives the 2 packet counters of each entry
+ */
+static void rtl839x_packet_cntr_read_bulk(int first, int n, u32 *cntr)
+{
+	struct table_reg *r = rtl_table_get(RTL8390_TBL_0, 4);
+
+	for (int i = 0; i < n; i++) {
+		rtl_table_read(r, first + i);
+		cntr[2 * i] = sw_r32(rtl_table_data(r, 1));
+		cntr[2 * i + 1] = sw_r32(rtl_table_data(r, 0));
+	}
+
+	rtl_table_release(r);
+}
+
 static void rtl839x_packet_cntr_clear(int counter)
 {
 	/* Access LOG table (4) via register RTL8390_TBL_0 */
@@ -1902,6 +1918,7 @@ const struct rtl838x_reg rtl839x_reg = {
 	.pie_rule_rm = rtl839x_pie_rule_rm,
 	.l2_learning_setup = rtl839x_l2_learning_setup,
 	.packet_cntr_read = rtl839x_packet_cntr_read,
+	.packet_cntr_read_bulk = rtl839x_packet_cntr_read_bulk,
 	.packet_cntr_clear = rtl839x_packet_cntr_clear,
 	.route_read = rtl839x_route_read,
 	.route_write = rtl839x_route_write,
@@ -73,9 +73,25 @@ inline u16 rtl_table_data(struct table_reg *r, int i);
 inline u32 rtl_table_data_r(struct table_reg *r, int i);
 inline void rtl_table_data_w(struct table_reg *r, u32 v, int i);
 
+enum scheduler_type {
+	WEIGHTED_FAIR_QUEUE = 0,
+	WEIGHTED_ROUND_ROBIN,
+};
+
 void __init rtl83xx_setup_qos(struct rtl838x_switch_priv *priv);
+u32 rtl838x_get_egress_rate(struct rtl838x_switch_priv *priv, int port);
+int rtl838x_set_egress_rate(struct rtl838x_switch_priv *priv, int port, u32 rate);
+u32 rtl839x_get_egress_rate(struct rtl838x_switch_priv *priv, int port);
+int rtl839x_set_egress_rate(struct rtl838x_switch_priv *priv, int port, u32 rate);
+void rtl839x_egress_rate_queue_limit(struct rtl838x_switch_priv *priv, int port,
+				     int queue, u32 rate);
+void rtl839x_set_scheduling_queue_weights(struct rtl838x_switch_priv *priv, int port,
+					  int *queue_weights);
+int rtl83xx_port_setup_tc(struct dsa_switch *ds, int port, enum tc_setup_type type,
+			  void *type_data);
 
 int rtl83xx_packet_cntr_alloc(struct rtl838x_switch_priv *priv);
+u64 rtl83xx_packet_cntr_get(struct rtl838x_switch_priv *priv, int counter);
 
 int rtl83xx_port_is_under(const struct net_device * dev, struct rtl838x_switch_priv *priv);
 
@@ -5,6 +5,8 @@
 #include <linux/etherdevice.h>
 #include <linux/netdevice.h>
 #include <net/flow_offload.h>
+#include <net/pkt_cls.h>
+#include <net/pkt_sched.h>
 #include <linux/rhashtable.h>
 #include <asm/mach-rtl838x/mach-rtl83xx.h>
 
@@ -319,7 +321,7 @@ static int rtl83xx_stats_flower(struct rtl838x_switch_priv *priv,
 {
 	struct rtl83xx_flow *flow;
 	unsigned long lastused = 0;
-	int total_packets, new_packets;
+	u64 total_packets, new_packets = 0;
 
 	pr_debug("%s: \n", __func__);
 	flow = rhashtable_lookup_fast(&priv->tc_ht, &cls_flower->cookie, tc_ht_params);
@@ -327,8 +329,8 @@ static int rtl83xx_stats_flower(struct rtl838x_switch_priv *priv,
 		return -1;
 
 	if (flow->rule.packet_cntr >= 0) {
-		total_packets = priv->r->packet_cntr_read(flow->rule.packet_cntr);
-		pr_debug("Total packets: %d\n", total_packets);
+		total_packets = rtl83xx_packet_cntr_get(priv, flow->rule.packet_cntr);
+		pr_debug("Total packets: %llu\n", total_packets);
 		new_packets = total_packets - flow->rule.last_packet_cnt;
 		flow->rule.last_packet_cnt = total_packets;
 	}
@@ -371,6 +373,242 @@ static int rtl83xx_setup_tc_block_cb(enum tc_setup_type type, void *type_data,
 	}
 }
 
+/* Egress rates are programmed in units of 16kbit/s, i.e. 625 for 10MBit/s */
+#define RTL83XX_RATE_UNIT		16000
+#define RTL838X_EGR_RATE_MAX		0x3ffff
+#define RTL839X_EGR_RATE_MAX		0xfffff
+#define RTL83XX_QUEUES			8
+
+static u32 rtl83xx_rate_to_hw(u64 rate_bytes_ps, u32 max)
+{
+	u64 rate = div_u64(rate_bytes_ps * 8 + RTL83XX_RATE_UNIT - 1,
+			   RTL83XX_RATE_UNIT);
+
+	return clamp_t(u64, rate, 1, max);
+}
+
+/* Bands of the offloaded ETS/PRIO root, band 0 being the most important
+ * one, map onto the egress queues from queue 7 downwards.
+ */
+static int rtl83xx_band_to_queue(struct rtl838x_switch_priv *priv, int port,
+				 u32 parent)
+{
+	u32 minor = TC_H_MIN(parent);
+
+	if (!priv->ports[port].tc_root ||
+	    TC_H_MAJ(parent) != TC_H_MAJ(priv->ports[port].tc_root))
+		return -EOPNOTSUPP;
+
+	if (minor < 1 || minor > RTL83XX_QUEUES)
+		return -EOPNOTSUPP;
+
+	return RTL83XX_QUEUES - minor;
+}
+
+/* TBF as root qdisc shapes the port, below an ETS/PRIO band the queue */
+static int rtl83xx_qdisc_tbf(struct rtl838x_switch_priv *priv, int port,
+			     struct tc_tbf_qopt_offload *qopt)
+{
+	struct rtl838x_port *p = &priv->ports[port];
+	bool root = qopt->parent == TC_H_ROOT;
+	u32 rate, max;
+	int queue = 0;
+
+	max = priv->family_id == RTL8380_FAMILY_ID ? RTL838X_EGR_RATE_MAX
+						    : RTL839X_EGR_RATE_MAX;
+
+	if (!root) {
+		/* there are no per queue weights to hang bands off on RTL838x */
+		if (priv->family_id != RTL8390_FAMILY_ID)
+			return -EOPNOTSUPP;
+
+		queue = rtl83xx_band_to_queue(priv, port, qopt->parent);
+		if (queue < 0)
+			return queue;
+	}
+
+	switch (qopt->command) {
+	case TC_TBF_REPLACE:
+		rate = rtl83xx_rate_to_hw(qopt->replace_params.rate.rate_bytes_ps, max);
+		pr_debug("%s: port %d queue %d rate %u\n", __func__, port,
+			 root ? -1 : queue, rate);
+
+		if (!root) {
+			rtl839x_egress_rate_queue_limit(priv, port, queue, rate);
+			return 0;
+		}
+
+		if (priv->family_id == RTL8380_FAMILY_ID)
+			rate = rtl838x_set_egress_rate(priv, port, rate);
+		else
+			rate = rtl839x_set_egress_rate(priv, port, rate);
+
+		if (!p->tbf_offloaded) {
+			p->tbf_saved_rate = rate;
+			p->tbf_offloaded = true;
+		}
+		return 0;
+
+	case TC_TBF_DESTROY:
+		if (!root) {
+			rtl839x_egress_rate_queue_limit(priv, port, queue,
+							RTL839X_EGR_RATE_MAX);
+			return 0;
+		}
+
+		if (!p->tbf_offloaded)
+			return 0;
+
+		if (priv->family_id == RTL8380_FAMILY_ID)
+			rtl838x_set_egress_rate(priv, port, p->tbf_saved_rate);
+		else
+			rtl839x_set_egress_rate(priv, port, p->tbf_saved_rate);
+		p->tbf_offloaded = false;
+		return 0;
+
+	case TC_TBF_STATS:
+		return 0;
+
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static void rtl83xx_qdisc_sched_reset(struct rtl838x_switch_priv *priv, int port)
+{
+	int weights[RTL83XX_QUEUES];
+
+	for (int q = 0; q < RTL83XX_QUEUES; q++) {
+		weights[q] = 1;
+		rtl839x_egress_rate_queue_limit(priv, port, q, RTL839X_EGR_RATE_MAX);
+	}
+
+	rtl839x_set_scheduling_queue_weights(priv, port, weights);
+	priv->ports[port].tc_root = 0;
+}
+
+/*
+ * ETS and PRIO program the WFQ weights of the port's queues, a weight of
+ * 0 puts a queue in strict priority. The priomap cannot be offloaded: the
+ * switch puts internal priority p into queue p with a single mapping shared
+ * by all ports. As band b is queue 7 - b, only eight bands with priority p
+ * in band 7 - p match what the hardware does. There are no internal
+ * priorities above 7, the rest of the priomap is of no concern.
+ */
+static bool rtl83xx_qdisc_priomap_matches(unsigned int bands,
+					  const u8 *priomap)
+{
+	if (bands != RTL83XX_QUEUES)
+		return false;
+
+	for (int p = 0; p < RTL83XX_QUEUES; p++)
+		if (priomap[p] != RTL83XX_QUEUES - 1 - p)
+			return false;
+
+	return true;
+}
+
+static int rtl83xx_qdisc_sched(struct rtl838x_switch_priv *priv, int port,
+			       u32 parent, u32 handle, unsigned int bands,
+			       const u8 *priomap, const unsigned int *quanta,
+			       const unsigned int *weights)
+{
+	int queue_weights[RTL83XX_QUEUES];
+
+	if (priv->family_id != RTL8390_FAMILY_ID)
+		return -EOPNOTSUPP;
+
+	if (parent != TC_H_ROOT)
+		return -EOPNOTSUPP;
+
+	if (!rtl83xx_qdisc_priomap_matches(bands, priomap))
+		return -EOPNOTSUPP;
+
+	for (int q = 0; q < RTL83XX_QUEUES; q++)
+		queue_weights[q] = 1;
+
+	for (int b = 0; b < bands; b++) {
+		int q = RTL83XX_QUEUES - 1 - b;
+
+		if (!quanta || !quanta[b])
+			queue_weights[q] = 0;
+		else
+			queue_weights[q] = clamp_t(unsigned int, weights[b], 1, 0x3ff);
+	}
+
+	rtl839x_set_scheduling_queue_weights(priv, port, queue_weights);
+	priv->ports[port].tc_root = handle;
+
+	return 0;
+}
+
+static int rtl83xx_qdisc_ets(struct rtl838x_switch_priv *priv, int port,
+			     struct tc_ets_qopt_offload *qopt)
+{
+	switch (qopt->command) {
+	case TC_ETS_REPLACE:
+		return rtl83xx_qdisc_sched(priv, port, qopt->parent, qopt->handle,
+					   qopt->replace_params.bands,
+					   qopt->replace_params.priomap,
+					   qopt->replace_params.quanta,
+					   qopt->replace_params.weights);
+	case TC_ETS_DESTROY:
+		if (priv->ports[port].tc_root == qopt->handle)
+			rtl83xx_qdisc_sched_reset(priv, port);
+		return 0;
+	case TC_ETS_STATS:
+	case TC_ETS_GRAFT:
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static int rtl83xx_qdisc_prio(struct rtl838x_switch_priv *priv, int port,
+			      struct tc_prio_qopt_offload *qopt)
+{
+	switch (qopt->command) {
+	case TC_PRIO_REPLACE:
+		return rtl83xx_qdisc_sched(priv, port, qopt->parent, qopt->handle,
+					   qopt->replace_params.bands,
+					   qopt->replace_params.priomap, NULL, NULL);
+	case TC_PRIO_DESTROY:
+		if (priv->ports[port].tc_root == qopt->handle)
+			rtl83xx_qdisc_sched_reset(priv, port);
+		return 0;
+	case TC_PRIO_STATS:
+	case TC_PRIO_GRAFT:
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+/* Qdisc offloads on the user ports, shaping switched traffic in the ASIC */
+int rtl83xx_port_setup_tc(struct dsa_switch *ds, int port, enum tc_setup_type type,
+			  void *type_data)
+{
+	struct rtl838x_switch_priv *priv = ds->priv;
+
+	if (priv->family_id != RTL8380_FAMILY_ID &&
+	    priv->family_id != RTL8390_FAMILY_ID)
+		return -EOPNOTSUPP;
+
+	if (port >= priv->cpu_port)
+		return -EOPNOTSUPP;
+
+	switch (type) {
+	case TC_SETUP_QDISC_TBF:
+		return rtl83xx_qdisc_tbf(priv, port, type_data);
+	case TC_SETUP_QDISC_ETS:
+		return rtl83xx_qdisc_ets(priv, port, type_data);
+	case TC_SETUP_QDISC_PRIO:
+		return rtl83xx_qdisc_prio(priv, port, type_data);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
 static LIST_HEAD(rtl83xx_block_cb_list);
 
 int rtl83xx_setup_tc(struct net_device *dev, enum tc_setup_type type, void *type_data)